@@ -0,0 +1,14 @@
+#!/bin/bash
+
+# Builds and runs the native golden-output regression tests and the stress benchmarks.
+# Results are written as JSON lines to test_results.jsonl and bench_results.jsonl.
+# The tests can also be run individually, e.g. ./libs/<platform>/zg-golden-test -t 2 ./test/
+# With -e, the dsp tests are also rendered with each dsp optimisation on and off, and must match.
+
+PLATFORM=`./src/platform`
+(cd src && make libzengarden-static native-test) || exit 1
+
+./libs/$PLATFORM/zg-golden-test -e -o test_results.jsonl ./test/
+RESULT=$?
+./libs/$PLATFORM/zg-benchmark -o bench_results.jsonl
+exit $RESULT
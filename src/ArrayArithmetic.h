@@ -27,8 +27,14 @@
 // The Accelerate framework is a library of tuned vector operations
 #include <Accelerate/Accelerate.h>
 #endif
+#if __AVX2__
+#include <immintrin.h>
+#endif
 #if __SSE__
 #include <xmmintrin.h>
+#if __SSE2__
+#include <emmintrin.h>
+#endif
 #elif __ARM_NEON__
 // __ARM_NEON__ is defined by the compiler if the arguments "-mfloat-abi=softfp -mfpu=neon" are passed.
 #include <arm_neon.h>
@@ -52,8 +58,8 @@ class ArrayArithmetic {
       output += startIndex;
       int n = endIndex - startIndex;
       
-      // align buffer to 16-byte boundary
-      switch (startIndex & 0x3) {
+      // align buffer to 16-byte boundary, unless there are too few samples to reach it
+      switch ((n < 4) ? 0 : (startIndex & 0x3)) {
         case 0: default: break;
         case 1: *output++ = *input0++ + *input1++; --n;
         case 2: *output++ = *input0++ + *input1++; --n;
@@ -110,12 +116,12 @@ class ArrayArithmetic {
       output += startIndex;
       int n = endIndex - startIndex;
       
-      // align buffer to 16-byte boundary
-      switch (startIndex & 0x3) {
+      // align buffer to 16-byte boundary, unless there are too few samples to reach it
+      switch ((n < 4) ? 0 : (startIndex & 0x3)) {
         case 0: default: break;
-        case 1: *output++ += constant; --n;
-        case 2: *output++ += constant; --n;
-        case 3: *output++ += constant; --n;
+        case 1: *output++ = *input++ + constant; --n;
+        case 2: *output++ = *input++ + constant; --n;
+        case 3: *output++ = *input++ + constant; --n;
       }
       
       int n4 = n & 0xFFFFFFFC;
@@ -126,9 +132,9 @@ class ArrayArithmetic {
       }
       
       switch (n & 0x3) {
-        case 3: *output++ += constant;
-        case 2: *output++ += constant;
-        case 1: *output++ += constant;
+        case 3: *output++ = *input++ + constant;
+        case 2: *output++ = *input++ + constant;
+        case 1: *output++ = *input++ + constant;
         case 0: default: break;
       }
       #elif __ARM_NEON__
@@ -146,9 +152,9 @@ class ArrayArithmetic {
         output += 4;
       }
       switch (n & 0x3) {
-        case 3: *output++ += constant;
-        case 2: *output++ += constant;
-        case 1: *output++ += constant;
+        case 3: *output++ = *input++ + constant;
+        case 2: *output++ = *input++ + constant;
+        case 1: *output++ = *input++ + constant;
         default: break;
       }
       #else
@@ -168,7 +174,7 @@ class ArrayArithmetic {
       output += startIndex;
       int n = endIndex - startIndex;
       
-      switch (startIndex & 0x3) {
+      switch ((n < 4) ? 0 : (startIndex & 0x3)) {
         case 0: default: break;
         case 1: *output++ = *input0++ - *input1++; --n;
         case 2: *output++ = *input0++ - *input1++; --n;
@@ -226,11 +232,11 @@ class ArrayArithmetic {
       output += startIndex;
       int n = endIndex - startIndex;
       
-      switch (startIndex & 0x3) {
+      switch ((n < 4) ? 0 : (startIndex & 0x3)) {
         case 0: default: break;
-        case 1: *output++ -= constant; --n;
-        case 2: *output++ -= constant; --n;
-        case 3: *output++ -= constant; --n;
+        case 1: *output++ = *input++ - constant; --n;
+        case 2: *output++ = *input++ - constant; --n;
+        case 3: *output++ = *input++ - constant; --n;
       }
       
       int n4 = n & 0xFFFFFFFC;
@@ -241,9 +247,9 @@ class ArrayArithmetic {
       }
       
       switch (n & 0x3) {
-        case 3: *output++ -= constant;
-        case 2: *output++ -= constant;
-        case 1: *output++ -= constant;
+        case 3: *output++ = *input++ - constant;
+        case 2: *output++ = *input++ - constant;
+        case 1: *output++ = *input++ - constant;
         case 0: default: break;
       }
       #elif __ARM_NEON__
@@ -261,9 +267,9 @@ class ArrayArithmetic {
         output += 4;
       }
       switch (n & 0x3) {
-        case 3: *output++ -= constant;
-        case 2: *output++ -= constant;
-        case 1: *output++ -= constant;
+        case 3: *output++ = *input++ - constant;
+        case 2: *output++ = *input++ - constant;
+        case 1: *output++ = *input++ - constant;
         default: break;
       }
       #else
@@ -282,7 +288,7 @@ class ArrayArithmetic {
       output += startIndex;
       int n = endIndex - startIndex;
       
-      switch (startIndex & 0x3) {
+      switch ((n < 4) ? 0 : (startIndex & 0x3)) {
         case 0: default: break;
         case 1: *output++ = *input0++ * *input1++; --n;
         case 2: *output++ = *input0++ * *input1++; --n;
@@ -339,11 +345,11 @@ class ArrayArithmetic {
       output += startIndex;
       int n = endIndex - startIndex;
       
-      switch (startIndex & 0x3) {
+      switch ((n < 4) ? 0 : (startIndex & 0x3)) {
         case 0: default: break;
-        case 1: *output++ *= constant; --n;
-        case 2: *output++ *= constant; --n;
-        case 3: *output++ *= constant; --n;
+        case 1: *output++ = *input++ * constant; --n;
+        case 2: *output++ = *input++ * constant; --n;
+        case 3: *output++ = *input++ * constant; --n;
       }
       
       int n4 = n & 0xFFFFFFFC;
@@ -354,9 +360,9 @@ class ArrayArithmetic {
       }
       
       switch (n & 0x3) {
-        case 3: *output++ *= constant;
-        case 2: *output++ *= constant;
-        case 1: *output++ *= constant;
+        case 3: *output++ = *input++ * constant;
+        case 2: *output++ = *input++ * constant;
+        case 1: *output++ = *input++ * constant;
         case 0: default: break;
       }
       #elif __ARM_NEON__
@@ -374,9 +380,9 @@ class ArrayArithmetic {
         output += 4;
       }
       switch (n & 0x3) {
-        case 3: *output++ *= constant;
-        case 2: *output++ *= constant;
-        case 1: *output++ *= constant;
+        case 3: *output++ = *input++ * constant;
+        case 2: *output++ = *input++ * constant;
+        case 1: *output++ = *input++ * constant;
         default: break;
       }
       #else
@@ -396,7 +402,7 @@ class ArrayArithmetic {
       output += startIndex;
       int n = endIndex - startIndex;
       
-      switch (startIndex & 0x3) {
+      switch ((n < 4) ? 0 : (startIndex & 0x3)) {
         case 0: default: break;
         case 1: *output++ = *input0++ / *input1++; --n;
         case 2: *output++ = *input0++ / *input1++; --n;
@@ -430,11 +436,11 @@ class ArrayArithmetic {
       output += startIndex;
       int n = endIndex - startIndex;
       
-      switch (startIndex & 0x3) {
+      switch ((n < 4) ? 0 : (startIndex & 0x3)) {
         case 0: default: break;
-        case 1: *output++ /= constant; --n;
-        case 2: *output++ /= constant; --n;
-        case 3: *output++ /= constant; --n;
+        case 1: *output++ = *input++ / constant; --n;
+        case 2: *output++ = *input++ / constant; --n;
+        case 3: *output++ = *input++ / constant; --n;
       }
       
       int n4 = n & 0xFFFFFFFC;
@@ -445,9 +451,9 @@ class ArrayArithmetic {
       }
       
       switch (n & 0x3) {
-        case 3: *output++ /= constant;
-        case 2: *output++ /= constant;
-        case 1: *output++ /= constant;
+        case 3: *output++ = *input++ / constant;
+        case 2: *output++ = *input++ / constant;
+        case 1: *output++ = *input++ / constant;
         case 0: default: break;
       }
       #else
@@ -464,7 +470,7 @@ class ArrayArithmetic {
       input += startIndex;
       int n = endIndex - startIndex;
       
-      switch (startIndex & 0x3) {
+      switch ((n < 4) ? 0 : (startIndex & 0x3)) {
         case 0: default: break;
         case 1: *input++ = constant; --n;
         case 2: *input++ = constant; --n;
@@ -506,10 +512,373 @@ class ArrayArithmetic {
       }
       #endif
     }
+
+    /**
+     * Returns true if every sample in the range is zero (of either sign). NaN is not silent. The
+     * input may be unaligned.
+     */
+    static inline bool isSilent(float *input, int startIndex, int endIndex) {
+      #if __APPLE__
+      float maxMagnitude = 0.0f;
+      vDSP_maxmgv(input+startIndex, 1, &maxMagnitude, endIndex-startIndex);
+      return maxMagnitude == 0.0f;
+      #elif __SSE__
+      input += startIndex;
+      int n = endIndex - startIndex;
+
+      // the bits of all samples are or'ed together. Only zeros leave nothing but the sign bit.
+      int n16 = n & 0xFFFFFFF0;
+      const __m128 zero = _mm_setzero_ps();
+      while (n16) {
+        __m128 bits = _mm_or_ps(_mm_or_ps(_mm_loadu_ps(input), _mm_loadu_ps(input+4)),
+            _mm_or_ps(_mm_loadu_ps(input+8), _mm_loadu_ps(input+12)));
+        if (_mm_movemask_ps(_mm_cmpneq_ps(bits, zero))) return false;
+        n16 -= 16; input += 16;
+      }
+      for (int i = 0; i < (n & 0xF); i++) {
+        if (input[i] != 0.0f) return false;
+      }
+      return true;
+      #elif __ARM_NEON__
+      input += startIndex;
+      int n = endIndex - startIndex;
+      int n4 = n & 0xFFFFFFFC;
+      uint32x4_t bits = vdupq_n_u32(0);
+      while (n4) {
+        bits = vorrq_u32(bits, vreinterpretq_u32_f32(vld1q_f32((const float32_t *) input)));
+        n4 -= 4;
+        input += 4;
+      }
+      // the sign bit is ignored, such that negative zero is silent as well
+      bits = vandq_u32(bits, vdupq_n_u32(0x7FFFFFFF));
+      uint32x2_t halves = vorr_u32(vget_low_u32(bits), vget_high_u32(bits));
+      if ((vget_lane_u32(halves, 0) | vget_lane_u32(halves, 1)) != 0) return false;
+      for (int i = 0; i < (n & 0x3); i++) {
+        if (input[i] != 0.0f) return false;
+      }
+      return true;
+      #else
+      for (int i = startIndex; i < endIndex; i++) {
+        if (input[i] != 0.0f) return false;
+      }
+      return true;
+      #endif
+    }
+
+    /**
+     * Reads a table at the indices input[i] + offset with 4-point polynomial interpolation, in the
+     * manner of Pd's tabread4~. Indices are clipped to [1, length-2], such that all four points
+     * are always within the table, which must therefore have at least four points. The input and
+     * output may be the same buffer.
+     */
+    static inline void interpolate4Clip(float *table, int length, float *input, float offset,
+        float *output, int startIndex, int endIndex) {
+      int maxIndex = length - 3;
+      int i = startIndex;
+      #if __AVX2__
+      const __m256 offsetVec = _mm256_set1_ps(offset);
+      const __m256 minVec = _mm256_set1_ps(1.0f);
+      const __m256 maxVec = _mm256_set1_ps((float) (maxIndex + 1));
+      const __m256 maxIndexVec = _mm256_set1_ps((float) maxIndex);
+      const __m256i oneVec = _mm256_set1_epi32(1);
+      for (; i <= endIndex - 8; i += 8) {
+        // a NaN index is clipped to the first point
+        __m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_loadu_ps(input+i), offsetVec),
+            minVec), maxVec);
+        __m256i xi = _mm256_cvttps_epi32(_mm256_min_ps(x, maxIndexVec));
+        __m256 frac = _mm256_sub_ps(x, _mm256_cvtepi32_ps(xi));
+        __m256 a = _mm256_i32gather_ps(table, _mm256_sub_epi32(xi, oneVec), 4);
+        __m256 b = _mm256_i32gather_ps(table, xi, 4);
+        __m256 c = _mm256_i32gather_ps(table + 1, xi, 4);
+        __m256 d = _mm256_i32gather_ps(table + 2, xi, 4);
+        _mm256_storeu_ps(output+i, interpolate4(a, b, c, d, frac));
+      }
+      #elif __SSE2__
+      const __m128 offsetVec = _mm_set1_ps(offset);
+      const __m128 minVec = _mm_set1_ps(1.0f);
+      const __m128 maxVec = _mm_set1_ps((float) (maxIndex + 1));
+      const __m128 maxIndexVec = _mm_set1_ps((float) maxIndex);
+      int xi[4] __attribute__ ((aligned (16)));
+      for (; i <= endIndex - 4; i += 4) {
+        __m128 x = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_loadu_ps(input+i), offsetVec), minVec), maxVec);
+        __m128i xiVec = _mm_cvttps_epi32(_mm_min_ps(x, maxIndexVec));
+        __m128 frac = _mm_sub_ps(x, _mm_cvtepi32_ps(xiVec));
+        _mm_store_si128((__m128i *) xi, xiVec);
+        // load the four consecutive points around each index, and transpose them into a, b, c, d
+        __m128 a = _mm_loadu_ps(table + xi[0] - 1);
+        __m128 b = _mm_loadu_ps(table + xi[1] - 1);
+        __m128 c = _mm_loadu_ps(table + xi[2] - 1);
+        __m128 d = _mm_loadu_ps(table + xi[3] - 1);
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        _mm_storeu_ps(output+i, interpolate4(a, b, c, d, frac));
+      }
+      #elif __ARM_NEON__
+      const float32x4_t offsetVec = vdupq_n_f32(offset);
+      const float32x4_t minVec = vdupq_n_f32(1.0f);
+      const float32x4_t maxVec = vdupq_n_f32((float) (maxIndex + 1));
+      const int32x4_t minIndexVec = vdupq_n_s32(1);
+      const int32x4_t maxIndexVec = vdupq_n_s32(maxIndex);
+      int32_t xi[4];
+      for (; i <= endIndex - 4; i += 4) {
+        float32x4_t x = vminq_f32(vmaxq_f32(vaddq_f32(vld1q_f32((const float32_t *) (input+i)),
+            offsetVec), minVec), maxVec);
+        // the integer indices are clipped again, as NaN survives the float comparisons
+        int32x4_t xiVec = vminq_s32(vmaxq_s32(vcvtq_s32_f32(x), minIndexVec), maxIndexVec);
+        float32x4_t frac = vsubq_f32(x, vcvtq_f32_s32(xiVec));
+        vst1q_s32(xi, xiVec);
+        float32x4_t a, b, c, d;
+        transpose4(vld1q_f32((const float32_t *) (table + xi[0] - 1)),
+            vld1q_f32((const float32_t *) (table + xi[1] - 1)),
+            vld1q_f32((const float32_t *) (table + xi[2] - 1)),
+            vld1q_f32((const float32_t *) (table + xi[3] - 1)), &a, &b, &c, &d);
+        vst1q_f32((float32_t *) (output+i), interpolate4(a, b, c, d, frac));
+      }
+      #endif
+      for (; i < endIndex; i++) {
+        float x = input[i] + offset;
+        int xi;
+        float frac;
+        if (!(x >= 1.0f)) { // also catches NaN
+          xi = 1;
+          frac = 0.0f;
+        } else if (x >= (float) (maxIndex + 1)) {
+          xi = maxIndex;
+          frac = 1.0f;
+        } else {
+          xi = (int) x;
+          frac = x - (float) xi;
+        }
+        output[i] = interpolate4(table[xi-1], table[xi], table[xi+1], table[xi+2], frac);
+      }
+    }
+  
+    /**
+     * Reads consecutive points of the input at a constant fraction in [0, 1] beyond each index, with
+     * the 4-point polynomial interpolation of Pd's vd~, as for a fixed fractional delay. The points
+     * from input[startIndex-1] to input[endIndex+1] are read. The input and output must not overlap.
+     */
+    static inline void interpolate4Fraction(float *input, float frac, float *output,
+        int startIndex, int endIndex) {
+      // the polynomial is linear in the points, so it is a filter with four constant weights
+      float wa = interpolate4(1.0f, 0.0f, 0.0f, 0.0f, frac);
+      float wb = interpolate4(0.0f, 1.0f, 0.0f, 0.0f, frac);
+      float wc = interpolate4(0.0f, 0.0f, 1.0f, 0.0f, frac);
+      float wd = interpolate4(0.0f, 0.0f, 0.0f, 1.0f, frac);
+      int i = startIndex;
+      #if __AVX2__
+      const __m256 waVec = _mm256_set1_ps(wa);
+      const __m256 wbVec = _mm256_set1_ps(wb);
+      const __m256 wcVec = _mm256_set1_ps(wc);
+      const __m256 wdVec = _mm256_set1_ps(wd);
+      for (; i <= endIndex - 8; i += 8) {
+        __m256 ab = _mm256_add_ps(_mm256_mul_ps(waVec, _mm256_loadu_ps(input+i-1)),
+            _mm256_mul_ps(wbVec, _mm256_loadu_ps(input+i)));
+        __m256 cd = _mm256_add_ps(_mm256_mul_ps(wcVec, _mm256_loadu_ps(input+i+1)),
+            _mm256_mul_ps(wdVec, _mm256_loadu_ps(input+i+2)));
+        _mm256_storeu_ps(output+i, _mm256_add_ps(ab, cd));
+      }
+      #elif __SSE__
+      const __m128 waVec = _mm_set1_ps(wa);
+      const __m128 wbVec = _mm_set1_ps(wb);
+      const __m128 wcVec = _mm_set1_ps(wc);
+      const __m128 wdVec = _mm_set1_ps(wd);
+      for (; i <= endIndex - 4; i += 4) {
+        __m128 ab = _mm_add_ps(_mm_mul_ps(waVec, _mm_loadu_ps(input+i-1)),
+            _mm_mul_ps(wbVec, _mm_loadu_ps(input+i)));
+        __m128 cd = _mm_add_ps(_mm_mul_ps(wcVec, _mm_loadu_ps(input+i+1)),
+            _mm_mul_ps(wdVec, _mm_loadu_ps(input+i+2)));
+        _mm_storeu_ps(output+i, _mm_add_ps(ab, cd));
+      }
+      #elif __ARM_NEON__
+      const float32x4_t waVec = vdupq_n_f32(wa);
+      const float32x4_t wbVec = vdupq_n_f32(wb);
+      const float32x4_t wcVec = vdupq_n_f32(wc);
+      const float32x4_t wdVec = vdupq_n_f32(wd);
+      for (; i <= endIndex - 4; i += 4) {
+        float32x4_t ab = vmlaq_f32(vmulq_f32(waVec, vld1q_f32((const float32_t *) (input+i-1))),
+            wbVec, vld1q_f32((const float32_t *) (input+i)));
+        float32x4_t cd = vmlaq_f32(vmulq_f32(wcVec, vld1q_f32((const float32_t *) (input+i+1))),
+            wdVec, vld1q_f32((const float32_t *) (input+i+2)));
+        vst1q_f32((float32_t *) (output+i), vaddq_f32(ab, cd));
+      }
+      #endif
+      for (; i < endIndex; i++) {
+        output[i] = (wa*input[i-1] + wb*input[i]) + (wc*input[i+1] + wd*input[i+2]);
+      }
+    }
+  
+    /**
+     * Reads a circular buffer at the indices input[i] with 4-point polynomial interpolation, as is
+     * done by Pd's vd~. Indices in [-length, 2*length) are wrapped into the buffer, as are the
+     * points around each index. The buffer must have at least three points. The input and output
+     * may be the same buffer.
+     */
+    static inline void interpolate4Wrap(float *buffer, int length, float *input, float *output,
+        int startIndex, int endIndex) {
+      float lengthFloat = (float) length;
+      int i = startIndex;
+      #if __AVX2__
+      const __m256 zeroVec = _mm256_setzero_ps();
+      const __m256 lengthVec = _mm256_set1_ps(lengthFloat);
+      const __m256 lastIndexVec = _mm256_set1_ps(lengthFloat - 1.0f);
+      const __m256i zeroIntVec = _mm256_setzero_si256();
+      const __m256i oneVec = _mm256_set1_epi32(1);
+      const __m256i twoVec = _mm256_set1_epi32(2);
+      const __m256i lengthIntVec = _mm256_set1_epi32(length);
+      const __m256i lastIndexIntVec = _mm256_set1_epi32(length - 1);
+      for (; i <= endIndex - 8; i += 8) {
+        __m256 x = _mm256_loadu_ps(input+i);
+        x = _mm256_add_ps(x, _mm256_and_ps(_mm256_cmp_ps(x, zeroVec, _CMP_LT_OQ), lengthVec));
+        x = _mm256_sub_ps(x, _mm256_and_ps(_mm256_cmp_ps(x, lengthVec, _CMP_GE_OQ), lengthVec));
+        x = _mm256_max_ps(x, zeroVec); // a NaN index reads the first point
+        __m256i xi = _mm256_cvttps_epi32(_mm256_min_ps(x, lastIndexVec));
+        __m256 frac = _mm256_sub_ps(x, _mm256_cvtepi32_ps(xi));
+        __m256i xa = _mm256_add_epi32(_mm256_sub_epi32(xi, oneVec),
+            _mm256_and_si256(_mm256_cmpeq_epi32(xi, zeroIntVec), lengthIntVec));
+        __m256i xc = _mm256_add_epi32(xi, oneVec);
+        xc = _mm256_sub_epi32(xc, _mm256_and_si256(_mm256_cmpgt_epi32(xc, lastIndexIntVec), lengthIntVec));
+        __m256i xd = _mm256_add_epi32(xi, twoVec);
+        xd = _mm256_sub_epi32(xd, _mm256_and_si256(_mm256_cmpgt_epi32(xd, lastIndexIntVec), lengthIntVec));
+        __m256 a = _mm256_i32gather_ps(buffer, xa, 4);
+        __m256 b = _mm256_i32gather_ps(buffer, xi, 4);
+        __m256 c = _mm256_i32gather_ps(buffer, xc, 4);
+        __m256 d = _mm256_i32gather_ps(buffer, xd, 4);
+        _mm256_storeu_ps(output+i, interpolate4(a, b, c, d, frac));
+      }
+      #elif __SSE2__
+      const __m128 zeroVec = _mm_setzero_ps();
+      const __m128 lengthVec = _mm_set1_ps(lengthFloat);
+      const __m128 lastIndexVec = _mm_set1_ps(lengthFloat - 1.0f);
+      const __m128 oneVec = _mm_set1_ps(1.0f);
+      const __m128 lastInteriorVec = _mm_set1_ps(lengthFloat - 2.0f);
+      int xi[4] __attribute__ ((aligned (16)));
+      __m128 rows[4];
+      for (; i <= endIndex - 4; i += 4) {
+        __m128 x = _mm_loadu_ps(input+i);
+        x = _mm_add_ps(x, _mm_and_ps(_mm_cmplt_ps(x, zeroVec), lengthVec));
+        x = _mm_sub_ps(x, _mm_and_ps(_mm_cmpge_ps(x, lengthVec), lengthVec));
+        x = _mm_max_ps(x, zeroVec);
+        __m128i xiVec = _mm_cvttps_epi32(_mm_min_ps(x, lastIndexVec));
+        __m128 frac = _mm_sub_ps(x, _mm_cvtepi32_ps(xiVec));
+        _mm_store_si128((__m128i *) xi, xiVec);
+        if (_mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(x, oneVec), _mm_cmplt_ps(x, lastInteriorVec))) == 0xF) {
+          // usually all four points around every index lie within the buffer
+          for (int k = 0; k < 4; k++) rows[k] = _mm_loadu_ps(buffer + xi[k] - 1);
+        } else {
+          for (int k = 0; k < 4; k++) {
+            rows[k] = _mm_setr_ps(buffer[wrapIndex(xi[k] - 1, length)], buffer[xi[k]],
+                buffer[wrapIndex(xi[k] + 1, length)], buffer[wrapIndex(xi[k] + 2, length)]);
+          }
+        }
+        _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+        _mm_storeu_ps(output+i, interpolate4(rows[0], rows[1], rows[2], rows[3], frac));
+      }
+      #elif __ARM_NEON__
+      const float32x4_t zeroVec = vdupq_n_f32(0.0f);
+      const float32x4_t lengthVec = vdupq_n_f32(lengthFloat);
+      const int32x4_t zeroIntVec = vdupq_n_s32(0);
+      const int32x4_t lastIndexIntVec = vdupq_n_s32(length - 1);
+      int32_t xi[4];
+      float32x4_t rows[4];
+      for (; i <= endIndex - 4; i += 4) {
+        float32x4_t x = vld1q_f32((const float32_t *) (input+i));
+        x = vaddq_f32(x, vreinterpretq_f32_u32(vandq_u32(vcltq_f32(x, zeroVec), vreinterpretq_u32_f32(lengthVec))));
+        x = vsubq_f32(x, vreinterpretq_f32_u32(vandq_u32(vcgeq_f32(x, lengthVec), vreinterpretq_u32_f32(lengthVec))));
+        int32x4_t xiVec = vminq_s32(vmaxq_s32(vcvtq_s32_f32(x), zeroIntVec), lastIndexIntVec);
+        float32x4_t frac = vsubq_f32(x, vcvtq_f32_s32(xiVec));
+        vst1q_s32(xi, xiVec);
+        for (int k = 0; k < 4; k++) {
+          if (xi[k] >= 1 && xi[k] <= length - 3) {
+            rows[k] = vld1q_f32((const float32_t *) (buffer + xi[k] - 1));
+          } else {
+            float row[4] = {buffer[wrapIndex(xi[k] - 1, length)], buffer[xi[k]],
+                buffer[wrapIndex(xi[k] + 1, length)], buffer[wrapIndex(xi[k] + 2, length)]};
+            rows[k] = vld1q_f32((const float32_t *) row);
+          }
+        }
+        float32x4_t a, b, c, d;
+        transpose4(rows[0], rows[1], rows[2], rows[3], &a, &b, &c, &d);
+        vst1q_f32((float32_t *) (output+i), interpolate4(a, b, c, d, frac));
+      }
+      #endif
+      for (; i < endIndex; i++) {
+        float x = input[i];
+        if (x < 0.0f) x += lengthFloat;
+        if (x >= lengthFloat) x -= lengthFloat;
+        int xi;
+        if (!(x >= 0.0f)) { // also catches NaN
+          x = 0.0f;
+          xi = 0;
+        } else {
+          xi = (x < lengthFloat - 1.0f) ? (int) x : length - 1;
+        }
+        output[i] = interpolate4(buffer[wrapIndex(xi - 1, length)], buffer[xi],
+            buffer[wrapIndex(xi + 1, length)], buffer[wrapIndex(xi + 2, length)], x - (float) xi);
+      }
+    }
     
   private:
     ArrayArithmetic(); // no instances of this object are allowed
     ~ArrayArithmetic();
+  
+    /** Wraps an index which is at most one length outside of [0, length). */
+    static inline int wrapIndex(int index, int length) {
+      return (index < 0) ? index + length : ((index >= length) ? index - length : index);
+    }
+  
+    /**
+     * The 4-point polynomial used by Pd's tabread4~ and vd~, which interpolates between b and c
+     * given the consecutive points a, b, c, and d, and a fraction in [0, 1].
+     */
+    static inline float interpolate4(float a, float b, float c, float d, float frac) {
+      float cminusb = c - b;
+      return b + frac * (cminusb - 0.1666667f * (1.0f - frac) *
+          ((d - a - 3.0f * cminusb) * frac + (d + 2.0f * a - 3.0f * b)));
+    }
+  
+    #if __AVX2__
+    static inline __m256 interpolate4(__m256 a, __m256 b, __m256 c, __m256 d, __m256 frac) {
+      __m256 three = _mm256_set1_ps(3.0f);
+      __m256 cminusb = _mm256_sub_ps(c, b);
+      __m256 p = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(d, a), _mm256_mul_ps(three, cminusb)), frac);
+      __m256 q = _mm256_sub_ps(_mm256_add_ps(d, _mm256_add_ps(a, a)), _mm256_mul_ps(three, b));
+      __m256 r = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.1666667f),
+          _mm256_sub_ps(_mm256_set1_ps(1.0f), frac)), _mm256_add_ps(p, q));
+      return _mm256_add_ps(b, _mm256_mul_ps(frac, _mm256_sub_ps(cminusb, r)));
+    }
+    #elif __SSE2__
+    static inline __m128 interpolate4(__m128 a, __m128 b, __m128 c, __m128 d, __m128 frac) {
+      __m128 three = _mm_set1_ps(3.0f);
+      __m128 cminusb = _mm_sub_ps(c, b);
+      __m128 p = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(d, a), _mm_mul_ps(three, cminusb)), frac);
+      __m128 q = _mm_sub_ps(_mm_add_ps(d, _mm_add_ps(a, a)), _mm_mul_ps(three, b));
+      __m128 r = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.1666667f), _mm_sub_ps(_mm_set1_ps(1.0f), frac)),
+          _mm_add_ps(p, q));
+      return _mm_add_ps(b, _mm_mul_ps(frac, _mm_sub_ps(cminusb, r)));
+    }
+    #elif __ARM_NEON__
+    static inline float32x4_t interpolate4(float32x4_t a, float32x4_t b, float32x4_t c, float32x4_t d,
+        float32x4_t frac) {
+      float32x4_t three = vdupq_n_f32(3.0f);
+      float32x4_t cminusb = vsubq_f32(c, b);
+      float32x4_t p = vmulq_f32(vsubq_f32(vsubq_f32(d, a), vmulq_f32(three, cminusb)), frac);
+      float32x4_t q = vsubq_f32(vaddq_f32(d, vaddq_f32(a, a)), vmulq_f32(three, b));
+      float32x4_t r = vmulq_f32(vmulq_f32(vdupq_n_f32(0.1666667f), vsubq_f32(vdupq_n_f32(1.0f), frac)),
+          vaddq_f32(p, q));
+      return vaddq_f32(b, vmulq_f32(frac, vsubq_f32(cminusb, r)));
+    }
+  
+    /** Transposes four rows of four points into the vectors of first, second, third, and fourth points. */
+    static inline void transpose4(float32x4_t r0, float32x4_t r1, float32x4_t r2, float32x4_t r3,
+        float32x4_t *a, float32x4_t *b, float32x4_t *c, float32x4_t *d) {
+      float32x4x2_t t01 = vtrnq_f32(r0, r1);
+      float32x4x2_t t23 = vtrnq_f32(r2, r3);
+      *a = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+      *b = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+      *c = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+      *d = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+    }
+    #endif
 };
 
 #endif // _ARRAY_ARITHMETIC_H_
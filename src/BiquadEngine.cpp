@@ -0,0 +1,324 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <math.h>
+#if __AVX2__
+#include <immintrin.h>
+#endif
+#if __SSE2__
+#include <emmintrin.h>
+#elif __ARM_NEON__
+#include <arm_neon.h>
+#endif
+#include "BiquadEngine.h"
+
+// state smaller than this is flushed to zero, as it is inaudible and may be denormal
+#define STATE_THRESHOLD 1e-20f
+
+BiquadEngine::BiquadEngine() {
+  setCoefficients(1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+  clear();
+}
+
+void BiquadEngine::setCoefficients(float b0, float b1, float b2, float a1, float a2) {
+  this->b0 = b0; this->b1 = b1; this->b2 = b2;
+  this->a1 = a1; this->a2 = a2;
+
+  // each column is the response to a unit impulse at one input of the block, or in one sample of
+  // the state, computed in double precision
+  for (int k = 0; k < BIQUAD_BLOCK_LENGTH + 4; k++) {
+    double x[BIQUAD_BLOCK_LENGTH + 2] = {0.0}; // x[j+2] is the input at time j
+    double y[BIQUAD_BLOCK_LENGTH + 2] = {0.0};
+    if (k < BIQUAD_BLOCK_LENGTH) x[k+2] = 1.0;
+    else if (k == BIQUAD_BLOCK_LENGTH) x[1] = 1.0; // x1
+    else if (k == BIQUAD_BLOCK_LENGTH + 1) x[0] = 1.0; // x2
+    else if (k == BIQUAD_BLOCK_LENGTH + 2) y[1] = 1.0; // y1
+    else y[0] = 1.0; // y2
+    for (int j = 2; j < BIQUAD_BLOCK_LENGTH + 2; j++) {
+      y[j] = b0*x[j] + b1*x[j-1] + b2*x[j-2] - a1*y[j-1] - a2*y[j-2];
+      blockMatrix[k][j-2] = (float) y[j];
+    }
+  }
+}
+
+void BiquadEngine::clear() {
+  x1 = x2 = y1 = y2 = 0.0f;
+}
+
+void BiquadEngine::setDirectFormIIState(float w1, float w2) {
+  // the direct form I state which results from w1 and w2 after a history of silence
+  x1 = w1 + a1*w2;
+  x2 = w2;
+  y1 = b0*w1 + b1*w2;
+  y2 = b0*w2;
+}
+
+void BiquadEngine::flushState() {
+  // written such that NaN is flushed as well
+  if (!(fabsf(x1) >= STATE_THRESHOLD)) x1 = 0.0f;
+  if (!(fabsf(x2) >= STATE_THRESHOLD)) x2 = 0.0f;
+  if (!(fabsf(y1) >= STATE_THRESHOLD)) y1 = 0.0f;
+  if (!(fabsf(y2) >= STATE_THRESHOLD)) y2 = 0.0f;
+}
+
+
+#pragma mark - Single Filter
+
+void BiquadEngine::process(const float *input, float *output, int length) {
+  int i = 0;
+  /*
+   * Each input is read before the output at the same index is written, as they may be the same.
+   * The part of each vector which depends on its inputs does not depend on the previous vector,
+   * and is computed while the previous vector finishes. Vectors of eight samples (AVX) are not
+   * faster, as the longer recursion across lanes outweighs the wider arithmetic.
+   */
+  #if __SSE2__
+  if (length >= 4) {
+    __m128 m0 = _mm_loadu_ps(blockMatrix[0]);
+    __m128 m1 = _mm_loadu_ps(blockMatrix[1]);
+    __m128 m2 = _mm_loadu_ps(blockMatrix[2]);
+    __m128 m3 = _mm_loadu_ps(blockMatrix[3]);
+    __m128 mx1 = _mm_loadu_ps(blockMatrix[BIQUAD_BLOCK_LENGTH]);
+    __m128 mx2 = _mm_loadu_ps(blockMatrix[BIQUAD_BLOCK_LENGTH+1]);
+    __m128 my1 = _mm_loadu_ps(blockMatrix[BIQUAD_BLOCK_LENGTH+2]);
+    __m128 my2 = _mm_loadu_ps(blockMatrix[BIQUAD_BLOCK_LENGTH+3]);
+    __m128 vx1 = _mm_set1_ps(x1);
+    __m128 vx2 = _mm_set1_ps(x2);
+    __m128 vy1 = _mm_set1_ps(y1);
+    __m128 vy2 = _mm_set1_ps(y2);
+    for (; i <= length - 4; i += 4) {
+      __m128 x = _mm_loadu_ps(input + i);
+      __m128 a = _mm_mul_ps(_mm_shuffle_ps(x, x, 0x00), m0);
+      __m128 b = _mm_mul_ps(_mm_shuffle_ps(x, x, 0x55), m1);
+      a = _mm_add_ps(a, _mm_mul_ps(_mm_shuffle_ps(x, x, 0xAA), m2));
+      b = _mm_add_ps(b, _mm_mul_ps(_mm_shuffle_ps(x, x, 0xFF), m3));
+      a = _mm_add_ps(a, _mm_mul_ps(vx1, mx1));
+      b = _mm_add_ps(b, _mm_mul_ps(vx2, mx2));
+      vx1 = _mm_shuffle_ps(x, x, 0xFF);
+      vx2 = _mm_shuffle_ps(x, x, 0xAA);
+      __m128 y = _mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(_mm_mul_ps(vy1, my1), _mm_mul_ps(vy2, my2)));
+      _mm_storeu_ps(output + i, y);
+      vy1 = _mm_shuffle_ps(y, y, 0xFF);
+      vy2 = _mm_shuffle_ps(y, y, 0xAA);
+    }
+    x1 = _mm_cvtss_f32(vx1);
+    x2 = _mm_cvtss_f32(vx2);
+    y1 = _mm_cvtss_f32(vy1);
+    y2 = _mm_cvtss_f32(vy2);
+  }
+  #elif __ARM_NEON__
+  if (length >= 4) {
+    float32x4_t m0 = vld1q_f32(blockMatrix[0]);
+    float32x4_t m1 = vld1q_f32(blockMatrix[1]);
+    float32x4_t m2 = vld1q_f32(blockMatrix[2]);
+    float32x4_t m3 = vld1q_f32(blockMatrix[3]);
+    float32x4_t mx1 = vld1q_f32(blockMatrix[BIQUAD_BLOCK_LENGTH]);
+    float32x4_t mx2 = vld1q_f32(blockMatrix[BIQUAD_BLOCK_LENGTH+1]);
+    float32x4_t my1 = vld1q_f32(blockMatrix[BIQUAD_BLOCK_LENGTH+2]);
+    float32x4_t my2 = vld1q_f32(blockMatrix[BIQUAD_BLOCK_LENGTH+3]);
+    float32x4_t vx1 = vdupq_n_f32(x1);
+    float32x4_t vx2 = vdupq_n_f32(x2);
+    float32x4_t vy1 = vdupq_n_f32(y1);
+    float32x4_t vy2 = vdupq_n_f32(y2);
+    for (; i <= length - 4; i += 4) {
+      float32x4_t x = vld1q_f32(input + i);
+      float32x2_t xLow = vget_low_f32(x);
+      float32x2_t xHigh = vget_high_f32(x);
+      float32x4_t a = vmulq_lane_f32(m0, xLow, 0);
+      float32x4_t b = vmulq_lane_f32(m1, xLow, 1);
+      a = vmlaq_lane_f32(a, m2, xHigh, 0);
+      b = vmlaq_lane_f32(b, m3, xHigh, 1);
+      a = vmlaq_f32(a, mx1, vx1);
+      b = vmlaq_f32(b, mx2, vx2);
+      vx1 = vdupq_lane_f32(xHigh, 1);
+      vx2 = vdupq_lane_f32(xHigh, 0);
+      float32x4_t y = vaddq_f32(vaddq_f32(a, b), vmlaq_f32(vmulq_f32(vy1, my1), vy2, my2));
+      vst1q_f32(output + i, y);
+      float32x2_t yHigh = vget_high_f32(y);
+      vy1 = vdupq_lane_f32(yHigh, 1);
+      vy2 = vdupq_lane_f32(yHigh, 0);
+    }
+    x1 = vgetq_lane_f32(vx1, 0);
+    x2 = vgetq_lane_f32(vx2, 0);
+    y1 = vgetq_lane_f32(vy1, 0);
+    y2 = vgetq_lane_f32(vy2, 0);
+  }
+  #endif
+  // the state is held locally, as the output may alias it for all the compiler knows
+  float _x1 = x1, _x2 = x2, _y1 = y1, _y2 = y2;
+  for (; i < length; i++) {
+    float x = input[i];
+    float y = b0*x + b1*_x1 + b2*_x2 - a1*_y1 - a2*_y2;
+    output[i] = y;
+    _x2 = _x1; _x1 = x;
+    _y2 = _y1; _y1 = y;
+  }
+  x1 = _x1; x2 = _x2; y1 = _y1; y2 = _y2;
+  flushState();
+}
+
+
+#pragma mark - Bank of Filters
+
+#if __AVX2__ || __SSE2__ || __ARM_NEON__
+#if __AVX2__
+#define BANK_WIDTH 8
+typedef __m256 bank_vector;
+#define bank_load(x) _mm256_loadu_ps(x)
+#define bank_store(x, v) _mm256_storeu_ps(x, v)
+#define bank_add(a, b) _mm256_add_ps(a, b)
+#define bank_sub(a, b) _mm256_sub_ps(a, b)
+#define bank_mul(a, b) _mm256_mul_ps(a, b)
+#elif __SSE2__
+#define BANK_WIDTH 4
+typedef __m128 bank_vector;
+#define bank_load(x) _mm_loadu_ps(x)
+#define bank_store(x, v) _mm_storeu_ps(x, v)
+#define bank_add(a, b) _mm_add_ps(a, b)
+#define bank_sub(a, b) _mm_sub_ps(a, b)
+#define bank_mul(a, b) _mm_mul_ps(a, b)
+#else
+#define BANK_WIDTH 4
+typedef float32x4_t bank_vector;
+#define bank_load(x) vld1q_f32(x)
+#define bank_store(x, v) vst1q_f32(x, v)
+#define bank_add(a, b) vaddq_f32(a, b)
+#define bank_sub(a, b) vsubq_f32(a, b)
+#define bank_mul(a, b) vmulq_f32(a, b)
+#endif
+
+/**
+ * Transposes four samples of each of BANK_WIDTH channels into four vectors of one sample of each
+ * channel.
+ */
+static inline void loadTransposed(float **buffers, int index, bank_vector *samples) {
+  #if __AVX2__
+  __m128 r0 = _mm_loadu_ps(buffers[0] + index), r4 = _mm_loadu_ps(buffers[4] + index);
+  __m128 r1 = _mm_loadu_ps(buffers[1] + index), r5 = _mm_loadu_ps(buffers[5] + index);
+  __m128 r2 = _mm_loadu_ps(buffers[2] + index), r6 = _mm_loadu_ps(buffers[6] + index);
+  __m128 r3 = _mm_loadu_ps(buffers[3] + index), r7 = _mm_loadu_ps(buffers[7] + index);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _MM_TRANSPOSE4_PS(r4, r5, r6, r7);
+  samples[0] = _mm256_insertf128_ps(_mm256_castps128_ps256(r0), r4, 1);
+  samples[1] = _mm256_insertf128_ps(_mm256_castps128_ps256(r1), r5, 1);
+  samples[2] = _mm256_insertf128_ps(_mm256_castps128_ps256(r2), r6, 1);
+  samples[3] = _mm256_insertf128_ps(_mm256_castps128_ps256(r3), r7, 1);
+  #elif __SSE2__
+  samples[0] = _mm_loadu_ps(buffers[0] + index);
+  samples[1] = _mm_loadu_ps(buffers[1] + index);
+  samples[2] = _mm_loadu_ps(buffers[2] + index);
+  samples[3] = _mm_loadu_ps(buffers[3] + index);
+  _MM_TRANSPOSE4_PS(samples[0], samples[1], samples[2], samples[3]);
+  #else
+  float32x4x2_t t01 = vtrnq_f32(vld1q_f32(buffers[0] + index), vld1q_f32(buffers[1] + index));
+  float32x4x2_t t23 = vtrnq_f32(vld1q_f32(buffers[2] + index), vld1q_f32(buffers[3] + index));
+  samples[0] = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+  samples[1] = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+  samples[2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+  samples[3] = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+  #endif
+}
+
+/** The inverse of loadTransposed(). */
+static inline void storeTransposed(float **buffers, int index, bank_vector *samples) {
+  #if __AVX2__
+  __m128 r0 = _mm256_castps256_ps128(samples[0]), r4 = _mm256_extractf128_ps(samples[0], 1);
+  __m128 r1 = _mm256_castps256_ps128(samples[1]), r5 = _mm256_extractf128_ps(samples[1], 1);
+  __m128 r2 = _mm256_castps256_ps128(samples[2]), r6 = _mm256_extractf128_ps(samples[2], 1);
+  __m128 r3 = _mm256_castps256_ps128(samples[3]), r7 = _mm256_extractf128_ps(samples[3], 1);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _MM_TRANSPOSE4_PS(r4, r5, r6, r7);
+  _mm_storeu_ps(buffers[0] + index, r0); _mm_storeu_ps(buffers[4] + index, r4);
+  _mm_storeu_ps(buffers[1] + index, r1); _mm_storeu_ps(buffers[5] + index, r5);
+  _mm_storeu_ps(buffers[2] + index, r2); _mm_storeu_ps(buffers[6] + index, r6);
+  _mm_storeu_ps(buffers[3] + index, r3); _mm_storeu_ps(buffers[7] + index, r7);
+  #elif __SSE2__
+  _MM_TRANSPOSE4_PS(samples[0], samples[1], samples[2], samples[3]);
+  _mm_storeu_ps(buffers[0] + index, samples[0]);
+  _mm_storeu_ps(buffers[1] + index, samples[1]);
+  _mm_storeu_ps(buffers[2] + index, samples[2]);
+  _mm_storeu_ps(buffers[3] + index, samples[3]);
+  #else
+  float32x4x2_t t01 = vtrnq_f32(samples[0], samples[1]);
+  float32x4x2_t t23 = vtrnq_f32(samples[2], samples[3]);
+  vst1q_f32(buffers[0] + index, vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])));
+  vst1q_f32(buffers[1] + index, vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])));
+  vst1q_f32(buffers[2] + index, vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])));
+  vst1q_f32(buffers[3] + index, vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])));
+  #endif
+}
+#endif
+
+void BiquadEngine::processBank(BiquadEngine **filters, float **inputs, float **outputs, int numFilters,
+    int length) {
+  int j = 0;
+  #if __AVX2__ || __SSE2__ || __ARM_NEON__
+  for (; j <= numFilters - BANK_WIDTH; j += BANK_WIDTH) {
+    BiquadEngine **f = filters + j;
+    // the coefficients and state of each filter in its own lane
+    float lanes[9][BANK_WIDTH];
+    for (int k = 0; k < BANK_WIDTH; k++) {
+      lanes[0][k] = f[k]->b0; lanes[1][k] = f[k]->b1; lanes[2][k] = f[k]->b2;
+      lanes[3][k] = f[k]->a1; lanes[4][k] = f[k]->a2;
+      lanes[5][k] = f[k]->x1; lanes[6][k] = f[k]->x2;
+      lanes[7][k] = f[k]->y1; lanes[8][k] = f[k]->y2;
+    }
+    bank_vector vb0 = bank_load(lanes[0]), vb1 = bank_load(lanes[1]), vb2 = bank_load(lanes[2]);
+    bank_vector va1 = bank_load(lanes[3]), va2 = bank_load(lanes[4]);
+    bank_vector vx1 = bank_load(lanes[5]), vx2 = bank_load(lanes[6]);
+    bank_vector vy1 = bank_load(lanes[7]), vy2 = bank_load(lanes[8]);
+    int i = 0;
+    for (; i <= length - 4; i += 4) {
+      bank_vector samples[4];
+      loadTransposed(inputs + j, i, samples);
+      for (int t = 0; t < 4; t++) {
+        bank_vector x = samples[t];
+        bank_vector y = bank_sub(
+            bank_add(bank_add(bank_mul(vb0, x), bank_mul(vb1, vx1)), bank_mul(vb2, vx2)),
+            bank_add(bank_mul(va1, vy1), bank_mul(va2, vy2)));
+        vx2 = vx1; vx1 = x;
+        vy2 = vy1; vy1 = y;
+        samples[t] = y;
+      }
+      storeTransposed(outputs + j, i, samples);
+    }
+    bank_store(lanes[5], vx1); bank_store(lanes[6], vx2);
+    bank_store(lanes[7], vy1); bank_store(lanes[8], vy2);
+    for (int k = 0; k < BANK_WIDTH; k++) {
+      BiquadEngine *filter = f[k];
+      filter->x1 = lanes[5][k]; filter->x2 = lanes[6][k];
+      filter->y1 = lanes[7][k]; filter->y2 = lanes[8][k];
+      // the remainder of the samples
+      for (int n = i; n < length; n++) {
+        outputs[j+k][n] = filter->processSample(inputs[j+k][n],
+            filter->b0, filter->b1, filter->b2, filter->a1, filter->a2);
+      }
+      filter->flushState();
+    }
+  }
+  #endif
+  // the remainder of the filters
+  for (; j < numFilters; j++) {
+    filters[j]->process(inputs[j], outputs[j], length);
+  }
+}
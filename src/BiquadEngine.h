@@ -0,0 +1,98 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _BIQUAD_ENGINE_H_
+#define _BIQUAD_ENGINE_H_
+
+// the number of samples which process() computes together
+#define BIQUAD_BLOCK_LENGTH 4
+
+/**
+ * A second order IIR filter, y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - a1*y[n-1] - a2*y[n-2], for
+ * [biquad~], [lop~], [hip~], and [bp~]. The input and output may be the same buffer.
+ *
+ * A single filter is computed a vector of samples at a time. Each vector of outputs is the product
+ * of a matrix with the vector of inputs and the four samples of state, such that the recursion only
+ * runs from one vector to the next. The matrix is computed whenever the coefficients change.
+ *
+ * A bank of filters, such as for many voices, is instead computed a vector of filters at a time,
+ * each filter in its own lane.
+ */
+class BiquadEngine {
+
+  public:
+    BiquadEngine();
+
+    void setCoefficients(float b0, float b1, float b2, float a1, float a2);
+
+    /** Resets the filter to silence. */
+    void clear();
+
+    /** Returns true if the filter is at rest, such that it outputs silence for silence. */
+    bool isAtRest() { return x1 == 0.0f && x2 == 0.0f && y1 == 0.0f && y2 == 0.0f; }
+
+    /**
+     * Sets the state of the equivalent direct form II filter, w[n] = x[n] - a1*w[n-1] - a2*w[n-2]
+     * and y[n] = b0*w[n] + b1*w[n-1] + b2*w[n-2], as with the "set" message of [biquad~].
+     */
+    void setDirectFormIIState(float w1, float w2);
+
+    /** Filters the input into the output. */
+    void process(const float *input, float *output, int length);
+
+    /**
+     * Filters one sample with the given coefficients, which replace none of the filter's own. For
+     * coefficients which change every sample, such as those computed from a signal.
+     */
+    inline float processSample(float x, float b0, float b1, float b2, float a1, float a2) {
+      float y = b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2;
+      x2 = x1; x1 = x;
+      y2 = y1; y1 = y;
+      return y;
+    }
+
+    /**
+     * Ensures that the state is neither denormal nor NaN, such that a filter which has decayed or
+     * become unstable continues at full speed. It is called at the end of each process().
+     */
+    void flushState();
+
+    /**
+     * Filters each input into the corresponding output with the corresponding filter. An output
+     * may only be the same buffer as its own input.
+     */
+    static void processBank(BiquadEngine **filters, float **inputs, float **outputs, int numFilters,
+        int length);
+
+  private:
+    float b0, b1, b2, a1, a2;
+    float x1, x2, y1, y2; // the previous two inputs and outputs
+
+    /**
+     * The response of the first BIQUAD_BLOCK_LENGTH outputs to each input of the block, followed by
+     * the response to each of x1, x2, y1, and y2. Column-major, such that each column is a vector.
+     */
+    float blockMatrix[BIQUAD_BLOCK_LENGTH + 4][BIQUAD_BLOCK_LENGTH];
+};
+
+#endif // _BIQUAD_ENGINE_H_
@@ -0,0 +1,130 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string.h>
+#include "BlockDeadlineMonitor.h"
+
+BlockDeadlineMonitor::BlockDeadlineMonitor(double blockDurationMs) {
+  this->blockDurationMs = blockDurationMs;
+  deadlineNs = (uint64_t) (blockDurationMs * 1000000.0);
+  sequence = 0;
+  shouldReset = false;
+  clear();
+}
+
+BlockDeadlineMonitor::~BlockDeadlineMonitor() {
+  // nothing to do
+}
+
+void BlockDeadlineMonitor::clear() {
+  numBlocks = 0;
+  numOverruns = 0;
+  totalNs = 0;
+  minNs = 0;
+  maxNs = 0;
+  totalMessageNs = 0;
+  maxMessageNs = 0;
+  totalDspNs = 0;
+  maxDspNs = 0;
+  slowestGraphId = -1;
+  slowestGraphNs = 0;
+  totalSkippedDspNodes = 0;
+  memset(histogram, 0, sizeof(histogram));
+}
+
+void BlockDeadlineMonitor::recordBlock(uint64_t messageNs, uint64_t dspNs,
+    int graphId, uint64_t graphNs, unsigned int numSkippedDspNodes) {
+  ++sequence; // odd, update in progress
+  __sync_synchronize();
+
+  if (shouldReset) {
+    shouldReset = false;
+    clear();
+  }
+
+  uint64_t blockNs = messageNs + dspNs;
+  if (numBlocks == 0 || blockNs < minNs) minNs = blockNs;
+  if (blockNs > maxNs) maxNs = blockNs;
+  if (blockNs > deadlineNs) ++numOverruns;
+  totalNs += blockNs;
+  totalMessageNs += messageNs;
+  if (messageNs > maxMessageNs) maxMessageNs = messageNs;
+  totalDspNs += dspNs;
+  if (dspNs > maxDspNs) maxDspNs = dspNs;
+  if (graphId >= 0 && graphNs > slowestGraphNs) {
+    slowestGraphId = graphId;
+    slowestGraphNs = graphNs;
+  }
+  totalSkippedDspNodes += numSkippedDspNodes;
+
+  uint64_t bucket = (deadlineNs > 0) ? (blockNs * 100) / deadlineNs : 0;
+  ++histogram[(bucket < BLOCK_HISTOGRAM_NUM_BUCKETS) ? bucket : BLOCK_HISTOGRAM_NUM_BUCKETS-1];
+  ++numBlocks;
+
+  __sync_synchronize();
+  ++sequence; // even, update complete
+}
+
+void BlockDeadlineMonitor::getStatistics(ZGBlockStatistics *stats) {
+  unsigned int localHistogram[BLOCK_HISTOGRAM_NUM_BUCKETS];
+  unsigned int startSequence;
+  do {
+    // wait for the audio thread to leave the critical section, then copy everything
+    while ((startSequence = sequence) & 0x1);
+    __sync_synchronize();
+
+    stats->deadlineMs = blockDurationMs;
+    stats->numBlocks = numBlocks;
+    stats->numOverruns = numOverruns;
+    stats->minMs = ((double) minNs) / 1000000.0;
+    stats->maxMs = ((double) maxNs) / 1000000.0;
+    stats->avgMs = (numBlocks > 0) ? ((double) totalNs) / (numBlocks * 1000000.0) : 0.0;
+    stats->avgMessageMs = (numBlocks > 0) ? ((double) totalMessageNs) / (numBlocks * 1000000.0) : 0.0;
+    stats->maxMessageMs = ((double) maxMessageNs) / 1000000.0;
+    stats->avgDspMs = (numBlocks > 0) ? ((double) totalDspNs) / (numBlocks * 1000000.0) : 0.0;
+    stats->maxDspMs = ((double) maxDspNs) / 1000000.0;
+    stats->slowestGraphId = slowestGraphId;
+    stats->slowestGraphMs = ((double) slowestGraphNs) / 1000000.0;
+    stats->avgSkippedDspNodes = (numBlocks > 0) ? ((double) totalSkippedDspNodes) / numBlocks : 0.0;
+    memcpy(localHistogram, histogram, sizeof(histogram));
+
+    __sync_synchronize();
+  } while (startSequence != sequence);
+
+  // the 99th percentile is resolved to the upper edge of the bucket in which it falls
+  stats->p99Ms = 0.0;
+  if (stats->numBlocks > 0) {
+    unsigned int threshold = stats->numBlocks - (stats->numBlocks / 100);
+    unsigned int count = 0;
+    for (int i = 0; i < BLOCK_HISTOGRAM_NUM_BUCKETS; i++) {
+      count += localHistogram[i];
+      if (count >= threshold) {
+        stats->p99Ms = (i < BLOCK_HISTOGRAM_NUM_BUCKETS-1)
+            ? (blockDurationMs * (i+1)) / 100.0 : stats->maxMs;
+        break;
+      }
+    }
+    // the bucket edge may be coarser than the actual extremes
+    if (stats->p99Ms > stats->maxMs) stats->p99Ms = stats->maxMs;
+    if (stats->p99Ms < stats->minMs) stats->p99Ms = stats->minMs;
+  }
+}
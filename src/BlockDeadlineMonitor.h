@@ -0,0 +1,91 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _BLOCK_DEADLINE_MONITOR_H_
+#define _BLOCK_DEADLINE_MONITOR_H_
+
+#include "ProfileTimer.h"
+#include "ZenGarden.h"
+
+// the histogram resolves block load in 1% steps of the deadline. The last bucket collects everything beyond.
+#define BLOCK_HISTOGRAM_NUM_BUCKETS 256
+
+/**
+ * The <code>BlockDeadlineMonitor</code> keeps statistics on how long each call to
+ * <code>PdContext::process()</code> takes relative to the duration of one block (the deadline).
+ * It is written to by exactly one thread (the audio thread) and never locks or allocates, such
+ * that it can be left on permanently. Other threads take consistent snapshots of the statistics
+ * by way of a sequence counter, retrying if a block was recorded in the meantime.
+ */
+class BlockDeadlineMonitor {
+
+  public:
+    BlockDeadlineMonitor(double blockDurationMs);
+    ~BlockDeadlineMonitor();
+
+    /**
+     * Records the timing of one block. All times are in nanoseconds. <code>slowestGraphId</code>
+     * is the id of the graph which took the longest in this block, or -1 if unknown.
+     * <code>numSkippedDspNodes</code> is the number of dsp objects which sleeping graphs did not
+     * process. Must only be called from the audio thread.
+     */
+    void recordBlock(uint64_t messageNs, uint64_t dspNs, int slowestGraphId, uint64_t slowestGraphNs,
+        unsigned int numSkippedDspNodes);
+
+    /**
+     * Requests that all statistics be cleared. The reset is carried out by the audio thread at the
+     * next call to <code>recordBlock()</code>, such that there is never more than one writer.
+     */
+    void reset() { shouldReset = true; }
+
+    /** Fills in a snapshot of the current statistics. May be called from any thread. */
+    void getStatistics(ZGBlockStatistics *stats);
+
+  private:
+    void clear();
+
+    double blockDurationMs;
+    uint64_t deadlineNs;
+
+    /** Odd while the audio thread is updating the statistics, even otherwise. */
+    volatile unsigned int sequence;
+
+    volatile bool shouldReset;
+
+    unsigned int numBlocks;
+    unsigned int numOverruns;
+    uint64_t totalNs;
+    uint64_t minNs;
+    uint64_t maxNs;
+    uint64_t totalMessageNs;
+    uint64_t maxMessageNs;
+    uint64_t totalDspNs;
+    uint64_t maxDspNs;
+    int slowestGraphId;
+    uint64_t slowestGraphNs;
+    uint64_t totalSkippedDspNodes;
+
+    /** The number of blocks falling into each percentage of the deadline. */
+    unsigned int histogram[BLOCK_HISTOGRAM_NUM_BUCKETS];
+};
+
+#endif // _BLOCK_DEADLINE_MONITOR_H_
@@ -28,6 +28,10 @@ BufferPool::BufferPool(unsigned short size) {
  
   zeroBuffer = ALLOC_ALIGNED_BUFFER(bufferSize * sizeof(float));
   memset(zeroBuffer, 0, bufferSize*sizeof(float)); // zero the zero buffer!
+
+  scratchBuffers = NULL;
+  numScratchBuffers = 0;
+  numHolds = 0;
 }
 
 BufferPool::~BufferPool() {
@@ -39,7 +43,14 @@ BufferPool::~BufferPool() {
     FREE_ALIGNED_BUFFER(pool.top());
     pool.pop();
   }
+  for (list<float *>::iterator it = held.begin(); it != held.end(); ++it) {
+    FREE_ALIGNED_BUFFER(*it);
+  }
   FREE_ALIGNED_BUFFER(zeroBuffer);
+  for (map<unsigned int, float *>::iterator it = constantBuffers.begin(); it != constantBuffers.end(); ++it) {
+    FREE_ALIGNED_BUFFER(it->second);
+  }
+  FREE_ALIGNED_BUFFER(scratchBuffers);
 }
 
 float *BufferPool::getBuffer(unsigned int numDependencies) {
@@ -56,6 +67,43 @@ float *BufferPool::getBuffer(unsigned int numDependencies) {
   return buffer;
 }
 
+float *BufferPool::getConstantBuffer(float value) {
+  unsigned int key = 0;
+  memcpy(&key, &value, sizeof(float));
+  if (key == 0) return zeroBuffer;
+  map<unsigned int, float *>::iterator it = constantBuffers.find(key);
+  if (it != constantBuffers.end()) return it->second;
+  float *buffer = ALLOC_ALIGNED_BUFFER(bufferSize * sizeof(float));
+  for (int i = 0; i < bufferSize; i++) {
+    buffer[i] = value;
+  }
+  constantBuffers[key] = buffer;
+  return buffer;
+}
+
+bool BufferPool::isConstantBuffer(float *buffer, float *value) {
+  if (buffer == zeroBuffer) {
+    *value = 0.0f;
+    return true;
+  }
+  for (map<unsigned int, float *>::iterator it = constantBuffers.begin(); it != constantBuffers.end(); ++it) {
+    if (it->second == buffer) {
+      *value = buffer[0];
+      return true;
+    }
+  }
+  return false;
+}
+
+float *BufferPool::getScratchBuffers(unsigned int numBuffers) {
+  if (numBuffers > numScratchBuffers) {
+    FREE_ALIGNED_BUFFER(scratchBuffers);
+    scratchBuffers = ALLOC_ALIGNED_BUFFER(numBuffers * bufferSize * sizeof(float));
+    numScratchBuffers = numBuffers;
+  }
+  return scratchBuffers;
+}
+
 void BufferPool::releaseBuffer(float *buffer) {
   // an object may try to release the zero buffer. This should not be possible.
   if (buffer == zeroBuffer) return;
@@ -65,7 +113,11 @@ void BufferPool::releaseBuffer(float *buffer) {
       --((*it).second);
       if ((*it).second <= 0) {
         reserved.erase(it);
-        pool.push(buffer);
+        if (numHolds > 0) {
+          held.push_back(buffer);
+        } else {
+          pool.push(buffer);
+        }
 //        printf("%i/%i buffer used.\n", getNumReservedBuffers(), getNumTotalBuffers());
         break;
       }
@@ -88,6 +140,19 @@ void BufferPool::reserveBuffer(float *buffer, unsigned int reserveCount) {
       "This may be ok if the buffer is global such as an adc~ input buffer.\n", buffer, reserveCount);
 }
 
+void BufferPool::holdReleasedBuffers() {
+  numHolds++;
+}
+
+void BufferPool::releaseHeldBuffers() {
+  if (numHolds > 0 && --numHolds == 0) {
+    while (!held.empty()) {
+      pool.push(held.front());
+      held.pop_front();
+    }
+  }
+}
+
 /*
 void BufferPool::resizeBuffers(unsigned int newBufferSize) {
   for (list<std::pair<float *, unsigned int> >::iterator it = reserved.begin(); it != reserved.end(); ++it) {
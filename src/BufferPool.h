@@ -24,6 +24,7 @@
 #define _BUFFER_POOL_
 
 #include <list>
+#include <map>
 #include <stack>
 using namespace std;
 
@@ -44,11 +45,39 @@ class BufferPool {
     /** Add to the reserve cound of the given buffer. */
     void reserveBuffer(float *buffer, unsigned int reserveCount);
   
+    /**
+     * Buffers which are released after this call are not made available again until
+     * <code>releaseHeldBuffers()</code>, such that every buffer which is reserved in the meantime is
+     * distinct from all others which are reserved in the meantime. The objects which are ordered
+     * in between may then be processed in any order which respects their connections. Holds nest.
+     */
+    void holdReleasedBuffers();
+    void releaseHeldBuffers();
+  
     /** Resizes all buffers in the pool (reserved and available). */
 //    void resizeBuffers(unsigned int newBufferSize);
   
     float *getZeroBuffer() { return zeroBuffer; }
   
+    /**
+     * Returns a buffer which is filled with the given value, and which all objects of the context
+     * share. It must not be written to. It is kept for as long as the pool.
+     */
+    float *getConstantBuffer(float value);
+  
+    /**
+     * Returns true if the given buffer is the zero buffer or a constant buffer, in which case the
+     * value which fills it is returned in <code>value</code>.
+     */
+    bool isConstantBuffer(float *buffer, float *value);
+  
+    /**
+     * Returns a scratch area of at least the given number of consecutive buffers, which all objects
+     * of the context share. Its contents are only valid while one object is processed, and it may
+     * move when a larger area is requested.
+     */
+    float *getScratchBuffers(unsigned int numBuffers);
+  
     unsigned int getNumReservedBuffers() { return reserved.size(); }
     unsigned int getNumAvailableBuffers() { return pool.size(); }
     unsigned int getNumTotalBuffers() { return (pool.size() + reserved.size()); }
@@ -60,8 +89,18 @@ class BufferPool {
     /** A pool of available buffers. */
     stack<float *> pool;
   
+    /** The buffers which have been released while held. See <code>holdReleasedBuffers()</code>. */
+    list<float *> held;
+    unsigned int numHolds;
+  
     float *zeroBuffer;
   
+    /** The constant buffers, by the bit pattern of their value, such that -0 and NaN are distinct. */
+    map<unsigned int, float *> constantBuffers;
+  
+    float *scratchBuffers;
+    unsigned int numScratchBuffers;
+  
     unsigned short bufferSize;
 };
 
@@ -0,0 +1,323 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <math.h>
+#if __AVX2__
+#include <immintrin.h>
+#endif
+#if __SSE2__
+#include <emmintrin.h>
+#elif __ARM_NEON__
+#include <arm_neon.h>
+#endif
+#include "CosineEngine.h"
+
+// the table has 2^TABLE_BITS entries, indexed by the top bits of the phase
+#define TABLE_BITS 10
+#define TABLE_LENGTH (1 << TABLE_BITS)
+#define FRACTION_BITS (32 - TABLE_BITS)
+#define FRACTION_MASK ((1 << FRACTION_BITS) - 1)
+#define FRACTION_SCALE (1.0f / (1 << FRACTION_BITS))
+#define PHASE_SCALE 4294967296.0f // 2^32
+#define INVERSE_PHASE_SCALE (1.0f / 4294967296.0f)
+
+/*
+ * sin(2*pi*u) ~= u*(C1 + C3*u^2 + C5*u^4 + C7*u^6 + C9*u^8) for u in [-1/4, 1/4], fitted for the
+ * least maximum error. cos(2*pi*t) for t in [-1/2, 1/2] is sin(2*pi*(1/4 - |t|)).
+ */
+#define C1 6.283185160e+00f
+#define C3 -4.134165509e+01f
+#define C5 8.160100774e+01f
+#define C7 -7.654987134e+01f
+#define C9 3.953741480e+01f
+
+/**
+ * Each entry is a pair of the cosine at that index and the slope to the next index, such that one
+ * interpolated lookup reads one pair.
+ */
+static float cosineTable[2 * TABLE_LENGTH] __attribute__((aligned(16)));
+
+static bool fillCosineTable() {
+  for (int i = 0; i < TABLE_LENGTH; i++) {
+    double value = cos(2.0 * M_PI * i / TABLE_LENGTH);
+    double nextValue = cos(2.0 * M_PI * (i+1) / TABLE_LENGTH);
+    cosineTable[2*i] = (float) value;
+    cosineTable[2*i+1] = (float) (nextValue - value);
+  }
+  return true;
+}
+
+// the table is filled when the library is loaded, before any context can exist
+static bool isCosineTableFilled = fillCosineTable();
+
+
+#pragma mark - Scalar
+
+inline float CosineEngine::lookup(uint32_t phase) {
+  const float *entry = cosineTable + 2 * (phase >> FRACTION_BITS);
+  return entry[0] + ((float) (phase & FRACTION_MASK)) * FRACTION_SCALE * entry[1];
+}
+
+inline float CosineEngine::polynomial(float periods) {
+  float u = 0.25f - fabsf(periods);
+  float u2 = u * u;
+  return u * (C1 + u2 * (C3 + u2 * (C5 + u2 * (C7 + u2 * C9))));
+}
+
+float CosineEngine::cosine(double periods, CosineAccuracy accuracy) {
+  double t = periods - floor(periods + 0.5); // in [-1/2, 1/2)
+  return (accuracy == COSINE_ACCURACY_POLYNOMIAL)
+      ? polynomial((float) t) : lookup((uint32_t) (int64_t) (t * 4294967296.0));
+}
+
+
+#pragma mark - Vector
+
+#if __AVX2__
+static inline __m256 lookup8(__m256i phases) {
+  __m256i indicies = _mm256_slli_epi32(_mm256_srli_epi32(phases, FRACTION_BITS), 1);
+  __m256 fraction = _mm256_mul_ps(_mm256_cvtepi32_ps(
+      _mm256_and_si256(phases, _mm256_set1_epi32(FRACTION_MASK))), _mm256_set1_ps(FRACTION_SCALE));
+  __m256 value = _mm256_i32gather_ps(cosineTable, indicies, 4);
+  __m256 slope = _mm256_i32gather_ps(cosineTable+1, indicies, 4);
+  return _mm256_add_ps(value, _mm256_mul_ps(fraction, slope));
+}
+
+static inline __m256 polynomial8(__m256 periods) {
+  __m256 u = _mm256_sub_ps(_mm256_set1_ps(0.25f),
+      _mm256_andnot_ps(_mm256_set1_ps(-0.0f), periods)); // 1/4 - |t|
+  __m256 u2 = _mm256_mul_ps(u, u);
+  __m256 p = _mm256_add_ps(_mm256_mul_ps(u2, _mm256_set1_ps(C9)), _mm256_set1_ps(C7));
+  p = _mm256_add_ps(_mm256_mul_ps(u2, p), _mm256_set1_ps(C5));
+  p = _mm256_add_ps(_mm256_mul_ps(u2, p), _mm256_set1_ps(C3));
+  p = _mm256_add_ps(_mm256_mul_ps(u2, p), _mm256_set1_ps(C1));
+  return _mm256_mul_ps(u, p);
+}
+
+static inline __m256 periodsOfPhases8(__m256i phases) {
+  // as a signed integer, the phase is in [-1/2, 1/2) of a period
+  return _mm256_mul_ps(_mm256_cvtepi32_ps(phases), _mm256_set1_ps(INVERSE_PHASE_SCALE));
+}
+
+static inline __m256 reducePeriods8(__m256 periods) {
+  return _mm256_sub_ps(periods, _mm256_round_ps(periods, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+}
+#elif __SSE2__
+static inline __m128 lookup4(__m128i phases) {
+  __m128i indicies = _mm_slli_epi32(_mm_srli_epi32(phases, FRACTION_BITS), 1);
+  __m128 fraction = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(phases, _mm_set1_epi32(FRACTION_MASK))),
+      _mm_set1_ps(FRACTION_SCALE));
+  // each (value, slope) pair is read with one load
+  int32_t offsets[4] __attribute__((aligned(16)));
+  _mm_store_si128((__m128i *) offsets, indicies);
+  __m128 pairs01 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (__m64 *) (cosineTable + offsets[0])),
+      (__m64 *) (cosineTable + offsets[1]));
+  __m128 pairs23 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (__m64 *) (cosineTable + offsets[2])),
+      (__m64 *) (cosineTable + offsets[3]));
+  __m128 value = _mm_shuffle_ps(pairs01, pairs23, _MM_SHUFFLE(2, 0, 2, 0));
+  __m128 slope = _mm_shuffle_ps(pairs01, pairs23, _MM_SHUFFLE(3, 1, 3, 1));
+  return _mm_add_ps(value, _mm_mul_ps(fraction, slope));
+}
+
+static inline __m128 polynomial4(__m128 periods) {
+  __m128 u = _mm_sub_ps(_mm_set1_ps(0.25f), _mm_andnot_ps(_mm_set1_ps(-0.0f), periods)); // 1/4 - |t|
+  __m128 u2 = _mm_mul_ps(u, u);
+  __m128 p = _mm_add_ps(_mm_mul_ps(u2, _mm_set1_ps(C9)), _mm_set1_ps(C7));
+  p = _mm_add_ps(_mm_mul_ps(u2, p), _mm_set1_ps(C5));
+  p = _mm_add_ps(_mm_mul_ps(u2, p), _mm_set1_ps(C3));
+  p = _mm_add_ps(_mm_mul_ps(u2, p), _mm_set1_ps(C1));
+  return _mm_mul_ps(u, p);
+}
+
+static inline __m128 periodsOfPhases4(__m128i phases) {
+  // as a signed integer, the phase is in [-1/2, 1/2) of a period
+  return _mm_mul_ps(_mm_cvtepi32_ps(phases), _mm_set1_ps(INVERSE_PHASE_SCALE));
+}
+
+static inline __m128 reducePeriods4(__m128 periods) {
+  return _mm_sub_ps(periods, _mm_cvtepi32_ps(_mm_cvtps_epi32(periods))); // rounds to nearest
+}
+#elif __ARM_NEON__
+static inline float32x4_t lookup4(uint32x4_t phases) {
+  uint32x4_t indicies = vshlq_n_u32(vshrq_n_u32(phases, FRACTION_BITS), 1);
+  float32x4_t fraction = vmulq_n_f32(vcvtq_f32_u32(vandq_u32(phases, vdupq_n_u32(FRACTION_MASK))),
+      FRACTION_SCALE);
+  float32x4x2_t pairs = vuzpq_f32(
+      vcombine_f32(vld1_f32(cosineTable + vgetq_lane_u32(indicies, 0)),
+          vld1_f32(cosineTable + vgetq_lane_u32(indicies, 1))),
+      vcombine_f32(vld1_f32(cosineTable + vgetq_lane_u32(indicies, 2)),
+          vld1_f32(cosineTable + vgetq_lane_u32(indicies, 3))));
+  return vmlaq_f32(pairs.val[0], fraction, pairs.val[1]);
+}
+
+static inline float32x4_t polynomial4(float32x4_t periods) {
+  float32x4_t u = vsubq_f32(vdupq_n_f32(0.25f), vabsq_f32(periods));
+  float32x4_t u2 = vmulq_f32(u, u);
+  float32x4_t p = vmlaq_n_f32(vdupq_n_f32(C7), u2, C9);
+  p = vmlaq_f32(vdupq_n_f32(C5), u2, p);
+  p = vmlaq_f32(vdupq_n_f32(C3), u2, p);
+  p = vmlaq_f32(vdupq_n_f32(C1), u2, p);
+  return vmulq_f32(u, p);
+}
+
+static inline float32x4_t periodsOfPhases4(uint32x4_t phases) {
+  // as a signed integer, the phase is in [-1/2, 1/2) of a period
+  return vmulq_n_f32(vcvtq_f32_s32(vreinterpretq_s32_u32(phases)), INVERSE_PHASE_SCALE);
+}
+
+static inline float32x4_t reducePeriods4(float32x4_t periods) {
+  // round to nearest by truncating after adding one half with the sign of the period
+  float32x4_t half = vreinterpretq_f32_u32(vorrq_u32(
+      vandq_u32(vreinterpretq_u32_f32(periods), vdupq_n_u32(0x80000000)),
+      vreinterpretq_u32_f32(vdupq_n_f32(0.5f))));
+  return vsubq_f32(periods, vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(periods, half))));
+}
+#endif
+
+
+#pragma mark - Arrays
+
+void CosineEngine::cosineOfPhases(const uint32_t *phases, float *output, int length,
+    CosineAccuracy accuracy) {
+  int i = 0;
+  if (accuracy == COSINE_ACCURACY_POLYNOMIAL) {
+    #if __AVX2__
+    for (; i <= length - 8; i += 8) {
+      _mm256_storeu_ps(output + i,
+          polynomial8(periodsOfPhases8(_mm256_loadu_si256((const __m256i *) (phases + i)))));
+    }
+    #elif __SSE2__
+    for (; i <= length - 4; i += 4) {
+      _mm_storeu_ps(output + i, polynomial4(periodsOfPhases4(_mm_loadu_si128((const __m128i *) (phases + i)))));
+    }
+    #elif __ARM_NEON__
+    for (; i <= length - 4; i += 4) {
+      vst1q_f32(output + i, polynomial4(periodsOfPhases4(vld1q_u32(phases + i))));
+    }
+    #endif
+    for (; i < length; i++) {
+      output[i] = polynomial(((float) (int32_t) phases[i]) * INVERSE_PHASE_SCALE);
+    }
+  } else {
+    #if __AVX2__
+    for (; i <= length - 8; i += 8) {
+      _mm256_storeu_ps(output + i, lookup8(_mm256_loadu_si256((const __m256i *) (phases + i))));
+    }
+    #elif __SSE2__
+    for (; i <= length - 4; i += 4) {
+      _mm_storeu_ps(output + i, lookup4(_mm_loadu_si128((const __m128i *) (phases + i))));
+    }
+    #elif __ARM_NEON__
+    for (; i <= length - 4; i += 4) {
+      vst1q_f32(output + i, lookup4(vld1q_u32(phases + i)));
+    }
+    #endif
+    for (; i < length; i++) {
+      output[i] = lookup(phases[i]);
+    }
+  }
+}
+
+uint32_t CosineEngine::cosineOfPhaseRamp(uint32_t phase, uint32_t increment, float *output,
+    int length, CosineAccuracy accuracy) {
+  int i = 0;
+  bool isPolynomial = (accuracy == COSINE_ACCURACY_POLYNOMIAL);
+  #if __AVX2__
+  __m256i phases = _mm256_add_epi32(_mm256_set1_epi32(phase),
+      _mm256_mullo_epi32(_mm256_set1_epi32(increment), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+  __m256i step = _mm256_set1_epi32(8 * increment);
+  for (; i <= length - 8; i += 8) {
+    _mm256_storeu_ps(output + i, isPolynomial ? polynomial8(periodsOfPhases8(phases)) : lookup8(phases));
+    phases = _mm256_add_epi32(phases, step);
+  }
+  phase = (uint32_t) _mm_cvtsi128_si32(_mm256_castsi256_si128(phases));
+  #elif __SSE2__
+  __m128i phases = _mm_set_epi32(phase + 3*increment, phase + 2*increment, phase + increment, phase);
+  __m128i step = _mm_set1_epi32(4 * increment);
+  for (; i <= length - 4; i += 4) {
+    _mm_storeu_ps(output + i, isPolynomial ? polynomial4(periodsOfPhases4(phases)) : lookup4(phases));
+    phases = _mm_add_epi32(phases, step);
+  }
+  phase = (uint32_t) _mm_cvtsi128_si32(phases);
+  #elif __ARM_NEON__
+  uint32_t initialPhases[4] = {phase, phase + increment, phase + 2*increment, phase + 3*increment};
+  uint32x4_t phases = vld1q_u32(initialPhases);
+  uint32x4_t step = vdupq_n_u32(4 * increment);
+  for (; i <= length - 4; i += 4) {
+    vst1q_f32(output + i, isPolynomial ? polynomial4(periodsOfPhases4(phases)) : lookup4(phases));
+    phases = vaddq_u32(phases, step);
+  }
+  phase = vgetq_lane_u32(phases, 0);
+  #endif
+  for (; i < length; i++, phase += increment) {
+    output[i] = isPolynomial ? polynomial(((float) (int32_t) phase) * INVERSE_PHASE_SCALE) : lookup(phase);
+  }
+  return phase;
+}
+
+void CosineEngine::cosineOfPeriods(const float *input, float *output, int length,
+    CosineAccuracy accuracy) {
+  int i = 0;
+  if (accuracy == COSINE_ACCURACY_POLYNOMIAL) {
+    #if __AVX2__
+    for (; i <= length - 8; i += 8) {
+      _mm256_storeu_ps(output + i, polynomial8(reducePeriods8(_mm256_loadu_ps(input + i))));
+    }
+    #elif __SSE2__
+    for (; i <= length - 4; i += 4) {
+      _mm_storeu_ps(output + i, polynomial4(reducePeriods4(_mm_loadu_ps(input + i))));
+    }
+    #elif __ARM_NEON__
+    for (; i <= length - 4; i += 4) {
+      vst1q_f32(output + i, polynomial4(reducePeriods4(vld1q_f32(input + i))));
+    }
+    #endif
+    for (; i < length; i++) {
+      // the phase is converted through 64 bits such that negative periods wrap correctly
+      uint32_t phase = (uint32_t) (int64_t) (input[i] * PHASE_SCALE);
+      output[i] = polynomial(((float) (int32_t) phase) * INVERSE_PHASE_SCALE);
+    }
+  } else {
+    // the reduced periods are in [-1/2, 1/2], such that they convert to signed 32-bit phases
+    #if __AVX2__
+    for (; i <= length - 8; i += 8) {
+      __m256 periods = reducePeriods8(_mm256_loadu_ps(input + i));
+      _mm256_storeu_ps(output + i,
+          lookup8(_mm256_cvttps_epi32(_mm256_mul_ps(periods, _mm256_set1_ps(PHASE_SCALE)))));
+    }
+    #elif __SSE2__
+    for (; i <= length - 4; i += 4) {
+      __m128 periods = reducePeriods4(_mm_loadu_ps(input + i));
+      _mm_storeu_ps(output + i, lookup4(_mm_cvttps_epi32(_mm_mul_ps(periods, _mm_set1_ps(PHASE_SCALE)))));
+    }
+    #elif __ARM_NEON__
+    for (; i <= length - 4; i += 4) {
+      float32x4_t periods = reducePeriods4(vld1q_f32(input + i));
+      vst1q_f32(output + i, lookup4(vreinterpretq_u32_s32(vcvtq_s32_f32(vmulq_n_f32(periods, PHASE_SCALE)))));
+    }
+    #endif
+    for (; i < length; i++) {
+      output[i] = lookup((uint32_t) (int64_t) (input[i] * PHASE_SCALE));
+    }
+  }
+}
@@ -0,0 +1,67 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _COSINE_ENGINE_H_
+#define _COSINE_ENGINE_H_
+
+#include <stdint.h>
+
+/** The method with which cosines are computed. */
+typedef enum CosineAccuracy {
+  COSINE_ACCURACY_TABLE,     // a 1024 point table with linear interpolation, to within 5e-6
+  COSINE_ACCURACY_POLYNOMIAL // a polynomial of degree 9, to within the precision of a float
+} CosineAccuracy;
+
+/**
+ * Computes cosines for [osc~], [cos~], [cos], and [sin]. The table is computed once per process
+ * and is shared by all contexts. It is only 8KB large, such that it stays in the L1 cache alongside
+ * the rest of the graph. The polynomial needs no memory at all, at the cost of a few more
+ * arithmetic operations per sample. Both are vectorised with AVX2, SSE2, or NEON.
+ *
+ * Phases are 32-bit fixed point fractions of a period, such that they wrap around by themselves.
+ */
+class CosineEngine {
+
+  public:
+    /** Writes cos(2*pi*phase/2^32) for each of the given phases. */
+    static void cosineOfPhases(const uint32_t *phases, float *output, int length, CosineAccuracy accuracy);
+
+    /**
+     * Writes cos(2*pi*(phase + i*increment)/2^32) for each i in [0, length), such as for an
+     * oscillator of constant frequency. Returns the phase which follows the last one.
+     */
+    static uint32_t cosineOfPhaseRamp(uint32_t phase, uint32_t increment, float *output, int length,
+        CosineAccuracy accuracy);
+
+    /** Writes cos(2*pi*x) for each x of the input, in periods. The output may be the input. */
+    static void cosineOfPeriods(const float *input, float *output, int length, CosineAccuracy accuracy);
+
+    /** Returns cos(2*pi*periods). The argument is reduced to one period in double precision. */
+    static float cosine(double periods, CosineAccuracy accuracy);
+
+  private:
+    static inline float lookup(uint32_t phase);
+    static inline float polynomial(float periods);
+};
+
+#endif // _COSINE_ENGINE_H_
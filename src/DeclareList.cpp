@@ -42,6 +42,9 @@ void DeclareList::addPath(const char *path) {
       // if no trailing slash exists, then one must be added
       declareList.push_back(string(path) + string("/"));
     }
+  } else if (declareList.empty()) {
+    // without a root path, the first path becomes the root path, relative to the working directory
+    declareList.push_back(hasTrailingSlash(path) ? string(path) : string(path) + string("/"));
   } else {
     // if it is not a full path, then make it relative to the root path
     if (hasTrailingSlash(path)) {
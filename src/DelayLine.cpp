@@ -0,0 +1,42 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "DelayLine.h"
+#include "DspObject.h"
+
+DelayLine::DelayLine(int minDelay, int blockSize) {
+  this->blockSize = blockSize;
+  // whole blocks, at least one more than the delay, and the spare block
+  length = ((minDelay + blockSize - 1) / blockSize + 2) * blockSize;
+  headIndex = 0;
+  buffer = ALLOC_ALIGNED_BUFFER((length + blockSize) * sizeof(float));
+  clear();
+}
+
+DelayLine::~DelayLine() {
+  FREE_ALIGNED_BUFFER(buffer);
+}
+
+void DelayLine::clear() {
+  memset(buffer, 0, (length + blockSize) * sizeof(float));
+}
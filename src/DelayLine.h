@@ -0,0 +1,96 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _DELAY_LINE_H_
+#define _DELAY_LINE_H_
+
+#include <string.h>
+#include "ArrayArithmetic.h"
+
+/**
+ * The ring buffer of [delwrite~] and [fdn~]. A block is written at the head at once, and the head
+ * then advances by one block. The length of the ring is a whole number of blocks, and its first
+ * block is mirrored after the end, such that any block of samples which begins in the ring is
+ * contiguous in memory, even if it wraps around the end. In particular buffer[length] == buffer[0].
+ *
+ * The ring holds one more block than the longest delay, such that the block which is being written
+ * in the current tick is never one which a reader still needs.
+ */
+class DelayLine {
+
+  public:
+    /** A delay line which can delay by at least the given number of samples. */
+    DelayLine(int minDelay, int blockSize);
+    ~DelayLine();
+
+    /** Returns the ring buffer, which is followed by the mirror of its first block. */
+    inline float *getBuffer() { return buffer; }
+    
+    /** The number of samples in the ring, not including the mirror. */
+    inline int getLength() { return length; }
+
+    /** The index at which the next block will be written. */
+    inline int getHeadIndex() { return headIndex; }
+
+    /** Returns the location at which the next block will be written. */
+    inline float *getHead() { return buffer + headIndex; }
+
+    /** The longest delay in samples, relative to the head, which a reader may request. */
+    inline int getMaxDelay() { return length - blockSize; }
+
+    /**
+     * Returns the index of the sample the given number of samples before the head, which must be in
+     * [0, length].
+     */
+    inline int getIndex(int delay) {
+      int index = headIndex - delay;
+      return (index < 0) ? index + length : index;
+    }
+
+    /** Writes one block at the head and advances it. */
+    inline void write(float *input) {
+      memcpy(buffer + headIndex, input, blockSize*sizeof(float));
+      advance();
+    }
+
+    /** Advances the head past the block which has been written there. */
+    inline void advance() {
+      if (headIndex == 0) memcpy(buffer + length, buffer, blockSize*sizeof(float));
+      headIndex += blockSize;
+      if (headIndex >= length) headIndex = 0;
+    }
+
+    /** Resets the line to silence. */
+    void clear();
+
+    /** Returns true if the whole line holds nothing but silence. */
+    inline bool isSilent() { return ArrayArithmetic::isSilent(buffer, 0, length); }
+
+  private:
+    float *buffer;
+    int length;
+    int blockSize;
+    int headIndex;
+};
+
+#endif // _DELAY_LINE_H_
@@ -0,0 +1,230 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <sys/time.h>
+#include "DiskStreamService.h"
+#include "TableBuffer.h"
+
+// the disk thread wakes up at least this often, in case a signal from the audio thread was missed
+#define DISK_STREAM_SERVICE_INTERVAL_MS 10
+
+
+#pragma mark - DiskStream
+
+DiskStream::DiskStream() {
+  numCommandsPosted = 0;
+  numCommandsExecuted = 0;
+}
+
+DiskStream::~DiskStream() {
+  // nothing to do
+}
+
+DiskStreamCommand *DiskStream::getNextCommand() {
+  if (numCommandsPosted - numCommandsExecuted >= DISK_STREAM_NUM_COMMANDS) {
+    return NULL; // the disk thread has fallen too far behind
+  }
+  return &commands[numCommandsPosted % DISK_STREAM_NUM_COMMANDS];
+}
+
+void DiskStream::postCommand() {
+  __sync_synchronize(); // the command must be complete before it is published
+  numCommandsPosted++;
+}
+
+void DiskStream::service() {
+  while (numCommandsExecuted != numCommandsPosted) {
+    __sync_synchronize();
+    executeCommand(&commands[numCommandsExecuted % DISK_STREAM_NUM_COMMANDS]);
+    __sync_synchronize(); // all effects of the command must be visible before it is retired
+    numCommandsExecuted++;
+  }
+  transfer();
+}
+
+
+#pragma mark - DiskStreamService
+
+DiskStreamService::DiskStreamService() {
+  isThreadStarted = false;
+  isRunning = false;
+  isSignalled = false;
+  servicedStream = NULL;
+  numCompletionsPosted = 0;
+  numCompletionsDelivered = 0;
+  blockIndex = 0;
+  retiredTableBuffers = NULL;
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&condition, NULL);
+  pthread_cond_init(&serviceCondition, NULL);
+}
+
+DiskStreamService::~DiskStreamService() {
+  if (isThreadStarted) {
+    pthread_mutex_lock(&mutex);
+    isRunning = false;
+    pthread_cond_signal(&condition);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+  }
+  pthread_cond_destroy(&serviceCondition);
+  pthread_cond_destroy(&condition);
+  pthread_mutex_destroy(&mutex);
+  
+  // nothing can be reading the table buffers anymore
+  for (TableBuffer *tableBuffer = retiredTableBuffers; tableBuffer != NULL;) {
+    TableBuffer *nextRetired = tableBuffer->nextRetired;
+    delete tableBuffer;
+    tableBuffer = nextRetired;
+  }
+  for (list<TableBuffer *>::iterator it = collectedTableBuffers.begin();
+      it != collectedTableBuffers.end(); ++it) {
+    delete *it;
+  }
+}
+
+void DiskStreamService::registerStream(DiskStream *stream) {
+  pthread_mutex_lock(&mutex);
+  streamList.push_back(stream);
+  pthread_mutex_unlock(&mutex);
+  start();
+}
+
+void DiskStreamService::start() {
+  pthread_mutex_lock(&mutex);
+  if (!isThreadStarted) {
+    isRunning = true;
+    isThreadStarted = (pthread_create(&thread, NULL, &run, this) == 0);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+void DiskStreamService::unregisterStream(DiskStream *stream) {
+  pthread_mutex_lock(&mutex);
+  streamList.remove(stream);
+  std::replace(pendingStreams.begin(), pendingStreams.end(), stream, (DiskStream *) NULL);
+  // the disk thread will not begin to service the stream again, but may be in the middle of it
+  while (servicedStream == stream) {
+    pthread_cond_wait(&serviceCondition, &mutex);
+  }
+  // completions which have not yet been delivered are forgotten. The audio thread does not deliver
+  // completions while streams are being unregistered, as both happen under the context lock.
+  for (unsigned int i = numCompletionsDelivered; i != numCompletionsPosted; i++) {
+    if (completions[i % DISK_STREAM_NUM_COMPLETIONS] == stream) {
+      completions[i % DISK_STREAM_NUM_COMPLETIONS] = NULL;
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+void DiskStreamService::signal() {
+  // if the lock cannot be taken then the disk thread is busy anyway, and will see the flag and check
+  // all streams again before waiting
+  isSignalled = true;
+  if (pthread_mutex_trylock(&mutex) == 0) {
+    pthread_cond_signal(&condition);
+    pthread_mutex_unlock(&mutex);
+  }
+}
+
+bool DiskStreamService::postCompletion(DiskStream *stream) {
+  if (numCompletionsPosted - numCompletionsDelivered >= DISK_STREAM_NUM_COMPLETIONS) return false;
+  completions[numCompletionsPosted % DISK_STREAM_NUM_COMPLETIONS] = stream;
+  __sync_synchronize();
+  numCompletionsPosted++;
+  return true;
+}
+
+void DiskStreamService::beginBlock() {
+  blockIndex++;
+  while (numCompletionsDelivered != numCompletionsPosted) {
+    __sync_synchronize();
+    DiskStream *stream = completions[numCompletionsDelivered % DISK_STREAM_NUM_COMPLETIONS];
+    if (stream != NULL) stream->complete();
+    __sync_synchronize();
+    numCompletionsDelivered++;
+  }
+}
+
+void DiskStreamService::retireTableBuffer(TableBuffer *tableBuffer) {
+  tableBuffer->retiredAtBlock = blockIndex;
+  TableBuffer *head = NULL;
+  do {
+    head = retiredTableBuffers;
+    tableBuffer->nextRetired = head;
+  } while (!__sync_bool_compare_and_swap(&retiredTableBuffers, head, tableBuffer));
+}
+
+void DiskStreamService::collectTableBuffers() {
+  // take all newly retired buffers at once
+  TableBuffer *tableBuffer = __sync_lock_test_and_set(&retiredTableBuffers, (TableBuffer *) NULL);
+  while (tableBuffer != NULL) {
+    collectedTableBuffers.push_back(tableBuffer);
+    tableBuffer = tableBuffer->nextRetired;
+  }
+  
+  // A buffer which was retired during block n can only have been seen by blocks up to n, all of
+  // which have finished once block n+1 has begun. One further block is allowed for good measure.
+  list<TableBuffer *>::iterator it = collectedTableBuffers.begin();
+  while (it != collectedTableBuffers.end()) {
+    if (blockIndex - (*it)->retiredAtBlock >= 2 && !(*it)->isRetained()) {
+      delete *it;
+      it = collectedTableBuffers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void *DiskStreamService::run(void *ptr) {
+  DiskStreamService *service = reinterpret_cast<DiskStreamService *>(ptr);
+  pthread_mutex_lock(&service->mutex);
+  while (service->isRunning) {
+    service->isSignalled = false;
+    service->pendingStreams.assign(service->streamList.begin(), service->streamList.end());
+    for (int i = 0; i < service->pendingStreams.size(); i++) {
+      DiskStream *stream = service->pendingStreams[i];
+      if (stream == NULL) continue; // the stream has been unregistered in the meantime
+      service->servicedStream = stream;
+      pthread_mutex_unlock(&service->mutex);
+      stream->service();
+      pthread_mutex_lock(&service->mutex);
+      service->servicedStream = NULL;
+      pthread_cond_broadcast(&service->serviceCondition);
+    }
+    pthread_mutex_unlock(&service->mutex);
+    service->collectTableBuffers();
+    pthread_mutex_lock(&service->mutex);
+    if (!service->isRunning || service->isSignalled) continue;
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct timespec timeout;
+    long nsec = (now.tv_usec * 1000L) + (DISK_STREAM_SERVICE_INTERVAL_MS * 1000000L);
+    timeout.tv_sec = now.tv_sec + (nsec / 1000000000L);
+    timeout.tv_nsec = nsec % 1000000000L;
+    pthread_cond_timedwait(&service->condition, &service->mutex, &timeout);
+  }
+  pthread_mutex_unlock(&service->mutex);
+  return NULL;
+}
@@ -0,0 +1,188 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _DISK_STREAM_SERVICE_H_
+#define _DISK_STREAM_SERVICE_H_
+
+#include <list>
+#include <pthread.h>
+#include <vector>
+using namespace std;
+
+class TableBuffer;
+
+#define DISK_STREAM_PATH_LENGTH 1024
+#define DISK_STREAM_NUM_COMMANDS 8
+#define DISK_STREAM_NUM_COMPLETIONS 64
+
+typedef enum DiskStreamCommandType {
+  DISK_STREAM_OPEN,
+  DISK_STREAM_CLOSE,
+  DISK_STREAM_READ, // a job which reads a whole file
+  DISK_STREAM_WRITE, // a job which writes a whole file
+  DISK_STREAM_COMPUTE, // a job which derives data off the audio thread, such as wavetable mipmaps
+  DISK_STREAM_RELEASE // memory which is no longer used by the audio thread
+} DiskStreamCommandType;
+
+/** A request from the audio thread to the disk thread. */
+typedef struct DiskStreamCommand {
+  DiskStreamCommandType type;
+  char path[DISK_STREAM_PATH_LENGTH];
+  int onset; // the number of frames to skip at the beginning of a file which is read
+  int format; // the libsndfile format of a file which is written
+  float sampleRate; // the sample rate of a file which is written
+  void *data; // any further data which the stream requires to execute the command
+} DiskStreamCommand;
+
+/**
+ * A <code>DiskStream</code> is anything which needs to access the disk on behalf of the audio
+ * thread, such as [readsf~] and [writesf~]. The audio thread posts commands without blocking, and
+ * the <code>DiskStreamService</code> executes them and otherwise keeps the stream's data flowing
+ * on its own thread.
+ */
+class DiskStream {
+
+  public:
+    DiskStream();
+    virtual ~DiskStream();
+
+    /** Executes all pending commands, then transfers data. Called only by the disk thread. */
+    void service();
+  
+    /**
+     * Called on the audio thread at the beginning of a block, after the stream has posted a
+     * completion with <code>DiskStreamService::postCompletion()</code>.
+     */
+    virtual void complete() { }
+
+  protected:
+    /**
+     * Returns a command to be filled in, or <code>NULL</code> if too many commands are pending.
+     * The command is not seen by the disk thread until <code>postCommand()</code> is called.
+     * Called only by the audio thread.
+     */
+    DiskStreamCommand *getNextCommand();
+    void postCommand();
+
+    /**
+     * Returns <code>true</code> if commands have been posted which have not yet been executed.
+     * Streams should generally not touch their data buffers while this is the case.
+     */
+    bool hasPendingCommands() { return numCommandsPosted != numCommandsExecuted; }
+
+    /** Executes the command on the disk thread. */
+    virtual void executeCommand(DiskStreamCommand *command) = 0;
+
+    /** Moves data between disk and the stream's buffers on the disk thread. */
+    virtual void transfer() = 0;
+
+  private:
+    DiskStreamCommand commands[DISK_STREAM_NUM_COMMANDS];
+    volatile unsigned int numCommandsPosted;
+    volatile unsigned int numCommandsExecuted;
+};
+
+/**
+ * The <code>DiskStreamService</code> owns one background thread per context which services all
+ * registered <code>DiskStream</code>s. The audio thread wakes it with <code>signal()</code>, which
+ * never blocks. The thread also wakes periodically in case a signal was missed. The same thread
+ * deletes retired <code>TableBuffer</code>s, such that memory is never freed on the audio thread.
+ */
+class DiskStreamService {
+
+  public:
+    DiskStreamService();
+    ~DiskStreamService();
+
+    /**
+     * Adds a stream to the service. The thread is started with the first stream.
+     * May block while the disk thread is busy, and thus must not be called from the audio thread.
+     */
+    void registerStream(DiskStream *stream);
+  
+    /** Starts the disk thread if it is not yet running. Must not be called from the audio thread. */
+    void start();
+
+    /**
+     * Removes a stream from the service. Once this function returns, the disk thread will not
+     * access the stream again. If the disk thread is servicing this very stream, waits until it has
+     * finished, but it never waits for the disk work of other streams. Must not be called from the
+     * audio thread.
+     */
+    void unregisterStream(DiskStream *stream);
+
+    /** Wakes the disk thread. Never blocks, and is safe to call from the audio thread. */
+    void signal();
+  
+    /**
+     * Requests that <code>complete()</code> be called on the given stream by the audio thread at the
+     * beginning of the next block. Returns <code>false</code> if too many completions are already
+     * waiting, in which case the request should be made again later. Called only by the disk thread.
+     */
+    bool postCompletion(DiskStream *stream);
+  
+    /**
+     * Marks the beginning of a block and calls <code>complete()</code> on all streams which have
+     * posted a completion. Called only by the audio thread.
+     */
+    void beginBlock();
+  
+    /**
+     * Hands over a table buffer which has been replaced. It is deleted once all blocks which could
+     * have read it have finished, and once it is no longer retained. Never blocks, and may be
+     * called from any thread.
+     */
+    void retireTableBuffer(TableBuffer *tableBuffer);
+
+  private:
+    static void *run(void *service);
+  
+    /** Deletes those retired table buffers which can no longer be in use. Called only by the disk thread. */
+    void collectTableBuffers();
+
+    list<DiskStream *> streamList;
+  
+    // The streams are serviced from a copy of the list, without holding the lock, such that
+    // registering or unregistering a stream does not wait on the disk work of other streams.
+    // Unregistered streams are set to NULL in the copy. Both are guarded by the lock.
+    vector<DiskStream *> pendingStreams;
+    DiskStream *servicedStream;
+  
+    DiskStream *completions[DISK_STREAM_NUM_COMPLETIONS];
+    volatile unsigned int numCompletionsPosted;
+    volatile unsigned int numCompletionsDelivered;
+  
+    // the number of blocks which have begun. Retired table buffers are deleted relative to this.
+    volatile unsigned int blockIndex;
+    TableBuffer * volatile retiredTableBuffers; // a lock-free stack
+    list<TableBuffer *> collectedTableBuffers; // owned by the disk thread
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    pthread_cond_t serviceCondition; // signalled whenever the disk thread finishes servicing a stream
+    bool isThreadStarted;
+    volatile bool isRunning;
+    volatile bool isSignalled;
+};
+
+#endif // _DISK_STREAM_SERVICE_H_
@@ -21,9 +21,10 @@
  */
 
 #include "ArrayArithmetic.h"
+#include "BufferPool.h"
 #include "DspAdd.h"
-
-class PdGraph;
+#include "DspFusedChain.h"
+#include "PdGraph.h"
 
 MessageObject *DspAdd::newObject(PdMessage *initMessage, PdGraph *graph) {
   return new DspAdd(initMessage, graph);
@@ -31,6 +32,7 @@ MessageObject *DspAdd::newObject(PdMessage *initMessage, PdGraph *graph) {
 
 DspAdd::DspAdd(PdMessage *initMessage, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {
   constant = initMessage->isFloat(0) ? initMessage->getFloat(0) : 0.0f;
+  processFunction = &processScalar;
   processFunctionNoMessage = &processScalar;
 }
 
@@ -43,6 +45,37 @@ void DspAdd::onInletConnectionUpdate(unsigned int inletIndex) {
       ? &processSignal : &processScalar;
 }
 
+bool DspAdd::getElementwiseOperation(ElementwiseOperation *operation) {
+  if (processFunction == &processSignal) {
+    operation->signal = getDspBufferSlotAtInlet(1);
+  } else if (processFunction == &processScalar) {
+    operation->signal = NULL;
+  } else {
+    return false;
+  }
+  operation->opcode = ElementwiseOperation::ADD;
+  operation->constant0 = &constant;
+  operation->constant1 = NULL;
+  return true;
+}
+
+float *DspAdd::getFoldedOutputBuffer() {
+  BufferPool *bufferPool = graph->getBufferPool();
+  float value0 = 0.0f;
+  float value1 = 0.0f;
+  bool isConstant0 = bufferPool->isConstantBuffer(dspBufferAtInlet[0], &value0);
+  if (processFunction == &processScalar) {
+    if (isConstant0) return bufferPool->getConstantBuffer(value0 + constant);
+    else if (constant == 0.0f) return dspBufferAtInlet[0];
+  } else if (processFunction == &processSignal) {
+    bool isConstant1 = bufferPool->isConstantBuffer(dspBufferAtInlet[1], &value1);
+    if (isConstant0 && isConstant1) return bufferPool->getConstantBuffer(value0 + value1);
+    else if (isConstant1 && value1 == 0.0f) return dspBufferAtInlet[0];
+    else if (isConstant0 && value0 == 0.0f) return dspBufferAtInlet[1];
+  }
+  return NULL;
+}
+
 std::string DspAdd::toString() {
   const char *fmt = (constant == 0.0f) ? "%s" : "%s %g";
   char str[snprintf(NULL, 0, fmt, getObjectLabel(), constant)+1];
@@ -65,5 +98,5 @@ void DspAdd::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
 void DspAdd::processScalar(DspObject *dspObject, int fromIndex, int toIndex) {
   DspAdd *d = reinterpret_cast<DspAdd *>(dspObject);
   ArrayArithmetic::add(d->dspBufferAtInlet[0] , d->constant,
-      d->dspBufferAtOutlet[0], fromIndex, fromIndex);
+      d->dspBufferAtOutlet[0], fromIndex, toIndex);
 }
@@ -35,6 +35,8 @@ class DspAdd : public DspObject {
   
     static const char *getObjectLabel();
     std::string toString();
+    bool getElementwiseOperation(ElementwiseOperation *operation);
+    float *getFoldedOutputBuffer();
   
     void onInletConnectionUpdate(unsigned int inletIndex);
     
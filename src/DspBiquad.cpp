@@ -0,0 +1,89 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "DspBiquad.h"
+#include "PdGraph.h"
+
+MessageObject *DspBiquad::newObject(PdMessage *initMessage, PdGraph *graph) {
+  return new DspBiquad(initMessage, graph);
+}
+
+DspBiquad::DspBiquad(PdMessage *initMessage, PdGraph *graph) : DspFilter(1, 1, graph) {
+  setCoefficients(initMessage);
+}
+
+DspBiquad::~DspBiquad() {
+  // nothing to do
+}
+
+string DspBiquad::toString() {
+  const char *format = "%s %g %g %g %g %g";
+  char str[snprintf(NULL, 0, format, getObjectLabel(), coefficients[0], coefficients[1],
+      coefficients[2], coefficients[3], coefficients[4])+1];
+  snprintf(str, sizeof(str), format, getObjectLabel(), coefficients[0], coefficients[1],
+      coefficients[2], coefficients[3], coefficients[4]);
+  return string(str);
+}
+
+void DspBiquad::setCoefficients(PdMessage *message) {
+  for (int i = 0; i < 5; i++) {
+    coefficients[i] = message->isFloat(i) ? message->getFloat(i) : 0.0f;
+  }
+  float fb1 = coefficients[0];
+  float fb2 = coefficients[1];
+
+  // the filter is stable if both poles, the roots of z^2 - fb1*z - fb2, are within the unit circle
+  bool isStable = false;
+  if (fb1*fb1 + 4.0f*fb2 < 0.0f) {
+    // complex conjugate poles, whose product is -fb2
+    isStable = (fb2 >= -1.0f);
+  } else {
+    // real poles
+    isStable = (fb1 <= 2.0f && fb1 >= -2.0f && 1.0f - fb1 - fb2 >= 0.0f && 1.0f + fb1 - fb2 >= 0.0f);
+  }
+  if (!isStable) {
+    memset(coefficients, 0, sizeof(coefficients));
+  }
+
+  biquad.setCoefficients(coefficients[2], coefficients[3], coefficients[4],
+      -coefficients[0], -coefficients[1]);
+}
+
+void DspBiquad::processMessage(int inletIndex, PdMessage *message) {
+  switch (message->getType(0)) {
+    case FLOAT: {
+      setCoefficients(message);
+      break;
+    }
+    case SYMBOL: {
+      if (message->isSymbol(0, "set")) {
+        biquad.setDirectFormIIState(message->isFloat(1) ? message->getFloat(1) : 0.0f,
+            message->isFloat(2) ? message->getFloat(2) : 0.0f);
+      } else if (message->isSymbol(0, "clear")) {
+        biquad.clear();
+      }
+      break;
+    }
+    default: break;
+  }
+}
@@ -0,0 +1,59 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _DSP_BIQUAD_H_
+#define _DSP_BIQUAD_H_
+
+#include "DspFilter.h"
+
+/**
+ * [biquad~], [biquad~ float float float float float]
+ * A second order IIR filter with the coefficients fb1, fb2, ff1, ff2, and ff3, as in Pd:
+ * w[n] = x[n] + fb1*w[n-1] + fb2*w[n-2] and y[n] = ff1*w[n] + ff2*w[n-1] + ff3*w[n-2].
+ * A list of five floats sets the coefficients. If they describe an unstable filter then all of
+ * them are set to zero. The message "set w1 w2" sets the state and "clear" resets it.
+ * The filter is computed in direct form I. A change of coefficients therefore continues from the
+ * previous inputs and outputs rather than from w[n-1] and w[n-2], and its transient differs from Pd.
+ */
+class DspBiquad : public DspFilter {
+
+  public:
+    static MessageObject *newObject(PdMessage *initMessage, PdGraph *graph);
+    DspBiquad(PdMessage *initMessage, PdGraph *graph);
+    ~DspBiquad();
+
+    static const char *getObjectLabel();
+    std::string toString();
+
+  private:
+    void processMessage(int inletIndex, PdMessage *message);
+    void setCoefficients(PdMessage *message);
+
+    float coefficients[5]; // fb1, fb2, ff1, ff2, ff3
+};
+
+inline const char *DspBiquad::getObjectLabel() {
+  return "biquad~";
+}
+
+#endif // _DSP_BIQUAD_H_
@@ -21,9 +21,10 @@
  */
 
 #include "ArrayArithmetic.h"
+#include "BufferPool.h"
 #include "DspClip.h"
-
-class PdGraph;
+#include "DspFusedChain.h"
+#include "PdGraph.h"
 
 MessageObject *DspClip::newObject(PdMessage *initMessage, PdGraph *graph) {
   return new DspClip(initMessage, graph);
@@ -46,6 +47,34 @@ std::string DspClip::toString() {
   return str;
 }
 
+bool DspClip::getElementwiseOperation(ElementwiseOperation *operation) {
+  #if __APPLE__
+  return false; // vDSP_vclip does not order the bounds as the generic code does
+  #else
+  if (processFunction != &processScalar) return false;
+  operation->opcode = ElementwiseOperation::CLIP;
+  operation->signal = NULL;
+  operation->constant0 = &lowerBound;
+  operation->constant1 = &upperBound;
+  return true;
+  #endif
+}
+
+float *DspClip::getFoldedOutputBuffer() {
+  #if __APPLE__
+  return NULL; // vDSP_vclip does not order the bounds as the generic code does
+  #else
+  BufferPool *bufferPool = graph->getBufferPool();
+  float value = 0.0f;
+  if (processFunction != &processScalar || !bufferPool->isConstantBuffer(dspBufferAtInlet[0], &value)) {
+    return NULL;
+  }
+  if (value < lowerBound) value = lowerBound;
+  else if (value > upperBound) value = upperBound;
+  return bufferPool->getConstantBuffer(value);
+  #endif
+}
+
 void DspClip::processMessage(int inletIndex, PdMessage *message) {
   switch (inletIndex) {
     case 1: if (message->isFloat(0)) lowerBound = message->getFloat(0); break; // set the lower bound
@@ -25,7 +25,9 @@
 
 #include "DspObject.h"
 
-/** [cos~] */
+/** [cos~]
+ * The cosine of the input, in periods, as computed by the <code>CosineEngine</code>.
+ */
 class DspCosine : public DspObject {
 
   public:
@@ -35,13 +37,11 @@ class DspCosine : public DspObject {
 
     static const char *getObjectLabel();
     std::string toString();
+    bool isAtRest() { return true; }
+    bool canSkipDsp() { return true; }
 
   private:
-    static void procesSignal(DspObject *dspObject, int fromIndex, int toIndex);
-  
-    float sampleRate;
-    static float *cos_table; // the Cosine lookup table
-    static int refCount; // a reference counter for Cosine table. Now we know when to free it.
+    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
 };
 
 inline std::string DspCosine::toString() {
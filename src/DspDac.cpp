@@ -44,6 +44,11 @@ DspDac::~DspDac() {
   free(dspBufferAtOutlet[2]);
 }
 
+bool DspDac::isAtRest() {
+  // silence adds nothing to the output
+  return areDspInletsKnownSilent();
+}
+
 void DspDac::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
   DspDac *d = reinterpret_cast<DspDac *>(dspObject);
   switch (d->incomingDspConnections.size()) {
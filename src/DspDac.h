@@ -34,6 +34,7 @@ class DspDac : public DspObject {
   
     static const char *getObjectLabel();
     std::string toString();
+    bool isAtRest();
   
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
@@ -37,18 +37,66 @@ DspDelayRead::DspDelayRead(PdMessage *initMessage, PdGraph *graph) : DelayReceiv
     graph->printErr("delread~ must be initialised in the format [delread~ name delay].");
     delayInSamples = 0.0f;
   }
+  isPublished = false;
   processFunction = &processSignal;
-  
-  // TODO(mhroth): implement process function for case of receiving messages
-//  processFunctionNoMessage = &processScalar;
+  processFunctionNoMessage = &processSignal;
 }
 
 DspDelayRead::~DspDelayRead() {
   // nothing to do
 }
 
-void DspDelayRead::onInletConnectionUpdate(unsigned int inletIndex) {
-//  processFunction = (incomingMessageConnections[0].size() > 0) ? &processScalar : &processSignal;
+list<DspObject *> DspDelayRead::getProcessOrder() {
+  if (!isOrdered) {
+    // the receivers are about to be given the outlet buffer
+    isPublished = false;
+    
+    // Receivers which sum several inputs do so through an implicit +~~, which is not known here.
+    // Graphs and outlet~s pass the buffer on to further objects.
+    receiverSlots.clear();
+    bool canPublish = (blockSizeInt % 4 == 0);
+    for (list<ObjectLetPair>::iterator it = outgoingDspConnections[0].begin();
+        it != outgoingDspConnections[0].end(); ++it) {
+      DspObject *dspObject = reinterpret_cast<DspObject *>((*it).first);
+      switch (dspObject->getObjectType()) {
+        case OBJECT_PD:
+        case DSP_OUTLET: canPublish = false; break;
+        default: {
+          if (dspObject->getIncomingDspConnections((*it).second).size() != 1) canPublish = false;
+          break;
+        }
+      }
+      receiverSlots.push_back(dspObject->getDspBufferSlotAtInlet((*it).second));
+    }
+    if (!canPublish) receiverSlots.clear();
+  }
+  return DspObject::getProcessOrder();
+}
+
+void DspDelayRead::addConnectionToObjectFromOutlet(MessageObject *messageObject, int inletIndex, int outletIndex) {
+  // receivers are only known to be safe once the graph has been ordered again
+  unpublish();
+  receiverSlots.clear();
+  DspObject::addConnectionToObjectFromOutlet(messageObject, inletIndex, outletIndex);
+}
+
+void DspDelayRead::removeConnectionToObjectFromOutlet(MessageObject *messageObject, int inletIndex, int outletIndex) {
+  unpublish();
+  receiverSlots.clear();
+  DspObject::removeConnectionToObjectFromOutlet(messageObject, inletIndex, outletIndex);
+}
+
+void DspDelayRead::setBufferAtReceivers(float *buffer) {
+  for (int i = 0; i < receiverSlots.size(); i++) {
+    *receiverSlots[i] = buffer;
+  }
+}
+
+void DspDelayRead::unpublish() {
+  if (isPublished) {
+    setBufferAtReceivers(dspBufferAtOutlet[0]);
+    isPublished = false;
+  }
 }
 
 void DspDelayRead::processMessage(int inletIndex, PdMessage *message) {
@@ -61,20 +109,40 @@ void DspDelayRead::processMessage(int inletIndex, PdMessage *message) {
 void DspDelayRead::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
   DspDelayRead *d = reinterpret_cast<DspDelayRead *>(dspObject);
   
+  // a message at the end of the block leaves nothing to copy, and the receivers keep this block
+  if (fromIndex == toIndex) return;
+  
+  if (d->delayline == NULL) {
+    d->unpublish();
+    memset(d->dspBufferAtOutlet[0] + fromIndex, 0, (toIndex-fromIndex)*sizeof(float));
+    return;
+  }
+  
   int headIndex = 0;
   int bufferLength = 0;
   float *buffer = d->delayline->getBuffer(&headIndex, &bufferLength);
   
-  // this handles the most common case. Messages are rarely sent to delread~.
-  int delayIndex = headIndex - toIndex - ((int) d->delayInSamples);
+  int delay = (int) d->delayInSamples;
+  if (delay < 0) {
+    delay = 0;
+  } else if (delay > d->delayline->getMaxDelay()) {
+    delay = d->delayline->getMaxDelay();
+  }
+  
+  // the index of the first sample of this block in the delay line. The following block is
+  // contiguous, as the delay line mirrors its first block after the end.
+  int delayIndex = headIndex - d->blockSizeInt - delay;
   if (delayIndex < 0) {
     delayIndex += bufferLength;
   }
-  if (delayIndex > bufferLength - toIndex) {
-    int samplesInBuffer = bufferLength - delayIndex; // samples remaining in the buffer that belong in this block
-    memcpy(d->dspBufferAtOutlet[0], buffer + delayIndex, samplesInBuffer * sizeof(float));
-    memcpy(d->dspBufferAtOutlet[0] + samplesInBuffer, buffer, (toIndex - samplesInBuffer) * sizeof(float));
+  
+  // this handles the most common case. Messages are rarely sent to delread~.
+  if (fromIndex == 0 && toIndex == d->blockSizeInt && !d->receiverSlots.empty() && (delay & 0x3) == 0) {
+    d->setBufferAtReceivers(buffer + delayIndex);
+    d->isPublished = true;
   } else {
-    memcpy(d->dspBufferAtOutlet[0], buffer + delayIndex, toIndex*sizeof(float));
+    d->unpublish();
+    memcpy(d->dspBufferAtOutlet[0] + fromIndex, buffer + delayIndex + fromIndex,
+        (toIndex-fromIndex)*sizeof(float));
   }
 }
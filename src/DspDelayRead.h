@@ -28,8 +28,11 @@
 class DspDelayWrite;
 
 /**
- * [delread~ symbol float]
+ * [delread~ name delay]
  * This object also implements the <code>DelayReceiver</code> interface.
+ * If the delay is a multiple of four samples, then the delayed block is aligned in the delay line
+ * and its receivers read it there directly. Otherwise, or while messages split the block, it is
+ * copied to the outlet buffer.
  */
 class DspDelayRead : public DelayReceiver {
   
@@ -42,13 +45,29 @@ class DspDelayRead : public DelayReceiver {
     std::string toString();
     ObjectType getObjectType();
   
-    void onInletConnectionUpdate(unsigned int inletIndex);
+    list<DspObject *> getProcessOrder();
+  
+    void addConnectionToObjectFromOutlet(MessageObject *messageObject, int inletIndex, int outletIndex);
+    void removeConnectionToObjectFromOutlet(MessageObject *messageObject, int inletIndex, int outletIndex);
   
   private:
     void processMessage(int inletIndex, PdMessage *message);
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
   
+    /** Sets the given buffer at the inlets of all receivers of this object. */
+    void setBufferAtReceivers(float *buffer);
+  
+    /** Returns the receivers to the outlet buffer, if they are referring to the delay line. */
+    void unpublish();
+  
     float delayInSamples;
+  
+    // If all receivers take their input only from this object, directly, then their inlet buffers
+    // may be moved to the delay line. These are the locations of those buffers, otherwise empty.
+    vector<float **> receiverSlots;
+  
+    // true if the receivers currently refer to the delay line instead of the outlet buffer
+    bool isPublished;
 };
 
 inline std::string DspDelayRead::toString() {
@@ -0,0 +1,129 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "ArrayArithmetic.h"
+#include "DspDelayTaps.h"
+#include "DspDelayWrite.h"
+#include "PdGraph.h"
+
+MessageObject *DspDelayTaps::newObject(PdMessage *initMessage, PdGraph *graph) {
+  return new DspDelayTaps(initMessage, graph);
+}
+
+/** Returns the number of delays given after the name, and at least one. */
+static int getNumTaps(PdMessage *initMessage) {
+  int numTaps = 0;
+  while (initMessage->isFloat(numTaps+1)) numTaps++;
+  return (numTaps > 0) ? numTaps : 1;
+}
+
+DspDelayTaps::DspDelayTaps(PdMessage *initMessage, PdGraph *graph) :
+    DelayReceiver(1, 0, 0, getNumTaps(initMessage), graph) {
+  numTaps = getNumDspOutlets();
+  delays = (float *) calloc(numTaps, sizeof(float));
+  if (initMessage->isSymbol(0)) {
+    name = StaticUtils::copyString(initMessage->getSymbol(0));
+    for (int i = 0; i < numTaps && initMessage->isFloat(i+1); i++) {
+      delays[i] = StaticUtils::millisecondsToSamples(initMessage->getFloat(i+1), graph->getSampleRate());
+    }
+  } else {
+    graph->printErr("taps~ must be initialised in the format [taps~ name delay1 delay2 ...].");
+  }
+  wrapBuffer = (float *) calloc(blockSizeInt+3, sizeof(float));
+  processFunction = &processSignal;
+  processFunctionNoMessage = &processSignal;
+}
+
+DspDelayTaps::~DspDelayTaps() {
+  free(delays);
+  free(wrapBuffer);
+}
+
+void DspDelayTaps::processMessage(int inletIndex, PdMessage *message) {
+  // a list sets the delays of the taps in order
+  for (int i = 0; i < numTaps && message->isFloat(i); i++) {
+    delays[i] = StaticUtils::millisecondsToSamples(message->getFloat(i), graph->getSampleRate());
+  }
+}
+
+void DspDelayTaps::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
+  DspDelayTaps *d = reinterpret_cast<DspDelayTaps *>(dspObject);
+  
+  if (d->delayline == NULL) {
+    for (int k = 0; k < d->numTaps; k++) {
+      memset(d->getDspBufferAtOutlet(k) + fromIndex, 0, (toIndex-fromIndex)*sizeof(float));
+    }
+    return;
+  }
+  
+  int headIndex = 0;
+  int bufferLength = 0;
+  float *buffer = d->delayline->getBuffer(&headIndex, &bufferLength);
+  int maxDelay = d->delayline->getMaxDelay();
+  
+  for (int k = 0; k < d->numTaps; k++) {
+    float *output = d->getDspBufferAtOutlet(k);
+    float delay = d->delays[k];
+    if (!(delay >= 0.0f)) { // also catches NaN
+      delay = 0.0f;
+    } else if (delay > (float) maxDelay) {
+      delay = (float) maxDelay;
+    }
+    int delayInt = (int) delay;
+    
+    if (delay == (float) delayInt) {
+      // As for delread~, the block is contiguous as the delay line mirrors its first block.
+      int delayIndex = headIndex - d->blockSizeInt - delayInt;
+      if (delayIndex < 0) delayIndex += bufferLength;
+      memcpy(output + fromIndex, buffer + delayIndex + fromIndex, (toIndex-fromIndex)*sizeof(float));
+    } else {
+      // As for vd~, a fractional delay is in [1, maxDelay-1], such that all four points around
+      // each sample are in the delay line and not being overwritten.
+      if (delayInt < 1) {
+        delayInt = 1;
+        delay = 1.0f;
+      } else if (delayInt > maxDelay - 2) {
+        delayInt = maxDelay - 2;
+        delay = (float) (maxDelay - 1);
+      }
+      
+      // the sample of the first point after each output sample, and the fraction from there
+      int delayIndex = headIndex - d->blockSizeInt - delayInt - 1;
+      if (delayIndex < 0) delayIndex += bufferLength;
+      float frac = (float) (delayInt + 1) - delay;
+      
+      if (delayIndex >= 1 && delayIndex <= bufferLength - 2) {
+        ArrayArithmetic::interpolate4Fraction(buffer + delayIndex, frac, output, fromIndex, toIndex);
+      } else {
+        // the points wrap around the ends of the delay line
+        float *wrapBuffer = d->wrapBuffer;
+        for (int i = 0, j = delayIndex - 1; i < d->blockSizeInt + 3; i++, j++) {
+          if (j < 0) j += bufferLength;
+          else if (j >= bufferLength) j -= bufferLength;
+          wrapBuffer[i] = buffer[j];
+        }
+        ArrayArithmetic::interpolate4Fraction(wrapBuffer + 1, frac, output, fromIndex, toIndex);
+      }
+    }
+  }
+}
@@ -0,0 +1,75 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _DSP_DELAY_TAPS_H_
+#define _DSP_DELAY_TAPS_H_
+
+#include "DelayReceiver.h"
+
+class DspDelayWrite;
+
+/**
+ * [taps~ name delay1 delay2 ...]
+ * Reads a delay line at several fixed delays, each to its own outlet. A list at the inlet sets the
+ * delays of the taps in order. This object also implements the <code>DelayReceiver</code>
+ * interface.
+ *
+ * The delays need not be whole samples. Each tap is a block of consecutive samples at a constant
+ * fraction between them, and so a whole block is interpolated with the same four weights, reading
+ * the delay line in place. Taps at whole samples are copied.
+ */
+class DspDelayTaps : public DelayReceiver {
+  
+  public:
+    static MessageObject *newObject(PdMessage *initMessage, PdGraph *graph);
+    DspDelayTaps(PdMessage *initMessage, PdGraph *graph);
+    ~DspDelayTaps();
+  
+    static const char *getObjectLabel();
+    std::string toString();
+    ObjectType getObjectType();
+  
+  private:
+    void processMessage(int inletIndex, PdMessage *message);
+    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
+  
+    int numTaps;
+    float *delays; // in samples
+  
+    // the points around a tap which wraps around the end of the delay line
+    float *wrapBuffer;
+};
+
+inline std::string DspDelayTaps::toString() {
+  return std::string(DspDelayTaps::getObjectLabel()) + " " + ((name == NULL) ? "" : name);
+}
+
+inline const char *DspDelayTaps::getObjectLabel() {
+  return "taps~";
+}
+
+inline ObjectType DspDelayTaps::getObjectType() {
+  return DSP_DELAY_TAPS;
+}
+
+#endif // _DSP_DELAY_TAPS_H_
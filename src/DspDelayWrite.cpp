@@ -21,6 +21,7 @@
  */
 
 #include "ArrayArithmetic.h"
+#include "BufferPool.h"
 #include "DspDelayWrite.h"
 #include "PdGraph.h"
 
@@ -30,40 +31,89 @@ MessageObject *DspDelayWrite::newObject(PdMessage *initMessage, PdGraph *graph)
 
 DspDelayWrite::DspDelayWrite(PdMessage *initMessage, PdGraph *graph) : DspObject(0, 1, 0, 0, graph) {
   if (initMessage->isSymbol(0) && initMessage->isFloat(1)) {
-    bufferLength = (int) ceilf(StaticUtils::millisecondsToSamples(initMessage->getFloat(1), 
-        graph->getSampleRate())); 
-    if (bufferLength % blockSizeInt != 0) {
-      bufferLength = ((bufferLength/blockSizeInt)+2) * blockSizeInt;
-    } else {
-      bufferLength += blockSizeInt;
-    }
-    headIndex = 0;
-    // buffer[bufferLength] == buffer[0], which makes calculation in vd~ easier
-    int numBufferLengthBytes = (bufferLength+1)*sizeof(float);
-    dspBufferAtOutlet[0] = ALLOC_ALIGNED_BUFFER(numBufferLengthBytes);
-    memset(dspBufferAtOutlet[0], 0, numBufferLengthBytes); // zero the delay buffer
+    int delayLength = (int) ceilf(StaticUtils::millisecondsToSamples(initMessage->getFloat(1), 
+        graph->getSampleRate()));
+    delayLine = new DelayLine(delayLength, blockSizeInt);
     name = StaticUtils::copyString(initMessage->getSymbol(0));
   } else {
     graph->printErr("ERROR: delwrite~ must be initialised as [delwrite~ name delay].");
-    headIndex = 0;
-    bufferLength = 0;
+    delayLine = new DelayLine(0, blockSizeInt);
     name = NULL;
   }
+  writer = NULL;
+  writerOutletIndex = 0;
   processFunction = &processSignal;
+  processFunctionNoMessage = &processSignal;
 }
 
 DspDelayWrite::~DspDelayWrite() {
   free(name);
-  FREE_ALIGNED_BUFFER(dspBufferAtOutlet[0]);
-  dspBufferAtOutlet[0] = NULL;
+  delete delayLine;
+}
+
+list<DspObject *> DspDelayWrite::getProcessOrder() {
+  if (isOrdered) return list<DspObject *>();
+  
+  list<DspObject *> processList = DspObject::getProcessOrder();
+  
+  // The input buffer has now been released. If it came from an object whose only receiver is this
+  // one, then that object may as well write into the delay line. Delay receivers are excluded as
+  // they may refer to the delay line themselves.
+  writer = NULL;
+  processFunction = &processSignal;
+  processFunctionNoMessage = &processSignal;
+  if (incomingDspConnections[0].size() == 1) {
+    ObjectLetPair objectLetPair = incomingDspConnections[0].front();
+    DspObject *dspObject = reinterpret_cast<DspObject *>(objectLetPair.first);
+    switch (dspObject->getObjectType()) {
+      case DSP_DELAY_READ:
+      case DSP_DELAY_TAPS:
+      case DSP_VARIABLE_DELAY: break;
+      default: {
+        if (dspObject->canSetBufferAtOutlet(objectLetPair.second) &&
+            dspObject->getOutgoingDspConnections(objectLetPair.second).size() == 1) {
+          writer = dspObject;
+          writerOutletIndex = objectLetPair.second;
+          writer->setDspBufferAtOutlet(delayLine->getHead(), writerOutletIndex);
+          processFunction = &processInPlace;
+          processFunctionNoMessage = &processInPlace;
+        }
+        break;
+      }
+    }
+  }
+  return processList;
+}
+
+bool DspDelayWrite::isAtRest() {
+  // readers elsewhere see silence whether or not the head advances
+  return isDspInletKnownSilent(0) && delayLine->isSilent();
+}
+
+void DspDelayWrite::onInletConnectionUpdate(unsigned int inletIndex) {
+  releaseWriter();
+}
+
+void DspDelayWrite::releaseWriter() {
+  if (writer != NULL) {
+    // the buffer which the writer had before it was ordered has since been reused. It gets a new
+    // one, which it keeps until the graph is next ordered.
+    writer->setDspBufferAtOutlet(graph->getBufferPool()->getBuffer(1), writerOutletIndex);
+    writer = NULL;
+    processFunction = &processSignal;
+    processFunctionNoMessage = &processSignal;
+  }
 }
 
 void DspDelayWrite::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
   DspDelayWrite *d = reinterpret_cast<DspDelayWrite *>(dspObject);
+  d->delayLine->write(d->dspBufferAtInlet[0]);
+}
+
+void DspDelayWrite::processInPlace(DspObject *dspObject, int fromIndex, int toIndex) {
+  DspDelayWrite *d = reinterpret_cast<DspDelayWrite *>(dspObject);
   
-  // copy inlet buffer to delay buffer
-  memcpy(d->dspBufferAtOutlet[0] + d->headIndex, d->dspBufferAtInlet[0], toIndex*sizeof(float));
-  if (d->headIndex == 0) d->dspBufferAtOutlet[0][d->bufferLength] = d->dspBufferAtOutlet[0][0];
-  d->headIndex += toIndex;
-  if (d->headIndex >= d->bufferLength) d->headIndex = 0;
+  // the writer has already filled the block at the head
+  d->delayLine->advance();
+  d->writer->setDspBufferAtOutlet(d->delayLine->getHead(), d->writerOutletIndex);
 }
@@ -23,8 +23,14 @@
 #ifndef _DSP_DELAY_WRITE_H_
 #define _DSP_DELAY_WRITE_H_
 
+#include "DelayLine.h"
 #include "DspObject.h"
 
+/**
+ * [delwrite~ name delay]
+ * Any block of samples which begins in the delay line is contiguous in memory, such that readers
+ * may refer to it in place. See <code>DelayLine</code>.
+ */
 class DspDelayWrite : public DspObject {
   
   public:
@@ -35,21 +41,44 @@ class DspDelayWrite : public DspObject {
     static const char *getObjectLabel();
     std::string toString();
     ObjectType getObjectType();
+    bool isAtRest();
   
     const char *getName();
   
     inline float *getBuffer(int *index, int *length) {
-      *index = headIndex;
-      *length = bufferLength;
-      return dspBufferAtOutlet[0];
+      *index = delayLine->getHeadIndex();
+      *length = delayLine->getLength();
+      return delayLine->getBuffer();
+    }
+  
+    /**
+     * The longest delay in samples which a reader may request, relative to the last block written.
+     * The block which is being written in the current tick is never one which a reader at this
+     * delay still needs, no matter whether the reader is processed before or after this object.
+     */
+    inline int getMaxDelay() {
+      return delayLine->getMaxDelay() - blockSizeInt;
     }
   
+    list<DspObject *> getProcessOrder();
+  
+  protected:
+    void onInletConnectionUpdate(unsigned int inletIndex);
+  
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
+    static void processInPlace(DspObject *dspObject, int fromIndex, int toIndex);
+  
+    /** Returns the object at the inlet to its own buffer, if it was writing into the delay line. */
+    void releaseWriter();
   
     char *name;
-    int bufferLength;
-    int headIndex;
+    DelayLine *delayLine;
+  
+    // If the only object connected to the inlet has no other receivers, then it writes its output
+    // directly into the delay line, and the copy of the input is avoided.
+    DspObject *writer;
+    int writerOutletIndex;
 };
 
 inline std::string DspDelayWrite::toString()  {
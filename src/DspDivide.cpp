@@ -50,6 +50,10 @@ string DspDivide::toString() {
   return string(str);
 }
 
+bool DspDivide::isAtRest() {
+  return true; // the output only depends on the inputs
+}
+
 void DspDivide::processMessage(int inletIndex, PdMessage *message) {
   if (inletIndex == 1) {
     if (message->isFloat(0)) {
@@ -34,6 +34,8 @@ class DspDivide : public DspObject {
 
     static const char *getObjectLabel();
     std::string toString();
+    bool isAtRest();
+    bool canSkipDsp() { return true; }
 
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
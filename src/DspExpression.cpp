@@ -0,0 +1,101 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "BufferPool.h"
+#include "DspExpression.h"
+#include "PdGraph.h"
+
+MessageObject *DspExpression::newObject(PdMessage *initMessage, PdGraph *graph) {
+  string text = getText(initMessage);
+  ExpressionProgram *program = new ExpressionProgram(text.c_str(), false, graph->getBlockSize(),
+      graph->getBufferPool());
+  if (!program->isValid()) {
+    graph->printErr("%s: %s in \"%s\".", getObjectLabel(), program->getError(), text.c_str());
+  }
+  return new DspExpression(program, text, graph);
+}
+
+DspExpression::DspExpression(ExpressionProgram *program, const string &text, PdGraph *graph) :
+    DspObject(program->getNumInlets(), program->getNumSignalInlets(), 0, program->getNumExpressions(), graph) {
+  this->program = program;
+  this->text = text;
+  float **inletSlots[getNumDspInlets()];
+  for (int i = 0; i < getNumDspInlets(); i++) {
+    inletSlots[i] = getDspBufferSlotAtInlet(i);
+  }
+  float **outletSlots[getNumDspOutlets()];
+  for (int i = 0; i < getNumDspOutlets(); i++) {
+    outletSlots[i] = getDspBufferSlotAtOutlet(i);
+  }
+  program->bind(inletSlots, outletSlots);
+  bufferPool = graph->getBufferPool();
+  processFunction = &processSignal;
+  processFunctionNoMessage = &processSignal;
+}
+
+DspExpression::~DspExpression() {
+  delete program;
+}
+
+string DspExpression::toString() {
+  return string(getObjectLabel()) + " " + text;
+}
+
+string DspExpression::getText(PdMessage *initMessage) {
+  // Escaped commas and semicolons arrive as "\," and "\", and dollar signs as "$" or "\$".
+  string text;
+  for (int i = 0; i < initMessage->getNumElements(); i++) {
+    if (i > 0) text += " ";
+    if (initMessage->isFloat(i)) {
+      char str[32];
+      snprintf(str, sizeof(str), "%.9g", initMessage->getFloat(i));
+      text += str;
+    } else if (initMessage->isSymbol(i)) {
+      const char *symbol = initMessage->getSymbol(i);
+      if (!strcmp(symbol, "\\")) {
+        text += ";";
+      } else {
+        for (const char *c = symbol; *c != '\0'; c++) {
+          if (*c != '\\') text += *c;
+        }
+      }
+    }
+  }
+  return text;
+}
+
+void DspExpression::processMessage(int inletIndex, PdMessage *message) {
+  if (message->isFloat(0)) {
+    program->setInlet(inletIndex, message->getFloat(0));
+  } else if (message->isSymbol(0, "clear")) {
+    // the samples of the block before the message are already computed
+    int blockIndex = (int) ceil(graph->getBlockIndex(message));
+    program->clear((blockIndex < 0) ? 0 : (blockIndex > blockSizeInt) ? blockSizeInt : blockIndex);
+  }
+}
+
+void DspExpression::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
+  DspExpression *d = reinterpret_cast<DspExpression *>(dspObject);
+  float *scratch = d->bufferPool->getScratchBuffers(d->program->getNumScratchBuffers());
+  d->program->process(scratch, fromIndex, toIndex);
+}
@@ -0,0 +1,65 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _DSP_EXPRESSION_H_
+#define _DSP_EXPRESSION_H_
+
+#include "DspObject.h"
+#include "ExpressionProgram.h"
+
+/**
+ * [expr~ expression; expression; ...]
+ * Computes the given expressions of the signal and float inlets, each to its own outlet, with the
+ * syntax of Pd's expr. See <code>ExpressionProgram</code>.
+ */
+class DspExpression : public DspObject {
+  
+  public:
+    static MessageObject *newObject(PdMessage *initMessage, PdGraph *graph);
+    DspExpression(ExpressionProgram *program, const string &text, PdGraph *graph);
+    ~DspExpression();
+  
+    static const char *getObjectLabel();
+    std::string toString();
+    bool isAtRest() { return true; }
+    bool canSkipDsp() { return true; }
+  
+  protected:
+    /** Returns the text of the expressions, which Pd has split into atoms. */
+    static string getText(PdMessage *initMessage);
+  
+    ExpressionProgram *program;
+    string text;
+  
+  private:
+    void processMessage(int inletIndex, PdMessage *message);
+    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
+  
+    BufferPool *bufferPool; // of the context, which provides the scratch buffers
+};
+
+inline const char *DspExpression::getObjectLabel() {
+  return "expr~";
+}
+
+#endif // _DSP_EXPRESSION_H_
@@ -0,0 +1,185 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <math.h>
+#if __SSE__
+#include <xmmintrin.h>
+#elif __ARM_NEON__
+#include <arm_neon.h>
+#endif
+#include "DspFdn.h"
+#include "PdGraph.h"
+
+// samples smaller than this are flushed to zero, as they are inaudible and may be denormal
+#define SAMPLE_THRESHOLD 1e-20f
+
+// the comb delays of Schroeder's reverberator, in milliseconds
+static const float DEFAULT_DELAYS[] = {29.7f, 37.1f, 41.1f, 43.7f};
+#define NUM_DEFAULT_DELAYS 4
+
+MessageObject *DspFdn::newObject(PdMessage *initMessage, PdGraph *graph) {
+  return new DspFdn(initMessage, graph);
+}
+
+DspFdn::DspFdn(PdMessage *initMessage, PdGraph *graph) : DspObject(2, 1, 0, 2, graph) {
+  numLines = 0;
+  while (initMessage->isFloat(numLines)) numLines++;
+  if (numLines == 0) numLines = NUM_DEFAULT_DELAYS;
+  
+  delayLines = new DelayLine *[numLines];
+  delays = (int *) calloc(numLines, sizeof(int));
+  for (int k = 0; k < numLines; k++) {
+    float delayInMs = initMessage->isFloat(0) ? initMessage->getFloat(k) : DEFAULT_DELAYS[k];
+    int delay = (int) roundf(StaticUtils::millisecondsToSamples(delayInMs, graph->getSampleRate()));
+    delays[k] = (delay > blockSizeInt) ? delay : blockSizeInt;
+    delayLines[k] = new DelayLine(delays[k], blockSizeInt);
+  }
+  feedback = 0.0f;
+  
+  taps = (float **) calloc(numLines, sizeof(float *));
+  leftSum = ALLOC_ALIGNED_BUFFER(blockSizeInt * sizeof(float));
+  rightSum = ALLOC_ALIGNED_BUFFER(blockSizeInt * sizeof(float));
+  
+  processFunction = &processSignal;
+  processFunctionNoMessage = &processSignal;
+}
+
+DspFdn::~DspFdn() {
+  for (int k = 0; k < numLines; k++) {
+    delete delayLines[k];
+  }
+  delete [] delayLines;
+  free(delays);
+  free(taps);
+  FREE_ALIGNED_BUFFER(leftSum);
+  FREE_ALIGNED_BUFFER(rightSum);
+}
+
+string DspFdn::toString() {
+  char str[snprintf(NULL, 0, "%s %i", getObjectLabel(), numLines)+1];
+  snprintf(str, sizeof(str), "%s %i", getObjectLabel(), numLines);
+  return string(str);
+}
+
+void DspFdn::processMessage(int inletIndex, PdMessage *message) {
+  switch (inletIndex) {
+    case 0: {
+      if (message->isSymbol(0, "clear")) {
+        for (int k = 0; k < numLines; k++) {
+          delayLines[k]->clear();
+        }
+      }
+      break;
+    }
+    case 1: {
+      if (message->isFloat(0)) {
+        float f = message->getFloat(0);
+        feedback = (f < -1.0f) ? -1.0f : (f > 1.0f) ? 1.0f : f;
+      }
+      break;
+    }
+    default: break;
+  }
+}
+
+/** output += input, over n samples. */
+static inline void accumulate(float *input, float *output, int n) {
+  int i = 0;
+  #if __SSE__
+  for (; i <= n - 4; i += 4) {
+    _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), _mm_loadu_ps(input + i)));
+  }
+  #elif __ARM_NEON__
+  for (; i <= n - 4; i += 4) {
+    vst1q_f32(output + i, vaddq_f32(vld1q_f32(output + i), vld1q_f32(input + i)));
+  }
+  #endif
+  for (; i < n; i++) {
+    output[i] += input[i];
+  }
+}
+
+/**
+ * output = input + g*tap + c*(leftSum + rightSum), where c = -2g/N, over n samples. Samples which
+ * are denormal or NaN are flushed to zero, such that the network neither slows nor stays broken.
+ */
+static inline void feedBack(float *input, float *tap, float *leftSum, float *rightSum, float g,
+    float c, float *output, int n) {
+  int i = 0;
+  #if __SSE__
+  const __m128 gVec = _mm_set1_ps(g);
+  const __m128 cVec = _mm_set1_ps(c);
+  const __m128 signVec = _mm_set1_ps(-0.0f);
+  const __m128 thresholdVec = _mm_set1_ps(SAMPLE_THRESHOLD);
+  for (; i <= n - 4; i += 4) {
+    __m128 sum = _mm_add_ps(_mm_loadu_ps(leftSum + i), _mm_loadu_ps(rightSum + i));
+    __m128 w = _mm_add_ps(_mm_loadu_ps(input + i),
+        _mm_add_ps(_mm_mul_ps(gVec, _mm_loadu_ps(tap + i)), _mm_mul_ps(cVec, sum)));
+    w = _mm_and_ps(w, _mm_cmpge_ps(_mm_andnot_ps(signVec, w), thresholdVec));
+    _mm_storeu_ps(output + i, w);
+  }
+  #elif __ARM_NEON__
+  const float32x4_t thresholdVec = vdupq_n_f32(SAMPLE_THRESHOLD);
+  for (; i <= n - 4; i += 4) {
+    float32x4_t sum = vaddq_f32(vld1q_f32(leftSum + i), vld1q_f32(rightSum + i));
+    float32x4_t w = vmlaq_n_f32(vmlaq_n_f32(vld1q_f32(input + i), vld1q_f32(tap + i), g), sum, c);
+    uint32x4_t mask = vcgeq_f32(vabsq_f32(w), thresholdVec);
+    vst1q_f32(output + i, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(w), mask)));
+  }
+  #endif
+  for (; i < n; i++) {
+    float w = input[i] + (g*tap[i] + c*(leftSum[i] + rightSum[i]));
+    output[i] = (fabsf(w) >= SAMPLE_THRESHOLD) ? w : 0.0f; // also catches NaN
+  }
+}
+
+void DspFdn::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
+  DspFdn *d = reinterpret_cast<DspFdn *>(dspObject);
+  
+  // The network is computed for the whole block at once, once any messages in it have arrived. A
+  // message at the end of the block leaves an empty range after the block has been computed.
+  if (toIndex < d->blockSizeInt || fromIndex == toIndex) return;
+  int n = d->blockSizeInt;
+  
+  // As each delay is at least one block, the taps are not overwritten while writing the lines.
+  for (int k = 0; k < d->numLines; k++) {
+    d->taps[k] = d->delayLines[k]->getBuffer() + d->delayLines[k]->getIndex(d->delays[k]);
+  }
+  memcpy(d->leftSum, d->taps[0], n*sizeof(float));
+  memset(d->rightSum, 0, n*sizeof(float));
+  for (int k = 1; k < d->numLines; k++) {
+    accumulate(d->taps[k], (k % 2 == 0) ? d->leftSum : d->rightSum, n);
+  }
+  
+  // the input buffer may be the same as either output buffer, and so it is read first
+  float c = -2.0f * d->feedback / (float) d->numLines;
+  for (int k = 0; k < d->numLines; k++) {
+    DelayLine *delayLine = d->delayLines[k];
+    feedBack(d->dspBufferAtInlet[0], d->taps[k], d->leftSum, d->rightSum, d->feedback, c,
+        delayLine->getHead(), n);
+    delayLine->advance();
+  }
+  
+  memcpy(d->dspBufferAtOutlet[0], d->leftSum, n*sizeof(float));
+  memcpy(d->dspBufferAtOutlet[1], d->rightSum, n*sizeof(float));
+}
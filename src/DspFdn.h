@@ -0,0 +1,72 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _DSP_FDN_H_
+#define _DSP_FDN_H_
+
+#include "DelayLine.h"
+#include "DspObject.h"
+
+/**
+ * [fdn~ delay1 delay2 ...]
+ * A feedback delay network, the core of a reverberator. The input is fed into a delay line for
+ * each given delay (in milliseconds). The outputs of the lines are mixed by the Householder matrix
+ * I - (2/N)*J, which is orthogonal, scaled by the feedback gain at the right inlet, and fed back
+ * into the lines. The left outlet is the sum of the first, third, ... lines, and the right outlet
+ * the sum of the others. "clear" at the left inlet silences all lines. Without arguments, the
+ * four comb delays of Schroeder's reverberator are used.
+ *
+ * The network is computed a block at a time, such that each line is read and written in place with
+ * a handful of vector operations over the block, and the feedback gain changes only at the start
+ * of a block. A delay is therefore at least one block long. The feedback gain is clamped to
+ * [-1, 1], at which the network is lossless.
+ */
+class DspFdn : public DspObject {
+  
+  public:
+    static MessageObject *newObject(PdMessage *initMessage, PdGraph *graph);
+    DspFdn(PdMessage *initMessage, PdGraph *graph);
+    ~DspFdn();
+  
+    static const char *getObjectLabel();
+    std::string toString();
+  
+  private:
+    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
+    void processMessage(int inletIndex, PdMessage *message);
+  
+    int numLines;
+    DelayLine **delayLines;
+    int *delays; // in samples
+    float feedback;
+  
+    float **taps; // the block read from each line
+    float *leftSum; // the sum of the taps of the first, third, ... lines
+    float *rightSum; // the sum of the taps of the second, fourth, ... lines
+};
+
+inline const char *DspFdn::getObjectLabel() {
+  return "fdn~";
+}
+
+#endif // _DSP_FDN_H_
@@ -20,14 +20,12 @@
  *
  */
 
-#include "ArrayArithmetic.h"
+#include "BufferPool.h"
 #include "DspFilter.h"
+#include "PdGraph.h"
 
-class PdGraph;
-
-DspFilter::DspFilter(int numMessageInlets, PdGraph *graph) : DspObject(numMessageInlets, 1, 0, 1, graph) {
-  x1 = x2 = y1 = y2 = 0.0f;
-
+DspFilter::DspFilter(int numMessageInlets, int numDspInlets, PdGraph *graph) :
+    DspObject(numMessageInlets, numDspInlets, 0, 1, graph) {
   processFunction = &processFilter;
   processFunctionNoMessage = &processFilter;
 }
@@ -36,34 +34,49 @@ DspFilter::~DspFilter() {
   // nothing to do
 }
 
-void DspFilter::onInletConnectionUpdate(unsigned int inletIndex) {
-  // TODO(mhroth)
+float *DspFilter::getFoldedOutputBuffer() {
+  // filters whose coefficients are computed from a signal are not folded
+  BufferPool *bufferPool = graph->getBufferPool();
+  float value = 0.0f;
+  return (processFunction == &processFilter && biquad.isAtRest() &&
+      bufferPool->isConstantBuffer(dspBufferAtInlet[0], &value) && value == 0.0f)
+      ? bufferPool->getZeroBuffer() : NULL;
+}
+
+bool DspFilter::isAtRest() {
+  return biquad.isAtRest() && isDspInletKnownSilent(0);
+}
+
+bool DspFilter::hasSilentOutput() {
+  // the filter is linear, whether or not its coefficients are computed from a signal
+  return isAtRest() && isDspOutputSilent();
 }
 
 void DspFilter::processFilter(DspObject *dspObject, int fromIndex, int toIndex) {
   DspFilter *d = reinterpret_cast<DspFilter *>(dspObject);
-  
-  int n = toIndex - fromIndex; // number of samples to process
-  float bufferIn[n+2]; // new inlet buffer
-  bufferIn[0] = d->x2; bufferIn[1] = d->x1;
-  memcpy(bufferIn+2, d->dspBufferAtInlet[0]+fromIndex, n*sizeof(float));
-  
-  float bufferOut[n+2]; // new outlet buffer
-  bufferOut[0] = d->y2; bufferOut[1] = d->y1;
-  
-  #if __APPLE__
-  vDSP_deq22(bufferIn, 1, d->b, bufferOut, 1, n);
+  d->biquad.process(d->dspBufferAtInlet[0]+fromIndex, d->dspBufferAtOutlet[0]+fromIndex,
+      toIndex-fromIndex);
+}
+
+DspGroupProcessFunction DspFilter::getGroupProcessFunction() {
+  #if __AVX2__
+  // filters with pending messages, or whose coefficients are computed from a signal, are not grouped
+  return (processFunction == &processFilter) ? &processFilterGroup : NULL;
   #else
-  int _toIndex = n + 2;
-  for (int i = 2; i < _toIndex; ++i) {
-    bufferOut[i] = d->b[0]*bufferIn[i] + d->b[1]*bufferIn[i-1] + d->b[2]*bufferIn[i-2] -
-        d->b[3]*bufferOut[i-1] - d->b[4]*bufferOut[i-2];
-  }
+  // a bank of four filters is no faster than one filter which computes four samples at once
+  return NULL;
   #endif
-  
-  memcpy(d->dspBufferAtOutlet[0]+fromIndex, bufferOut+2, n*sizeof(float));
-  
-  // retain state
-  d->x2 = bufferIn[n]; d->x1 = bufferIn[n+1];
-  d->y2 = bufferOut[n]; d->y1 = bufferOut[n+1];
+}
+
+void DspFilter::processFilterGroup(DspObject **dspObjects, int numObjects, int blockSize) {
+  BiquadEngine *filters[numObjects];
+  float *inputs[numObjects];
+  float *outputs[numObjects];
+  for (int i = 0; i < numObjects; i++) {
+    DspFilter *d = reinterpret_cast<DspFilter *>(dspObjects[i]);
+    filters[i] = &d->biquad;
+    inputs[i] = d->dspBufferAtInlet[0];
+    outputs[i] = d->dspBufferAtOutlet[0];
+  }
+  BiquadEngine::processBank(filters, inputs, outputs, numObjects, blockSize);
 }
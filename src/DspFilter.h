@@ -23,22 +23,35 @@
 #ifndef _DSP_FILTER_H_
 #define _DSP_FILTER_H_
 
+#include "BiquadEngine.h"
 #include "DspObject.h"
 
-/** The superclass of lop~, hip~, bp~, and biquad~ */
+/**
+ * The superclass of lop~, hip~, bp~, and biquad~. The filter is computed in place by a
+ * <code>BiquadEngine</code>, with the coefficients which the subclass sets.
+ */
 class DspFilter : public DspObject {
   
   public:
-    DspFilter(int numMessageInlets, PdGraph *graph);
+    DspFilter(int numMessageInlets, int numDspInlets, PdGraph *graph);
     ~DspFilter();
-
-    void onInletConnectionUpdate(unsigned int inletIndex);
+  
+    /** A filter at rest stays at rest with silence at its input. */
+    float *getFoldedOutputBuffer();
+    bool isAtRest();
+    bool hasSilentOutput();
+  
+    /**
+     * Filters with fixed coefficients are processed as a bank, see <code>BiquadEngine::processBank()</code>,
+     * where vectors are wide enough for it to be faster.
+     */
+    DspGroupProcessFunction getGroupProcessFunction();
   
   protected:  
     static void processFilter(DspObject *dspObject, int fromIndex, int toIndex);
+    static void processFilterGroup(DspObject **dspObjects, int numObjects, int blockSize);
     
-    float x1, x2, y1, y2;
-    float b[5]; // filter coefficients
+    BiquadEngine biquad;
 };
 
 #endif // _DSP_FILTER_H_
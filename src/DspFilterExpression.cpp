@@ -0,0 +1,48 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "DspFilterExpression.h"
+#include "PdGraph.h"
+
+MessageObject *DspFilterExpression::newObject(PdMessage *initMessage, PdGraph *graph) {
+  string text = getText(initMessage);
+  ExpressionProgram *program = new ExpressionProgram(text.c_str(), true, graph->getBlockSize(),
+      graph->getBufferPool());
+  if (!program->isValid()) {
+    graph->printErr("%s: %s in \"%s\".", getObjectLabel(), program->getError(), text.c_str());
+  }
+  return new DspFilterExpression(program, text, graph);
+}
+
+DspFilterExpression::DspFilterExpression(ExpressionProgram *program, const string &text, PdGraph *graph) :
+    DspExpression(program, text, graph) {
+  // nothing to do
+}
+
+DspFilterExpression::~DspFilterExpression() {
+  // nothing to do
+}
+
+string DspFilterExpression::toString() {
+  return string(getObjectLabel()) + " " + text;
+}
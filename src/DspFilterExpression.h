@@ -0,0 +1,54 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _DSP_FILTER_EXPRESSION_H_
+#define _DSP_FILTER_EXPRESSION_H_
+
+#include "DspExpression.h"
+
+/**
+ * [fexpr~ expression; expression; ...]
+ * As [expr~], but the expressions may refer to earlier samples of the inputs ($x#[-n]) and of the
+ * outputs ($y#[-n]), as for filters. Samples which do not depend on each other are computed
+ * together. "clear" resets the history to silence.
+ */
+class DspFilterExpression : public DspExpression {
+  
+  public:
+    static MessageObject *newObject(PdMessage *initMessage, PdGraph *graph);
+    DspFilterExpression(ExpressionProgram *program, const string &text, PdGraph *graph);
+    ~DspFilterExpression();
+  
+    static const char *getObjectLabel();
+    std::string toString();
+  
+    /** The history of the expressions is not tracked, such that the object is never at rest. */
+    bool isAtRest() { return false; }
+    bool canSkipDsp() { return false; }
+};
+
+inline const char *DspFilterExpression::getObjectLabel() {
+  return "fexpr~";
+}
+
+#endif // _DSP_FILTER_EXPRESSION_H_
@@ -0,0 +1,296 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "DspFusedChain.h"
+#include "DspLog.h"
+#include "PdGraph.h"
+
+// the number of samples which are carried through the chain at once
+#define STRIP_LENGTH 16
+
+#pragma mark - Fusion
+
+/** Returns true if the given object may follow the previous one in a fused chain, if any. */
+static bool canFuse(DspObject *dspObject, DspObject *previous, ElementwiseOperation *operation) {
+  if (dspObject->getNumPendingMessages() > 0 || !dspObject->getElementwiseOperation(operation)) {
+    return false;
+  }
+  if (previous == NULL) return true;
+  // the previous object must connect only to the left inlet of this one, and nothing else to it
+  list<ObjectLetPair> outgoingConnections = previous->getOutgoingDspConnections(0);
+  list<ObjectLetPair> incomingConnections = dspObject->getIncomingDspConnections(0);
+  return outgoingConnections.size() == 1 && incomingConnections.size() == 1 &&
+      outgoingConnections.front() == ObjectLetPair(dspObject, 0) &&
+      incomingConnections.front() == ObjectLetPair(previous, 0);
+}
+
+void DspFusedChain::fuse(list<DspObject *> *processOrder, PdGraph *graph) {
+  if (graph->getBlockSize() % STRIP_LENGTH != 0) return;
+
+  list<DspObject *>::iterator it = processOrder->begin();
+  while (it != processOrder->end()) {
+    vector<DspObject *> members;
+    vector<ElementwiseOperation> operations;
+    ElementwiseOperation operation;
+    list<DspObject *>::iterator next = it;
+    while (next != processOrder->end() &&
+        canFuse(*next, members.empty() ? NULL : members.back(), &operation)) {
+      members.push_back(*next++);
+      operations.push_back(operation);
+    }
+    if (members.size() > 1) {
+      DspFusedChain *chain = new DspFusedChain(members, operations, graph);
+      chain->memberNodes.splice(chain->memberNodes.end(), *processOrder, it, next);
+      processOrder->insert(next, chain);
+      it = next;
+    } else {
+      ++it;
+    }
+  }
+}
+
+void DspFusedChain::unfuse(list<DspObject *> *processOrder) {
+  list<DspObject *>::iterator it = processOrder->begin();
+  while (it != processOrder->end()) {
+    if ((*it)->getObjectType() == DSP_FUSED_CHAIN) {
+      DspFusedChain *chain = reinterpret_cast<DspFusedChain *>(*it);
+      processOrder->splice(it, chain->memberNodes);
+      it = processOrder->erase(it);
+      delete chain;
+    } else {
+      ++it;
+    }
+  }
+}
+
+list<DspObject *>::iterator DspFusedChain::dissolve(list<DspObject *> *processOrder,
+    list<DspObject *>::iterator position, list<DspObject *> *dissolvedChains) {
+  DspFusedChain *chain = reinterpret_cast<DspFusedChain *>(*position);
+  processOrder->splice(position, chain->memberNodes);
+  list<DspObject *>::iterator next = position;
+  ++next;
+  dissolvedChains->splice(dissolvedChains->end(), *processOrder, position);
+  return next;
+}
+
+
+#pragma mark - Constructor/Destructor
+
+DspFusedChain::DspFusedChain(vector<DspObject *> &members, vector<ElementwiseOperation> &operations,
+    PdGraph *graph) : DspObject(0, 0, 0, 1, graph) {
+  this->members = members;
+  this->operations = operations;
+  for (int i = 0; i < members.size(); i++) {
+    processFunctions.push_back(members[i]->processFunction);
+  }
+  input = members.front()->getDspBufferSlotAtInlet(0);
+  output = members.back()->getDspBufferAtOutlet(0);
+  dspBufferAtOutlet[0] = output; // as seen by the graph
+  processFunction = &processChain;
+  processIndex = members.front()->processIndex;
+}
+
+DspFusedChain::~DspFusedChain() {
+  // the objects belong to the graph
+}
+
+string DspFusedChain::toString() {
+  string str = getObjectLabel();
+  for (int i = 0; i < members.size(); i++) {
+    str += (i == 0) ? " " : " | ";
+    str += members[i]->toString();
+  }
+  return str;
+}
+
+bool DspFusedChain::isAtRest() {
+  return true; // the members are elementwise
+}
+
+bool DspFusedChain::hasSilentOutput() {
+  // as for each of the objects, the output stays silent if it is silent now and does not change
+  // while the chain is at rest. Anything multiplied by silence does not change.
+  bool isZero = graph->isDspBufferKnownSilent(*input);
+  bool isSteady = isZero;
+  for (int k = 0; k < operations.size(); k++) {
+    ElementwiseOperation *operation = &operations[k];
+    switch (operation->opcode) {
+      case ElementwiseOperation::ADD:
+      case ElementwiseOperation::SUBTRACT:
+      case ElementwiseOperation::MULTIPLY: {
+        bool isOperandZero = (operation->signal != NULL)
+            ? graph->isDspBufferKnownSilent(*operation->signal) : (*operation->constant0 == 0.0f);
+        bool isOperandSteady = (operation->signal == NULL) || isOperandZero;
+        if (operation->opcode == ElementwiseOperation::MULTIPLY) {
+          isZero = isZero || isOperandZero;
+          isSteady = isZero || (isSteady && isOperandSteady);
+        } else {
+          isZero = isZero && isOperandZero;
+          isSteady = isSteady && isOperandSteady;
+        }
+        break;
+      }
+      default: {
+        isZero = false; // the other operations only depend on their input
+        break;
+      }
+    }
+  }
+  return isSteady && ArrayArithmetic::isSilent(output, 0, blockSizeInt);
+}
+
+
+#pragma mark - Process
+
+void DspFusedChain::processMembers(int fromIndex, int toIndex) {
+  for (int i = 0; i < members.size(); i++) {
+    members[i]->processFunction(members[i], fromIndex, toIndex);
+  }
+}
+
+#if __SSE__
+// apply an operation to the four vectors of a strip, with a signal or a constant operand
+#define STRIP_SIGNAL(_op, _signal) { \
+  float *s = _signal; \
+  x0 = _op(x0, _mm_loadu_ps(s)); x1 = _op(x1, _mm_loadu_ps(s+4)); \
+  x2 = _op(x2, _mm_loadu_ps(s+8)); x3 = _op(x3, _mm_loadu_ps(s+12)); \
+}
+#define STRIP_CONSTANT(_op, _constant) { \
+  const __m128 c = _mm_set1_ps(_constant); \
+  x0 = _op(x0, c); x1 = _op(x1, c); x2 = _op(x2, c); x3 = _op(x3, c); \
+}
+// as [clip~], x < lower ? lower : (x > upper ? upper : x)
+#define CLIP_VECTOR(_x) { \
+  __m128 above = _mm_cmpgt_ps(_x, upper); \
+  __m128 below = _mm_cmplt_ps(_x, lower); \
+  _x = _mm_or_ps(_mm_and_ps(above, upper), _mm_andnot_ps(above, _x)); \
+  _x = _mm_or_ps(_mm_and_ps(below, lower), _mm_andnot_ps(below, _x)); \
+}
+#endif
+
+void DspFusedChain::processChain(DspObject *dspObject, int fromIndex, int toIndex) {
+  DspFusedChain *d = reinterpret_cast<DspFusedChain *>(dspObject);
+  int numOperations = d->operations.size();
+  for (int k = 0; k < numOperations; k++) {
+    if (d->members[k]->processFunction != d->processFunctions[k]) {
+      d->processMembers(fromIndex, toIndex);
+      return;
+    }
+  }
+
+  // as the objects, the whole block is computed
+  float *input = *d->input;
+  float *output = d->output;
+  ElementwiseOperation *operations = &d->operations[0];
+  #if __SSE__
+  float strip[STRIP_LENGTH] __attribute__((aligned(16)));
+  for (int j = 0; j < toIndex; j += STRIP_LENGTH) {
+    __m128 x0 = _mm_loadu_ps(input+j);
+    __m128 x1 = _mm_loadu_ps(input+j+4);
+    __m128 x2 = _mm_loadu_ps(input+j+8);
+    __m128 x3 = _mm_loadu_ps(input+j+12);
+    for (int k = 0; k < numOperations; k++) {
+      ElementwiseOperation *operation = operations + k;
+      switch (operation->opcode) {
+        case ElementwiseOperation::ADD: {
+          if (operation->signal != NULL) STRIP_SIGNAL(_mm_add_ps, *operation->signal + j)
+          else STRIP_CONSTANT(_mm_add_ps, *operation->constant0)
+          break;
+        }
+        case ElementwiseOperation::SUBTRACT: {
+          if (operation->signal != NULL) STRIP_SIGNAL(_mm_sub_ps, *operation->signal + j)
+          else STRIP_CONSTANT(_mm_sub_ps, *operation->constant0)
+          break;
+        }
+        case ElementwiseOperation::MULTIPLY: {
+          if (operation->signal != NULL) STRIP_SIGNAL(_mm_mul_ps, *operation->signal + j)
+          else STRIP_CONSTANT(_mm_mul_ps, *operation->constant0)
+          break;
+        }
+        case ElementwiseOperation::CLIP: {
+          const __m128 lower = _mm_set1_ps(*operation->constant0);
+          const __m128 upper = _mm_set1_ps(*operation->constant1);
+          CLIP_VECTOR(x0); CLIP_VECTOR(x1); CLIP_VECTOR(x2); CLIP_VECTOR(x3);
+          break;
+        }
+        case ElementwiseOperation::SQRT: {
+          STRIP_CONSTANT(_mm_max_ps, 0.0f)
+          x0 = _mm_sqrt_ps(x0); x1 = _mm_sqrt_ps(x1); x2 = _mm_sqrt_ps(x2); x3 = _mm_sqrt_ps(x3);
+          break;
+        }
+        case ElementwiseOperation::WRAP:
+        case ElementwiseOperation::LOG: {
+          // these are computed sample by sample, exactly as by the objects
+          _mm_store_ps(strip, x0); _mm_store_ps(strip+4, x1);
+          _mm_store_ps(strip+8, x2); _mm_store_ps(strip+12, x3);
+          if (operation->opcode == ElementwiseOperation::WRAP) {
+            for (int i = 0; i < STRIP_LENGTH; i++) {
+              strip[i] = strip[i] - floorf(strip[i]);
+            }
+          } else {
+            for (int i = 0; i < STRIP_LENGTH; i++) {
+              strip[i] = (strip[i] <= 0.0f) ? -1000.0f : DspLog::log2Approx(strip[i]);
+            }
+          }
+          x0 = _mm_load_ps(strip); x1 = _mm_load_ps(strip+4);
+          x2 = _mm_load_ps(strip+8); x3 = _mm_load_ps(strip+12);
+          if (operation->opcode == ElementwiseOperation::LOG) {
+            STRIP_CONSTANT(_mm_mul_ps, *operation->constant0)
+          }
+          break;
+        }
+      }
+    }
+    _mm_store_ps(output+j, x0);
+    _mm_store_ps(output+j+4, x1);
+    _mm_store_ps(output+j+8, x2);
+    _mm_store_ps(output+j+12, x3);
+  }
+  #else
+  float x[STRIP_LENGTH];
+  for (int j = 0; j < toIndex; j += STRIP_LENGTH) {
+    memcpy(x, input+j, STRIP_LENGTH*sizeof(float));
+    for (int k = 0; k < numOperations; k++) {
+      ElementwiseOperation *operation = operations + k;
+      float *s = (operation->signal != NULL) ? *operation->signal + j : NULL;
+      float c = (operation->constant0 != NULL) ? *operation->constant0 : 0.0f;
+      for (int i = 0; i < STRIP_LENGTH; i++) {
+        switch (operation->opcode) {
+          case ElementwiseOperation::ADD: x[i] = x[i] + ((s != NULL) ? s[i] : c); break;
+          case ElementwiseOperation::SUBTRACT: x[i] = x[i] - ((s != NULL) ? s[i] : c); break;
+          case ElementwiseOperation::MULTIPLY: x[i] = x[i] * ((s != NULL) ? s[i] : c); break;
+          case ElementwiseOperation::CLIP: {
+            if (x[i] < c) x[i] = c;
+            else if (x[i] > *operation->constant1) x[i] = *operation->constant1;
+            break;
+          }
+          case ElementwiseOperation::WRAP: x[i] = x[i] - floorf(x[i]); break;
+          case ElementwiseOperation::SQRT: x[i] = sqrtf(x[i]); break;
+          case ElementwiseOperation::LOG: x[i] = ((x[i] <= 0.0f) ? -1000.0f : DspLog::log2Approx(x[i])) * c; break;
+        }
+      }
+    }
+    memcpy(output+j, x, STRIP_LENGTH*sizeof(float));
+  }
+  #endif
+}
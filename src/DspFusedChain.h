@@ -0,0 +1,99 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _DSP_FUSED_CHAIN_H_
+#define _DSP_FUSED_CHAIN_H_
+
+#include "DspObject.h"
+
+/** The computation of an elementwise object, as fused into a <code>DspFusedChain</code>. */
+struct ElementwiseOperation {
+  enum Opcode {ADD, SUBTRACT, MULTIPLY, CLIP, WRAP, SQRT, LOG} opcode;
+  float **signal; // the slot of the buffer of the second operand if it is a signal, otherwise NULL
+  float *constant0; // otherwise the second operand, which messages may change between blocks
+  float *constant1; // the upper bound of clip~
+};
+
+/**
+ * A run of elementwise objects in the process order of a graph, each of which is the only consumer
+ * of the one before, computed in a single pass. Strips of samples are carried from one operation
+ * to the next in registers, such that the buffers between the objects are neither written nor
+ * read. The objects stay in the graph and keep their buffers. If any of them has a message to
+ * process, or computes its output differently than when it was fused, then the chain is computed
+ * object by object in that block.
+ *
+ * As with <code>DspImplicitAdd</code>, chains only exist in the process order of a graph, and are
+ * made and deleted with it.
+ */
+class DspFusedChain : public DspObject {
+
+  public:
+    /** Replaces the runs of elementwise objects in the given process order with fused chains. */
+    static void fuse(list<DspObject *> *processOrder, PdGraph *graph);
+
+    /** Replaces the fused chains in the given process order with their objects, and deletes them. */
+    static void unfuse(list<DspObject *> *processOrder);
+
+    /**
+     * Replaces the fused chain at the given position in the process order with its objects, without
+     * deleting it or allocating anything. The chain is moved to the given list, from which it is
+     * later deleted by <code>unfuse()</code>. Returns the position after the objects.
+     */
+    static list<DspObject *>::iterator dissolve(list<DspObject *> *processOrder,
+        list<DspObject *>::iterator position, list<DspObject *> *dissolvedChains);
+
+    DspFusedChain(vector<DspObject *> &members, vector<ElementwiseOperation> &operations, PdGraph *graph);
+    ~DspFusedChain();
+
+    static const char *getObjectLabel();
+    std::string toString();
+    bool isAtRest();
+    bool hasSilentOutput();
+    ObjectType getObjectType();
+
+    /** Returns the objects of the chain, in process order. */
+    const vector<DspObject *> &getMembers() { return members; }
+
+  private:
+    static void processChain(DspObject *dspObject, int fromIndex, int toIndex);
+
+    /** Computes each object by itself, as without fusion. */
+    void processMembers(int fromIndex, int toIndex);
+
+    vector<DspObject *> members; // in process order
+    list<DspObject *> memberNodes; // the same, in the nodes which held them in the process order
+    vector<ElementwiseOperation> operations; // of each member
+    vector<void (*)(DspObject *, int, int)> processFunctions; // of each member, when it was fused
+    float **input; // the slot of the buffer at the left inlet of the first member
+    float *output; // the buffer at the outlet of the last member
+};
+
+inline const char *DspFusedChain::getObjectLabel() {
+  return "fused~";
+}
+
+inline ObjectType DspFusedChain::getObjectType() {
+  return DSP_FUSED_CHAIN;
+}
+
+#endif // _DSP_FUSED_CHAIN_H_
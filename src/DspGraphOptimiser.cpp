@@ -0,0 +1,352 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <set>
+#include "BufferPool.h"
+#include "DspFusedChain.h"
+#include "DspGraphOptimiser.h"
+#include "PdGraph.h"
+
+#pragma mark - Folding
+
+/**
+ * Returns true if the objects which receive the output of the given object only read it through
+ * their inlet buffers. [delwrite~] may have given its delay line to the object as its outlet buffer.
+ */
+static bool canFoldOutput(DspObject *dspObject) {
+  list<ObjectLetPair> outgoingConnections = dspObject->getOutgoingDspConnections(0);
+  for (list<ObjectLetPair>::iterator it = outgoingConnections.begin(); it != outgoingConnections.end(); ++it) {
+    if ((*it).first->getObjectType() == DSP_DELAY_WRITE) return false;
+  }
+  return true;
+}
+
+/**
+ * Returns true if the given buffer at an inlet of the object is always the one which it reads.
+ * [delread~] may instead publish the delay line to its receivers in each block.
+ */
+static bool isStableInletBuffer(DspObject *dspObject, float *buffer) {
+  for (int i = 0; i < dspObject->getNumDspInlets(); i++) {
+    if (dspObject->getDspBufferAtInlet(i) == buffer) {
+      list<ObjectLetPair> incomingConnections = dspObject->getIncomingDspConnections(i);
+      for (list<ObjectLetPair>::iterator it = incomingConnections.begin(); it != incomingConnections.end(); ++it) {
+        if ((*it).first->getObjectType() == DSP_DELAY_READ) return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * Gives the folded buffer to all objects following the given position in the process order which
+ * read the given buffer before it is next written. If the folded buffer is not constant then it
+ * must not be written in the meantime either. Returns false, and changes nothing, if this is not
+ * possible. Otherwise each substitution is recorded, such that it can be undone.
+ */
+static bool substitute(list<DspObject *> *processOrder, list<DspObject *>::iterator position,
+    float *buffer, float *foldedBuffer, vector<DspSubstitution> *substitutions, PdGraph *graph) {
+  DspObject *foldedObject = *position;
+  float value = 0.0f;
+  bool isFoldedBufferWritten = false;
+  bool isBufferWritten = false;
+  bool isConstant = graph->getBufferPool()->isConstantBuffer(foldedBuffer, &value);
+  list<pair<DspObject *, int> > readers;
+  for (list<DspObject *>::iterator it = ++position; it != processOrder->end() && !isBufferWritten; ++it) {
+    DspObject *dspObject = *it;
+    if (dspObject->getObjectType() == OBJECT_PD) {
+      // subgraphs pass their inlet buffers on to their own objects, which may use any free buffer
+      for (int i = 0; i < dspObject->getNumInlets(); i++) {
+        if (dspObject->getDspBufferAtInlet(i) == buffer) return false;
+      }
+      for (int i = 0; i < dspObject->getNumOutlets(); i++) {
+        if (dspObject->getDspBufferAtOutlet(i) == buffer) isBufferWritten = true;
+      }
+      isFoldedBufferWritten = !isConstant;
+    } else {
+      for (int i = 0; i < dspObject->getNumDspInlets(); i++) {
+        if (dspObject->getDspBufferAtInlet(i) == buffer) {
+          if (isFoldedBufferWritten) return false;
+          readers.push_back(make_pair(dspObject, i));
+        }
+      }
+      for (int i = 0; i < dspObject->getNumDspOutlets(); i++) {
+        float *outletBuffer = dspObject->getDspBufferAtOutlet(i);
+        if (outletBuffer == buffer) isBufferWritten = true;
+        if (outletBuffer == foldedBuffer) isFoldedBufferWritten = true;
+      }
+    }
+  }
+  if (!isBufferWritten) {
+    // the buffer may reach the end of the graph, where outlet~s pass it on to the parent graph
+    for (int i = 0; i < graph->getNumOutlets(); i++) {
+      if (graph->getDspBufferAtOutlet(i) == buffer) return false;
+    }
+  }
+  
+  for (list<pair<DspObject *, int> >::iterator it = readers.begin(); it != readers.end(); ++it) {
+    DspSubstitution substitution = {foldedObject, (*it).first, (*it).second, buffer};
+    substitutions->push_back(substitution);
+    (*it).first->setDspBufferAtInlet(foldedBuffer, (*it).second);
+  }
+  return true;
+}
+
+/**
+ * Folds all objects whose output is known, in process order. Objects of other graphs, such as
+ * those ordered before a [throw~] by its [catch~], are left alone, as a message to a folded object
+ * unfolds it in the process order of its own graph.
+ */
+static void fold(list<DspObject *> *processOrder, list<DspObject *> *dormantObjects,
+    vector<DspSubstitution> *substitutions, PdGraph *graph) {
+  BufferPool *bufferPool = graph->getBufferPool();
+  list<DspObject *>::iterator it = processOrder->begin();
+  while (it != processOrder->end()) {
+    DspObject *dspObject = *it;
+    float value = 0.0f;
+    float *foldedBuffer = (dspObject->getNumPendingMessages() == 0 && dspObject->getNumDspOutlets() == 1 &&
+        dspObject->getGraph() == graph) ? dspObject->getFoldedOutputBuffer() : NULL;
+    if (foldedBuffer != NULL && canFoldOutput(dspObject) &&
+        (bufferPool->isConstantBuffer(foldedBuffer, &value) || isStableInletBuffer(dspObject, foldedBuffer)) &&
+        substitute(processOrder, it, dspObject->getDspBufferAtOutlet(0), foldedBuffer, substitutions, graph)) {
+      dspObject->nodeState = DSP_NODE_FOLDED;
+      dormantObjects->push_back(dspObject);
+      it = processOrder->erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+
+#pragma mark - Dead Object Elimination
+
+/**
+ * Returns true if the object has an effect of its own. Objects without any outlets, such as dac~,
+ * send~, throw~, or delwrite~, exist for their effect, as do objects which send messages. Subgraphs
+ * are not looked into.
+ */
+static bool hasEffect(DspObject *dspObject) {
+  return dspObject->getNumOutlets() == 0 || dspObject->getObjectType() == OBJECT_PD ||
+      !dspObject->MessageObject::isLeafNode();
+}
+
+/** Returns true if any receiver of the object, other than through an implicit +~~, is live. */
+static bool hasLiveReceiver(DspObject *dspObject) {
+  for (int i = 0; i < dspObject->getNumDspOutlets(); i++) {
+    list<ObjectLetPair> outgoingConnections = dspObject->getOutgoingDspConnections(i);
+    for (list<ObjectLetPair>::iterator it = outgoingConnections.begin(); it != outgoingConnections.end(); ++it) {
+      // receivers which are not in this process order, such as outlet~, are assumed to be live
+      if (reinterpret_cast<DspObject *>((*it).first)->nodeState == DSP_NODE_ACTIVE) return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Removes all dead objects, in reverse process order. An object is live if it has an effect, if it
+ * could not catch up with the blocks which it misses, or if a live object reads one of its outlet
+ * buffers before it is written again.
+ */
+static void eliminateDeadObjects(list<DspObject *> *processOrder, list<DspObject *> *dormantObjects,
+    PdGraph *graph) {
+  // the buffers whose current contents are read by a live object
+  set<float *> liveBuffers;
+  for (int i = 0; i < graph->getNumOutlets(); i++) {
+    float *buffer = graph->getDspBufferAtOutlet(i);
+    if (buffer != NULL) liveBuffers.insert(buffer);
+  }
+  
+  list<DspObject *>::iterator it = processOrder->end();
+  while (it != processOrder->begin()) {
+    DspObject *dspObject = *--it;
+    bool isGraph = (dspObject->getObjectType() == OBJECT_PD);
+    int numInlets = isGraph ? dspObject->getNumInlets() : dspObject->getNumDspInlets();
+    int numOutlets = isGraph ? dspObject->getNumOutlets() : dspObject->getNumDspOutlets();
+    bool isLive = hasEffect(dspObject) || dspObject->getNumPendingMessages() > 0 ||
+        !dspObject->canSkipDsp() || hasLiveReceiver(dspObject);
+    for (int i = 0; i < numOutlets && !isLive; i++) {
+      isLive = (liveBuffers.count(dspObject->getDspBufferAtOutlet(i)) > 0);
+    }
+    if (isLive) {
+      for (int i = 0; i < numOutlets; i++) {
+        liveBuffers.erase(dspObject->getDspBufferAtOutlet(i));
+      }
+      for (int i = 0; i < numInlets; i++) {
+        float *buffer = dspObject->getDspBufferAtInlet(i);
+        if (buffer != NULL) liveBuffers.insert(buffer);
+      }
+    } else {
+      dspObject->nodeState = DSP_NODE_DEAD;
+      dormantObjects->push_back(dspObject);
+      it = processOrder->erase(it);
+    }
+  }
+}
+
+
+#pragma mark - Unfolding
+
+/** Returns true if the object, or a graph, writes the given buffer at one of its outlets. */
+static bool writesBuffer(DspObject *dspObject, float *buffer) {
+  bool isGraph = (dspObject->getObjectType() == OBJECT_PD);
+  int numOutlets = isGraph ? dspObject->getNumOutlets() : dspObject->getNumDspOutlets();
+  for (int i = 0; i < numOutlets; i++) {
+    if (dspObject->getDspBufferAtOutlet(i) == buffer) return true;
+  }
+  return false;
+}
+
+/**
+ * Returns the object which last writes the given buffer before the given position in the
+ * unoptimised process order, whether it is processed or dormant, or NULL if there is none.
+ */
+static DspObject *getLastWriter(float *buffer, unsigned int processIndex,
+    list<DspObject *> *processOrder, list<DspObject *> *dormantObjects) {
+  DspObject *writer = NULL;
+  list<DspObject *> *lists[2] = {processOrder, dormantObjects};
+  for (int i = 0; i < 2; i++) {
+    for (list<DspObject *>::iterator it = lists[i]->begin(); it != lists[i]->end(); ++it) {
+      if ((*it)->getObjectType() == DSP_FUSED_CHAIN) {
+        // dissolved chains are kept among the dormant objects until they are deleted
+        if (lists[i] == dormantObjects) continue;
+        const vector<DspObject *> &members = reinterpret_cast<DspFusedChain *>(*it)->getMembers();
+        for (int j = 0; j < members.size(); j++) {
+          DspObject *member = members[j];
+          if (member->processIndex < processIndex && writesBuffer(member, buffer) &&
+              (writer == NULL || member->processIndex > writer->processIndex)) {
+            writer = member;
+          }
+        }
+      } else {
+        DspObject *dspObject = *it;
+        if (dspObject->processIndex < processIndex && writesBuffer(dspObject, buffer) &&
+            (writer == NULL || dspObject->processIndex > writer->processIndex)) {
+          writer = dspObject;
+        }
+      }
+    }
+  }
+  return writer;
+}
+
+/**
+ * Returns the object to its active state, and the readers of its folded output to its own output.
+ * Readers which have been folded are woken in turn, as are dead objects whose output it reads.
+ */
+static void wake(DspObject *dspObject, list<DspObject *> *processOrder, list<DspObject *> *dormantObjects,
+    vector<DspSubstitution> *substitutions) {
+  dspObject->nodeState = DSP_NODE_ACTIVE;
+  
+  for (int i = 0; i < substitutions->size(); i++) {
+    DspSubstitution &substitution = (*substitutions)[i];
+    if (substitution.foldedObject == dspObject) {
+      substitution.reader->setDspBufferAtInlet(substitution.buffer, substitution.inletIndex);
+      if (substitution.reader->nodeState == DSP_NODE_FOLDED) {
+        wake(substitution.reader, processOrder, dormantObjects, substitutions);
+      }
+    }
+  }
+  
+  for (int i = 0; i < dspObject->getNumDspInlets(); i++) {
+    float *buffer = dspObject->getDspBufferAtInlet(i);
+    if (buffer == NULL) continue;
+    DspObject *writer = getLastWriter(buffer, dspObject->processIndex, processOrder, dormantObjects);
+    if (writer != NULL && writer->nodeState == DSP_NODE_DEAD) {
+      wake(writer, processOrder, dormantObjects, substitutions);
+    }
+  }
+}
+
+/** Returns true if an object which has been woken among the dormant ones belongs inside the chain. */
+static bool enclosesWokenObject(DspFusedChain *chain, list<DspObject *> *dormantObjects) {
+  const vector<DspObject *> &members = chain->getMembers();
+  unsigned int firstIndex = members.front()->processIndex;
+  unsigned int lastIndex = members.back()->processIndex;
+  for (list<DspObject *>::iterator it = dormantObjects->begin(); it != dormantObjects->end(); ++it) {
+    DspObject *dspObject = *it;
+    if (dspObject->nodeState == DSP_NODE_ACTIVE && dspObject->getObjectType() != DSP_FUSED_CHAIN &&
+        dspObject->processIndex > firstIndex && dspObject->processIndex < lastIndex) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+#pragma mark - Optimise/Restore/Unfold
+
+void DspGraphOptimiser::optimise(list<DspObject *> *processOrder, list<DspObject *> *dormantObjects,
+    vector<DspSubstitution> *substitutions, PdGraph *graph) {
+  unsigned int processIndex = 0;
+  for (list<DspObject *>::iterator it = processOrder->begin(); it != processOrder->end(); ++it) {
+    (*it)->processIndex = processIndex++;
+  }
+  
+  // folding comes first, as the objects which only fed folded ones are then dead
+  fold(processOrder, dormantObjects, substitutions, graph);
+  eliminateDeadObjects(processOrder, dormantObjects, graph);
+}
+
+void DspGraphOptimiser::restore(list<DspObject *> *processOrder, list<DspObject *> *dormantObjects,
+    vector<DspSubstitution> *substitutions) {
+  for (list<DspObject *>::iterator it = dormantObjects->begin(); it != dormantObjects->end(); ++it) {
+    (*it)->nodeState = DSP_NODE_ACTIVE;
+  }
+  processOrder->splice(processOrder->end(), *dormantObjects);
+  substitutions->clear();
+}
+
+void DspGraphOptimiser::unfold(list<DspObject *> *processOrder, list<DspObject *> *dormantObjects,
+    vector<DspSubstitution> *substitutions) {
+  for (list<DspObject *>::iterator it = dormantObjects->begin(); it != dormantObjects->end(); ++it) {
+    DspObject *dspObject = *it;
+    if (dspObject->nodeState == DSP_NODE_FOLDED && dspObject->getNumPendingMessages() > 0) {
+      wake(dspObject, processOrder, dormantObjects, substitutions);
+    }
+  }
+  
+  // the woken objects are processed in their original place, which may be inside a fused chain
+  list<DspObject *>::iterator it = processOrder->begin();
+  while (it != processOrder->end()) {
+    if ((*it)->getObjectType() == DSP_FUSED_CHAIN &&
+        enclosesWokenObject(reinterpret_cast<DspFusedChain *>(*it), dormantObjects)) {
+      it = DspFusedChain::dissolve(processOrder, it, dormantObjects);
+    } else {
+      ++it;
+    }
+  }
+  
+  it = dormantObjects->begin();
+  while (it != dormantObjects->end()) {
+    list<DspObject *>::iterator next = it;
+    ++next;
+    DspObject *dspObject = *it;
+    if (dspObject->nodeState == DSP_NODE_ACTIVE && dspObject->getObjectType() != DSP_FUSED_CHAIN) {
+      list<DspObject *>::iterator position = processOrder->begin();
+      while (position != processOrder->end() && (*position)->processIndex < dspObject->processIndex) {
+        ++position;
+      }
+      processOrder->splice(position, *dormantObjects, it);
+    }
+    it = next;
+  }
+}
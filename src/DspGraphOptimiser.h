@@ -0,0 +1,81 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _DSP_GRAPH_OPTIMISER_H_
+#define _DSP_GRAPH_OPTIMISER_H_
+
+#include <list>
+#include <vector>
+#include "DspObject.h"
+
+/** The buffer which an inlet of a reader of a folded object read before the object was folded. */
+struct DspSubstitution {
+  DspObject *foldedObject;
+  DspObject *reader;
+  int inletIndex;
+  float *buffer;
+};
+
+/**
+ * Takes objects out of the process order of a graph which need not be processed. An object is
+ * folded if its output is known in advance, e.g. [*~ 0] or [+~] of two constants, and the objects
+ * which read its output are given the known buffer instead. Known buffers are propagated down the
+ * process order, such that folding an object may allow its receivers to be folded as well. An
+ * object is dead if it has no effect of its own, no live object reads its output, and it can go
+ * unprocessed without changing its later output, e.g. an oscillator connected to nothing. See
+ * <code>DspObject::canSkipDsp()</code>. Filters and other objects whose state follows their input
+ * are always processed, such that the output is the same whether or not the graph is optimised.
+ *
+ * Objects taken out of the process order are kept in a separate list of dormant objects, and are
+ * returned to the process order whenever it is recomputed. An object is only folded for as long as
+ * its configuration stays the same. A folded object which receives a message is unfolded in place
+ * before the next block, along with the objects which depend on it, without recomputing the order.
+ * Messages to dead objects take effect immediately.
+ */
+class DspGraphOptimiser {
+  
+  public:
+    /**
+     * Moves all objects from the process order which need not be processed to the list of dormant
+     * objects. The list of dormant objects must be empty.
+     */
+    static void optimise(list<DspObject *> *processOrder, list<DspObject *> *dormantObjects,
+        vector<DspSubstitution> *substitutions, PdGraph *graph);
+  
+    /**
+     * Returns all dormant objects to the given process order, and to their active state. The
+     * buffers of their readers are left as they are, as the order is then recomputed.
+     */
+    static void restore(list<DspObject *> *processOrder, list<DspObject *> *dormantObjects,
+        vector<DspSubstitution> *substitutions);
+  
+    /**
+     * Returns each folded object which has received a message to its place in the process order,
+     * and its readers to its output. Folded readers are unfolded in turn, and dead objects whose
+     * output an unfolded object reads are revived. Fused chains which would enclose a returned
+     * object are dissolved. Nothing is allocated, such that this may be done between blocks.
+     */
+    static void unfold(list<DspObject *> *processOrder, list<DspObject *> *dormantObjects,
+        vector<DspSubstitution> *substitutions);
+};
+
+#endif // _DSP_GRAPH_OPTIMISER_H_
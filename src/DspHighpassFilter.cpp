@@ -27,7 +27,7 @@ MessageObject *DspHighpassFilter::newObject(PdMessage *initMessage, PdGraph *gra
   return new DspHighpassFilter(initMessage, graph);
 }
 
-DspHighpassFilter::DspHighpassFilter(PdMessage *initMessage, PdGraph *graph) : DspFilter(2, graph) {
+DspHighpassFilter::DspHighpassFilter(PdMessage *initMessage, PdGraph *graph) : DspFilter(2, 2, graph) {
   // by default, the filter is initialised completely open
   calcFiltCoeff(initMessage->isFloat(0) ? initMessage->getFloat(0) : 0.0f);
 }
@@ -36,17 +36,35 @@ DspHighpassFilter::~DspHighpassFilter() {
   // nothing to do
 }
 
+void DspHighpassFilter::onInletConnectionUpdate(unsigned int inletIndex) {
+  // messages to the cutoff inlet are ignored while it is connected to a signal
+  processFunction = incomingDspConnections[1].empty() ? &processFilter : &processSignal;
+  processFunctionNoMessage = processFunction;
+}
+
 // http://en.wikipedia.org/wiki/High-pass_filter
-void DspHighpassFilter::calcFiltCoeff(float fc) {
+inline float DspHighpassFilter::getAlpha(float fc) {
   if (fc > 0.5f*graph->getSampleRate()) fc = 0.5f * graph->getSampleRate();
-  else if (fc < 0.0f) fc = 10.0f;
+  else if (!(fc >= 0.0f)) fc = 10.0f; // also catches NaN
   
-  float alpha = graph->getSampleRate() / ((2.0f*M_PI*fc) + graph->getSampleRate());
-  b[0] = alpha;
-  b[1] = -alpha;
-  b[2] = 0.0f;
-  b[3] = -alpha;
-  b[4] = 0.0f;
+  return graph->getSampleRate() / ((2.0f*M_PI*fc) + graph->getSampleRate());
+}
+
+void DspHighpassFilter::calcFiltCoeff(float fc) {
+  float alpha = getAlpha(fc);
+  biquad.setCoefficients(alpha, -alpha, 0.0f, -alpha, 0.0f);
+}
+
+void DspHighpassFilter::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
+  DspHighpassFilter *d = reinterpret_cast<DspHighpassFilter *>(dspObject);
+  float *input = d->dspBufferAtInlet[0];
+  float *cutoff = d->dspBufferAtInlet[1];
+  float *output = d->dspBufferAtOutlet[0];
+  for (int i = fromIndex; i < toIndex; i++) {
+    float alpha = d->getAlpha(cutoff[i]);
+    output[i] = d->biquad.processSample(input[i], alpha, -alpha, 0.0f, -alpha, 0.0f);
+  }
+  d->biquad.flushState();
 }
 
 void DspHighpassFilter::processMessage(int inletIndex, PdMessage *message) {
@@ -59,8 +77,7 @@ void DspHighpassFilter::processMessage(int inletIndex, PdMessage *message) {
         }
         case SYMBOL: {
           if (message->isSymbol(0, "clear")) {
-            x1 = x2 = 0.0f;
-            dspBufferAtOutlet[0][0] = dspBufferAtOutlet[0][1] = 0.0f;
+            biquad.clear();
           }
           break;
         }
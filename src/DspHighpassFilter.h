@@ -28,6 +28,7 @@
 /**
  * [hip~], [hip~ float]
  * A one-tap IIR filter: y[i] = a * (y[i-1] + x[i] - x[i-1])
+ * The cutoff frequency may be given as a signal, in which case a is computed for every sample.
  */
 class DspHighpassFilter : public DspFilter {
   
@@ -39,9 +40,13 @@ class DspHighpassFilter : public DspFilter {
     static const char *getObjectLabel();
     std::string toString();
   
+    void onInletConnectionUpdate(unsigned int inletIndex);
+  
   private:
+    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
     void processMessage(int inletIndex, PdMessage *message);
     void calcFiltCoeff(float cutoffFrequency);
+    float getAlpha(float cutoffFrequency);
 };
 
 inline std::string DspHighpassFilter::toString() {
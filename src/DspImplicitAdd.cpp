@@ -21,7 +21,9 @@
  */
 
 #include "ArrayArithmetic.h"
+#include "BufferPool.h"
 #include "DspImplicitAdd.h"
+#include "PdGraph.h"
 
 MessageObject *DspImplicitAdd::newObject(PdMessage *initMessage, PdGraph *graph) {
   return new DspImplicitAdd(initMessage, graph);
@@ -35,6 +37,22 @@ DspImplicitAdd::~DspImplicitAdd() {
   // nothing to do
 }
 
+float *DspImplicitAdd::getFoldedOutputBuffer() {
+  BufferPool *bufferPool = graph->getBufferPool();
+  float value0 = 0.0f;
+  float value1 = 0.0f;
+  bool isConstant0 = bufferPool->isConstantBuffer(dspBufferAtInlet[0], &value0);
+  bool isConstant1 = bufferPool->isConstantBuffer(dspBufferAtInlet[1], &value1);
+  if (isConstant0 && isConstant1) return bufferPool->getConstantBuffer(value0 + value1);
+  else if (isConstant1 && value1 == 0.0f) return dspBufferAtInlet[0];
+  else if (isConstant0 && value0 == 0.0f) return dspBufferAtInlet[1];
+  else return NULL;
+}
+
+bool DspImplicitAdd::isAtRest() {
+  return true; // the output only depends on the inputs
+}
+
 void DspImplicitAdd::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
   DspImplicitAdd *d = reinterpret_cast<DspImplicitAdd *>(dspObject);
   ArrayArithmetic::add(d->dspBufferAtInlet[0], d->dspBufferAtInlet[1], d->dspBufferAtOutlet[0], 0, toIndex);
@@ -38,6 +38,9 @@ public:
   
   static const char *getObjectLabel();
   std::string toString();
+  float *getFoldedOutputBuffer();
+  bool isAtRest();
+  bool canSkipDsp() { return true; }
   
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
@@ -39,6 +39,10 @@ DspLine::~DspLine() {
   // nothing to do
 }
 
+bool DspLine::isAtRest() {
+  return numSamplesToTarget <= 0.0f;
+}
+
 void DspLine::processMessage(int inletIndex, PdMessage *message) {
   if (inletIndex == 0) { // not sure what the right inlet is for
     switch (message->getNumElements()) {
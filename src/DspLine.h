@@ -35,6 +35,7 @@ class DspLine : public DspObject {
   
     static const char *getObjectLabel();
     std::string toString();
+    bool isAtRest();
   
   private:
     void processMessage(int inletIndex, PdMessage *message);
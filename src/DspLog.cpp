@@ -20,6 +20,7 @@
  *
  */
 
+#include "DspFusedChain.h"
 #include "DspLog.h"
 #include "PdGraph.h"
 
@@ -43,6 +44,20 @@ void DspLog::onInletConnectionUpdate(unsigned int inletIndex) {
       ? &processSignal : &processScalar;
 }
 
+bool DspLog::getElementwiseOperation(ElementwiseOperation *operation) {
+  #if __APPLE__
+  return false; // the fused chain computes the approximation, not vvlog2f
+  #else
+  // a signal base is not supported
+  if (processFunction != &processScalar) return false;
+  operation->opcode = ElementwiseOperation::LOG;
+  operation->signal = NULL;
+  operation->constant0 = &invLog2Base;
+  operation->constant1 = NULL;
+  return true;
+  #endif
+}
+
 void DspLog::processMessage(int inletIndex, PdMessage *message) {
   if (inletIndex == 1) {
     if (message->isFloat(0)) {
@@ -35,20 +35,21 @@ class DspLog : public DspObject {
   
     static const char *getObjectLabel();
     std::string toString();
+    bool getElementwiseOperation(ElementwiseOperation *operation);
   
     void onInletConnectionUpdate(unsigned int inletIndex);
   
-  private:
-    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
-    static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
-    void processMessage(int inletIndex, PdMessage *message);
-  
     // this implementation is reproduced from http://www.musicdsp.org/showone.php?id=91
-    inline float log2Approx(float x) {
+    static inline float log2Approx(float x) {
       int y = (*(int *)&x); // input is assumed to be positive
       return (((y & 0x7f800000)>>23)-0x7f)+(y & 0x007fffff)/(float)0x800000;
     }
   
+  private:
+    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
+    static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
+    void processMessage(int inletIndex, PdMessage *message);
+  
     float invLog2Base; // 1/log2(base)
 };
 
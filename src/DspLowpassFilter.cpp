@@ -27,7 +27,7 @@ MessageObject *DspLowpassFilter::newObject(PdMessage *initMessage, PdGraph *grap
   return new DspLowpassFilter(initMessage, graph);
 }
 
-DspLowpassFilter::DspLowpassFilter(PdMessage *initMessage, PdGraph *graph) : DspFilter(2, graph) {
+DspLowpassFilter::DspLowpassFilter(PdMessage *initMessage, PdGraph *graph) : DspFilter(2, 2, graph) {
   calcFiltCoeff(initMessage->isFloat(0) ? initMessage->getFloat(0) : graph->getSampleRate()/2.0f);
 }
 
@@ -35,18 +35,36 @@ DspLowpassFilter::~DspLowpassFilter() {
   // nothing to do
 }
 
+void DspLowpassFilter::onInletConnectionUpdate(unsigned int inletIndex) {
+  // messages to the cutoff inlet are ignored while it is connected to a signal
+  processFunction = incomingDspConnections[1].empty() ? &processFilter : &processSignal;
+  processFunctionNoMessage = processFunction;
+}
+
 // http://en.wikipedia.org/wiki/Low_pass_filter
-void DspLowpassFilter::calcFiltCoeff(float fc) {
+inline float DspLowpassFilter::getAlpha(float fc) {
   if (fc > 0.5f * graph->getSampleRate()) fc = 0.5f * graph->getSampleRate();
-  else if (fc < 0.0f) fc = 0.0f;
+  else if (!(fc >= 0.0f)) fc = 0.0f; // also catches NaN
   
   float wc = 2.0f*M_PI*fc;
-  float alpha = wc / (wc + graph->getSampleRate());
-  b[0] = alpha;
-  b[1] = 0.0f;
-  b[2] = 0.0f;
-  b[3] = -(1.0f-alpha);
-  b[4] = 0.0f;
+  return wc / (wc + graph->getSampleRate());
+}
+
+void DspLowpassFilter::calcFiltCoeff(float fc) {
+  float alpha = getAlpha(fc);
+  biquad.setCoefficients(alpha, 0.0f, 0.0f, -(1.0f-alpha), 0.0f);
+}
+
+void DspLowpassFilter::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
+  DspLowpassFilter *d = reinterpret_cast<DspLowpassFilter *>(dspObject);
+  float *input = d->dspBufferAtInlet[0];
+  float *cutoff = d->dspBufferAtInlet[1];
+  float *output = d->dspBufferAtOutlet[0];
+  for (int i = fromIndex; i < toIndex; i++) {
+    float alpha = d->getAlpha(cutoff[i]);
+    output[i] = d->biquad.processSample(input[i], alpha, 0.0f, 0.0f, -(1.0f-alpha), 0.0f);
+  }
+  d->biquad.flushState();
 }
 
 void DspLowpassFilter::processMessage(int inletIndex, PdMessage *message) {
@@ -59,7 +77,7 @@ void DspLowpassFilter::processMessage(int inletIndex, PdMessage *message) {
         }
         case SYMBOL: {
           if (message->isSymbol(0, "clear")) {
-            x1 = x2 = dspBufferAtOutlet[0][0] = dspBufferAtOutlet[0][1] = 0.0f;
+            biquad.clear();
           }
           break;
         }
@@ -26,8 +26,9 @@
 #include "DspFilter.h"
 
 /**
- * [lop~]
+ * [lop~], [lop~ float]
  * Specficially implement a one-tap IIR filter: y = alpha * x_0 + (1-alpha) * y_-1
+ * The cutoff frequency may be given as a signal, in which case alpha is computed for every sample.
  */
 class DspLowpassFilter : public DspFilter {
   
@@ -40,9 +41,12 @@ class DspLowpassFilter : public DspFilter {
     std::string toString();
   
     void processMessage(int inletIndex, PdMessage *message);
+    void onInletConnectionUpdate(unsigned int inletIndex);
   
   private:
+    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
     void calcFiltCoeff(float cutoffFrequency);
+    float getAlpha(float cutoffFrequency);
 };
 
 inline const char *DspLowpassFilter::getObjectLabel() {
@@ -45,6 +45,10 @@ string DspMinimum::toString() {
   return  string(str);
 }
 
+bool DspMinimum::isAtRest() {
+  return true; // the output only depends on the inputs
+}
+
 void DspMinimum::processMessage(int inletIndex, PdMessage *message) {
   if (inletIndex == 1) {
     if (message->isFloat(0)) constant = message->getFloat(0);
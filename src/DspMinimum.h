@@ -35,6 +35,8 @@ class DspMinimum : public DspObject {
     
     static const char *getObjectLabel();
     std::string toString();
+    bool isAtRest();
+    bool canSkipDsp() { return true; }
   
     void onInletConnectionUpdate(unsigned int inletIndex);
     
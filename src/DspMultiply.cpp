@@ -21,9 +21,10 @@
  */
 
 #include "ArrayArithmetic.h"
+#include "BufferPool.h"
+#include "DspFusedChain.h"
 #include "DspMultiply.h"
-
-class PdGraph;
+#include "PdGraph.h"
 
 MessageObject *DspMultiply::newObject(PdMessage *initMessage, PdGraph *graph) {
   return new DspMultiply(initMessage, graph);
@@ -32,6 +33,7 @@ MessageObject *DspMultiply::newObject(PdMessage *initMessage, PdGraph *graph) {
 DspMultiply::DspMultiply(PdMessage *initMessage, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {
   constant = initMessage->isFloat(0) ? initMessage->getFloat(0) : 0.0f;
   inputConstant = 0.0f;
+  processFunction = &processScalar;
   processFunctionNoMessage = &processScalar;
 }
 
@@ -56,6 +58,48 @@ void DspMultiply::onInletConnectionUpdate(unsigned int inletIndex) {
   }
 }
 
+bool DspMultiply::getElementwiseOperation(ElementwiseOperation *operation) {
+  if (processFunction == &processSignal) {
+    operation->signal = getDspBufferSlotAtInlet(1);
+  } else if (processFunction == &processScalar) {
+    operation->signal = NULL;
+  } else {
+    return false;
+  }
+  operation->opcode = ElementwiseOperation::MULTIPLY;
+  operation->constant0 = &constant;
+  operation->constant1 = NULL;
+  return true;
+}
+
+float *DspMultiply::getFoldedOutputBuffer() {
+  // signals are taken to be finite, such that anything multiplied by zero is zero
+  BufferPool *bufferPool = graph->getBufferPool();
+  float value0 = 0.0f;
+  float value1 = 0.0f;
+  bool isConstant0 = bufferPool->isConstantBuffer(dspBufferAtInlet[0], &value0);
+  if (processFunction == &processScalar) {
+    if (isConstant0) return bufferPool->getConstantBuffer(value0 * constant);
+    else if (constant == 0.0f) return bufferPool->getZeroBuffer();
+    else if (constant == 1.0f) return dspBufferAtInlet[0];
+  } else if (processFunction == &processSignal) {
+    bool isConstant1 = bufferPool->isConstantBuffer(dspBufferAtInlet[1], &value1);
+    if (isConstant0 && isConstant1) return bufferPool->getConstantBuffer(value0 * value1);
+    else if (isConstant0 && value0 == 0.0f) return bufferPool->getZeroBuffer();
+    else if (isConstant1 && value1 == 0.0f) return bufferPool->getZeroBuffer();
+    else if (isConstant1 && value1 == 1.0f) return dspBufferAtInlet[0];
+    else if (isConstant0 && value0 == 1.0f) return dspBufferAtInlet[1];
+  }
+  return NULL;
+}
+
+bool DspMultiply::hasSilentOutput() {
+  // anything multiplied by silence is silent
+  bool isFactorSilent = isDspInletKnownSilent(0) ||
+      ((processFunction == &processSignal) ? isDspInletKnownSilent(1) : (constant == 0.0f));
+  return isAtRest() && isFactorSilent && isDspOutputSilent();
+}
+
 void DspMultiply::processMessage(int inletIndex, PdMessage *message) {
   switch (inletIndex) {
     case 0: if (message->isFloat(0)) inputConstant = message->getFloat(0); break;
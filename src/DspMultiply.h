@@ -34,7 +34,9 @@ class DspMultiply : public DspObject {
   
     static const char *getObjectLabel();
     std::string toString();
-  
+    bool getElementwiseOperation(ElementwiseOperation *operation);
+    float *getFoldedOutputBuffer();
+    bool hasSilentOutput();
 
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
@@ -21,25 +21,30 @@
  */
 
 #include "DspNoise.h"
-#include "MersenneTwister.h"
+#include "PdContext.h"
+#include "PdGraph.h"
 
 MessageObject *DspNoise::newObject(PdMessage *initMessage, PdGraph *graph) {
   return new DspNoise(graph);
 }
 
-DspNoise::DspNoise(PdGraph *graph) : DspObject(1, 0, 0, 1, graph) {
-  twister = new MTRand(); // use new seed
+DspNoise::DspNoise(PdGraph *graph) : DspObject(1, 0, 0, 1, graph),
+    generator(graph->getContext()->nextRandomSeed()) {
   processFunction = &processSignal;
+  processFunctionNoMessage = &processSignal;
 }
 
 DspNoise::~DspNoise() {
-  delete twister;
+  // nothing to do
+}
+
+void DspNoise::processMessage(int inletIndex, PdMessage *message) {
+  if (message->isSymbol(0, "seed") && message->isFloat(1)) {
+    generator.seed((uint32_t) (int32_t) message->getFloat(1));
+  }
 }
 
 void DspNoise::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
   DspNoise *d = reinterpret_cast<DspNoise *>(dspObject);
-  
-  for (int i = 0; i < toIndex; i++) {
-    d->dspBufferAtOutlet[0][i] = ((float) d->twister->rand(2.0)) - 1.0f;
-  }
+  d->generator.fillUniform(d->dspBufferAtOutlet[0] + fromIndex, toIndex - fromIndex);
 }
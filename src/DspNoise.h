@@ -24,11 +24,15 @@
 #define _DSP_NOISE_H_
 
 #include "DspObject.h"
+#include "RandomGenerator.h"
 
-class MTRand;
 class PdGraph;
 
-/** [noise~] */
+/**
+ * [noise~]
+ * Uniformly distributed white noise in [-1, 1). The generator is seeded from the context, unless
+ * it is given a seed with the message "seed float".
+ */
 class DspNoise : public DspObject {
     
   public:
@@ -39,10 +43,18 @@ class DspNoise : public DspObject {
     static const char *getObjectLabel();
     std::string toString();
   
+    /**
+     * Skipping ahead in the sequence would cost as much as computing it, and so it never pauses.
+     * The object is never at rest, and is processed even if nothing reads its output.
+     */
+    bool isAtRest() { return false; }
+    bool hasSilentOutput() { return false; }
+  
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
+    void processMessage(int inletIndex, PdMessage *message);
   
-    MTRand *twister;
+    RandomGenerator generator;
 };
 
 inline std::string DspNoise::toString() {
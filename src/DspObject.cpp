@@ -22,6 +22,7 @@
 
 #include "ArrayArithmetic.h"
 #include "BufferPool.h"
+#include "DspFusedChain.h"
 #include "DspImplicitAdd.h"
 #include "DspObject.h"
 #include "PdGraph.h"
@@ -43,6 +44,9 @@ void DspObject::init(int numDspInlets, int numDspOutlets, int blockSize) {
   blockSizeInt = blockSize;
   processFunction = &processFunctionDefaultNoMessage;
   processFunctionNoMessage = &processFunctionDefaultNoMessage;
+  memset(&profile, 0, sizeof(DspProfile));
+  nodeState = DSP_NODE_ACTIVE;
+  processIndex = 0;
   
   // initialise the incoming dsp connections list
   incomingDspConnections = vector<list<ObjectLetPair> >(numDspInlets);
@@ -186,6 +190,12 @@ void DspObject::receiveMessage(int inletIndex, PdMessage *message) {
   // Queue the message to be processed during the DSP round only if the graph is switched on.
   // Otherwise messages would begin to pile up because the graph is not processed.
   if (graph->isSwitchedOn()) {
+    if (nodeState == DSP_NODE_DEAD) {
+      // nothing observes this object, such that the message may as well take effect immediately
+      processMessage(inletIndex, message);
+      return;
+    }
+    
     // Copy the message to the heap so that it is available to process later.
     // The message is released once it is consumed in processDsp().
     messageQueue.push(make_pair(message->copyToHeap(), inletIndex));
@@ -193,7 +203,49 @@ void DspObject::receiveMessage(int inletIndex, PdMessage *message) {
     // only process the message if the process function is set to the default no-message function.
     // If it is set to anything else, then it is assumed that messages should not be processed.
     if (processFunction == processFunctionNoMessage) processFunction = &processFunctionMessage;
+    
+    // the message may change the output of a folded object, which must then be processed again
+    if (nodeState == DSP_NODE_FOLDED) graph->scheduleDspUnfolding();
+    
+    // a sleeping graph must process the message in this block
+    graph->wake();
+  }
+}
+
+bool DspObject::isDspOutputSilent() {
+  for (int i = 0; i < getNumDspOutlets(); i++) {
+    float *buffer = getDspBufferAtOutlet(i);
+    if (buffer != NULL && !ArrayArithmetic::isSilent(buffer, 0, blockSizeInt)) return false;
+  }
+  return true;
+}
+
+bool DspObject::isDspInletKnownSilent(unsigned int inletIndex) {
+  return graph->isDspBufferKnownSilent(getDspBufferAtInlet(inletIndex));
+}
+
+bool DspObject::areDspInletsKnownSilent() {
+  for (int i = 0; i < getNumDspInlets(); i++) {
+    if (!graph->isDspBufferKnownSilent(getDspBufferAtInlet(i))) return false;
   }
+  return true;
+}
+
+bool DspObject::isAtRest() {
+  // elementwise objects have no state
+  ElementwiseOperation operation;
+  return getElementwiseOperation(&operation);
+}
+
+bool DspObject::hasSilentOutput() {
+  // an object at rest with silent inputs computes the same output in every block
+  return isAtRest() && areDspInletsKnownSilent() && isDspOutputSilent();
+}
+
+bool DspObject::canSkipDsp() {
+  // elementwise objects have no state
+  ElementwiseOperation operation;
+  return getElementwiseOperation(&operation);
 }
 
 
@@ -26,6 +26,7 @@
 #include <queue>
 #include "ArrayArithmetic.h"
 #include "MessageObject.h"
+#include "ProfileTimer.h"
 
 #if __SSE__
 // allocate memory aligned to 16-bytes memory boundary
@@ -39,6 +40,22 @@
 
 typedef std::pair<PdMessage *, unsigned int> MessageLetPair;
 
+struct ElementwiseOperation;
+class DspObject;
+
+/**
+ * Processes the given objects over the whole block, as if each were processed in turn by its own
+ * <code>processFunction</code>. See <code>DspObject::getGroupProcessFunction()</code>.
+ */
+typedef void (*DspGroupProcessFunction)(DspObject **dspObjects, int numObjects, int blockSize);
+
+/** The states in which the process order optimisation of a graph may leave an object. */
+typedef enum DspNodeState {
+  DSP_NODE_ACTIVE, // the object is processed in every block
+  DSP_NODE_FOLDED, // the output of the object is known without processing it
+  DSP_NODE_DEAD    // nothing observes the output of the object
+} DspNodeState;
+
 /**
  * A <code>DspObject</code> is the abstract superclass of any object which processes audio.
  * <code>DspObject</code> is a subclass of <code>MessageObject</code>, such that all of the former
@@ -78,6 +95,20 @@ class DspObject : public MessageObject {
     virtual float *getDspBufferAtInlet(int inletIndex);
     virtual float *getDspBufferAtOutlet(int outletIndex);
   
+    /**
+     * Returns the location at which the buffer at the given inlet is stored. An object which moves
+     * its outlet buffer in every block may update its receivers through it, bypassing
+     * <code>setDspBufferAtInlet()</code>. It is only meaningful for objects which do not override it.
+     */
+    float **getDspBufferSlotAtInlet(unsigned int inletIndex) {
+      return (inletIndex < 2) ? &dspBufferAtInlet[inletIndex] : &((float **) dspBufferAtInlet[2])[inletIndex-2];
+    }
+  
+    /** As <code>getDspBufferSlotAtInlet()</code>, for the buffer at the given outlet. */
+    float **getDspBufferSlotAtOutlet(unsigned int outletIndex) {
+      return (outletIndex < 2) ? &dspBufferAtOutlet[outletIndex] : &((float **) dspBufferAtOutlet[2])[outletIndex-2];
+    }
+  
   
     /** Return true if a buffer from the Buffer Pool should set set at the given outlet. False otherwise. */
     virtual bool canSetBufferAtOutlet(unsigned int outletIndex) { return true; }
@@ -89,6 +120,58 @@ class DspObject : public MessageObject {
   
     virtual bool doesProcessAudio() { return true; }
   
+    /**
+     * An elementwise object computes each sample of its only outlet from the same sample of its
+     * inlets. It describes how, as currently connected, such that it may be fused with its
+     * neighbours into a <code>DspFusedChain</code>. Other objects return false.
+     */
+    virtual bool getElementwiseOperation(ElementwiseOperation *operation) { return false; }
+  
+    /**
+     * Returns a buffer which, as the object is currently connected and configured, always holds
+     * what the object would write to its only outlet. This is either a constant buffer from the
+     * <code>BufferPool</code> or one of the buffers at its inlets, such that the object need not be
+     * processed. Returns NULL otherwise. The inlet buffers must already have been resolved.
+     */
+    virtual float *getFoldedOutputBuffer() { return NULL; }
+  
+    /**
+     * The same object in each instance of a <code>PdCloneGraph</code> may be processed together
+     * with its counterparts, e.g. a bank of filters with one filter in each vector lane. Returns the
+     * function which does so, if it may process this object in the current block, or NULL. Objects
+     * are only grouped with those which return the same function. By default, objects are
+     * processed on their own.
+     */
+    virtual DspGroupProcessFunction getGroupProcessFunction() { return NULL; }
+
+    /**
+     * Returns true if not processing the object, for as long as it receives no messages and the
+     * inputs which are known to be silent stay so, would not change what it later outputs. Objects
+     * without state are at rest, as are those whose state has decayed, and oscillators which catch
+     * up with the samples which they have missed. A subgraph in which all objects are at rest, and
+     * whose outlets are known to be silent, goes to sleep. See
+     * <code>PdGraph::isDspBufferKnownSilent()</code>.
+     *
+     * Both functions are asked right after the object has been processed, while its buffers are
+     * still intact. By default, only elementwise objects are at rest.
+     */
+    virtual bool isAtRest();
+
+    /**
+     * Returns true if the buffers at all dsp outlets are silent, and stay so for as long as the
+     * object is at rest. By default, this is the case if the object is at rest, all of its inputs
+     * are known to be silent, and its output is silent now.
+     */
+    virtual bool hasSilentOutput();
+  
+    /**
+     * Returns true if the object may go unprocessed while nothing reads its output, whatever arrives
+     * at its inlets, and still compute the same output once it is processed again. Objects without
+     * state may, as may oscillators which catch up with the samples which they have missed. By
+     * default, only elementwise objects may. See <code>DspGraphOptimiser</code>.
+     */
+    virtual bool canSkipDsp();
+
     virtual bool isLeafNode();
 
     virtual list<DspObject *> getProcessOrder();
@@ -121,6 +204,27 @@ class DspObject : public MessageObject {
     virtual list<ObjectLetPair> getOutgoingDspConnections(unsigned int outletIndex);
   
     static const char *getObjectLabel() { return "obj~"; }
+  
+    /** Returns the number of messages waiting to be processed in the current block. */
+    unsigned int getNumPendingMessages() { return messageQueue.size(); }
+  
+    /**
+     * Profiling counters for this object. They are only updated when the context is profiling,
+     * and are otherwise left untouched. See <code>PdContext::setProfiling()</code>.
+     */
+    DspProfile profile;
+  
+    /**
+     * Whether this object has been taken out of the process order of its graph. See
+     * <code>DspGraphOptimiser</code>.
+     */
+    DspNodeState nodeState;
+  
+    /**
+     * The position of this object in the process order of its graph, as it was before the order
+     * was optimised. See <code>DspGraphOptimiser</code>.
+     */
+    unsigned int processIndex;
     
   protected:
     static void processFunctionDefaultNoMessage(DspObject *dspObject, int fromIndex, int toIndex);
@@ -139,7 +243,16 @@ class DspObject : public MessageObject {
   
     /** Immediately deletes all messages in the message queue without executing them. */
     void clearMessageQueue();
-    
+
+    /** Returns true if the buffers at all dsp outlets hold nothing but silence. */
+    bool isDspOutputSilent();
+
+    /** Returns true if the buffer at the given dsp inlet is known to stay silent. */
+    bool isDspInletKnownSilent(unsigned int inletIndex);
+
+    /** Returns true if the buffers at all dsp inlets are known to stay silent. */
+    bool areDspInletsKnownSilent();
+
     // both float and int versions of the blocksize are stored as different internal mechanisms
     // require different number formats
     int blockSizeInt;
@@ -20,48 +20,55 @@
  *
  */
 
+#include "CosineEngine.h"
 #include "DspOsc.h"
+#include "PdContext.h"
 #include "PdGraph.h"
 
-// initialise the static class variables
-float *DspOsc::cos_table = NULL;
-int DspOsc::refCount = 0;
+#define PHASE_SCALE 4294967296.0f // 2^32
 
 MessageObject *DspOsc::newObject(PdMessage *initMessage, PdGraph *graph) {
   return new DspOsc(initMessage, graph);
 }
 
 DspOsc::DspOsc(PdMessage *initMessage, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {
-  frequency = initMessage->isFloat(0) ? initMessage->getFloat(0) : 0.0f;
-  sampleStep = frequency * 65536.0f / graph->getSampleRate();
-  #if __SSE3__
-  short step = (short) roundf(sampleStep);
-  inc = _mm_set_epi16(8*step, 8*step, 8*step, 8*step, 8*step, 8*step, 8*step, 8*step);
-  indicies = _mm_set_epi16(7*step, 6*step, 5*step, 4*step, 3*step, 2*step, step, 0);
-  #endif
-  
-  phase = 0.0f;
-  refCount++;
-  if (cos_table == NULL) {
-    cos_table = ALLOC_ALIGNED_BUFFER(65536 * sizeof(float));
-    for (int i = 0; i < 65536; i++) {
-      cos_table[i] = cosf(2.0f * M_PI * ((float) i) / 65536.0f);
-    }
-  }
+  sampleDuration = 1.0f / graph->getSampleRate();
+  phase = 0;
+  phaseIncrement = 0;
+  phaseSample = graph->getContext()->getBlockStartSample();
+  PdMessage *message = PD_MESSAGE_ON_STACK(1);
+  message->initWithTimestampAndFloat(0.0, initMessage->isFloat(0) ? initMessage->getFloat(0) : 0.0f);
+  processMessage(0, message);
   
   processFunction = &processScalar;
   processFunctionNoMessage = &processScalar;
 }
 
 DspOsc::~DspOsc() {
-  if (--refCount == 0) {
-    FREE_ALIGNED_BUFFER(cos_table);
-    cos_table = NULL;
-  }
+  // nothing to do
 }
 
 void DspOsc::onInletConnectionUpdate(unsigned int inletIndex) {
-  // TODO(mhroth): support this with processSignal
+  // messages to the phase inlet must still be processed if the frequency is a signal
+  processFunction = incomingDspConnections[0].empty() ? &processScalar : &processSignal;
+  processFunctionNoMessage = processFunction;
+  phaseSample = graph->getContext()->getBlockStartSample();
+}
+
+bool DspOsc::isAtRest() {
+  return incomingDspConnections[0].empty() || isDspInletKnownSilent(0);
+}
+
+bool DspOsc::canSkipDsp() {
+  return incomingDspConnections[0].empty();
+}
+
+void DspOsc::advancePhase(uint64_t sample) {
+  if (sample > phaseSample) {
+    // the phase wraps around modulo 2^32, as it does when it is advanced sample by sample
+    phase += phaseIncrement * (uint32_t) (sample - phaseSample);
+    phaseSample = sample;
+  }
 }
 
 string DspOsc::toString() {
@@ -74,21 +81,23 @@ void DspOsc::processMessage(int inletIndex, PdMessage *message) {
   switch (inletIndex) {
     case 0: { // update the frequency
       if (message->isFloat(0)) {
-        frequency = fabsf(message->getFloat(0));
-        sampleStep = frequency * 65536.0f / graph->getSampleRate();
-        
-        #if __SSE3__
-        short step = (short) roundf(sampleStep);
-        inc = _mm_set_epi16(8*step, 8*step, 8*step, 8*step, 8*step, 8*step, 8*step, 8*step);
-        unsigned short currentIndex = _mm_extract_epi16(indicies,0);
-        indicies = _mm_set_epi16(7*step+currentIndex, 6*step+currentIndex, 5*step+currentIndex,
-            4*step+currentIndex, 3*step+currentIndex, 2*step+currentIndex, step+currentIndex, currentIndex);
-        #endif
+        // a dead oscillator receives messages right away, such that it must catch up first
+        if (incomingDspConnections[0].empty()) advancePhase(graph->getSampleIndex(message));
+        frequency = message->getFloat(0);
+        // only the fraction of a period by which the phase advances each sample is relevant
+        double periodsPerSample = ((double) frequency) / graph->getSampleRate();
+        periodsPerSample -= floor(periodsPerSample);
+        phaseIncrement = (uint32_t) (periodsPerSample * 4294967296.0);
       }
       break;
     }
-    case 1: { // update the phase
-      // TODO(mhroth)
+    case 1: { // reset the phase, given as a fraction of a period
+      if (message->isFloat(0)) {
+        double newPhase = message->getFloat(0);
+        phase = (uint32_t) ((newPhase - floor(newPhase)) * 4294967296.0);
+        uint64_t sample = graph->getSampleIndex(message);
+        if (sample > phaseSample) phaseSample = sample;
+      }
       break;
     }
     default: break;
@@ -97,80 +106,82 @@ void DspOsc::processMessage(int inletIndex, PdMessage *message) {
 
 void DspOsc::processScalar(DspObject *dspObject, int fromIndex, int toIndex) {
   DspOsc *d = reinterpret_cast<DspOsc *>(dspObject);
-  #if __SSE3__
+  uint64_t blockStartSample = d->graph->getContext()->getBlockStartSample();
+  d->advancePhase(blockStartSample + fromIndex); // there is nothing to do unless blocks were skipped
+  d->phase = CosineEngine::cosineOfPhaseRamp(d->phase, d->phaseIncrement,
+      d->dspBufferAtOutlet[0] + fromIndex, toIndex - fromIndex, d->graph->getContext()->getCosineAccuracy());
+  d->phaseSample = blockStartSample + toIndex;
+}
+
+void DspOsc::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
+  DspOsc *d = reinterpret_cast<DspOsc *>(dspObject);
+  float *input = d->dspBufferAtInlet[0] + fromIndex;
+  float sampleDuration = d->sampleDuration;
+  int n = toIndex - fromIndex;
+  uint32_t phases[n];
+  uint32_t phase = d->phase;
+  int i = 0;
   /*
-   * Creates an array of unsigned short indicies (since the length of the cosine lookup table is
-   * of length 2^16. These indicies are incremented by a step size based on the desired frequency.
-   * As the indicies overflow during addition, they loop back around to zero.
+   * The frequency of each sample is converted to a phase increment, wrapped to [-1/2, 1/2] of a
+   * period such that it fits into 32 bits. The phase of each sample is the phase of the previous
+   * sample plus its increment, which is computed as a prefix sum over the vector.
    */
-  float *output = d->dspBufferAtOutlet[0]+fromIndex;
-  __m128i inc = d->inc;
-  __m128i indicies = d->indicies;
-  int n = toIndex - fromIndex;
-  
-  unsigned short currentIndex = _mm_extract_epi16(indicies,0);
-  short step = _mm_extract_epi16(inc,0)/8;
-  
-  switch (fromIndex & 0x7) {
-    case 0: default: break;
-    case 1: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n; // allow fallthrough
-    case 2: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-    case 3: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-    case 4: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-    case 5: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-    case 6: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-    case 7: {
-      *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; --n;
-      
-      d->indicies = _mm_set_epi16(7*step+currentIndex, 6*step+currentIndex, 5*step+currentIndex,
-          4*step+currentIndex, 3*step+currentIndex, 2*step+currentIndex, step+currentIndex, currentIndex);
-    }
+  #if __AVX2__
+  __m256 duration = _mm256_set1_ps(sampleDuration);
+  __m256i accumulator = _mm256_set1_epi32(phase);
+  for (; i <= n - 8; i += 8) {
+    __m256 periods = _mm256_mul_ps(_mm256_loadu_ps(input + i), duration);
+    periods = _mm256_sub_ps(periods, _mm256_round_ps(periods, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    __m256i increments = _mm256_cvttps_epi32(_mm256_mul_ps(periods, _mm256_set1_ps(PHASE_SCALE)));
+    // the prefix sum within each half, and then the sum of the lower half is added to the upper
+    __m256i sum = _mm256_add_epi32(increments, _mm256_slli_si256(increments, 4));
+    sum = _mm256_add_epi32(sum, _mm256_slli_si256(sum, 8));
+    __m256i lowerSum = _mm256_shuffle_epi32(sum, 0xFF);
+    sum = _mm256_add_epi32(sum, _mm256_permute2x128_si256(lowerSum, lowerSum, 0x08));
+    _mm256_storeu_si256((__m256i *) (phases + i),
+        _mm256_add_epi32(accumulator, _mm256_sub_epi32(sum, increments)));
+    accumulator = _mm256_add_epi32(accumulator, _mm256_permutevar8x32_epi32(sum, _mm256_set1_epi32(7)));
   }
-  
-  int n4 = n & 0xFFFFFFF8; // we can process 8 indicies at a time
-  while (n4) {
-    __m128 values = _mm_set_ps(DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,3)],
-                               DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,2)],
-                               DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,1)],
-                               DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,0)]);
-    _mm_store_ps(output, values);
-    output += 4;
-    values = _mm_set_ps(DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,7)],
-                        DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,6)],
-                        DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,5)],
-                        DspOsc::cos_table[(unsigned short) _mm_extract_epi16(indicies,4)]);
-    _mm_store_ps(output, values);
-    indicies = _mm_add_epi16(indicies, inc);
-    output += 4;
-    n4 -= 8;
+  phase = (uint32_t) _mm_cvtsi128_si32(_mm256_castsi256_si128(accumulator));
+  #elif __SSE2__
+  __m128 duration = _mm_set1_ps(sampleDuration);
+  __m128i accumulator = _mm_set1_epi32(phase);
+  for (; i <= n - 4; i += 4) {
+    __m128 periods = _mm_mul_ps(_mm_loadu_ps(input + i), duration);
+    periods = _mm_sub_ps(periods, _mm_cvtepi32_ps(_mm_cvtps_epi32(periods))); // rounds to nearest
+    __m128i increments = _mm_cvttps_epi32(_mm_mul_ps(periods, _mm_set1_ps(PHASE_SCALE)));
+    __m128i sum = _mm_add_epi32(increments, _mm_slli_si128(increments, 4));
+    sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 8));
+    _mm_storeu_si128((__m128i *) (phases + i), _mm_add_epi32(accumulator, _mm_sub_epi32(sum, increments)));
+    accumulator = _mm_add_epi32(accumulator, _mm_shuffle_epi32(sum, 0xFF));
   }
-  
-  currentIndex = _mm_extract_epi16(indicies,0);
-  switch (n & 0x7) {
-    case 7: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step; // allow fallthrough
-    case 6: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    case 5: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    case 4: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    case 3: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    case 2: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    case 1: *output++ = DspOsc::cos_table[currentIndex]; currentIndex += step;
-    default: {
-      // set the current index to the correct location, given that the step size is actually
-      // a real number, not an integer
-      // NOTE(mhroth): but doing this will cause clicks :-/ Osc will thus go out of phase over time
-      // Will anyone complain?
-//      d->currentIndex = currentIndex + ((short) ((d->sampleStep - floorf(d->sampleStep)) * n));
-      
-      if ((n & 0x7) == 0) {
-        d->indicies = indicies;
-      } else {
-        d->indicies = _mm_set_epi16(7*step+currentIndex, 6*step+currentIndex, 5*step+currentIndex,
-            4*step+currentIndex, 3*step+currentIndex, 2*step+currentIndex, step+currentIndex, currentIndex);        
-      }
-      break;
-    }
+  phase = (uint32_t) _mm_cvtsi128_si32(accumulator);
+  #elif __ARM_NEON__
+  uint32x4_t zero = vdupq_n_u32(0);
+  uint32x4_t accumulator = vdupq_n_u32(phase);
+  for (; i <= n - 4; i += 4) {
+    float32x4_t periods = vmulq_n_f32(vld1q_f32(input + i), sampleDuration);
+    // round to nearest by truncating after adding one half with the sign of the period
+    float32x4_t half = vreinterpretq_f32_u32(vorrq_u32(
+        vandq_u32(vreinterpretq_u32_f32(periods), vdupq_n_u32(0x80000000)),
+        vreinterpretq_u32_f32(vdupq_n_f32(0.5f))));
+    periods = vsubq_f32(periods, vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(periods, half))));
+    uint32x4_t increments = vreinterpretq_u32_s32(vcvtq_s32_f32(vmulq_n_f32(periods, PHASE_SCALE)));
+    uint32x4_t sum = vaddq_u32(increments, vextq_u32(zero, increments, 3));
+    sum = vaddq_u32(sum, vextq_u32(zero, sum, 2));
+    vst1q_u32(phases + i, vaddq_u32(accumulator, vsubq_u32(sum, increments)));
+    accumulator = vaddq_u32(accumulator, vdupq_n_u32(vgetq_lane_u32(sum, 3)));
   }
-  #else
-  // TODO(mhroth):!!!
+  phase = vgetq_lane_u32(accumulator, 0);
   #endif
+  for (; i < n; i++) {
+    phases[i] = phase;
+    // the increment is converted through 64 bits such that negative frequencies wrap correctly
+    phase += (uint32_t) (int64_t) (input[i] * sampleDuration * PHASE_SCALE);
+  }
+  d->phase = phase;
+  d->phaseSample = d->graph->getContext()->getBlockStartSample() + toIndex;
+  // the output may be the input buffer, which has been read completely by now
+  CosineEngine::cosineOfPhases(phases, d->dspBufferAtOutlet[0] + fromIndex, n,
+      d->graph->getContext()->getCosineAccuracy());
 }
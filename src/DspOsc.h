@@ -23,9 +23,15 @@
 #ifndef _DSP_OSC_H_
 #define _DSP_OSC_H_
 
+#include <stdint.h>
 #include "DspObject.h"
 
-/** [osc~], [osc~ float] */
+/**
+ * [osc~], [osc~ float]
+ * A cosine oscillator. The phase is a 32-bit fixed point fraction of a period, which wraps around
+ * by itself and resolves the frequency to sampleRate/2^32 Hz. The cosine is computed by the
+ * <code>CosineEngine</code>. The frequency may be given as a signal, such as for FM synthesis.
+ */
 class DspOsc : public DspObject {
   
   public:
@@ -36,23 +42,31 @@ class DspOsc : public DspObject {
     static const char *getObjectLabel();
     std::string toString();
   
+    /**
+     * At a constant frequency, the phase catches up with the samples which the oscillator has
+     * missed while it was not processed. At a silent signal frequency, it stands still.
+     */
+    bool isAtRest();
+    bool hasSilentOutput() { return false; }
+    bool canSkipDsp();
+  
     void onInletConnectionUpdate(unsigned int inletIndex);
   
   private:
     static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
+    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
     void processMessage(int inletIndex, PdMessage *message);
   
-    float frequency; // frequency and phase are stored as integers because they are used
-    float sampleStep;
-    int phase;     // in for-loops to traverse the lookup table
+    float frequency;
+    float sampleDuration; // in seconds
+    uint32_t phase;
+    uint32_t phaseIncrement; // per sample, at the given frequency
   
-    static float *cos_table; // the cosine lookup table
-    static int refCount; // a reference counter for cos_table. Now we know when to free it.
+    /** The sample of the context, as counted by <code>PdContext</code>, which the phase is for. */
+    uint64_t phaseSample;
   
-    #if __SSE3__
-    __m128i inc; // the amount by which to increment indicies every step
-    __m128i indicies; // the table lookup indicies
-    #endif
+    /** Advances the phase at the given frequency to the given sample of the context. */
+    void advancePhase(uint64_t sample);
 };
 
 inline const char *DspOsc::getObjectLabel() {
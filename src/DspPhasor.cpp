@@ -21,6 +21,7 @@
  */
 
 #include "DspPhasor.h"
+#include "PdContext.h"
 #include "PdGraph.h"
 
 #define SHORT_TO_FLOAT_RATIO 0.0000152590219f // == 1/(2^16 - 1)
@@ -30,6 +31,10 @@ MessageObject *DspPhasor::newObject(PdMessage *initMessage, PdGraph *graph) {
 }
 
 DspPhasor::DspPhasor(PdMessage *initMessage, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {  
+  phaseSample = graph->getContext()->getBlockStartSample();
+  #if __SSE3__
+  indicies = _mm_setzero_si64(); // the phase starts at zero
+  #endif // __SSE3__
   PdMessage *message = PD_MESSAGE_ON_STACK(1);
   message->initWithTimestampAndFloat(0.0, initMessage->isFloat(0) ? initMessage->getFloat(0) : 0.0f);
   processMessage(0, message);
@@ -50,17 +55,42 @@ string DspPhasor::toString() {
 
 void DspPhasor::onInletConnectionUpdate(unsigned int inletIndex) {
   processFunction = incomingDspConnections[0].empty() ? &processScalar : &processSignal;
+  phaseSample = graph->getContext()->getBlockStartSample();
+}
+
+bool DspPhasor::isAtRest() {
+  return incomingDspConnections[0].empty() || isDspInletKnownSilent(0);
+}
+
+bool DspPhasor::canSkipDsp() {
+  return incomingDspConnections[0].empty();
+}
+
+void DspPhasor::advancePhase(uint64_t sample) {
+  if (sample > phaseSample) {
+    #if __SSE3__
+    // the indicies wrap around modulo 2^16, as they do when they are advanced sample by sample
+    uint32_t step = (uint16_t) (_mm_extract_pi16(inc,0) >> 2);
+    indicies = _mm_add_pi16(indicies, _mm_set1_pi16((short) (step * (uint32_t) (sample - phaseSample))));
+    #endif // __SSE3__
+    phaseSample = sample;
+  }
 }
 
 void DspPhasor::processMessage(int inletIndex, PdMessage *message) {
   switch (inletIndex) {
     case 0: { // update the frequency
       if (message->isFloat(0)) {
+        // a dead phasor receives messages right away, such that it must catch up first
+        if (incomingDspConnections[0].empty()) advancePhase(graph->getSampleIndex(message));
         frequency = message->getFloat(0);
         #if __SSE3__
         float sampleStep = frequency * 65536.0f / graph->getSampleRate();
         short s = (short) sampleStep; // signed as step size may be negative as well!
         inc = _mm_set1_pi16(4*s);
+        // the four lanes are one step apart, counting from the next index
+        unsigned short idx = _mm_extract_pi16(indicies,0);
+        indicies = _mm_set_pi16(idx+3*s, idx+2*s, idx+s, idx);
         #endif // __SSE3__
       }
       break;
@@ -76,6 +106,7 @@ void DspPhasor::processMessage(int inletIndex, PdMessage *message) {
 // NOTE(mhroth): it is assumed that the block size (toIndex) is a multiple of 4
 void DspPhasor::processSignal(DspObject *dspObject, int fromIndex, int n4) {
   DspPhasor *d = reinterpret_cast<DspPhasor *>(dspObject);
+  d->phaseSample = d->graph->getContext()->getBlockStartSample() + n4;
   #if __SSE3__
   float *input = d->dspBufferAtInlet[0];
   float *output = d->dspBufferAtOutlet[0];
@@ -111,6 +142,9 @@ void DspPhasor::processSignal(DspObject *dspObject, int fromIndex, int n4) {
 // http://cache-www.intel.com/cd/00/00/34/76/347603_347603.pdf
 void DspPhasor::processScalar(DspObject *dspObject, int fromIndex, int toIndex) {
   DspPhasor *d = reinterpret_cast<DspPhasor *>(dspObject);
+  uint64_t blockStartSample = d->graph->getContext()->getBlockStartSample();
+  d->advancePhase(blockStartSample + fromIndex); // there is nothing to do unless blocks were skipped
+  d->phaseSample = blockStartSample + toIndex;
   #if __SSE3__
   /*
    * Creates an array of unsigned short indicies (since the length of the cosine lookup table is
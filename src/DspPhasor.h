@@ -37,6 +37,14 @@ class DspPhasor : public DspObject {
     static const char *getObjectLabel();
     std::string toString();
 
+    /**
+     * At a constant frequency, the phase catches up with the samples which the phasor has missed
+     * while it was not processed. At a silent signal frequency, it stands still.
+     */
+    bool isAtRest();
+    bool hasSilentOutput() { return false; }
+    bool canSkipDsp();
+
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
     static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
@@ -48,6 +56,12 @@ class DspPhasor : public DspObject {
     __m64 inc; // the amount by which to increment indicies every step
     __m64 indicies; // the table lookup indicies
     #endif
+  
+    /** The sample of the context, as counted by <code>PdContext</code>, which the phase is for. */
+    uint64_t phaseSample;
+  
+    /** Advances the phase at the given frequency to the given sample of the context. */
+    void advancePhase(uint64_t sample);
 };
 
 inline const char *DspPhasor::getObjectLabel() {
@@ -0,0 +1,273 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "DspReadSoundfile.h"
+#include "PdContext.h"
+#include "PdGraph.h"
+
+// the default buffer size in bytes per channel, as in Pd
+#define DEFAULT_BUFFER_SIZE 262144
+#define MAX_NUM_CHANNELS 64
+// the buffer must hold at least this many blocks
+#define MIN_NUM_BLOCKS 16
+// the maximum number of frames read from the file at once
+#define NUM_FRAMES_PER_READ 1024
+
+MessageObject *DspReadSoundfile::newObject(PdMessage *initMessage, PdGraph *graph) {
+  return new DspReadSoundfile(initMessage, graph);
+}
+
+/** Returns the number of channels given as the first argument, clamped to [1, MAX_NUM_CHANNELS]. */
+static int getNumChannels(PdMessage *initMessage) {
+  if (!initMessage->isFloat(0) || initMessage->getFloat(0) < 1.0f) return 1;
+  else if (initMessage->getFloat(0) > MAX_NUM_CHANNELS) return MAX_NUM_CHANNELS;
+  else return (int) initMessage->getFloat(0);
+}
+
+DspReadSoundfile::DspReadSoundfile(PdMessage *initMessage, PdGraph *graph) :
+    DspObject(1, 0, getNumChannels(initMessage)+1, getNumChannels(initMessage), graph) {
+  numChannels = getNumDspOutlets();
+  bufferSize = initMessage->isFloat(1) ? (int) initMessage->getFloat(1) : DEFAULT_BUFFER_SIZE;
+  unsigned int minCapacity = (bufferSize / sizeof(float)) * numChannels;
+  if (minCapacity < MIN_NUM_BLOCKS * blockSizeInt * numChannels) {
+    minCapacity = MIN_NUM_BLOCKS * blockSizeInt * numChannels;
+  }
+  ringBuffer = new RingBuffer(minCapacity);
+  interleavedBuffer = (float *) calloc(blockSizeInt * numChannels, sizeof(float));
+
+  isPlaying = false;
+  openPath[0] = '\0';
+  numUnderruns = 0;
+  numOpenFailuresReported = 0;
+
+  sndFile = NULL;
+  numFileChannels = 0;
+  fileBuffer = NULL;
+  streamBuffer = (float *) calloc(NUM_FRAMES_PER_READ * numChannels, sizeof(float));
+
+  isEndOfFile = true;
+  numOpenFailures = 0;
+
+  diskStreamService = graph->getContext()->getDiskStreamService();
+}
+
+DspReadSoundfile::~DspReadSoundfile() {
+  // a graph which is deleted while still attached does not unregister its objects. Ensure that the
+  // disk thread has let go of this stream before it is taken apart.
+  diskStreamService->unregisterStream(this);
+  closeFile();
+  delete ringBuffer;
+  free(interleavedBuffer);
+  free(fileBuffer);
+  free(streamBuffer);
+}
+
+string DspReadSoundfile::toString() {
+  char str[snprintf(NULL, 0, "%s %i %i", getObjectLabel(), numChannels, bufferSize)+1];
+  snprintf(str, sizeof(str), "%s %i %i", getObjectLabel(), numChannels, bufferSize);
+  return string(str);
+}
+
+ConnectionType DspReadSoundfile::getConnectionType(int outletIndex) {
+  // the rightmost outlet bangs when the file has finished playing
+  return (outletIndex == numChannels) ? MESSAGE : DSP;
+}
+
+
+#pragma mark - Audio Thread
+
+void DspReadSoundfile::processMessage(int inletIndex, PdMessage *message) {
+  switch (message->getType(0)) {
+    case FLOAT: {
+      if (message->getFloat(0) == 0.0f) {
+        stop();
+      } else {
+        isPlaying = true;
+      }
+      break;
+    }
+    case SYMBOL: {
+      if (message->isSymbol(0, "open") && message->isSymbol(1)) {
+        open(message->getSymbol(1), message->isFloat(2) ? (int) message->getFloat(2) : 0);
+      } else if (message->isSymbol(0, "start")) {
+        isPlaying = true;
+      } else if (message->isSymbol(0, "stop")) {
+        stop();
+      } else if (message->isSymbol(0, "print")) {
+        graph->printStd("%s: %s, %i channels, %u/%u samples buffered, %u underruns", getObjectLabel(),
+            isPlaying ? "playing" : "stopped", numChannels, ringBuffer->getNumAvailable(),
+            ringBuffer->getCapacity(), numUnderruns);
+      } else {
+        graph->printErr("%s: unknown message %s.", getObjectLabel(), message->getSymbol(0));
+      }
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+void DspReadSoundfile::open(const char *path, int onset) {
+  DiskStreamCommand *command = getNextCommand();
+  if (command == NULL) {
+    graph->printErr("%s: too many pending requests. Ignoring open %s.", getObjectLabel(), path);
+    return;
+  }
+  isPlaying = false;
+  command->type = DISK_STREAM_OPEN;
+  strncpy(command->path, path, DISK_STREAM_PATH_LENGTH-1);
+  command->path[DISK_STREAM_PATH_LENGTH-1] = '\0';
+  command->onset = (onset > 0) ? onset : 0;
+  postCommand();
+  strcpy(openPath, command->path);
+  diskStreamService->signal();
+}
+
+void DspReadSoundfile::stop() {
+  isPlaying = false;
+  DiskStreamCommand *command = getNextCommand();
+  if (command != NULL) {
+    command->type = DISK_STREAM_CLOSE;
+    postCommand();
+    diskStreamService->signal();
+  }
+}
+
+void DspReadSoundfile::processDspWithIndex(int fromIndex, int toIndex) {
+  if (numOpenFailures != numOpenFailuresReported) {
+    numOpenFailuresReported = numOpenFailures;
+    graph->printErr("%s: file '%s' cannot be opened.", getObjectLabel(), openPath);
+  }
+
+  int numFrames = 0;
+  // the ring buffer belongs to the disk thread until all commands have been executed
+  if (isPlaying && !hasPendingCommands()) {
+    // the end of file flag must be read before the buffer, such that no frames are missed
+    bool isFileFinished = isEndOfFile;
+    __sync_synchronize();
+    unsigned int numRequested = (toIndex - fromIndex) * numChannels;
+    unsigned int numRead = ringBuffer->read(interleavedBuffer, numRequested);
+    numFrames = numRead / numChannels;
+    for (int j = 0; j < numChannels; j++) {
+      float *output = getDspBufferAtOutlet(j) + fromIndex;
+      for (int i = 0, k = j; i < numFrames; i++, k += numChannels) {
+        output[i] = interleavedBuffer[k];
+      }
+    }
+    if (numRead < numRequested) {
+      if (isFileFinished) {
+        isPlaying = false;
+        PdMessage *outgoingMessage = PD_MESSAGE_ON_STACK(1);
+        outgoingMessage->initWithTimestampAndBang(0.0);
+        graph->scheduleMessage(this, numChannels, outgoingMessage);
+      } else {
+        numUnderruns++;
+      }
+    }
+    diskStreamService->signal();
+  }
+
+  // fill any remaining output with silence
+  if (fromIndex + numFrames < toIndex) {
+    for (int j = 0; j < numChannels; j++) {
+      memset(getDspBufferAtOutlet(j) + fromIndex + numFrames, 0,
+          (toIndex - fromIndex - numFrames) * sizeof(float));
+    }
+  }
+}
+
+
+#pragma mark - Disk Thread
+
+void DspReadSoundfile::executeCommand(DiskStreamCommand *command) {
+  // the audio thread does not access the ring buffer while a command is pending
+  closeFile();
+  ringBuffer->reset();
+  isEndOfFile = true;
+
+  switch (command->type) {
+    case DISK_STREAM_OPEN: {
+      char *fullPath = graph->resolveFullPath(command->path);
+      if (fullPath == NULL) {
+        numOpenFailures++;
+        break;
+      }
+      SF_INFO sfInfo;
+      memset(&sfInfo, 0, sizeof(SF_INFO));
+      sndFile = sf_open(fullPath, SFM_READ, &sfInfo);
+      free(fullPath);
+      if (sndFile == NULL) {
+        numOpenFailures++;
+        break;
+      }
+      if (command->onset > 0) sf_seek(sndFile, command->onset, SEEK_SET);
+      numFileChannels = sfInfo.channels;
+      fileBuffer = (float *) realloc(fileBuffer, NUM_FRAMES_PER_READ * numFileChannels * sizeof(float));
+      isEndOfFile = false;
+
+      // prefetch, such that playback can begin as soon as the command has been executed
+      fillRingBuffer();
+      break;
+    }
+    case DISK_STREAM_CLOSE:
+    default: {
+      break; // the file has already been closed
+    }
+  }
+}
+
+void DspReadSoundfile::transfer() {
+  fillRingBuffer();
+}
+
+void DspReadSoundfile::fillRingBuffer() {
+  while (sndFile != NULL) {
+    // only whole frames are written, such that the audio thread always reads whole frames
+    unsigned int numFramesFree = ringBuffer->getNumFree() / numChannels;
+    if (numFramesFree == 0) break;
+    if (numFramesFree > NUM_FRAMES_PER_READ) numFramesFree = NUM_FRAMES_PER_READ;
+
+    sf_count_t numFramesRead = sf_readf_float(sndFile, fileBuffer, numFramesFree);
+    if (numFramesRead <= 0) {
+      closeFile();
+      __sync_synchronize(); // all frames must be visible before the end of the file is
+      isEndOfFile = true;
+      break;
+    }
+
+    // map the channels of the file onto the channels of this object
+    for (int i = 0; i < numFramesRead; i++) {
+      for (int j = 0; j < numChannels; j++) {
+        streamBuffer[i*numChannels + j] = (j < numFileChannels) ? fileBuffer[i*numFileChannels + j] : 0.0f;
+      }
+    }
+    ringBuffer->write(streamBuffer, numFramesRead * numChannels);
+  }
+}
+
+void DspReadSoundfile::closeFile() {
+  if (sndFile != NULL) {
+    sf_close(sndFile);
+    sndFile = NULL;
+  }
+}
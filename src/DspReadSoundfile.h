@@ -0,0 +1,96 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _DSP_READ_SOUNDFILE_H_
+#define _DSP_READ_SOUNDFILE_H_
+
+#include <sndfile.h>
+#include "DiskStreamService.h"
+#include "DspObject.h"
+#include "RingBuffer.h"
+
+/**
+ * [readsf~], [readsf~ float], [readsf~ float float]
+ * Streams a soundfile from disk. The file is read by the context's <code>DiskStreamService</code>
+ * into a ring buffer, such that the audio thread never touches the filesystem. The arguments are
+ * the number of channels and the buffer size in bytes per channel, as in Pd.
+ */
+class DspReadSoundfile : public DspObject, public DiskStream {
+
+  public:
+    static MessageObject *newObject(PdMessage *initMessage, PdGraph *graph);
+    DspReadSoundfile(PdMessage *initMessage, PdGraph *graph);
+    ~DspReadSoundfile();
+
+    static const char *getObjectLabel();
+    std::string toString();
+    ObjectType getObjectType();
+
+    ConnectionType getConnectionType(int outletIndex);
+
+  protected:
+    void executeCommand(DiskStreamCommand *command);
+    void transfer();
+
+  private:
+    void processMessage(int inletIndex, PdMessage *message);
+    void processDspWithIndex(int fromIndex, int toIndex);
+
+    void open(const char *path, int onset);
+    void stop();
+
+    /** Reads from the open file into the ring buffer until it is full or the file ends. */
+    void fillRingBuffer();
+    void closeFile();
+
+    int numChannels;
+    int bufferSize; // in bytes per channel
+    DiskStreamService *diskStreamService;
+    RingBuffer *ringBuffer; // interleaved frames, written by the disk thread
+
+    // audio thread state
+    bool isPlaying;
+    char openPath[DISK_STREAM_PATH_LENGTH]; // the most recently requested file, for error reporting
+    float *interleavedBuffer; // one block of interleaved frames
+    unsigned int numUnderruns;
+    unsigned int numOpenFailuresReported;
+
+    // disk thread state
+    SNDFILE *sndFile;
+    int numFileChannels;
+    float *fileBuffer; // frames as read from the file
+    float *streamBuffer; // frames mapped to the channels of this object
+
+    // written by the disk thread, read by the audio thread
+    volatile bool isEndOfFile;
+    volatile unsigned int numOpenFailures;
+};
+
+inline const char *DspReadSoundfile::getObjectLabel() {
+  return "readsf~";
+}
+
+inline ObjectType DspReadSoundfile::getObjectType() {
+  return DSP_READ_SOUNDFILE;
+}
+
+#endif // _DSP_READ_SOUNDFILE_H_
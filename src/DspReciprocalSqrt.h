@@ -35,6 +35,8 @@ class DspReciprocalSqrt : public DspObject {
     
     static const char *getObjectLabel();
     std::string toString();
+    bool isAtRest() { return true; }
+    bool canSkipDsp() { return true; }
   
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
@@ -20,6 +20,7 @@
  *
  */
 
+#include "ArrayArithmetic.h"
 #include "DspSend.h"
 #include "PdGraph.h"
 
@@ -43,6 +44,11 @@ DspSend::~DspSend() {
   FREE_ALIGNED_BUFFER(dspBufferAtOutlet[0]);
 }
 
+bool DspSend::isAtRest() {
+  // [receive~] keeps reading the buffer while this object is not processed
+  return isDspInletKnownSilent(0) && ArrayArithmetic::isSilent(dspBufferAtOutlet[0], 0, blockSizeInt);
+}
+
 /*
  * It would be very nice to not have to use memcpys with send~ and receive~, but unfortunately
  * things become very complicated very quickly. If s~ is already in an attached graph, then
@@ -36,6 +36,7 @@ class DspSend : public DspObject {
     const char *getName();
     static const char *getObjectLabel();
     std::string toString();
+    bool isAtRest();
   
     ObjectType getObjectType();
     
@@ -21,6 +21,7 @@
  */
 
 #include "ArrayArithmetic.h"
+#include "BufferPool.h"
 #include "DspSignal.h"
 #include "PdGraph.h"
 
@@ -44,6 +45,14 @@ string DspSignal::toString() {
   return string(str);
 }
 
+float *DspSignal::getFoldedOutputBuffer() {
+  return graph->getBufferPool()->getConstantBuffer(constant);
+}
+
+bool DspSignal::isAtRest() {
+  return true; // the output only changes with a message
+}
+
 void DspSignal::processMessage(int inletIndex, PdMessage *message) {
   if (message->isFloat(0)) {
     constant = message->getFloat(0);
@@ -35,6 +35,9 @@ class DspSignal : public DspObject {
   
     static const char *getObjectLabel();
     std::string toString();
+    float *getFoldedOutputBuffer();
+    bool isAtRest();
+    bool canSkipDsp() { return true; }
   
   private:
     static void processScalar(DspObject *dspObject, int fromIndex, int toIndex);
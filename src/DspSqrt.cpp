@@ -20,6 +20,7 @@
  *
  */
 
+#include "DspFusedChain.h"
 #include "DspSqrt.h"
 #include "PdGraph.h"
 
@@ -35,6 +36,17 @@ DspSqrt::~DspSqrt() {
   // nothing to do
 }
 
+bool DspSqrt::getElementwiseOperation(ElementwiseOperation *operation) {
+  #if __ARM_NEON__
+  return false; // the square root is approximated, which the fused chain does not reproduce
+  #else
+  operation->opcode = ElementwiseOperation::SQRT;
+  operation->signal = NULL;
+  operation->constant0 = operation->constant1 = NULL;
+  return true;
+  #endif
+}
+
 void DspSqrt::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
   // [sqrt~] takes no messages, so the full block will be computed every time
   DspSqrt *d = reinterpret_cast<DspSqrt *>(dspObject);
@@ -36,6 +36,7 @@ class DspSqrt : public DspObject {
     
     static const char *getObjectLabel();
     std::string toString();
+    bool getElementwiseOperation(ElementwiseOperation *operation);
   
   private:
     static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
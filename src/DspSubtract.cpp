@@ -21,9 +21,10 @@
  */
 
 #include "ArrayArithmetic.h"
+#include "BufferPool.h"
+#include "DspFusedChain.h"
 #include "DspSubtract.h"
-
-class PdGraph;
+#include "PdGraph.h"
 
 MessageObject *DspSubtract::newObject(PdMessage *initMessage, PdGraph *graph) {
   return new DspSubtract(initMessage, graph);
@@ -31,6 +32,7 @@ MessageObject *DspSubtract::newObject(PdMessage *initMessage, PdGraph *graph) {
 
 DspSubtract::DspSubtract(PdMessage *initMessage, PdGraph *graph) : DspObject(2, 2, 0, 1, graph) {
   constant = initMessage->isFloat(0) ? initMessage->getFloat(0) : 0.0f;
+  processFunction = &processScalar;
   processFunctionNoMessage = &processScalar;
 }
 
@@ -50,6 +52,36 @@ void DspSubtract::onInletConnectionUpdate(unsigned int inletIndex) {
       ? &processSignal : processScalar;
 }
 
+bool DspSubtract::getElementwiseOperation(ElementwiseOperation *operation) {
+  if (processFunction == &processSignal) {
+    operation->signal = getDspBufferSlotAtInlet(1);
+  } else if (processFunction == &processScalar) {
+    operation->signal = NULL;
+  } else {
+    return false;
+  }
+  operation->opcode = ElementwiseOperation::SUBTRACT;
+  operation->constant0 = &constant;
+  operation->constant1 = NULL;
+  return true;
+}
+
+float *DspSubtract::getFoldedOutputBuffer() {
+  BufferPool *bufferPool = graph->getBufferPool();
+  float value0 = 0.0f;
+  float value1 = 0.0f;
+  bool isConstant0 = bufferPool->isConstantBuffer(dspBufferAtInlet[0], &value0);
+  if (processFunction == &processScalar) {
+    if (isConstant0) return bufferPool->getConstantBuffer(value0 - constant);
+    else if (constant == 0.0f) return dspBufferAtInlet[0];
+  } else if (processFunction == &processSignal) {
+    bool isConstant1 = bufferPool->isConstantBuffer(dspBufferAtInlet[1], &value1);
+    if (isConstant0 && isConstant1) return bufferPool->getConstantBuffer(value0 - value1);
+    else if (isConstant1 && value1 == 0.0f) return dspBufferAtInlet[0];
+  }
+  return NULL;
+}
+
 void DspSubtract::processMessage(int inletIndex, PdMessage *message) {
   if (inletIndex == 1) {
     if (message->isFloat(0)) constant = message->getFloat(0);
@@ -34,6 +34,8 @@ class DspSubtract : public DspObject {
 
     static const char *getObjectLabel();
     std::string toString();
+    bool getElementwiseOperation(ElementwiseOperation *operation);
+    float *getFoldedOutputBuffer();
   
     void onInletConnectionUpdate(unsigned int inletIndex);
 
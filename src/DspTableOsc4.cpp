@@ -0,0 +1,150 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "ArrayArithmetic.h"
+#include "DspTableOsc4.h"
+#include "PdContext.h"
+#include "PdGraph.h"
+
+MessageObject *DspTableOsc4::newObject(PdMessage *initMessage, PdGraph *graph) {
+  return new DspTableOsc4(initMessage, graph);
+}
+
+DspTableOsc4::DspTableOsc4(PdMessage *initMessage, PdGraph *graph) : DspObject(2, 1, 0, 1, graph) {
+  name = initMessage->isSymbol(0) ? StaticUtils::copyString(initMessage->getSymbol(0)) : NULL;
+  table = NULL;
+  frequency = 0.0f;
+  phase = 0;
+  phaseIncrementPerHz = 4294967296.0f / graph->getSampleRate();
+  positions = (float *) malloc(blockSizeInt * sizeof(float));
+  wavetableCache = graph->getContext()->getWavetableCache();
+  wavetableCache->start();
+  cacheEntry = NULL;
+}
+
+DspTableOsc4::~DspTableOsc4() {
+  free(name);
+  free(positions);
+}
+
+/** Returns true if the table has a power of two plus three points, as tabosc4~ requires. */
+static bool isValidLength(int bufferLength) {
+  int length = bufferLength - 3;
+  return length >= 1 && (length & (length-1)) == 0;
+}
+
+void DspTableOsc4::setTable(MessageTable *aTable) {
+  table = aTable;
+  // the entry was created when the table was registered, and not on the audio thread
+  cacheEntry = (table != NULL) ? wavetableCache->getEntry(table->getName()) : NULL;
+  if (table != NULL) {
+    int bufferLength = 0;
+    table->getBuffer(&bufferLength);
+    if (!isValidLength(bufferLength)) {
+      graph->printErr("%s: %s: number of points (%i) not a power of 2 plus three.",
+          getObjectLabel(), name, bufferLength);
+    }
+  }
+}
+
+void DspTableOsc4::processMessage(int inletIndex, PdMessage *message) {
+  switch (inletIndex) {
+    case 0: {
+      if (message->isFloat(0)) {
+        frequency = message->getFloat(0);
+      } else if (message->isSymbol(0, "set") && message->isSymbol(1)) {
+        // change the table from which this object reads
+        free(name);
+        name = StaticUtils::copyString(message->getSymbol(1));
+        setTable(graph->getTable(name));
+      }
+      break;
+    }
+    case 1: {
+      if (message->isFloat(0)) {
+        // set the phase, in periods
+        phase = (uint32_t) (int64_t) ((message->getFloat(0) - floorf(message->getFloat(0))) * 4294967296.0f);
+      }
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+void DspTableOsc4::processDspWithIndex(int fromIndex, int toIndex) {
+  float *output = dspBufferAtOutlet[0];
+  TableBuffer *tableBuffer = (table != NULL) ? table->getTableBuffer() : NULL;
+  if (tableBuffer == NULL || !isValidLength(tableBuffer->getLength())) {
+    ArrayArithmetic::fill(output, 0.0f, fromIndex, toIndex);
+    return;
+  }
+  int length = tableBuffer->getLength() - 3;
+
+  float *input = incomingDspConnections[0].empty() ? NULL : dspBufferAtInlet[0];
+  float maxFrequency = fabsf(frequency);
+  if (input != NULL) {
+    maxFrequency = 0.0f;
+    for (int i = fromIndex; i < toIndex; i++) {
+      float f = fabsf(input[i]);
+      if (f > maxFrequency) maxFrequency = f;
+    }
+  }
+
+  // choose the level with the most harmonics which all remain below the Nyquist frequency
+  float *period = tableBuffer->getBuffer() + 1;
+  int periodLength = length;
+  WavetableMipmap *mipmap = (cacheEntry != NULL)
+      ? wavetableCache->getMipmap(cacheEntry, tableBuffer) : NULL;
+  if (mipmap != NULL) {
+    int level = 0;
+    if (maxFrequency > 0.0f) {
+      float maxNumHarmonics = 0.5f * graph->getSampleRate() / maxFrequency;
+      while (level < mipmap->numLevels-1 && mipmap->getNumHarmonics(level) > maxNumHarmonics) {
+        level++;
+      }
+    }
+    period = mipmap->levels[level];
+    periodLength = mipmap->levelLengths[level];
+  }
+
+  // Only the position within the period is handed to the (vectorised) interpolation kernel. The
+  // increments are converted through 64 bits such that negative frequencies wrap correctly.
+  float positionScale = periodLength / 4294967296.0f;
+  uint32_t phase = this->phase;
+  if (input != NULL) {
+    for (int i = fromIndex; i < toIndex; i++) {
+      positions[i] = (float) phase * positionScale;
+      phase += (uint32_t) (int64_t) (input[i] * phaseIncrementPerHz);
+    }
+  } else {
+    uint32_t phaseIncrement = (uint32_t) (int64_t) (frequency * phaseIncrementPerHz);
+    for (int i = fromIndex; i < toIndex; i++) {
+      positions[i] = (float) phase * positionScale;
+      phase += phaseIncrement;
+    }
+  }
+  this->phase = phase;
+  ArrayArithmetic::interpolate4Wrap(period, periodLength, positions, output, fromIndex, toIndex);
+}
@@ -0,0 +1,86 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _DSP_TABLE_OSC4_H_
+#define _DSP_TABLE_OSC4_H_
+
+#include <stdint.h>
+#include "DspObject.h"
+#include "TableReceiverInterface.h"
+#include "WavetableCache.h"
+
+/**
+ * [tabosc4~ name]
+ * A wavetable oscillator which plays one period of a table with 4-point interpolation. As in Pd,
+ * the table must have a power of two plus three points, the first and last two of which are
+ * guard points. The table is played from a band-limited mipmap chosen by the highest frequency in
+ * each block, such that it does not alias. Mipmaps are shared through the context's
+ * <code>WavetableCache</code>, and until the mipmap of a changed table is ready the table itself
+ * is played.
+ */
+class DspTableOsc4 : public DspObject, public TableReceiverInterface {
+
+  public:
+    static MessageObject *newObject(PdMessage *initMessage, PdGraph *graph);
+    DspTableOsc4(PdMessage *initMessage, PdGraph *graph);
+    ~DspTableOsc4();
+
+    static const char *getObjectLabel();
+    std::string toString();
+    ObjectType getObjectType();
+
+    char *getName();
+    void setTable(MessageTable *table);
+
+  private:
+    void processMessage(int inletIndex, PdMessage *message);
+    void processDspWithIndex(int fromIndex, int toIndex);
+
+    float frequency; // used while no signal is connected to the left inlet
+    // The phase is a 32-bit fixed point fraction of a period, which wraps around by itself.
+    uint32_t phase;
+    float phaseIncrementPerHz; // the phase increment of one sample at 1 Hz
+    char *name;
+    MessageTable *table;
+    WavetableCache *wavetableCache;
+    WavetableCacheEntry *cacheEntry;
+    float *positions; // the fractional index into the period of each sample
+};
+
+inline std::string DspTableOsc4::toString() {
+  return (name != NULL) ? std::string(getObjectLabel()) + " " + name : getObjectLabel();
+}
+
+inline const char *DspTableOsc4::getObjectLabel() {
+  return "tabosc4~";
+}
+
+inline ObjectType DspTableOsc4::getObjectType() {
+  return DSP_TABLE_OSC4;
+}
+
+inline char *DspTableOsc4::getName() {
+  return name;
+}
+
+#endif // _DSP_TABLE_OSC4_H_
@@ -106,8 +106,10 @@ void DspTablePlay::playTable(int startIndex, int duration, double startTime) {
 
 void DspTablePlay::processDspWithIndex(int fromIndex, int toIndex) {
   if (table != NULL) {
-    int bufferLength = 0;
-    float *tableBuffer = table->getBuffer(&bufferLength);
+    // take one snapshot of the table for the whole block
+    TableBuffer *snapshot = table->getTableBuffer();
+    int bufferLength = snapshot->getLength();
+    float *tableBuffer = snapshot->getBuffer();
     if (bufferLength < endTableIndex) {
       // in case the table length has been reset while tabplay~ is playing the buffer
       endTableIndex = bufferLength;
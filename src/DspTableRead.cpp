@@ -67,8 +67,10 @@ void DspTableRead::processMessage(int inletIndex, PdMessage *message) {
 
 void DspTableRead::processDspWithIndex(int fromIndex, int toIndex) {
   if (table != NULL) { // ensure that there is a table to read from!
-    int bufferLength = 0;
-    float *buffer = table->getBuffer(&bufferLength);
+    // take one snapshot of the table for the whole block
+    TableBuffer *tableBuffer = table->getTableBuffer();
+    int bufferLength = tableBuffer->getLength();
+    float *buffer = tableBuffer->getBuffer();
     #if __APPLE__
     int duration = toIndex - fromIndex;
     float *outBuff = dspBufferAtOutlet[0]+fromIndex;
@@ -28,7 +28,7 @@
 
 /**
  * [tabread4~ name]
- * This is a linear-interpolating table reader.
+ * A table reader with 4-point interpolation, as in Pd.
  */
 class DspTableRead4 : public DspObject, public TableReceiverInterface {
   
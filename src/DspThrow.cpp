@@ -20,6 +20,7 @@
  *
  */
 
+#include "ArrayArithmetic.h"
 #include "DspThrow.h"
 #include "PdContext.h"
 #include "PdGraph.h"
@@ -45,6 +46,11 @@ DspThrow::~DspThrow() {
   free(name);
 }
 
+bool DspThrow::isAtRest() {
+  // [catch~] keeps reading the buffer while this object is not processed
+  return isDspInletKnownSilent(0) && ArrayArithmetic::isSilent(buffer, 0, blockSizeInt);
+}
+
 void DspThrow::processMessage(int inletIndex, PdMessage *message) {
   if (inletIndex == 0 && message->isSymbol(0, "set") && message->isSymbol(1)) {
     graph->printErr("throw~ does not support the \"set\" message.");
@@ -43,6 +43,7 @@ class DspThrow : public DspObject {
     const char *getName() { return name; }
     static const char *getObjectLabel() { return "throw~"; }
     string toString() { return string(getObjectLabel()) + " " + string(name); }
+    bool isAtRest();
     ObjectType getObjectType() { return DSP_THROW; }
 
     void processMessage(int inletIndex, PdMessage *message);
@@ -20,73 +20,151 @@
  *
  */
 
-#include "ArrayArithmetic.h"
+#include <math.h>
+#if __SSE2__
+#include <emmintrin.h>
+#elif __ARM_NEON__
+#include <arm_neon.h>
+#endif
+#include "CosineEngine.h"
 #include "DspVCF.h"
+#include "PdContext.h"
 #include "PdGraph.h"
 
+// state smaller than this is flushed to zero, as it is inaudible and may be denormal
+#define STATE_THRESHOLD 1e-20f
+
 MessageObject *DspVCF::newObject(PdMessage *initMessage, PdGraph *graph) {
   return new DspVCF(initMessage, graph);
 }
 
-DspVCF::DspVCF(PdMessage *initMessage, PdGraph *graph) : DspObject(3, 3, 0, 2, graph) {
-  sampleRate = graph->getSampleRate();
-  calculateFilterCoefficients(this->sampleRate/2.0f, 1.0f); // initialise the filter completely open
-  tap_0 = tap_1 = 0.0f;
+DspVCF::DspVCF(PdMessage *initMessage, PdGraph *graph) : DspObject(3, 2, 0, 2, graph) {
+  sampleDuration = 1.0f / graph->getSampleRate();
+  q = initMessage->isFloat(0) ? initMessage->getFloat(0) : 0.0f;
+  real = imaginary = 0.0f;
+
+  processFunction = &processSignal;
+  processFunctionNoMessage = &processSignal;
 }
 
 DspVCF::~DspVCF() {
   // nothing to do
 }
 
-const char *DspVCF::getObjectLabel() {
-  return "vcf~";
+string DspVCF::toString() {
+  char str[snprintf(NULL, 0, "%s %g", getObjectLabel(), q)+1];
+  snprintf(str, sizeof(str), "%s %g", getObjectLabel(), q);
+  return string(str);
 }
 
-void DspVCF::calculateFilterCoefficients(float f, float q) {
-  float r, oneminusr, omega;
-  if (f < 0.001f) f = 10.0f;
-  if (q < 0.0f) q = 0.0f;
-  this->centerFrequency = f;
-  this->q = q;
-  omega = f * (2.0f * M_PI) / sampleRate;
-  if (q < 0.001) oneminusr = 1.0f;
-  else oneminusr = omega/q;
-  if (oneminusr > 1.0f) oneminusr = 1.0f;
-  r = 1.0f - oneminusr;
-  coef1 = 2.0f * sigbp_qcos(omega) * r;
-  coef2 = - r * r;
-  gain = 2 * oneminusr * (oneminusr + r * omega);
+bool DspVCF::isAtRest() {
+  return real == 0.0f && imaginary == 0.0f && isDspInletKnownSilent(0);
 }
 
-float DspVCF::sigbp_qcos(float f) {
-  if (f >= -(0.5f * M_PI) && f <= (0.5f * M_PI)) {
-    float g = f*f;
-    return (((g*g*g * (-1.0f/720.0f) + g*g*(1.0f/24.0f)) - g*0.5) + 1);
-  } else {
-    return 0.0f;
-  }
+bool DspVCF::hasSilentOutput() {
+  // the filter is linear, whatever its centre frequency
+  return isAtRest() && isDspOutputSilent();
 }
 
 void DspVCF::processMessage(int inletIndex, PdMessage *message) {
-  // not sure what the other inlets do wrt messages
-  if (inletIndex == 2) {
-    if (message->isFloat(0)) {
-      q = message->getFloat(0); // update the resonance (q)
-    }
+  if (inletIndex == 2 && message->isFloat(0)) {
+    q = message->getFloat(0); // update the resonance (q)
   }
 }
 
-void DspVCF::processDspWithIndex(int fromIndex, int toIndex) {
+void DspVCF::processSignal(DspObject *dspObject, int fromIndex, int toIndex) {
+  DspVCF *d = reinterpret_cast<DspVCF *>(dspObject);
+  int n = toIndex - fromIndex;
+  float *input = d->dspBufferAtInlet[0] + fromIndex;
+  float *frequency = d->dspBufferAtInlet[1] + fromIndex;
+  float *bandpass = d->dspBufferAtOutlet[0] + fromIndex;
+  float *lowpass = d->dspBufferAtOutlet[1] + fromIndex;
+
   /*
-  for (int i = fromIndex; i < toIndex; i++) {
-    calculateFilterCoefficients(dspBufferAtInlet1[i], q);
-    dspBufferAtOutlet0[i] = dspBufferAtInlet0[i] + (coef1 * tap_0) + (coef2 * tap_1);
-    tap_1 = tap_0;
-    tap_0 = dspBufferAtOutlet0[i];
+   * The pole of each sample is r*e^(i*w), where w is the centre frequency in radians per sample
+   * and r = 1 - w/q. The radius, the real and imaginary parts of the pole, and the gain are
+   * computed for the whole block before the recursion, such that the inputs are free to be
+   * overwritten by the outputs.
+   */
+  float qInverse = (d->q > 0.0f) ? 1.0f / d->q : 0.0f;
+  float ampCorrection = 2.0f - 2.0f / (d->q + 2.0f);
+  float sampleDuration = d->sampleDuration;
+  float radiusScale = 2.0f * M_PI * qInverse; // the radius is 1 - w/q
+  float periods[n]; // the centre frequency of each sample, in periods per sample
+  float quarterPeriods[n]; // the same, less a quarter of a period
+  float radius[n];
+  float poleReal[n];
+  float poleImaginary[n];
+  int i = 0;
+  #if __SSE2__
+  for (; i <= n - 4; i += 4) {
+    // the frequency is clamped at zero (and NaN is made zero) before the radius is computed
+    __m128 p = _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(frequency + i), _mm_set1_ps(sampleDuration)),
+        _mm_setzero_ps());
+    __m128 r = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(p, _mm_set1_ps(radiusScale)));
+    r = (qInverse > 0.0f) ? _mm_max_ps(r, _mm_setzero_ps()) : _mm_setzero_ps();
+    _mm_storeu_ps(periods + i, p);
+    _mm_storeu_ps(quarterPeriods + i, _mm_sub_ps(p, _mm_set1_ps(0.25f)));
+    _mm_storeu_ps(radius + i, r);
+  }
+  #elif __ARM_NEON__
+  for (; i <= n - 4; i += 4) {
+    float32x4_t p = vmaxq_f32(vmulq_n_f32(vld1q_f32(frequency + i), sampleDuration), vdupq_n_f32(0.0f));
+    float32x4_t r = vmlsq_n_f32(vdupq_n_f32(1.0f), p, radiusScale);
+    r = (qInverse > 0.0f) ? vmaxq_f32(r, vdupq_n_f32(0.0f)) : vdupq_n_f32(0.0f);
+    vst1q_f32(periods + i, p);
+    vst1q_f32(quarterPeriods + i, vsubq_f32(p, vdupq_n_f32(0.25f)));
+    vst1q_f32(radius + i, r);
+  }
+  #endif
+  for (; i < n; i++) {
+    float p = frequency[i] * sampleDuration;
+    p = (p > 0.0f) ? p : 0.0f;
+    float r = (qInverse > 0.0f) ? 1.0f - p * radiusScale : 0.0f;
+    periods[i] = p;
+    quarterPeriods[i] = p - 0.25f;
+    radius[i] = (r > 0.0f) ? r : 0.0f;
+  }
+
+  // cos(w) and sin(w) = cos(w - pi/2)
+  CosineAccuracy accuracy = d->graph->getContext()->getCosineAccuracy();
+  CosineEngine::cosineOfPeriods(periods, poleReal, n, accuracy);
+  CosineEngine::cosineOfPeriods(quarterPeriods, poleImaginary, n, accuracy);
+
+  // the pole is r*e^(i*w), and the gain of the input is in place of the radius
+  i = 0;
+  #if __SSE2__
+  for (; i <= n - 4; i += 4) {
+    __m128 r = _mm_loadu_ps(radius + i);
+    _mm_storeu_ps(poleReal + i, _mm_mul_ps(_mm_loadu_ps(poleReal + i), r));
+    _mm_storeu_ps(poleImaginary + i, _mm_mul_ps(_mm_loadu_ps(poleImaginary + i), r));
+    _mm_storeu_ps(radius + i, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), r), _mm_set1_ps(ampCorrection)));
+  }
+  #elif __ARM_NEON__
+  for (; i <= n - 4; i += 4) {
+    float32x4_t r = vld1q_f32(radius + i);
+    vst1q_f32(poleReal + i, vmulq_f32(vld1q_f32(poleReal + i), r));
+    vst1q_f32(poleImaginary + i, vmulq_f32(vld1q_f32(poleImaginary + i), r));
+    vst1q_f32(radius + i, vmulq_n_f32(vsubq_f32(vdupq_n_f32(1.0f), r), ampCorrection));
+  }
+  #endif
+  for (; i < n; i++) {
+    poleReal[i] *= radius[i];
+    poleImaginary[i] *= radius[i];
+    radius[i] = ampCorrection * (1.0f - radius[i]);
+  }
+
+  // z = gain*x + pole*z, where z = real + i*imaginary
+  float re = d->real;
+  float im = d->imaginary;
+  for (i = 0; i < n; i++) {
+    float x = input[i];
+    float re2 = radius[i]*x + poleReal[i]*re - poleImaginary[i]*im;
+    im = poleImaginary[i]*re + poleReal[i]*im;
+    re = re2;
+    bandpass[i] = re;
+    lowpass[i] = im;
   }
-  // dspBufferAtOutlet0[i] *= gain;
-  ArrayArithmetic::multiply(dspBufferAtOutlet0, gain, dspBufferAtOutlet0, fromIndex, toIndex);
-  */
-  // NOTE(mhroth): This object is definitely not working properly. It outputs only zero.
-  ArrayArithmetic::fill(dspBufferAtOutlet[0], 0, fromIndex, toIndex);
+  d->real = (fabsf(re) >= STATE_THRESHOLD) ? re : 0.0f; // also catches NaN
+  d->imaginary = (fabsf(im) >= STATE_THRESHOLD) ? im : 0.0f;
 }
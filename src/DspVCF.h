@@ -25,7 +25,16 @@
 
 #include "DspObject.h"
 
-/** [vcf~], a voltage controlled bandpass filter */
+/**
+ * [vcf~], [vcf~ float]
+ * A voltage controlled bandpass filter, as in Pd. The left inlet is the input signal, the middle
+ * inlet is the centre frequency as a signal, and the right inlet is the q. The filter is a complex
+ * one-pole resonator whose real part is the bandpass output (left outlet) and whose imaginary part
+ * is a lowpass output (right outlet).
+ *
+ * The pole of each sample is computed for the whole block at once, with the cosines of the
+ * <code>CosineEngine</code>, such that the recursion itself is a short loop of multiplications.
+ */
 class DspVCF : public DspObject {
   
   public:
@@ -35,26 +44,21 @@ class DspVCF : public DspObject {
   
     static const char *getObjectLabel();
     std::string toString();
+    bool isAtRest();
+    bool hasSilentOutput();
     
   private:
+    static void processSignal(DspObject *dspObject, int fromIndex, int toIndex);
     void processMessage(int inletIndex, PdMessage *message);
-    void processDspWithIndex(int fromIndex, int toIndex);
   
-    void calculateFilterCoefficients(float f, float q);
-    float sigbp_qcos(float f); // not entirely sure what this is doing. From Pd.
-    
-    float sampleRate;
-    float centerFrequency;
+    float sampleDuration; // in seconds
     float q;
-    float coef1;
-    float coef2;
-    float gain;
-    float tap_0;
-    float tap_1;
+    float real; // the state of the resonator
+    float imaginary;
 };
 
-inline std::string DspVCF::toString() {
-  return DspVCF::getObjectLabel();
+inline const char *DspVCF::getObjectLabel() {
+  return "vcf~";
 }
 
 #endif // _DSP_VCF_H_
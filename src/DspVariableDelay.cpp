@@ -47,55 +47,29 @@ void DspVariableDelay::processDspWithIndex(int fromIndex, int toIndex) {
   int headIndex;
   int bufferLength;
   float *buffer = delayline->getBuffer(&headIndex, &bufferLength);
-  float bufferLengthFloat = (float) bufferLength;
   
-  float targetIndexBase = (float) (headIndex - blockSizeInt);
-  #if __APPLE__
-  float xArray[blockSizeInt];
-  float targetIndexBaseArray[blockSizeInt];
+  // As in Pd, the delay is at least one sample, such that the points after the interpolated one
+  // have already been written. It is less than the longest delay of the delay line, such that the
+  // points before it have not yet been overwritten.
+  float minDelay = 1.0f;
+  float maxDelay = (float) (delayline->getMaxDelay() - 1);
+  if (maxDelay < minDelay) maxDelay = minDelay;
   
-  // calculate delay in samples (vector version of StaticUtils::millisecondsToSamples)
+  // the index of each output sample in the delay buffer, less its delay
+  float *inputBuffer = dspBufferAtInlet[0];
+  float targetIndex[blockSizeInt];
+  float targetIndexBase = (float) (headIndex - blockSizeInt);
   float samplesPerMillisecond = sampleRate / 1000.0f;
-  vDSP_vsmul(dspBufferAtInlet[0], 1, &samplesPerMillisecond, xArray, 1, blockSizeInt);
-  
-  float zero = 0.0f;
-  float one = 1.0f;
-  vDSP_vclip(xArray, 1, &zero, &bufferLengthFloat, xArray, 1, blockSizeInt); // clip the delay between 0 and the buffer length
-  vDSP_vramp(&targetIndexBase, &one, targetIndexBaseArray, 1, blockSizeInt);  // create targetIndexBaseArray
-  vDSP_vsub(xArray, 1, targetIndexBaseArray, 1, xArray, 1, blockSizeInt); // targetIndexBaseArray - xArray (== targetSampleIndex)
-  
-  // ensure that targetSampleIndex is positive
-  // TODO(mhroth): vectorise this!
   for (int i = 0; i < blockSizeInt; i++) {
-    if (xArray[i] < 0.0f) {
-      xArray[i] += bufferLengthFloat;
+    float delayInSamples = inputBuffer[i] * samplesPerMillisecond;
+    if (delayInSamples < minDelay) {
+      delayInSamples = minDelay;
+    } else if (delayInSamples > maxDelay) {
+      delayInSamples = maxDelay;
     }
+    targetIndex[i] = (targetIndexBase + (float) i) - delayInSamples;
   }
   
-  // do table lookup (in buffer) using xArray as indicies, with linear interpolation 
-  vDSP_vlint(buffer, xArray, 1, dspBufferAtOutlet[0], 1, blockSizeInt, bufferLength);
-  #else
-  float *inputbuffer = dspBufferAtInlet[0];
-  for (int i = 0; i < blockSizeInt; i++, targetIndexBase+=1.0f) {
-    float delayInSamples = StaticUtils::millisecondsToSamples(inputbuffer[i], sampleRate);
-    if (delayInSamples < 0.0f) {
-      delayInSamples = 0.0f;
-    } else if (delayInSamples > bufferLengthFloat) {
-      delayInSamples = bufferLengthFloat;
-    }
-    
-    float targetSampleIndex = targetIndexBase - delayInSamples;
-    if (targetSampleIndex < 0.0f) {
-      targetSampleIndex += bufferLengthFloat;
-    }
-    
-    // 2-point linear interpolation (basic and fast)
-    int x0 = (int) targetSampleIndex;
-    float dx = targetSampleIndex - ((float) x0);
-    float y0 = buffer[x0];
-    float y1 = buffer[x0+1];
-    float slope = (y1 - y0); // /(x1 - x0) == 1.0f!
-    dspBufferAtOutlet[0][i] = (slope * dx) + y0;
-  }
-  #endif
+  // the kernel wraps negative indices around the end of the buffer
+  ArrayArithmetic::interpolate4Wrap(buffer, bufferLength, targetIndex, dspBufferAtOutlet[0], 0, blockSizeInt);
 }
@@ -43,6 +43,11 @@ DspVariableLine::~DspVariableLine() {
   // to delete pending messages here
 }
 
+bool DspVariableLine::isAtRest() {
+  // delayed segments are scheduled by the object itself, and do not wake its graph
+  return messageList.empty() && numSamplesToTarget <= 0.0f;
+}
+
 void DspVariableLine::processMessage(int inletIndex, PdMessage *message) {
   switch (inletIndex) {
     case 0: { 
@@ -35,6 +35,7 @@ class DspVariableLine : public DspObject {
     
     static const char *getObjectLabel();
     std::string toString();
+    bool isAtRest();
   
     // this implementation assumes that all messages arrive only on the left-most inlet
     bool shouldDistributeMessageToInlets();
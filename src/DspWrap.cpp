@@ -21,6 +21,7 @@
  */
 
 #include "ArrayArithmetic.h"
+#include "DspFusedChain.h"
 #include "DspWrap.h"
 
 MessageObject *DspWrap::newObject(PdMessage *initMessage, PdGraph *graph) {
@@ -35,6 +36,13 @@ DspWrap::~DspWrap() {
   // nothing to do
 }
 
+bool DspWrap::getElementwiseOperation(ElementwiseOperation *operation) {
+  operation->opcode = ElementwiseOperation::WRAP;
+  operation->signal = NULL;
+  operation->constant0 = operation->constant1 = NULL;
+  return true;
+}
+
 void DspWrap::processSignal(DspObject *dspObject, int fromIndex, int n4) {
   DspWrap *d = reinterpret_cast<DspWrap *>(dspObject);
   // as no messages are received and there is only one inlet, processDsp does not need much of the
@@ -0,0 +1,266 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "DspWriteSoundfile.h"
+#include "PdContext.h"
+#include "PdGraph.h"
+
+// the default buffer size in bytes per channel, as in Pd
+#define DEFAULT_BUFFER_SIZE 262144
+#define MAX_NUM_CHANNELS 64
+// the buffer must hold at least this many blocks
+#define MIN_NUM_BLOCKS 16
+// frames are written to the file in batches of this size
+#define NUM_FRAMES_PER_WRITE 4096
+
+MessageObject *DspWriteSoundfile::newObject(PdMessage *initMessage, PdGraph *graph) {
+  return new DspWriteSoundfile(initMessage, graph);
+}
+
+/** Returns the number of channels given as the first argument, clamped to [1, MAX_NUM_CHANNELS]. */
+static int getNumChannels(PdMessage *initMessage) {
+  if (!initMessage->isFloat(0) || initMessage->getFloat(0) < 1.0f) return 1;
+  else if (initMessage->getFloat(0) > MAX_NUM_CHANNELS) return MAX_NUM_CHANNELS;
+  else return (int) initMessage->getFloat(0);
+}
+
+DspWriteSoundfile::DspWriteSoundfile(PdMessage *initMessage, PdGraph *graph) :
+    DspObject(1, getNumChannels(initMessage), 0, 0, graph) {
+  numChannels = getNumDspInlets();
+  bufferSize = initMessage->isFloat(1) ? (int) initMessage->getFloat(1) : DEFAULT_BUFFER_SIZE;
+  unsigned int minCapacity = (bufferSize / sizeof(float)) * numChannels;
+  if (minCapacity < (MIN_NUM_BLOCKS * blockSizeInt + NUM_FRAMES_PER_WRITE) * numChannels) {
+    minCapacity = (MIN_NUM_BLOCKS * blockSizeInt + NUM_FRAMES_PER_WRITE) * numChannels;
+  }
+  ringBuffer = new RingBuffer(minCapacity);
+  interleavedBuffer = (float *) calloc(blockSizeInt * numChannels, sizeof(float));
+
+  isRecording = false;
+  openPath[0] = '\0';
+  numOverflows = 0;
+  numDroppedFrames = 0;
+  numOpenFailuresReported = 0;
+
+  sndFile = NULL;
+  fileBuffer = (float *) calloc(NUM_FRAMES_PER_WRITE * numChannels, sizeof(float));
+
+  isFileOpen = false;
+  numOpenFailures = 0;
+
+  diskStreamService = graph->getContext()->getDiskStreamService();
+}
+
+DspWriteSoundfile::~DspWriteSoundfile() {
+  // a graph which is deleted while still attached does not unregister its objects. Ensure that the
+  // disk thread has let go of this stream before it is taken apart.
+  diskStreamService->unregisterStream(this);
+  // whatever has been recorded so far is kept
+  drainRingBuffer(true);
+  closeFile();
+  delete ringBuffer;
+  free(interleavedBuffer);
+  free(fileBuffer);
+}
+
+string DspWriteSoundfile::toString() {
+  char str[snprintf(NULL, 0, "%s %i %i", getObjectLabel(), numChannels, bufferSize)+1];
+  snprintf(str, sizeof(str), "%s %i %i", getObjectLabel(), numChannels, bufferSize);
+  return string(str);
+}
+
+
+#pragma mark - Audio Thread
+
+void DspWriteSoundfile::processMessage(int inletIndex, PdMessage *message) {
+  if (message->isSymbol(0, "open")) {
+    open(message);
+  } else if (message->isSymbol(0, "start")) {
+    if (!isFileOpen && !hasPendingCommands()) {
+      graph->printErr("%s: start requested with no prior open.", getObjectLabel());
+    }
+    isRecording = true;
+  } else if (message->isSymbol(0, "stop")) {
+    stop();
+  } else if (message->isSymbol(0, "print")) {
+    graph->printStd("%s: %s, %i channels, %u/%u samples buffered, %u overflows, %u frames dropped",
+        getObjectLabel(), isRecording ? "recording" : "stopped", numChannels,
+        ringBuffer->getNumAvailable(), ringBuffer->getCapacity(), numOverflows, numDroppedFrames);
+  } else if (message->isSymbol(0)) {
+    graph->printErr("%s: unknown message %s.", getObjectLabel(), message->getSymbol(0));
+  }
+}
+
+void DspWriteSoundfile::open(PdMessage *message) {
+  // open [flags] filename, where the flags are any of -bytes <2, 3, or 4>, -rate <sample rate>,
+  // -wave, or -aiff. The file type is otherwise determined by the extension of the filename.
+  int numBytes = 2;
+  float sampleRate = graph->getSampleRate();
+  int fileType = 0;
+  int i = 1;
+  while (message->isSymbol(i) && message->getSymbol(i)[0] == '-') {
+    if (message->isSymbol(i, "-bytes") && message->isFloat(i+1)) {
+      numBytes = (int) message->getFloat(i+1);
+      i += 2;
+    } else if (message->isSymbol(i, "-rate") && message->isFloat(i+1)) {
+      sampleRate = message->getFloat(i+1);
+      i += 2;
+    } else if (message->isSymbol(i, "-wave")) {
+      fileType = SF_FORMAT_WAV;
+      i++;
+    } else if (message->isSymbol(i, "-aiff")) {
+      fileType = SF_FORMAT_AIFF;
+      i++;
+    } else {
+      graph->printErr("%s: unknown flag %s to open.", getObjectLabel(), message->getSymbol(i));
+      return;
+    }
+  }
+  if (!message->isSymbol(i)) {
+    graph->printErr("%s: open requires a filename.", getObjectLabel());
+    return;
+  }
+  const char *path = message->getSymbol(i);
+  if (fileType == 0) {
+    const char *extension = strrchr(path, '.');
+    fileType = (extension != NULL && (!strcmp(extension, ".aif") || !strcmp(extension, ".aiff")))
+        ? SF_FORMAT_AIFF : SF_FORMAT_WAV;
+  }
+  int encoding = 0;
+  switch (numBytes) {
+    case 2: encoding = SF_FORMAT_PCM_16; break;
+    case 3: encoding = SF_FORMAT_PCM_24; break;
+    case 4: encoding = SF_FORMAT_FLOAT; break;
+    default: {
+      graph->printErr("%s: -bytes must be 2, 3, or 4.", getObjectLabel());
+      return;
+    }
+  }
+
+  DiskStreamCommand *command = getNextCommand();
+  if (command == NULL) {
+    graph->printErr("%s: too many pending requests. Ignoring open %s.", getObjectLabel(), path);
+    return;
+  }
+  isRecording = false;
+  command->type = DISK_STREAM_OPEN;
+  strncpy(command->path, path, DISK_STREAM_PATH_LENGTH-1);
+  command->path[DISK_STREAM_PATH_LENGTH-1] = '\0';
+  command->format = fileType | encoding;
+  command->sampleRate = sampleRate;
+  postCommand();
+  strcpy(openPath, command->path);
+  diskStreamService->signal();
+}
+
+void DspWriteSoundfile::stop() {
+  isRecording = false;
+  DiskStreamCommand *command = getNextCommand();
+  if (command != NULL) {
+    command->type = DISK_STREAM_CLOSE;
+    postCommand();
+    diskStreamService->signal();
+  }
+}
+
+void DspWriteSoundfile::processDspWithIndex(int fromIndex, int toIndex) {
+  if (numOpenFailures != numOpenFailuresReported) {
+    numOpenFailuresReported = numOpenFailures;
+    graph->printErr("%s: file '%s' cannot be opened for writing.", getObjectLabel(), openPath);
+  }
+
+  // the ring buffer belongs to the disk thread until all commands have been executed
+  if (isRecording && isFileOpen && !hasPendingCommands()) {
+    int numFrames = toIndex - fromIndex;
+    for (int j = 0; j < numChannels; j++) {
+      float *input = getDspBufferAtInlet(j) + fromIndex;
+      for (int i = 0, k = j; i < numFrames; i++, k += numChannels) {
+        interleavedBuffer[k] = input[i];
+      }
+    }
+    // only whole frames are written, such that the disk thread always reads whole frames
+    unsigned int numFramesFree = ringBuffer->getNumFree() / numChannels;
+    if (numFramesFree < numFrames) {
+      numOverflows++;
+      numDroppedFrames += numFrames - numFramesFree;
+      numFrames = numFramesFree;
+    }
+    ringBuffer->write(interleavedBuffer, numFrames * numChannels);
+    if (ringBuffer->getNumAvailable() >= NUM_FRAMES_PER_WRITE * numChannels) {
+      diskStreamService->signal();
+    }
+  }
+}
+
+
+#pragma mark - Disk Thread
+
+void DspWriteSoundfile::executeCommand(DiskStreamCommand *command) {
+  // everything recorded into the previous file is written before it is closed
+  drainRingBuffer(true);
+  closeFile();
+  ringBuffer->reset();
+
+  switch (command->type) {
+    case DISK_STREAM_OPEN: {
+      SF_INFO sfInfo;
+      memset(&sfInfo, 0, sizeof(SF_INFO));
+      sfInfo.samplerate = (int) command->sampleRate;
+      sfInfo.channels = numChannels;
+      sfInfo.format = command->format;
+      char *fullPath = graph->resolveNewFilePath(command->path);
+      sndFile = sf_open(fullPath, SFM_WRITE, &sfInfo);
+      free(fullPath);
+      if (sndFile == NULL) {
+        numOpenFailures++;
+      } else {
+        isFileOpen = true;
+      }
+      break;
+    }
+    case DISK_STREAM_CLOSE:
+    default: {
+      break; // the file has already been closed
+    }
+  }
+}
+
+void DspWriteSoundfile::transfer() {
+  drainRingBuffer(false);
+}
+
+void DspWriteSoundfile::drainRingBuffer(bool flush) {
+  if (sndFile == NULL) return;
+  unsigned int numFloatsPerWrite = NUM_FRAMES_PER_WRITE * numChannels;
+  while (ringBuffer->getNumAvailable() >= numFloatsPerWrite ||
+      (flush && ringBuffer->getNumAvailable() > 0)) {
+    unsigned int numFloats = ringBuffer->read(fileBuffer, numFloatsPerWrite);
+    sf_writef_float(sndFile, fileBuffer, numFloats / numChannels);
+  }
+}
+
+void DspWriteSoundfile::closeFile() {
+  isFileOpen = false;
+  if (sndFile != NULL) {
+    sf_close(sndFile);
+    sndFile = NULL;
+  }
+}
@@ -0,0 +1,96 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _DSP_WRITE_SOUNDFILE_H_
+#define _DSP_WRITE_SOUNDFILE_H_
+
+#include <sndfile.h>
+#include "DiskStreamService.h"
+#include "DspObject.h"
+#include "RingBuffer.h"
+
+/**
+ * [writesf~], [writesf~ float], [writesf~ float float]
+ * Records its inputs to a soundfile. Each block is copied into a ring buffer, which the context's
+ * <code>DiskStreamService</code> writes to disk in batches. If the disk thread cannot keep up then
+ * frames are dropped and counted, but the audio thread never waits.
+ */
+class DspWriteSoundfile : public DspObject, public DiskStream {
+
+  public:
+    static MessageObject *newObject(PdMessage *initMessage, PdGraph *graph);
+    DspWriteSoundfile(PdMessage *initMessage, PdGraph *graph);
+    ~DspWriteSoundfile();
+
+    static const char *getObjectLabel();
+    std::string toString();
+    ObjectType getObjectType();
+
+  protected:
+    void executeCommand(DiskStreamCommand *command);
+    void transfer();
+
+  private:
+    void processMessage(int inletIndex, PdMessage *message);
+    void processDspWithIndex(int fromIndex, int toIndex);
+
+    void open(PdMessage *message);
+    void stop();
+
+    /**
+     * Writes the contents of the ring buffer to the open file. Unless <code>flush</code> is true,
+     * only whole batches are written.
+     */
+    void drainRingBuffer(bool flush);
+    void closeFile();
+
+    int numChannels;
+    int bufferSize; // in bytes per channel
+    DiskStreamService *diskStreamService;
+    RingBuffer *ringBuffer; // interleaved frames, read by the disk thread
+
+    // audio thread state
+    bool isRecording;
+    char openPath[DISK_STREAM_PATH_LENGTH]; // the most recently requested file, for error reporting
+    float *interleavedBuffer; // one block of interleaved frames
+    unsigned int numOverflows; // the number of blocks which could not be completely buffered
+    unsigned int numDroppedFrames;
+    unsigned int numOpenFailuresReported;
+
+    // disk thread state
+    SNDFILE *sndFile;
+    float *fileBuffer; // one batch of interleaved frames
+
+    // written by the disk thread, read by the audio thread
+    volatile bool isFileOpen;
+    volatile unsigned int numOpenFailures;
+};
+
+inline const char *DspWriteSoundfile::getObjectLabel() {
+  return "writesf~";
+}
+
+inline ObjectType DspWriteSoundfile::getObjectType() {
+  return DSP_WRITE_SOUNDFILE;
+}
+
+#endif // _DSP_WRITE_SOUNDFILE_H_
@@ -0,0 +1,951 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if __SSE__
+#include <xmmintrin.h>
+#elif __ARM_NEON__
+#include <arm_neon.h>
+#endif
+#include "BufferPool.h"
+#include "DspObject.h"
+#include "ExpressionProgram.h"
+
+/** A node of the syntax tree of an expression, which only exists while the program is compiled. */
+struct ExpressionProgram::Node {
+  enum {CONSTANT, VARIABLE, OPERATION} type;
+  bool isInt; // as in Pd, operations on integers are integer operations, e.g. 1/2 == 0
+  float value; // of a constant
+  char kind; // of a variable, i.e. 'v', 'f', 'i', 'x', or 'y'
+  int index; // of a variable, from zero
+  int delay; // of a variable, in samples
+  Opcode opcode;
+  int numArgs;
+  Node *args[3];
+
+  Node() {
+    type = CONSTANT;
+    isInt = false;
+    value = 0.0f;
+    kind = '\0';
+    index = 0;
+    delay = 0;
+    opcode = COPY;
+    numArgs = 0;
+    args[0] = args[1] = args[2] = NULL;
+  }
+
+  ~Node() {
+    for (int i = 0; i < numArgs; i++) {
+      delete args[i];
+    }
+  }
+};
+
+#pragma mark - Parser
+
+/**
+ * A recursive descent parser for the syntax of Pd's expr. The precedence of operators is that of C,
+ * from || (lowest) to the unary operators.
+ */
+class ExpressionProgram::Parser {
+
+  public:
+    Parser(ExpressionProgram *program, const char *text) {
+      this->program = program;
+      pos = text;
+    }
+
+    /** Parses all expressions, and returns false if there is an error. */
+    bool parse(vector<Node *> *roots) {
+      do {
+        Node *node = parseBinary(0);
+        if (node == NULL) return false;
+        roots->push_back(node);
+      } while (accept(";"));
+      skipSpace();
+      if (*pos != '\0') {
+        fail("unexpected '%c'", *pos);
+        return false;
+      }
+      return true;
+    }
+
+  private:
+    void skipSpace() {
+      while (isspace(*pos)) pos++;
+    }
+
+    void fail(const char *format, ...) {
+      if (program->error[0] != '\0') return; // the first error is reported
+      va_list ap;
+      va_start(ap, format);
+      vsnprintf(program->error, sizeof(program->error), format, ap);
+      va_end(ap);
+      if (program->error[0] == '\0') strcpy(program->error, "error");
+    }
+
+    /** Returns the operator or punctuation at the current position, without consuming it. */
+    const char *peekOperator() {
+      static const char *OPERATORS[] = {
+        "||", "&&", "==", "!=", "<=", ">=", "<<", ">>",
+        "|", "^", "&", "<", ">", "+", "-", "*", "/", "%", "!", "~", "(", ")", "[", "]", ",", ";",
+        NULL
+      };
+      skipSpace();
+      for (int i = 0; OPERATORS[i] != NULL; i++) {
+        if (!strncmp(pos, OPERATORS[i], strlen(OPERATORS[i]))) return OPERATORS[i];
+      }
+      return NULL;
+    }
+
+    /** Consumes the given operator if it is next. */
+    bool accept(const char *op) {
+      const char *next = peekOperator();
+      if (next != NULL && !strcmp(next, op)) {
+        pos += strlen(op);
+        return true;
+      }
+      return false;
+    }
+
+    bool expect(const char *op) {
+      if (accept(op)) return true;
+      skipSpace();
+      if (*pos == '\0') fail("missing '%s'", op);
+      else fail("expected '%s' at '%c'", op, *pos);
+      return false;
+    }
+
+    /** Returns a new node for the given operation, which is folded if its arguments are constant. */
+    Node *newOperation(Opcode opcode, int numArgs, Node *a, Node *b, Node *c) {
+      Node *node = new Node();
+      node->type = Node::OPERATION;
+      node->opcode = opcode;
+      node->numArgs = numArgs;
+      node->args[0] = a;
+      node->args[1] = b;
+      node->args[2] = c;
+
+      // Pd's expr computes operations on integers as integers
+      bool isInt0 = (numArgs > 0) && a->isInt;
+      bool isInt1 = (numArgs > 1) && b->isInt;
+      bool isInt2 = (numArgs > 2) && c->isInt;
+      switch (opcode) {
+        case NEGATE: case ABS: node->isInt = isInt0; break;
+        case ADD: case SUBTRACT: case MULTIPLY: case MIN: case MAX: node->isInt = isInt0 && isInt1; break;
+        case DIVIDE: {
+          if (isInt0 && isInt1) {
+            node->opcode = DIVIDE_INT;
+            node->isInt = true;
+          }
+          break;
+        }
+        case IF: node->isInt = isInt1 && isInt2; break;
+        case NOT: case BITWISE_NOT: case MODULO: case INT:
+        case BITWISE_AND: case BITWISE_OR: case BITWISE_XOR: case SHIFT_LEFT: case SHIFT_RIGHT:
+        case EQUAL: case NOT_EQUAL: case LESS: case GREATER: case LESS_EQUAL: case GREATER_EQUAL:
+        case AND: case OR: node->isInt = true; break;
+        default: node->isInt = false; break;
+      }
+
+      bool isConstant = true;
+      for (int i = 0; i < numArgs; i++) {
+        if (node->args[i]->type != Node::CONSTANT) isConstant = false;
+      }
+      if (isConstant) {
+        float value = evaluate(node->opcode, a->value,
+            (numArgs > 1) ? b->value : 0.0f, (numArgs > 2) ? c->value : 0.0f);
+        for (int i = 0; i < numArgs; i++) {
+          delete node->args[i];
+        }
+        node->numArgs = 0;
+        node->type = Node::CONSTANT;
+        node->value = value;
+      } else if ((node->opcode == ADD || node->opcode == SUBTRACT) && (isProduct(a) || isProduct(b))) {
+        // a product which is added or subtracted is computed by the same instruction, in one pass
+        // over the block instead of two
+        bool isFirst = isProduct(a);
+        Node *product = isFirst ? a : b;
+        if (node->opcode == ADD) node->opcode = MULTIPLY_ADD;
+        else node->opcode = isFirst ? MULTIPLY_SUBTRACT : SUBTRACT_PRODUCT;
+        node->numArgs = 3;
+        node->args[0] = product->args[0];
+        node->args[1] = product->args[1];
+        node->args[2] = isFirst ? b : a;
+        product->numArgs = 0;
+        delete product;
+      }
+      return node;
+    }
+
+    static bool isProduct(Node *node) {
+      return node->type == Node::OPERATION && node->opcode == MULTIPLY;
+    }
+
+    /** The binary operators of the given level of precedence, or NULL beyond the highest level. */
+    static const char **getOperators(int level) {
+      static const char *LEVELS[][5] = {
+        {"||", NULL}, {"&&", NULL}, {"|", NULL}, {"^", NULL}, {"&", NULL}, {"==", "!=", NULL},
+        {"<", ">", "<=", ">=", NULL}, {"<<", ">>", NULL}, {"+", "-", NULL}, {"*", "/", "%", NULL}
+      };
+      return (level < (int) (sizeof(LEVELS) / sizeof(LEVELS[0]))) ? LEVELS[level] : NULL;
+    }
+
+    static Opcode getBinaryOpcode(const char *op) {
+      static const struct {
+        const char *op;
+        Opcode opcode;
+      } BINARY[] = {
+        {"||", OR}, {"&&", AND}, {"|", BITWISE_OR}, {"^", BITWISE_XOR}, {"&", BITWISE_AND},
+        {"==", EQUAL}, {"!=", NOT_EQUAL}, {"<", LESS}, {">", GREATER}, {"<=", LESS_EQUAL},
+        {">=", GREATER_EQUAL}, {"<<", SHIFT_LEFT}, {">>", SHIFT_RIGHT}, {"+", ADD}, {"-", SUBTRACT},
+        {"*", MULTIPLY}, {"/", DIVIDE}, {"%", MODULO}, {NULL, COPY}
+      };
+      for (int i = 0; BINARY[i].op != NULL; i++) {
+        if (!strcmp(BINARY[i].op, op)) return BINARY[i].opcode;
+      }
+      return COPY;
+    }
+
+    Node *parseBinary(int level) {
+      const char **operators = getOperators(level);
+      if (operators == NULL) return parseUnary();
+      Node *node = parseBinary(level+1);
+      while (node != NULL) {
+        const char *op = peekOperator();
+        int i = 0;
+        while (operators[i] != NULL && (op == NULL || strcmp(operators[i], op))) i++;
+        if (operators[i] == NULL) break; // the next operator is not of this level
+        pos += strlen(op);
+        Node *right = parseBinary(level+1);
+        if (right == NULL) {
+          delete node;
+          return NULL;
+        }
+        node = newOperation(getBinaryOpcode(op), 2, node, right, NULL);
+      }
+      return node;
+    }
+
+    Node *parseUnary() {
+      Opcode opcode;
+      if (accept("-")) opcode = NEGATE;
+      else if (accept("!")) opcode = NOT;
+      else if (accept("~")) opcode = BITWISE_NOT;
+      else if (accept("+")) return parseUnary();
+      else return parsePrimary();
+      Node *node = parseUnary();
+      return (node == NULL) ? NULL : newOperation(opcode, 1, node, NULL, NULL);
+    }
+
+    Node *parsePrimary() {
+      skipSpace();
+      if (accept("(")) {
+        Node *node = parseBinary(0);
+        if (node != NULL && !expect(")")) {
+          delete node;
+          return NULL;
+        }
+        return node;
+      } else if (isdigit(*pos) || (*pos == '.' && isdigit(pos[1]))) {
+        char *end = NULL;
+        Node *node = new Node();
+        node->value = (float) strtod(pos, &end);
+        node->isInt = true;
+        for (const char *c = pos; c < end; c++) {
+          if (*c == '.' || *c == 'e' || *c == 'E') node->isInt = false;
+        }
+        pos = end;
+        return node;
+      } else if (*pos == '$') {
+        return parseVariable();
+      } else if (isalpha(*pos) || *pos == '_') {
+        const char *name = pos;
+        while (isalnum(*pos) || *pos == '_') pos++;
+        return parseFunction(name, pos - name);
+      } else if (*pos == '\0') {
+        fail("unexpected end of expression");
+      } else {
+        fail("unexpected '%c'", *pos);
+      }
+      return NULL;
+    }
+
+    Node *parseVariable() {
+      char kind = pos[1];
+      if (strchr("vfixys", kind) == NULL || kind == '\0' || !isdigit(pos[2])) {
+        fail("unknown variable '$%c'", (kind == '\0') ? ' ' : kind);
+        return NULL;
+      }
+      char *end = NULL;
+      int number = (int) strtol(pos + 2, &end, 10);
+      pos = end;
+      if (number < 1) {
+        fail("$%c%i must be numbered from 1", kind, number);
+        return NULL;
+      }
+      if (kind == 's') {
+        fail("tables ($s%i) are not supported", number);
+        return NULL;
+      } else if ((kind == 'x' || kind == 'y') && !program->hasHistory) {
+        fail("$%c%i requires fexpr~", kind, number);
+        return NULL;
+      } else if (kind == 'v' && program->hasHistory) {
+        fail("$v%i is $x%i in fexpr~", number, number);
+        return NULL;
+      }
+
+      Node *node = new Node();
+      node->type = Node::VARIABLE;
+      node->kind = kind;
+      node->index = number - 1;
+      node->isInt = (kind == 'i');
+      node->delay = (kind == 'y') ? 1 : 0;
+      if (accept("[")) {
+        if (kind != 'x' && kind != 'y') {
+          fail("$%c%i cannot be indexed", kind, number);
+          delete node;
+          return NULL;
+        }
+        Node *index = parseBinary(0);
+        if (index == NULL || !expect("]")) {
+          delete index;
+          delete node;
+          return NULL;
+        }
+        int minDelay = (kind == 'y') ? 1 : 0;
+        bool isValid = (index->type == Node::CONSTANT) && (index->value == floorf(index->value)) &&
+            (-index->value >= minDelay) && (-index->value <= program->blockSize);
+        node->delay = (int) -index->value;
+        delete index;
+        if (!isValid) {
+          fail("the index of $%c%i must be a constant integer in [-%i, %i]", kind, number,
+              program->blockSize, -minDelay);
+          delete node;
+          return NULL;
+        }
+      }
+
+      // each inlet is either a signal inlet or a float inlet
+      if (kind != 'y') {
+        char inletKind = (kind == 'x') ? 'v' : kind;
+        while (program->inletKinds.size() <= node->index) program->inletKinds.push_back('\0');
+        char &existingKind = program->inletKinds[node->index];
+        if (existingKind != '\0' && (existingKind == 'v') != (inletKind == 'v')) {
+          fail("inlet %i is both a signal and a float", number);
+          delete node;
+          return NULL;
+        }
+        if (existingKind == '\0' || inletKind == 'f') existingKind = inletKind;
+      }
+      return node;
+    }
+
+    Node *parseFunction(const char *name, int length) {
+      static const struct {
+        const char *name;
+        Opcode opcode;
+        int numArgs;
+      } FUNCTIONS[] = {
+        {"if", IF, 3}, {"min", MIN, 2}, {"max", MAX, 2}, {"abs", ABS, 1}, {"fabs", ABS, 1},
+        {"int", INT, 1}, {"rint", RINT, 1}, {"float", COPY, 1}, {"floor", FLOOR, 1},
+        {"ceil", CEIL, 1}, {"sqrt", SQRT, 1}, {"exp", EXP, 1}, {"ln", LN, 1}, {"log", LN, 1},
+        {"log10", LOG10, 1}, {"pow", POW, 2}, {"fmod", FMOD, 2}, {"sin", SIN, 1},
+        {"cos", COS, 1}, {"tan", TAN, 1}, {"asin", ASIN, 1}, {"acos", ACOS, 1},
+        {"atan", ATAN, 1}, {"atan2", ATAN2, 2}, {"sinh", SINH, 1}, {"cosh", COSH, 1},
+        {"tanh", TANH, 1}, {NULL, COPY, 0}
+      };
+      int f = 0;
+      while (FUNCTIONS[f].name != NULL &&
+          (strlen(FUNCTIONS[f].name) != length || strncmp(FUNCTIONS[f].name, name, length))) f++;
+      if (FUNCTIONS[f].name == NULL) {
+        fail("unknown function '%.*s'", length, name);
+        return NULL;
+      }
+      if (!expect("(")) return NULL;
+      Node *args[3] = {NULL, NULL, NULL};
+      for (int i = 0; i < FUNCTIONS[f].numArgs; i++) {
+        if ((i > 0 && !expect(",")) || (args[i] = parseBinary(0)) == NULL) {
+          for (int j = 0; j < i; j++) delete args[j];
+          if (program->error[0] == '\0') fail("%s takes %i arguments", FUNCTIONS[f].name, FUNCTIONS[f].numArgs);
+          return NULL;
+        }
+      }
+      if (!expect(")")) {
+        for (int i = 0; i < FUNCTIONS[f].numArgs; i++) delete args[i];
+        return NULL;
+      }
+      if (FUNCTIONS[f].opcode == COPY) {
+        // float() only changes the type
+        args[0]->isInt = false;
+        return args[0];
+      }
+      return newOperation(FUNCTIONS[f].opcode, FUNCTIONS[f].numArgs, args[0], args[1], args[2]);
+    }
+
+    ExpressionProgram *program;
+    const char *pos;
+};
+
+
+#pragma mark - Operations
+
+/** Converts to an integer as Pd's expr does, with values beyond the range of an int made zero. */
+static inline int toInt(float f) {
+  return (f > -2147483648.0f && f < 2147483648.0f) ? (int) f : 0;
+}
+
+float ExpressionProgram::evaluate(Opcode opcode, float a, float b, float c) {
+  switch (opcode) {
+    case COPY: return a;
+    case NEGATE: return -a;
+    case NOT: return (a == 0.0f) ? 1.0f : 0.0f;
+    case BITWISE_NOT: return (float) ~toInt(a);
+    case ADD: return a + b;
+    case SUBTRACT: return a - b;
+    case MULTIPLY: return a * b;
+    case MULTIPLY_ADD: return a * b + c;
+    case MULTIPLY_SUBTRACT: return a * b - c;
+    case SUBTRACT_PRODUCT: return c - a * b;
+    case DIVIDE: return (b != 0.0f) ? a / b : 0.0f; // as in Pd, division by zero is zero
+    case DIVIDE_INT: {
+      long long d = toInt(b);
+      return (d != 0) ? (float) (toInt(a) / d) : 0.0f;
+    }
+    case MODULO: {
+      long long d = toInt(b);
+      return (d != 0) ? (float) (toInt(a) % d) : 0.0f;
+    }
+    case BITWISE_AND: return (float) (toInt(a) & toInt(b));
+    case BITWISE_OR: return (float) (toInt(a) | toInt(b));
+    case BITWISE_XOR: return (float) (toInt(a) ^ toInt(b));
+    case SHIFT_LEFT: return (float) (int) ((unsigned int) toInt(a) << (toInt(b) & 0x1F));
+    case SHIFT_RIGHT: return (float) (toInt(a) >> (toInt(b) & 0x1F));
+    case EQUAL: return (a == b) ? 1.0f : 0.0f;
+    case NOT_EQUAL: return (a != b) ? 1.0f : 0.0f;
+    case LESS: return (a < b) ? 1.0f : 0.0f;
+    case GREATER: return (a > b) ? 1.0f : 0.0f;
+    case LESS_EQUAL: return (a <= b) ? 1.0f : 0.0f;
+    case GREATER_EQUAL: return (a >= b) ? 1.0f : 0.0f;
+    case AND: return (a != 0.0f && b != 0.0f) ? 1.0f : 0.0f;
+    case OR: return (a != 0.0f || b != 0.0f) ? 1.0f : 0.0f;
+    case IF: return (a != 0.0f) ? b : c;
+    case MIN: return (a < b) ? a : b;
+    case MAX: return (a > b) ? a : b;
+    case ABS: return fabsf(a);
+    case INT: return truncf(a);
+    case RINT: return rintf(a);
+    case FLOOR: return floorf(a);
+    case CEIL: return ceilf(a);
+    case SQRT: return (a > 0.0f) ? sqrtf(a) : 0.0f; // as sqrt~
+    case EXP: return expf(a);
+    case LN: return logf(a);
+    case LOG10: return log10f(a);
+    case POW: return powf(a, b);
+    case FMOD: return (b != 0.0f) ? fmodf(a, b) : 0.0f;
+    case SIN: return sinf(a);
+    case COS: return cosf(a);
+    case TAN: return tanf(a);
+    case ASIN: return asinf(a);
+    case ACOS: return acosf(a);
+    case ATAN: return atanf(a);
+    case ATAN2: return atan2f(a, b);
+    case SINH: return sinhf(a);
+    case COSH: return coshf(a);
+    case TANH: return tanhf(a);
+    default: return 0.0f;
+  }
+}
+
+void ExpressionProgram::execute(Opcode opcode, float *a, float *b, float *c, float *output, int n) {
+  // The common operations are computed a vector at a time, exactly as evaluate() would. The rest,
+  // and the remainder of each vector, are computed by evaluate().
+  int i = 0;
+  #if __SSE__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  switch (opcode) {
+    case COPY: {
+      for (; i <= n-4; i += 4) _mm_storeu_ps(output+i, _mm_loadu_ps(a+i));
+      break;
+    }
+    case NEGATE: {
+      for (; i <= n-4; i += 4) _mm_storeu_ps(output+i, _mm_xor_ps(_mm_loadu_ps(a+i), _mm_set1_ps(-0.0f)));
+      break;
+    }
+    case ABS: {
+      for (; i <= n-4; i += 4) _mm_storeu_ps(output+i, _mm_andnot_ps(_mm_set1_ps(-0.0f), _mm_loadu_ps(a+i)));
+      break;
+    }
+    case ADD: {
+      for (; i <= n-4; i += 4) _mm_storeu_ps(output+i, _mm_add_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+      break;
+    }
+    case SUBTRACT: {
+      for (; i <= n-4; i += 4) _mm_storeu_ps(output+i, _mm_sub_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+      break;
+    }
+    case MULTIPLY: {
+      for (; i <= n-4; i += 4) _mm_storeu_ps(output+i, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+      break;
+    }
+    case MULTIPLY_ADD: {
+      for (; i <= n-4; i += 4) {
+        __m128 product = _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i));
+        _mm_storeu_ps(output+i, _mm_add_ps(product, _mm_loadu_ps(c+i)));
+      }
+      break;
+    }
+    case MULTIPLY_SUBTRACT: {
+      for (; i <= n-4; i += 4) {
+        __m128 product = _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i));
+        _mm_storeu_ps(output+i, _mm_sub_ps(product, _mm_loadu_ps(c+i)));
+      }
+      break;
+    }
+    case SUBTRACT_PRODUCT: {
+      for (; i <= n-4; i += 4) {
+        __m128 product = _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i));
+        _mm_storeu_ps(output+i, _mm_sub_ps(_mm_loadu_ps(c+i), product));
+      }
+      break;
+    }
+    case DIVIDE: {
+      for (; i <= n-4; i += 4) {
+        __m128 divisor = _mm_loadu_ps(b+i);
+        __m128 quotient = _mm_div_ps(_mm_loadu_ps(a+i), divisor);
+        _mm_storeu_ps(output+i, _mm_and_ps(quotient, _mm_cmpneq_ps(divisor, zero)));
+      }
+      break;
+    }
+    case MIN: {
+      for (; i <= n-4; i += 4) _mm_storeu_ps(output+i, _mm_min_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+      break;
+    }
+    case MAX: {
+      for (; i <= n-4; i += 4) _mm_storeu_ps(output+i, _mm_max_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+      break;
+    }
+    case SQRT: {
+      for (; i <= n-4; i += 4) _mm_storeu_ps(output+i, _mm_sqrt_ps(_mm_max_ps(_mm_loadu_ps(a+i), zero)));
+      break;
+    }
+    case NOT: {
+      for (; i <= n-4; i += 4) {
+        _mm_storeu_ps(output+i, _mm_and_ps(_mm_cmpeq_ps(_mm_loadu_ps(a+i), zero), one));
+      }
+      break;
+    }
+    case EQUAL: {
+      for (; i <= n-4; i += 4) {
+        _mm_storeu_ps(output+i, _mm_and_ps(_mm_cmpeq_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)), one));
+      }
+      break;
+    }
+    case NOT_EQUAL: {
+      for (; i <= n-4; i += 4) {
+        _mm_storeu_ps(output+i, _mm_and_ps(_mm_cmpneq_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)), one));
+      }
+      break;
+    }
+    case LESS: {
+      for (; i <= n-4; i += 4) {
+        _mm_storeu_ps(output+i, _mm_and_ps(_mm_cmplt_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)), one));
+      }
+      break;
+    }
+    case GREATER: {
+      for (; i <= n-4; i += 4) {
+        _mm_storeu_ps(output+i, _mm_and_ps(_mm_cmpgt_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)), one));
+      }
+      break;
+    }
+    case LESS_EQUAL: {
+      for (; i <= n-4; i += 4) {
+        _mm_storeu_ps(output+i, _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)), one));
+      }
+      break;
+    }
+    case GREATER_EQUAL: {
+      for (; i <= n-4; i += 4) {
+        _mm_storeu_ps(output+i, _mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)), one));
+      }
+      break;
+    }
+    case AND: {
+      for (; i <= n-4; i += 4) {
+        __m128 mask = _mm_and_ps(_mm_cmpneq_ps(_mm_loadu_ps(a+i), zero),
+            _mm_cmpneq_ps(_mm_loadu_ps(b+i), zero));
+        _mm_storeu_ps(output+i, _mm_and_ps(mask, one));
+      }
+      break;
+    }
+    case OR: {
+      for (; i <= n-4; i += 4) {
+        __m128 mask = _mm_or_ps(_mm_cmpneq_ps(_mm_loadu_ps(a+i), zero),
+            _mm_cmpneq_ps(_mm_loadu_ps(b+i), zero));
+        _mm_storeu_ps(output+i, _mm_and_ps(mask, one));
+      }
+      break;
+    }
+    case IF: {
+      for (; i <= n-4; i += 4) {
+        __m128 mask = _mm_cmpneq_ps(_mm_loadu_ps(a+i), zero);
+        _mm_storeu_ps(output+i, _mm_or_ps(_mm_and_ps(mask, _mm_loadu_ps(b+i)),
+            _mm_andnot_ps(mask, _mm_loadu_ps(c+i))));
+      }
+      break;
+    }
+    default: break;
+  }
+  #elif __ARM_NEON__
+  switch (opcode) {
+    case COPY: {
+      for (; i <= n-4; i += 4) vst1q_f32(output+i, vld1q_f32(a+i));
+      break;
+    }
+    case NEGATE: {
+      for (; i <= n-4; i += 4) vst1q_f32(output+i, vnegq_f32(vld1q_f32(a+i)));
+      break;
+    }
+    case ABS: {
+      for (; i <= n-4; i += 4) vst1q_f32(output+i, vabsq_f32(vld1q_f32(a+i)));
+      break;
+    }
+    case ADD: {
+      for (; i <= n-4; i += 4) vst1q_f32(output+i, vaddq_f32(vld1q_f32(a+i), vld1q_f32(b+i)));
+      break;
+    }
+    case SUBTRACT: {
+      for (; i <= n-4; i += 4) vst1q_f32(output+i, vsubq_f32(vld1q_f32(a+i), vld1q_f32(b+i)));
+      break;
+    }
+    case MULTIPLY: {
+      for (; i <= n-4; i += 4) vst1q_f32(output+i, vmulq_f32(vld1q_f32(a+i), vld1q_f32(b+i)));
+      break;
+    }
+    case MULTIPLY_ADD: {
+      for (; i <= n-4; i += 4) vst1q_f32(output+i, vmlaq_f32(vld1q_f32(c+i), vld1q_f32(a+i), vld1q_f32(b+i)));
+      break;
+    }
+    case MULTIPLY_SUBTRACT: {
+      for (; i <= n-4; i += 4) {
+        vst1q_f32(output+i, vsubq_f32(vmulq_f32(vld1q_f32(a+i), vld1q_f32(b+i)), vld1q_f32(c+i)));
+      }
+      break;
+    }
+    case SUBTRACT_PRODUCT: {
+      for (; i <= n-4; i += 4) vst1q_f32(output+i, vmlsq_f32(vld1q_f32(c+i), vld1q_f32(a+i), vld1q_f32(b+i)));
+      break;
+    }
+    default: break;
+  }
+  #endif
+  for (; i < n; i++) {
+    output[i] = evaluate(opcode, a[i], b[i], c[i]);
+  }
+}
+
+
+#pragma mark - Compiler
+
+ExpressionProgram::ExpressionProgram(const char *text, bool hasHistory, int blockSize,
+    BufferPool *bufferPool) {
+  this->hasHistory = hasHistory;
+  this->blockSize = blockSize;
+  error[0] = '\0';
+
+  vector<Node *> roots;
+  Parser parser(this, text);
+  if (parser.parse(&roots)) {
+    for (int i = 0; i < inletKinds.size(); i++) {
+      if (inletKinds[i] == '\0') inletKinds[i] = 'f'; // an unused inlet
+    }
+    if (inletKinds.empty()) inletKinds.push_back('v');
+
+    for (int i = 0; i < roots.size() && isValid(); i++) {
+      results.push_back(getRegister(REGISTER_RESULT, i, 0));
+    }
+    for (int i = 0; i < roots.size() && isValid(); i++) {
+      compileNode(roots[i], 0, results[i]);
+    }
+  }
+  for (int i = 0; i < roots.size(); i++) {
+    delete roots[i];
+  }
+  if (!isValid()) compileSilence();
+
+  // the registers which need not persist between blocks are kept in the scratch buffers
+  numScratchBuffers = 0;
+  int numInletRegisters = 0;
+  for (int i = 0; i < registers.size(); i++) {
+    Register &r = registers[i];
+    if (r.kind == REGISTER_TEMPORARY || (r.kind == REGISTER_RESULT && !hasHistory)) {
+      r.scratchIndex = numScratchBuffers++;
+    } else if (r.kind == REGISTER_INLET) {
+      numInletRegisters++;
+    }
+  }
+  if (numInletRegisters == 0) numInletRegisters = 1;
+  inletBuffers = ALLOC_ALIGNED_BUFFER(numInletRegisters * blockSize * sizeof(float));
+
+  // the expressions only depend on earlier runs of samples
+  runLength = blockSize;
+  for (int i = 0; i < registers.size(); i++) {
+    if (registers[i].kind == REGISTER_HISTORY && registers[i].delay < runLength) {
+      runLength = registers[i].delay;
+    }
+  }
+  if (hasHistory) {
+    for (int i = 0; i < inletKinds.size(); i++) {
+      inputHistory.push_back((inletKinds[i] == 'v') ? (float *) calloc(2*blockSize, sizeof(float)) : NULL);
+    }
+    for (int i = 0; i < results.size(); i++) {
+      outputHistory.push_back((float *) calloc(2*blockSize, sizeof(float)));
+    }
+  }
+
+  // the scratch registers are located when the scratch buffers are known
+  pointers = (float **) calloc(registers.size(), sizeof(float *));
+  boundScratch = NULL;
+  float *inletBuffer = inletBuffers;
+  for (int i = 0; i < registers.size(); i++) {
+    Register &r = registers[i];
+    switch (r.kind) {
+      case REGISTER_CONSTANT: pointers[i] = bufferPool->getConstantBuffer(r.value); break;
+      case REGISTER_INLET: {
+        pointers[i] = inletBuffer;
+        memset(inletBuffer, 0, blockSize*sizeof(float));
+        inletBuffer += blockSize;
+        break;
+      }
+      case REGISTER_SIGNAL: {
+        if (hasHistory) pointers[i] = inputHistory[r.index] + blockSize - r.delay;
+        break;
+      }
+      case REGISTER_HISTORY: pointers[i] = outputHistory[r.index] + blockSize - r.delay; break;
+      case REGISTER_RESULT: if (hasHistory) pointers[i] = outputHistory[r.index] + blockSize; break;
+      default: break;
+    }
+  }
+  boundInstructions = NULL;
+}
+
+ExpressionProgram::~ExpressionProgram() {
+  FREE_ALIGNED_BUFFER(inletBuffers);
+  for (int i = 0; i < inputHistory.size(); i++) {
+    free(inputHistory[i]);
+  }
+  for (int i = 0; i < outputHistory.size(); i++) {
+    free(outputHistory[i]);
+  }
+  free(pointers);
+  free(boundInstructions);
+}
+
+void ExpressionProgram::compileSilence() {
+  registers.clear();
+  temporaryRegisters.clear();
+  instructions.clear();
+  results.clear();
+  inletKinds.assign(1, 'v');
+
+  results.push_back(getRegister(REGISTER_RESULT, 0, 0));
+  Instruction instruction = {COPY, results[0], getConstantRegister(0.0f), 0, 0};
+  instruction.input1 = instruction.input2 = instruction.input0;
+  instructions.push_back(instruction);
+}
+
+int ExpressionProgram::getRegister(RegisterKind kind, int index, int delay) {
+  for (int i = 0; i < registers.size(); i++) {
+    if (registers[i].kind == kind && registers[i].index == index && registers[i].delay == delay) return i;
+  }
+  Register r = {kind, index, delay, 0.0f, -1};
+  registers.push_back(r);
+  return registers.size() - 1;
+}
+
+int ExpressionProgram::getConstantRegister(float value) {
+  for (int i = 0; i < registers.size(); i++) {
+    if (registers[i].kind == REGISTER_CONSTANT && registers[i].value == value) return i;
+  }
+  Register r = {REGISTER_CONSTANT, 0, 0, value, -1};
+  registers.push_back(r);
+  return registers.size() - 1;
+}
+
+int ExpressionProgram::compileNode(Node *node, int depth, int output) {
+  int input = 0;
+  switch (node->type) {
+    case Node::CONSTANT: {
+      input = getConstantRegister(node->value);
+      break;
+    }
+    case Node::VARIABLE: {
+      switch (node->kind) {
+        case 'y': {
+          if (node->index >= results.size()) {
+            snprintf(error, sizeof(error), "there is no expression %i for $y%i", node->index+1, node->index+1);
+          }
+          input = getRegister(REGISTER_HISTORY, node->index, node->delay);
+          break;
+        }
+        case 'v':
+        case 'x': input = getRegister(REGISTER_SIGNAL, node->index, node->delay); break;
+        default: input = getRegister(REGISTER_INLET, node->index, 0); break;
+      }
+      break;
+    }
+    case Node::OPERATION: {
+      int inputs[3] = {0, 0, 0};
+      for (int i = 0; i < node->numArgs; i++) {
+        // each argument is computed into its own temporary register, or is a register already
+        inputs[i] = compileNode(node->args[i], depth + i, -1);
+      }
+      for (int i = node->numArgs; i < 3; i++) {
+        inputs[i] = inputs[0];
+      }
+      if (output < 0) {
+        while (temporaryRegisters.size() <= depth) {
+          temporaryRegisters.push_back(getRegister(REGISTER_TEMPORARY, temporaryRegisters.size(), 0));
+        }
+        output = temporaryRegisters[depth];
+      }
+      Instruction instruction = {node->opcode, output, inputs[0], inputs[1], inputs[2]};
+      instructions.push_back(instruction);
+      return output;
+    }
+  }
+  if (output < 0) return input;
+  Instruction instruction = {COPY, output, input, input, input};
+  instructions.push_back(instruction);
+  return output;
+}
+
+int ExpressionProgram::getNumSignalInlets() {
+  int numSignalInlets = 1;
+  for (int i = 0; i < inletKinds.size(); i++) {
+    if (inletKinds[i] == 'v') numSignalInlets = i + 1;
+  }
+  return numSignalInlets;
+}
+
+
+#pragma mark - Processing
+
+void ExpressionProgram::setInlet(int inletIndex, float value) {
+  if (inletIndex < 0 || inletIndex >= inletKinds.size() || inletKinds[inletIndex] == 'v') return;
+  if (inletKinds[inletIndex] == 'i') value = truncf(value);
+  for (int i = 0; i < registers.size(); i++) {
+    if (registers[i].kind == REGISTER_INLET && registers[i].index == inletIndex) {
+      ArrayArithmetic::fill(pointers[i], value, 0, blockSize);
+    }
+  }
+}
+
+void ExpressionProgram::clear(int blockIndex) {
+  // the current block is in the second half of each history
+  int numBytes = (blockSize + blockIndex) * sizeof(float);
+  for (int i = 0; i < inputHistory.size(); i++) {
+    if (inputHistory[i] != NULL) memset(inputHistory[i], 0, numBytes);
+  }
+  for (int i = 0; i < outputHistory.size(); i++) {
+    memset(outputHistory[i], 0, numBytes);
+  }
+}
+
+float **ExpressionProgram::getRegisterSlot(int index) {
+  if (!hasHistory) {
+    // The signals are read where they are. The last expression is computed directly into its
+    // outlet, as the inputs are no longer needed, and the others are copied there at the end.
+    if (registers[index].kind == REGISTER_SIGNAL) return inletSlots[registers[index].index];
+    if (index == results.back()) return outletSlots.back();
+  }
+  return &pointers[index];
+}
+
+void ExpressionProgram::bind(float ***inletSlots, float ***outletSlots) {
+  this->inletSlots.assign(inletSlots, inletSlots + getNumSignalInlets());
+  this->outletSlots.assign(outletSlots, outletSlots + getNumExpressions());
+  free(boundInstructions);
+  boundInstructions = (BoundInstruction *) malloc(instructions.size() * sizeof(BoundInstruction));
+  for (int i = 0; i < instructions.size(); i++) {
+    Instruction &instruction = instructions[i];
+    BoundInstruction boundInstruction = {instruction.opcode, getRegisterSlot(instruction.output),
+        getRegisterSlot(instruction.input0), getRegisterSlot(instruction.input1),
+        getRegisterSlot(instruction.input2)};
+    boundInstructions[i] = boundInstruction;
+  }
+}
+
+void ExpressionProgram::process(float *scratch, int fromIndex, int toIndex) {
+  if (scratch != boundScratch) {
+    for (int i = 0; i < registers.size(); i++) {
+      if (registers[i].scratchIndex >= 0) pointers[i] = scratch + registers[i].scratchIndex * blockSize;
+    }
+    boundScratch = scratch;
+  }
+
+  if (hasHistory && fromIndex == 0) {
+    // the outputs may overwrite the inputs
+    for (int i = 0; i < inletSlots.size(); i++) {
+      if (inputHistory[i] != NULL) memcpy(inputHistory[i] + blockSize, *inletSlots[i], blockSize*sizeof(float));
+    }
+  }
+
+  int numInstructions = instructions.size();
+  BoundInstruction *instruction = boundInstructions;
+  for (int j = fromIndex; j < toIndex; j += runLength) {
+    int n = (toIndex - j < runLength) ? toIndex - j : runLength;
+    for (int i = 0; i < numInstructions; i++) {
+      BoundInstruction &in = instruction[i];
+      execute(in.opcode, *in.input0 + j, *in.input1 + j, *in.input2 + j, *in.output + j, n);
+    }
+  }
+
+  int lastResult = results.size() - 1;
+  if (hasHistory || lastResult > 0) {
+    int numBytes = (toIndex - fromIndex) * sizeof(float);
+    for (int i = 0; i < results.size(); i++) {
+      if (hasHistory || i != lastResult) {
+        memcpy(*outletSlots[i] + fromIndex, pointers[results[i]] + fromIndex, numBytes);
+      }
+    }
+  }
+
+  if (hasHistory && toIndex == blockSize) {
+    for (int i = 0; i < inputHistory.size(); i++) {
+      if (inputHistory[i] != NULL) memcpy(inputHistory[i], inputHistory[i] + blockSize, blockSize*sizeof(float));
+    }
+    for (int i = 0; i < outputHistory.size(); i++) {
+      memcpy(outputHistory[i], outputHistory[i] + blockSize, blockSize*sizeof(float));
+    }
+  }
+}
+
@@ -0,0 +1,192 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _EXPRESSION_PROGRAM_H_
+#define _EXPRESSION_PROGRAM_H_
+
+#include <vector>
+
+using namespace std;
+
+class BufferPool;
+
+/**
+ * The compiled form of the expressions of [expr~] and [fexpr~]. The text is parsed once, constant
+ * subexpressions are folded, and each expression becomes a short program of instructions, each of
+ * which computes one operation over a vector of samples. Variables, constants, and intermediate
+ * results are registers of one block each. Constants, and the registers which need not persist
+ * between blocks, are kept in buffers which all programs of a context share. A product which is
+ * added or subtracted is computed in the same pass as the sum. The common operations are computed
+ * with SIMD instructions. The program is bound once to the buffers of its object, such that a
+ * block costs little more than its instructions. Even so, an expression is not faster than the
+ * equivalent chain of elementwise objects, which the graph fuses into a single pass (see
+ * <code>DspFusedChain</code>). [expr~] is for compatibility with Pd, not for speed.
+ *
+ * The syntax is that of Pd's expr. Expressions are separated by semicolons, and each has its own
+ * outlet. $v# (or $x# with history) is a signal inlet, and $f# and $i# are float and integer
+ * inlets. With history, as for [fexpr~], $x#[-n] is the input n samples ago and $y#[-n] the output
+ * of the given expression n samples ago. $x# means $x#[0] and $y# means $y#[-1]. Tables are not
+ * supported.
+ */
+class ExpressionProgram {
+
+  public:
+    /**
+     * Compiles the given text, for blocks of the given size. The constants are taken from the given
+     * pool. If the text cannot be compiled, then <code>isValid()</code> is false,
+     * <code>getError()</code> says why, and the program outputs silence from one outlet.
+     */
+    ExpressionProgram(const char *text, bool hasHistory, int blockSize, BufferPool *bufferPool);
+    ~ExpressionProgram();
+
+    bool isValid() { return error[0] == '\0'; }
+    const char *getError() { return error; }
+
+    int getNumExpressions() { return (int) results.size(); }
+
+    /** The number of inlets, which is at least one. */
+    int getNumInlets() { return (int) inletKinds.size(); }
+
+    /** The number of inlets up to and including the last signal inlet, and at least one. */
+    int getNumSignalInlets();
+
+    /** Sets the value of the float or integer inlet with the given index. */
+    void setInlet(int inletIndex, float value);
+
+    /**
+     * Clears the history of the inputs and outputs before the given index of the current block.
+     * The inputs of the block from there on are kept, as they are still to be processed.
+     */
+    void clear(int blockIndex);
+
+    /** The number of scratch buffers which <code>process()</code> requires. */
+    int getNumScratchBuffers() { return numScratchBuffers; }
+
+    /**
+     * Binds the program to the locations at which an object keeps the buffers of its signal inlets
+     * and of its outlets, see <code>DspObject::getDspBufferSlotAtInlet()</code>. The instructions
+     * then read and write those buffers directly, whichever they are in a block. An output may be
+     * the same buffer as an input.
+     */
+    void bind(float ***inletSlots, float ***outletSlots);
+
+    /**
+     * Computes all expressions over [fromIndex, toIndex) of the block, from and to the bound
+     * buffers. The scratch buffers are overwritten. With history, the block must be computed in
+     * order, each part exactly once.
+     */
+    void process(float *scratch, int fromIndex, int toIndex);
+
+  private:
+    enum Opcode {
+      COPY,
+      NEGATE, NOT, BITWISE_NOT,
+      ADD, SUBTRACT, MULTIPLY, DIVIDE, DIVIDE_INT, MODULO,
+      MULTIPLY_ADD, MULTIPLY_SUBTRACT, SUBTRACT_PRODUCT, // a*b + c, a*b - c, and c - a*b
+      BITWISE_AND, BITWISE_OR, BITWISE_XOR, SHIFT_LEFT, SHIFT_RIGHT,
+      EQUAL, NOT_EQUAL, LESS, GREATER, LESS_EQUAL, GREATER_EQUAL, AND, OR,
+      IF, MIN, MAX, ABS, INT, RINT, FLOOR, CEIL, SQRT, EXP, LN, LOG10, POW, FMOD,
+      SIN, COS, TAN, ASIN, ACOS, ATAN, ATAN2, SINH, COSH, TANH
+    };
+
+    enum RegisterKind {
+      REGISTER_TEMPORARY, // an intermediate result
+      REGISTER_CONSTANT,
+      REGISTER_INLET, // the value of a float or integer inlet
+      REGISTER_SIGNAL, // a signal inlet, possibly delayed
+      REGISTER_HISTORY, // an earlier output of an expression
+      REGISTER_RESULT // the output of an expression
+    };
+
+    struct Register {
+      RegisterKind kind;
+      int index; // of the inlet or expression
+      int delay; // in samples
+      float value; // of a constant
+      int scratchIndex; // of the scratch buffer which holds the register, or -1
+    };
+
+    struct Instruction {
+      Opcode opcode;
+      int output; // register indices
+      int input0;
+      int input1;
+      int input2;
+    };
+
+    /** An instruction with the location of the buffer of each register, as bound. */
+    struct BoundInstruction {
+      Opcode opcode;
+      float **output;
+      float **input0;
+      float **input1;
+      float **input2;
+    };
+
+    struct Node;
+    class Parser;
+    friend class Parser;
+
+    /** Computes one operation on scalars, as for constant folding and the remainder of a vector. */
+    static float evaluate(Opcode opcode, float a, float b, float c);
+
+    /** Computes one operation over n samples. */
+    static void execute(Opcode opcode, float *a, float *b, float *c, float *output, int n);
+
+    int getRegister(RegisterKind kind, int index, int delay);
+    int getConstantRegister(float value);
+
+    /** Emits the instructions which compute the given node, and returns the register of the result. */
+    int compileNode(Node *node, int depth, int output);
+
+    /** Compiles the constant expression 0, after an error. */
+    void compileSilence();
+
+    /** Returns the location at which the buffer of the given register is found when processing. */
+    float **getRegisterSlot(int index);
+
+    bool hasHistory;
+    int blockSize;
+    char error[128];
+
+    vector<Register> registers;
+    int numScratchBuffers;
+    float *inletBuffers; // of the float and integer inlets which are used
+    vector<int> temporaryRegisters; // by depth
+    vector<Instruction> instructions;
+    vector<int> results; // the result register of each expression
+    vector<char> inletKinds; // 'v' for signal inlets, otherwise 'f' or 'i'
+    float **pointers; // the location of each register, other than those read or written in place
+    float *boundScratch; // the scratch buffers to which the pointers refer
+    vector<float **> inletSlots; // of the signal inlets
+    vector<float **> outletSlots;
+    BoundInstruction *boundInstructions;
+
+    // As for Pd's fexpr~, expressions are computed in runs of samples which do not depend on each
+    // other. Each input and output keeps one block of history before the current block.
+    int runLength;
+    vector<float *> inputHistory; // for each signal inlet
+    vector<float *> outputHistory; // for each expression
+};
+
+#endif // _EXPRESSION_PROGRAM_H_
@@ -20,6 +20,7 @@
  *
  */
 
+#include "CosineEngine.h"
 #include "MessageCosine.h"
 
 MessageObject *MessageCosine::newObject(PdMessage *initMessage, PdGraph *graph) {
@@ -36,8 +37,10 @@ MessageCosine::~MessageCosine() {
 
 void MessageCosine::processMessage(int inletIndex, PdMessage *message) {
   if (message->isFloat(0)) {
+    // messages are rare, such that the most accurate method is always used
     PdMessage *outgoingMessage = PD_MESSAGE_ON_STACK(1);
-    outgoingMessage->initWithTimestampAndFloat(message->getTimestamp(), cosf(message->getFloat(0)));
+    outgoingMessage->initWithTimestampAndFloat(message->getTimestamp(),
+        CosineEngine::cosine(message->getFloat(0) / (2.0 * M_PI), COSINE_ACCURACY_POLYNOMIAL));
     sendMessage(0, outgoingMessage);
   }
 }
@@ -0,0 +1,130 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "MessagePoly.h"
+
+MessageObject *MessagePoly::newObject(PdMessage *initMessage, PdGraph *graph) {
+  return new MessagePoly(initMessage, graph);
+}
+
+MessagePoly::MessagePoly(PdMessage *initMessage, PdGraph *graph) : MessageObject(2, 3, graph) {
+  numVoices = (initMessage->isFloat(0) && initMessage->getFloat(0) >= 1.0f)
+      ? (int) initMessage->getFloat(0) : 1;
+  shouldSteal = initMessage->isFloat(1) && initMessage->getFloat(1) != 0.0f;
+  voices = (PolyVoice *) calloc(numVoices, sizeof(PolyVoice));
+  velocity = 0.0f;
+  nextSerial = 0;
+}
+
+MessagePoly::~MessagePoly() {
+  free(voices);
+}
+
+std::string MessagePoly::toString() {
+  char str[snprintf(NULL, 0, "%s %i %i", getObjectLabel(), numVoices, shouldSteal ? 1 : 0)+1];
+  snprintf(str, sizeof(str), "%s %i %i", getObjectLabel(), numVoices, shouldSteal ? 1 : 0);
+  return std::string(str);
+}
+
+void MessagePoly::processMessage(int inletIndex, PdMessage *message) {
+  switch (inletIndex) {
+    case 0: {
+      if (message->isFloat(0)) {
+        if (velocity > 0.0f) {
+          noteOn(message->getFloat(0), message->getTimestamp());
+        } else {
+          noteOff(message->getFloat(0), message->getTimestamp());
+        }
+      } else if (message->isSymbol(0, "stop")) {
+        // release all held voices
+        for (int i = 0; i < numVoices; i++) {
+          if (voices[i].isUsed) {
+            voices[i].isUsed = false;
+            voices[i].serial = nextSerial++;
+            sendVoice(i, voices[i].pitch, 0.0f, message->getTimestamp());
+          }
+        }
+      } else if (message->isSymbol(0, "clear")) {
+        // forget all voices without releasing them
+        memset(voices, 0, numVoices * sizeof(PolyVoice));
+        nextSerial = 0;
+      }
+      break;
+    }
+    case 1: {
+      if (message->isFloat(0)) {
+        velocity = message->getFloat(0);
+      }
+      break;
+    }
+    default: break;
+  }
+}
+
+void MessagePoly::noteOn(float pitch, double timestamp) {
+  // find the oldest free voice, and the oldest voice in use in case there is none
+  int freeIndex = -1;
+  int usedIndex = -1;
+  for (int i = 0; i < numVoices; i++) {
+    if (voices[i].isUsed) {
+      if (usedIndex < 0 || voices[i].serial < voices[usedIndex].serial) usedIndex = i;
+    } else {
+      if (freeIndex < 0 || voices[i].serial < voices[freeIndex].serial) freeIndex = i;
+    }
+  }
+  if (freeIndex < 0) {
+    if (!shouldSteal) return; // the note is dropped
+    // the stolen voice is released before it is taken again
+    freeIndex = usedIndex;
+    sendVoice(freeIndex, voices[freeIndex].pitch, 0.0f, timestamp);
+  }
+  voices[freeIndex].pitch = pitch;
+  voices[freeIndex].isUsed = true;
+  voices[freeIndex].serial = nextSerial++;
+  sendVoice(freeIndex, pitch, velocity, timestamp);
+}
+
+void MessagePoly::noteOff(float pitch, double timestamp) {
+  int usedIndex = -1;
+  for (int i = 0; i < numVoices; i++) {
+    if (voices[i].isUsed && voices[i].pitch == pitch &&
+        (usedIndex < 0 || voices[i].serial < voices[usedIndex].serial)) {
+      usedIndex = i;
+    }
+  }
+  if (usedIndex >= 0) {
+    voices[usedIndex].isUsed = false;
+    voices[usedIndex].serial = nextSerial++;
+    sendVoice(usedIndex, pitch, 0.0f, timestamp);
+  }
+}
+
+void MessagePoly::sendVoice(int voiceIndex, float pitch, float noteVelocity, double timestamp) {
+  PdMessage *outgoingMessage = PD_MESSAGE_ON_STACK(1);
+  outgoingMessage->initWithTimestampAndFloat(timestamp, noteVelocity);
+  sendMessage(2, outgoingMessage);
+  outgoingMessage->initWithTimestampAndFloat(timestamp, pitch);
+  sendMessage(1, outgoingMessage);
+  outgoingMessage->initWithTimestampAndFloat(timestamp, (float) (voiceIndex + 1));
+  sendMessage(0, outgoingMessage);
+}
@@ -0,0 +1,76 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _MESSAGE_POLY_H_
+#define _MESSAGE_POLY_H_
+
+#include "MessageObject.h"
+
+/** The state of one voice allocated by [poly]. */
+typedef struct PolyVoice {
+  float pitch;
+  bool isUsed;
+  unsigned int serial; // the order in which voices were last taken or released
+} PolyVoice;
+
+/**
+ * [poly]
+ * Allocates voices to notes, such that each note-on is given a free voice and the following
+ * note-off with the same pitch returns it. Voices are numbered from 1, and are output as
+ * (voice, pitch, velocity) with the velocity arriving first. The oldest free voice is always taken.
+ * If none is free and voice stealing is enabled, then the oldest held voice is released and taken.
+ */
+class MessagePoly : public MessageObject {
+  
+  public:
+    static MessageObject *newObject(PdMessage *initMessage, PdGraph *graph);
+    MessagePoly(PdMessage *initMessage, PdGraph *graph);
+    ~MessagePoly();
+  
+    static const char *getObjectLabel();
+    std::string toString();
+  
+  private:
+    void processMessage(int inletIndex, PdMessage *message);
+  
+    /** Takes a voice for the given pitch at the current velocity. */
+    void noteOn(float pitch, double timestamp);
+  
+    /** Releases the oldest voice which holds the given pitch. */
+    void noteOff(float pitch, double timestamp);
+  
+    /** Sends the (voice, pitch, velocity) triplet for the given voice. */
+    void sendVoice(int voiceIndex, float pitch, float noteVelocity, double timestamp);
+  
+    PolyVoice *voices;
+    int numVoices;
+    bool shouldSteal;
+    float velocity; // the last velocity received in the right inlet
+    unsigned int nextSerial;
+};
+
+inline const char *MessagePoly::getObjectLabel() {
+  return "poly";
+}
+
+#endif // _MESSAGE_POLY_H_
@@ -21,18 +21,20 @@
  */
 
 #include "MessageRandom.h"
+#include "PdContext.h"
+#include "PdGraph.h"
 
 MessageObject *MessageRandom::newObject(PdMessage *initMessage, PdGraph *graph) {
   return new MessageRandom(initMessage, graph);
 }
 
-MessageRandom::MessageRandom(PdMessage *initMessage, PdGraph *graph) : MessageObject(2, 1, graph) {
+MessageRandom::MessageRandom(PdMessage *initMessage, PdGraph *graph) : MessageObject(2, 1, graph),
+    generator(graph->getContext()->nextRandomSeed()) {
   max_inc = initMessage->isFloat(0) ? ((int) initMessage->getFloat(0))-1 : 1;
-  twister = new MTRand();
 }
 
 MessageRandom::~MessageRandom() {
-  delete twister;
+  // nothing to do
 }
 
 void MessageRandom::processMessage(int inletIndex, PdMessage *message) {
@@ -41,13 +43,14 @@ void MessageRandom::processMessage(int inletIndex, PdMessage *message) {
       switch (message->getType(0)) {
         case SYMBOL: {
           if (message->isSymbol(0, "seed") && message->isFloat(1)) {
-            twister->seed((int) message->getFloat(1)); // reset the seed
+            generator.seed((uint32_t) (int32_t) message->getFloat(1)); // reset the seed
           }
           break;
         }
         case BANG: {
           PdMessage *outgoingMessage = PD_MESSAGE_ON_STACK(1);
-          outgoingMessage->initWithTimestampAndFloat(message->getTimestamp(), (float) twister->randInt(max_inc));
+          outgoingMessage->initWithTimestampAndFloat(message->getTimestamp(),
+              (float) generator.nextInt((uint32_t) max_inc + 1));
           sendMessage(0, outgoingMessage);
           break;
         }
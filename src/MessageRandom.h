@@ -23,8 +23,8 @@
 #ifndef _MESSAGE_RANDOM_H_
 #define _MESSAGE_RANDOM_H_
 
-#include "MersenneTwister.h"
 #include "MessageObject.h"
+#include "RandomGenerator.h"
 
 class PdGraph;
 
@@ -46,7 +46,7 @@ class MessageRandom : public MessageObject {
 
   private:
     int max_inc; // random output is in range [0, max_inc]
-    MTRand *twister;
+    RandomGenerator generator;
 };
 
 inline const char *MessageRandom::getObjectLabel() {
@@ -30,7 +30,7 @@
 // and Lists as the value.
 MessageSendController::MessageSendController(PdContext *aContext) : MessageObject(0, 0, NULL) {
   context = aContext;
-  sendStack = vector<std::pair<string, set<RemoteMessageReceiver *> > >();
+  sendStack = vector<std::pair<string, list<RemoteMessageReceiver *> > >();
 }
 
 MessageSendController::~MessageSendController() {
@@ -70,8 +70,9 @@ void MessageSendController::sendMessage(int outletIndex, PdMessage *message) {
   if (outletIndex == SYSTEM_NAME_INDEX) {
     context->receiveSystemMessage(message);
   } else {
-    set<RemoteMessageReceiver *> receiverSet = sendStack[outletIndex].second;
-    for (set<RemoteMessageReceiver *>::iterator it = receiverSet.begin(); it != receiverSet.end(); ++it) {
+    // receivers are sent to in the order in which they were registered
+    list<RemoteMessageReceiver *> receiverList = sendStack[outletIndex].second;
+    for (list<RemoteMessageReceiver *>::iterator it = receiverList.begin(); it != receiverList.end(); ++it) {
       RemoteMessageReceiver *receiver = *it;
       receiver->receiveMessage(0, message);
     }
@@ -81,23 +82,23 @@ void MessageSendController::sendMessage(int outletIndex, PdMessage *message) {
 void MessageSendController::addReceiver(RemoteMessageReceiver *receiver) {
   int nameIndex = getNameIndex(receiver->getName());
   if (nameIndex == -1) {
-    set<RemoteMessageReceiver *> remoteSet = set<RemoteMessageReceiver *>();
-    remoteSet.insert(receiver);
-    std::pair<string, set<RemoteMessageReceiver *> > nameSetPair =
-        make_pair(string(receiver->getName()), remoteSet);
-    sendStack.push_back(nameSetPair);
+    std::pair<string, list<RemoteMessageReceiver *> > nameListPair =
+        make_pair(string(receiver->getName()), list<RemoteMessageReceiver *>());
+    sendStack.push_back(nameListPair);
     nameIndex = sendStack.size()-1;
   }
   
-  set<RemoteMessageReceiver *> *receiverSet = &(sendStack[nameIndex].second);
-  receiverSet->insert(receiver);
+  list<RemoteMessageReceiver *> *receiverList = &(sendStack[nameIndex].second);
+  if (find(receiverList->begin(), receiverList->end(), receiver) == receiverList->end()) {
+    receiverList->push_back(receiver);
+  }
 }
 
 void MessageSendController::removeReceiver(RemoteMessageReceiver *receiver) {
   int nameIndex = getNameIndex(receiver->getName());
   if (nameIndex != -1) {
-    set<RemoteMessageReceiver *> *receiverSet = &(sendStack[nameIndex].second);
-    receiverSet->erase(receiver);
+    list<RemoteMessageReceiver *> *receiverList = &(sendStack[nameIndex].second);
+    receiverList->remove(receiver);
     // NOTE(mhroth):
     // once the receiver set has been created, it should not be erased anymore from the sendStack.
     // PdContext depends on the nameIndex to be constant for all receiver names once they are
@@ -23,6 +23,8 @@
 #ifndef _MESSAGE_SEND_CONTROLLER_H_
 #define _MESSAGE_SEND_CONTROLLER_H_
 
+#include <algorithm>
+#include <list>
 #include <set>
 #include <string>
 #include "MessageObject.h"
@@ -80,7 +82,7 @@ class MessageSendController : public MessageObject {
   
     PdContext *context;
   
-    vector<std::pair<string, set<RemoteMessageReceiver *> > > sendStack;
+    vector<std::pair<string, list<RemoteMessageReceiver *> > > sendStack;
   
     set<string> externalReceiverSet;
 };
@@ -20,127 +20,504 @@
  *
  */
 
+#include <string>
+#include <vector>
 #include "MessageSoundfiler.h"
 #include "MessageTable.h"
+#include "PdContext.h"
 #include "PdGraph.h"
+#include "SoundfileCache.h"
 
 #include <sndfile.h>
 
+// the number of frames which are decoded or encoded at once
+#define NUM_FRAMES_PER_CHUNK 4096
+
+struct SoundfilerJob {
+  DiskStreamCommandType type; // DISK_STREAM_READ or DISK_STREAM_WRITE
+  string path;
+  vector<string> tableNames;
+  vector<float *> buffers; // one per table, into which a file is read
+  vector<int> bufferLengths;
+  vector<void *> mappings; // the memory mapping into which each buffer points, or NULL
+  vector<size_t> mappingLengths;
+  vector<TableBuffer *> tableBuffers; // retained snapshots of the tables from which a file is written
+  bool shouldResize;
+  bool shouldMap; // tables are backed by memory mapped cache files of the soundfile
+  bool shouldPrefetch;
+  string cacheDirectory;
+  int skip; // the number of frames skipped at the beginning of the file (read) or tables (write)
+  int maxFrames; // the maximum number of frames to read or write, or -1 if unlimited
+  int format; // the libsndfile format of a file which is written
+  float sampleRate;
+  int numFrames; // the number of frames which have been read or written
+  string error; // empty if the job was successful
+  volatile bool isDone;
+};
+
 MessageObject *MessageSoundfiler::newObject(PdMessage *initMessage, PdGraph *graph) {
   return new MessageSoundfiler(initMessage, graph);
 }
 
 MessageSoundfiler::MessageSoundfiler(PdMessage *initMessage, PdGraph *graph) : MessageObject(1, 1, graph) {
-  // TODO(mhroth)
+  hasUndeliveredCompletion = false;
+  isDeleting = false;
+  diskStreamService = graph->getContext()->getDiskStreamService();
 }
 
 MessageSoundfiler::~MessageSoundfiler() {
-  // nothing to do
+  // a graph which is deleted while still attached does not unregister its objects
+  diskStreamService->unregisterStream(this);
+  // finish all outstanding work on this thread, such that no file is left half written
+  isDeleting = true;
+  service();
+  while (!runningJobs.empty()) {
+    freeJob(runningJobs.front());
+    runningJobs.pop();
+  }
+  while (!finishedJobs.empty()) {
+    freeJob(finishedJobs.front());
+    finishedJobs.pop();
+  }
 }
 
-void MessageSoundfiler::processMessage(int inletIndex, PdMessage *message)
-{
-  if (message->isSymbol(0, "read"))
-  {
-    int currentElementIndex;
-    bool shouldResizeTable = false;
-    char *tabName;
-    char *soundfilePath;
-    MessageTable *table;
-    
-    for (currentElementIndex = 1;
-         currentElementIndex < message->getNumElements();
-         ++currentElementIndex)
-    {
-      if (message->isSymbol(currentElementIndex, "-resize"))
-        shouldResizeTable = true;
-      /* else if other flags... */
-      else
-        break;
-    }
-    if (message->getNumElements() - currentElementIndex - 2 < 0)
-    {
-      graph->printErr("[soundfiler]: parameters are incorrect");
-      return;
+void MessageSoundfiler::freeJob(SoundfilerJob *job) {
+  for (int i = 0; i < job->buffers.size(); i++) {
+    if (job->mappings[i] != NULL) {
+      SoundfileCache::unmap(job->mappings[i], job->mappingLengths[i]);
+    } else {
+      free(job->buffers[i]);
     }
-    soundfilePath = message->getSymbol(currentElementIndex++);
-    tabName = message->getSymbol(currentElementIndex++);
-    if ((table = graph->getTable(tabName)) == NULL)
-    {
-      graph->printErr("[soundfiler]: table '%s' cannot be found", tabName);
+  }
+  for (int i = 0; i < job->tableBuffers.size(); i++) {
+    job->tableBuffers[i]->release();
+  }
+  delete job;
+}
+
+
+#pragma mark - Audio Thread
+
+void MessageSoundfiler::processMessage(int inletIndex, PdMessage *message) {
+  releaseJobs(); // try again to hand back any jobs which could not be released earlier
+  
+  bool isAsync = false;
+  SoundfilerJob *job = NULL;
+  if (message->isSymbol(0, "read")) {
+    job = newReadJob(message, &isAsync);
+  } else if (message->isSymbol(0, "write")) {
+    job = newWriteJob(message, &isAsync);
+  }
+  if (job == NULL) return;
+  
+  if (isAsync) {
+    DiskStreamCommand *command = getNextCommand();
+    if (command == NULL) {
+      graph->printErr("[soundfiler]: too many pending requests. Ignoring %s.", job->path.c_str());
+      freeJob(job);
       return;
     }
-    SF_INFO sfInfo;
-    char *fullPath = graph->resolveFullPath(soundfilePath);
-    if (fullPath == NULL)
-    {
-      graph->printErr("[soundfiler]: file '%s' cannot be found.", soundfilePath);
-      return;
+    command->type = job->type;
+    command->data = job;
+    postCommand();
+    runningJobs.push(job);
+    diskStreamService->signal();
+  } else {
+    if (job->type == DISK_STREAM_READ) {
+      readFile(job);
+    } else {
+      writeFile(job);
     }
-    
-    SNDFILE *sndFile = sf_open(fullPath, SFM_READ, &sfInfo);
-    if (sndFile == NULL)
-    {
-      graph->printErr("[soundfiler]: file %s cannot be opened.", fullPath);
-      free(fullPath);
-      return; // there was an error reading the file. Move on with life.
-    }
-    delete fullPath;
-    
-    // It is assumed that the channels are interleaved.
-    int samplesPerChannel = static_cast<int>(sfInfo.frames);
-    int bufferLength = samplesPerChannel * sfInfo.channels;
-    // create a buffer in memory for the file data
-    float *buffer = (float *) malloc(bufferLength * sizeof(float));
-    sf_read_float(sndFile, buffer, bufferLength); // read the whole file into memory
-    sf_close(sndFile); // release the handle to the file
-    
-    if (sfInfo.channels > 0) // sanity check
-    {
-      // get the table's buffer. Resize the buffer if necessary.
-      int tableLength = samplesPerChannel;
-      float *tableBuffer = shouldResizeTable ? table->resizeBuffer(samplesPerChannel) :
-      table->getBuffer(&tableLength);
-      if (tableLength > samplesPerChannel)
-      {
-        // avoid trying to read more into the table buffer than is available
-        tableLength = samplesPerChannel;
+    finishJob(job, message->getTimestamp());
+    freeJob(job);
+  }
+}
+
+SoundfilerJob *MessageSoundfiler::newReadJob(PdMessage *message, bool *isAsync) {
+  // read [flags] filename table1 [table2 ...]
+  SoundfilerJob *job = new SoundfilerJob();
+  job->type = DISK_STREAM_READ;
+  job->shouldResize = false;
+  job->shouldMap = false;
+  job->shouldPrefetch = false;
+  job->skip = 0;
+  job->maxFrames = -1;
+  job->numFrames = 0;
+  job->isDone = false;
+  
+  int i = 1;
+  while (message->isSymbol(i) && message->getSymbol(i)[0] == '-') {
+    if (message->isSymbol(i, "-resize")) {
+      job->shouldResize = true;
+      i++;
+    } else if (message->isSymbol(i, "-async")) {
+      *isAsync = true;
+      i++;
+    } else if (message->isSymbol(i, "-map")) {
+      job->shouldMap = true;
+      i++;
+    } else if (message->isSymbol(i, "-prefetch")) {
+      job->shouldPrefetch = true;
+      i++;
+    } else if (message->isSymbol(i, "-skip") && message->isFloat(i+1)) {
+      job->skip = (int) message->getFloat(i+1);
+      if (job->skip < 0) {
+        // as in Pd, frames before the beginning of the file or table cannot be skipped
+        graph->printErr("[soundfiler]: -skip must not be negative.");
+        delete job;
+        return NULL;
       }
-      
-      // extract the first channel
-      for (int i = 0, j = 0; i < bufferLength; i+=sfInfo.channels, j++)
-      {
-        tableBuffer[j] = buffer[i];
+      i += 2;
+    } else if (message->isSymbol(i, "-maxsize") && message->isFloat(i+1)) {
+      job->maxFrames = (int) message->getFloat(i+1);
+      i += 2;
+    } else {
+      graph->printErr("[soundfiler]: unknown flag %s to read.", message->getSymbol(i));
+      delete job;
+      return NULL;
+    }
+  }
+  if (!message->isSymbol(i) || !message->isSymbol(i+1)) {
+    graph->printErr("[soundfiler]: parameters are incorrect");
+    delete job;
+    return NULL;
+  }
+  job->path = string(message->getSymbol(i++));
+  if (job->shouldMap) job->cacheDirectory = string(graph->getContext()->getTableCacheDirectory());
+  for (; message->isSymbol(i); i++) {
+    MessageTable *table = graph->getTable(message->getSymbol(i));
+    if (table == NULL) {
+      graph->printErr("[soundfiler]: table '%s' cannot be found", message->getSymbol(i));
+      delete job;
+      return NULL;
+    }
+    int bufferLength = 0;
+    table->getBuffer(&bufferLength);
+    job->tableNames.push_back(string(message->getSymbol(i)));
+    job->buffers.push_back(NULL);
+    job->bufferLengths.push_back(bufferLength);
+    job->mappings.push_back(NULL);
+    job->mappingLengths.push_back(0);
+  }
+  return job;
+}
+
+SoundfilerJob *MessageSoundfiler::newWriteJob(PdMessage *message, bool *isAsync) {
+  // write [flags] filename table1 [table2 ...]
+  SoundfilerJob *job = new SoundfilerJob();
+  job->type = DISK_STREAM_WRITE;
+  job->shouldResize = false;
+  job->skip = 0;
+  job->maxFrames = -1;
+  job->sampleRate = graph->getSampleRate();
+  job->numFrames = 0;
+  job->isDone = false;
+  
+  int numBytes = 2;
+  int fileType = 0;
+  int i = 1;
+  while (message->isSymbol(i) && message->getSymbol(i)[0] == '-') {
+    if (message->isSymbol(i, "-async")) {
+      *isAsync = true;
+      i++;
+    } else if (message->isSymbol(i, "-bytes") && message->isFloat(i+1)) {
+      numBytes = (int) message->getFloat(i+1);
+      i += 2;
+    } else if (message->isSymbol(i, "-rate") && message->isFloat(i+1)) {
+      job->sampleRate = message->getFloat(i+1);
+      i += 2;
+    } else if (message->isSymbol(i, "-skip") && message->isFloat(i+1)) {
+      job->skip = (int) message->getFloat(i+1);
+      if (job->skip < 0) {
+        // as in Pd, frames before the beginning of the file or table cannot be skipped
+        graph->printErr("[soundfiler]: -skip must not be negative.");
+        delete job;
+        return NULL;
       }
-      
-      // extract the second channel (if it exists and if there is a table to write it to)
-      if (sfInfo.channels > 1 &&
-          (tabName = message->getSymbol(currentElementIndex++)) != NULL &&
-          (table = graph->getTable(tabName)) != NULL)
-      {
-        tableLength = samplesPerChannel;
-        tableBuffer = shouldResizeTable ? table->resizeBuffer(samplesPerChannel) :
-        table->getBuffer(&tableLength);
-        if (tableLength > samplesPerChannel)
-        {
-          // avoid trying to read more into the table buffer than is available
-          tableLength = samplesPerChannel;
+      i += 2;
+    } else if (message->isSymbol(i, "-nframes") && message->isFloat(i+1)) {
+      job->maxFrames = (int) message->getFloat(i+1);
+      i += 2;
+    } else if (message->isSymbol(i, "-wave")) {
+      fileType = SF_FORMAT_WAV;
+      i++;
+    } else if (message->isSymbol(i, "-aiff")) {
+      fileType = SF_FORMAT_AIFF;
+      i++;
+    } else if (message->isSymbol(i, "-big") || message->isSymbol(i, "-little")) {
+      i++; // the byte order is left to libsndfile
+    } else {
+      graph->printErr("[soundfiler]: unknown flag %s to write.", message->getSymbol(i));
+      delete job;
+      return NULL;
+    }
+  }
+  if (!message->isSymbol(i) || !message->isSymbol(i+1)) {
+    graph->printErr("[soundfiler]: parameters are incorrect");
+    delete job;
+    return NULL;
+  }
+  job->path = string(message->getSymbol(i++));
+  if (fileType == 0) {
+    size_t extension = job->path.rfind('.');
+    fileType = (extension != string::npos &&
+        (!job->path.compare(extension, string::npos, ".aif") ||
+         !job->path.compare(extension, string::npos, ".aiff"))) ? SF_FORMAT_AIFF : SF_FORMAT_WAV;
+  }
+  switch (numBytes) {
+    case 2: job->format = fileType | SF_FORMAT_PCM_16; break;
+    case 3: job->format = fileType | SF_FORMAT_PCM_24; break;
+    case 4: job->format = fileType | SF_FORMAT_FLOAT; break;
+    default: {
+      graph->printErr("[soundfiler]: -bytes must be 2, 3, or 4.");
+      delete job;
+      return NULL;
+    }
+  }
+  
+  // The current versions of the tables are retained, such that they remain valid while the file
+  // is written even if the tables are changed in the meantime.
+  for (; message->isSymbol(i); i++) {
+    MessageTable *table = graph->getTable(message->getSymbol(i));
+    if (table == NULL) {
+      graph->printErr("[soundfiler]: table '%s' cannot be found", message->getSymbol(i));
+      freeJob(job);
+      return NULL;
+    }
+    TableBuffer *tableBuffer = table->getTableBuffer();
+    tableBuffer->retain();
+    job->tableBuffers.push_back(tableBuffer);
+    job->tableNames.push_back(string(message->getSymbol(i)));
+  }
+  
+  // the number of frames written is limited by the shortest table
+  int numFrames = -1;
+  for (int j = 0; j < job->tableBuffers.size(); j++) {
+    int bufferLength = job->tableBuffers[j]->getLength();
+    if (numFrames == -1 || bufferLength - job->skip < numFrames) numFrames = bufferLength - job->skip;
+  }
+  if (numFrames < 0) numFrames = 0;
+  if (job->maxFrames >= 0 && numFrames > job->maxFrames) numFrames = job->maxFrames;
+  job->numFrames = numFrames;
+  return job;
+}
+
+void MessageSoundfiler::finishJob(SoundfilerJob *job, double timestamp) {
+  if (!job->error.empty()) {
+    graph->printErr("[soundfiler]: %s", job->error.c_str());
+    return;
+  }
+  
+  if (job->type == DISK_STREAM_READ) {
+    // the tables are looked up again, in case any have been removed in the meantime
+    for (int i = 0; i < job->tableNames.size(); i++) {
+      MessageTable *table = graph->getTable((char *) job->tableNames[i].c_str());
+      if (table != NULL) {
+        // the buffer now belongs to the table
+        if (job->mappings[i] != NULL) {
+          table->setMappedBuffer(job->buffers[i], job->bufferLengths[i], job->mappings[i],
+              job->mappingLengths[i]);
+        } else {
+          table->setBuffer(job->buffers[i], job->bufferLengths[i]);
         }
-        for (int i = 1, j = 0; i < bufferLength; i+=sfInfo.channels, j++)
-          tableBuffer[j] = buffer[i];
+        job->buffers[i] = NULL;
+        job->mappings[i] = NULL;
+      }
+    }
+  }
+  
+  // send message with sample length when all tables have been filled
+  PdMessage *outgoingMessage = PD_MESSAGE_ON_STACK(1);
+  outgoingMessage->initWithTimestampAndFloat(timestamp, job->numFrames);
+  sendMessage(0, outgoingMessage);
+}
+
+void MessageSoundfiler::complete() {
+  double timestamp = graph->getContext()->getBlockStartTimestamp();
+  while (!runningJobs.empty() && runningJobs.front()->isDone) {
+    SoundfilerJob *job = runningJobs.front();
+    runningJobs.pop();
+    finishJob(job, timestamp);
+    finishedJobs.push(job);
+  }
+  releaseJobs();
+}
+
+void MessageSoundfiler::releaseJobs() {
+  while (!finishedJobs.empty()) {
+    DiskStreamCommand *command = getNextCommand();
+    if (command == NULL) break; // try again later
+    command->type = DISK_STREAM_RELEASE;
+    command->data = finishedJobs.front();
+    postCommand();
+    finishedJobs.pop();
+  }
+}
+
+
+#pragma mark - Disk Thread
+
+void MessageSoundfiler::executeCommand(DiskStreamCommand *command) {
+  SoundfilerJob *job = (SoundfilerJob *) command->data;
+  switch (command->type) {
+    case DISK_STREAM_READ:
+    case DISK_STREAM_WRITE: {
+      if (command->type == DISK_STREAM_READ) {
+        readFile(job);
+      } else {
+        writeFile(job);
+      }
+      __sync_synchronize(); // the results must be visible before the job is marked as done
+      job->isDone = true;
+      if (!isDeleting && !diskStreamService->postCompletion(this)) {
+        hasUndeliveredCompletion = true;
       }
+      break;
+    }
+    case DISK_STREAM_RELEASE: {
+      freeJob(job);
+      break;
+    }
+    default: {
+      break;
     }
-    delete buffer;
-    
-    // send message with sample length when all tables have been filled
-    PdMessage *outgoingMessage = PD_MESSAGE_ON_STACK(1);
-    outgoingMessage->initWithTimestampAndFloat(message->getTimestamp(), samplesPerChannel);
-    sendMessage(0, outgoingMessage);
   }
-  else if (message->isSymbol(0, "write"))
-  {
-    //Not implemented yet
-    graph->printErr("[soundfiler]: The 'write' command is not supported yet.");
+}
+
+void MessageSoundfiler::transfer() {
+  if (hasUndeliveredCompletion && diskStreamService->postCompletion(this)) {
+    hasUndeliveredCompletion = false;
   }
 }
 
+
+#pragma mark - Read/Write
+
+void MessageSoundfiler::readFile(SoundfilerJob *job) {
+  char *fullPath = graph->resolveFullPath(job->path.c_str());
+  if (fullPath == NULL) {
+    job->error = "file '" + job->path + "' cannot be found.";
+    return;
+  }
+  if (job->shouldMap) {
+    readMappedFile(job, fullPath);
+    free(fullPath);
+    return;
+  }
+  SF_INFO sfInfo;
+  memset(&sfInfo, 0, sizeof(SF_INFO));
+  SNDFILE *sndFile = sf_open(fullPath, SFM_READ, &sfInfo);
+  if (sndFile == NULL || sfInfo.channels <= 0) {
+    job->error = "file " + string(fullPath) + " cannot be opened.";
+    if (sndFile != NULL) sf_close(sndFile);
+    free(fullPath);
+    return; // there was an error reading the file. Move on with life.
+  }
+  free(fullPath);
+  
+  int numFrames = static_cast<int>(sfInfo.frames);
+  if (job->skip > 0) {
+    numFrames = (sf_seek(sndFile, job->skip, SEEK_SET) < 0) ? 0 : numFrames - job->skip;
+  }
+  if (job->maxFrames >= 0 && numFrames > job->maxFrames) numFrames = job->maxFrames;
+  
+  // without -resize the tables keep their length, and any part which is not read is cleared
+  int maxBufferLength = 0;
+  for (int i = 0; i < job->buffers.size(); i++) {
+    if (job->shouldResize) job->bufferLengths[i] = numFrames;
+    if (job->bufferLengths[i] < 1) job->bufferLengths[i] = 1;
+    if (job->bufferLengths[i] > maxBufferLength) maxBufferLength = job->bufferLengths[i];
+    job->buffers[i] = (float *) calloc(job->bufferLengths[i], sizeof(float));
+  }
+  if (numFrames > maxBufferLength) numFrames = maxBufferLength;
+  
+  // de-interleave one chunk at a time, such that the whole file need not be in memory twice
+  float *chunk = (float *) malloc(NUM_FRAMES_PER_CHUNK * sfInfo.channels * sizeof(float));
+  int numFramesRead = 0;
+  while (numFramesRead < numFrames) {
+    int numFramesInChunk = numFrames - numFramesRead;
+    if (numFramesInChunk > NUM_FRAMES_PER_CHUNK) numFramesInChunk = NUM_FRAMES_PER_CHUNK;
+    sf_count_t n = sf_readf_float(sndFile, chunk, numFramesInChunk);
+    if (n <= 0) break;
+    for (int i = 0; i < job->buffers.size() && i < sfInfo.channels; i++) {
+      float *buffer = job->buffers[i];
+      int length = job->bufferLengths[i];
+      for (int j = 0, k = i; j < n && numFramesRead + j < length; j++, k += sfInfo.channels) {
+        buffer[numFramesRead + j] = chunk[k];
+      }
+    }
+    numFramesRead += n;
+  }
+  free(chunk);
+  sf_close(sndFile); // release the handle to the file
+  job->numFrames = numFramesRead;
+}
+
+void MessageSoundfiler::readMappedFile(SoundfilerJob *job, const char *fullPath) {
+  // The tables always take the length of the file (less -skip and -maxsize), as the mapped samples
+  // cannot be padded. Tables beyond the channels of the file are cleared.
+  int numFrames = -1;
+  for (int i = 0; i < job->buffers.size(); i++) {
+    int numMappedFrames = 0;
+    float *mapping = SoundfileCache::map(job->cacheDirectory.c_str(), fullPath, i,
+        job->shouldPrefetch, &numMappedFrames, &job->mappingLengths[i]);
+    if (mapping == NULL) {
+      if (i == 0) {
+        job->error = "file " + string(fullPath) + " cannot be mapped.";
+        return;
+      }
+      continue;
+    }
+    job->mappings[i] = mapping;
+    int skip = (job->skip < numMappedFrames) ? job->skip : numMappedFrames;
+    job->buffers[i] = mapping + skip;
+    job->bufferLengths[i] = numMappedFrames - skip;
+    if (job->maxFrames >= 0 && job->bufferLengths[i] > job->maxFrames) {
+      job->bufferLengths[i] = job->maxFrames;
+    }
+    numFrames = job->bufferLengths[i];
+  }
+  for (int i = 0; i < job->buffers.size(); i++) {
+    if (job->mappings[i] == NULL) {
+      job->bufferLengths[i] = (numFrames > 0) ? numFrames : 1;
+      job->buffers[i] = (float *) calloc(job->bufferLengths[i], sizeof(float));
+    }
+  }
+  job->numFrames = numFrames;
+}
+
+void MessageSoundfiler::writeFile(SoundfilerJob *job) {
+  int numChannels = job->tableBuffers.size();
+  SF_INFO sfInfo;
+  memset(&sfInfo, 0, sizeof(SF_INFO));
+  sfInfo.samplerate = (int) job->sampleRate;
+  sfInfo.channels = numChannels;
+  sfInfo.format = job->format;
+  char *fullPath = graph->resolveNewFilePath(job->path.c_str());
+  SNDFILE *sndFile = sf_open(fullPath, SFM_WRITE, &sfInfo);
+  if (sndFile == NULL) {
+    job->error = "file " + string(fullPath) + " cannot be opened for writing.";
+    free(fullPath);
+    return;
+  }
+  free(fullPath);
+  
+  float *chunk = (float *) malloc(NUM_FRAMES_PER_CHUNK * numChannels * sizeof(float));
+  int numFramesWritten = 0;
+  while (numFramesWritten < job->numFrames) {
+    int numFramesInChunk = job->numFrames - numFramesWritten;
+    if (numFramesInChunk > NUM_FRAMES_PER_CHUNK) numFramesInChunk = NUM_FRAMES_PER_CHUNK;
+    for (int i = 0; i < numChannels; i++) {
+      float *buffer = job->tableBuffers[i]->getBuffer() + job->skip + numFramesWritten;
+      for (int j = 0, k = i; j < numFramesInChunk; j++, k += numChannels) {
+        chunk[k] = buffer[j];
+      }
+    }
+    sf_count_t n = sf_writef_float(sndFile, chunk, numFramesInChunk);
+    if (n <= 0) break;
+    numFramesWritten += n;
+  }
+  free(chunk);
+  sf_close(sndFile);
+  job->numFrames = numFramesWritten;
+}
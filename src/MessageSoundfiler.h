@@ -23,10 +23,26 @@
 #ifndef _MESSAGE_SOUNDFILER_H_
 #define _MESSAGE_SOUNDFILER_H_
 
+#include <queue>
+#include "DiskStreamService.h"
 #include "MessageObject.h"
 
-/** [soundfiler~] */
-class MessageSoundfiler : public MessageObject {
+typedef struct SoundfilerJob SoundfilerJob;
+
+/**
+ * [soundfiler]
+ * Reads soundfiles into tables and writes tables to soundfiles. By default this happens
+ * immediately, as in Pd. With the <code>-async</code> flag the file is instead decoded or encoded
+ * by the context's disk thread. A decoded file is read into fresh buffers which are published as
+ * new versions of the tables at the beginning of a block, and the number of frames is sent from
+ * the outlet once this has happened. A file is written from retained snapshots of the tables.
+ *
+ * With the <code>-map</code> flag, tables are instead backed by memory mapped
+ * <code>SoundfileCache</code> files, which are generated on first use. The mapped samples are
+ * shared with every other table of the same file, and are paged in as they are played (or in
+ * advance with <code>-prefetch</code>). Mapped tables always take the length of the file.
+ */
+class MessageSoundfiler : public MessageObject, public DiskStream {
   
   public:
     static MessageObject *newObject(PdMessage *initMessage, PdGraph *graph);
@@ -35,9 +51,47 @@ class MessageSoundfiler : public MessageObject {
   
     static const char *getObjectLabel();
     std::string toString();
+    ObjectType getObjectType();
+  
+    void complete();
+  
+  protected:
+    void executeCommand(DiskStreamCommand *command);
+    void transfer();
     
   private:
     void processMessage(int inletIndex, PdMessage *message);
+  
+    /** Returns a new job described by the message, or NULL if the message is malformed. */
+    SoundfilerJob *newReadJob(PdMessage *message, bool *isAsync);
+    SoundfilerJob *newWriteJob(PdMessage *message, bool *isAsync);
+  
+    /** Executes a job. May be called from any thread. */
+    void readFile(SoundfilerJob *job);
+    void writeFile(SoundfilerJob *job);
+  
+    /** Backs the tables of a read job with memory mapped cache files. */
+    void readMappedFile(SoundfilerJob *job, const char *fullPath);
+  
+    /**
+     * Installs the buffers of a finished read job in their tables, reports any error, and sends
+     * the number of frames from the outlet. Called only by the audio thread.
+     */
+    void finishJob(SoundfilerJob *job, double timestamp);
+  
+    /** Hands finished jobs to the disk thread to be freed. Called only by the audio thread. */
+    void releaseJobs();
+  
+    void freeJob(SoundfilerJob *job);
+  
+    // audio thread state
+    queue<SoundfilerJob *> runningJobs; // jobs which have been handed to the disk thread, in order
+    queue<SoundfilerJob *> finishedJobs; // jobs which are waiting to be handed back to be freed
+  
+    // disk thread state
+    bool hasUndeliveredCompletion;
+    bool isDeleting;
+    DiskStreamService *diskStreamService;
 };
 
 inline const char *MessageSoundfiler::getObjectLabel() {
@@ -48,4 +102,8 @@ inline std::string MessageSoundfiler::toString() {
   return MessageSoundfiler::getObjectLabel();
 }
 
+inline ObjectType MessageSoundfiler::getObjectType() {
+  return MESSAGE_SOUNDFILER;
+}
+
 #endif // _MESSAGE_SOUNDFILER_H_
@@ -21,11 +21,15 @@
  */
 
 #include "ArrayArithmetic.h"
+#include "DiskStreamService.h"
 #include "MessageTable.h"
+#include "PdContext.h"
 #include "PdGraph.h"
 
 #define DEFAULT_BUFFER_LENGTH 1024
 
+volatile unsigned int MessageTable::numVersions = 0;
+
 MessageObject *MessageTable::newObject(PdMessage *initMessage, PdGraph *graph) {
   return new MessageTable(initMessage, graph);
 }
@@ -34,40 +38,56 @@ MessageTable::MessageTable(PdMessage *initMessage, PdGraph *graph) : RemoteMessa
   if (initMessage->isSymbol(0)) {
     name = StaticUtils::copyString(initMessage->getSymbol(0));
     // by default, the buffer length is 1024. The buffer should never be NULL.
-    bufferLength = initMessage->isFloat(1) ? (int) initMessage->getFloat(1) : DEFAULT_BUFFER_LENGTH;
-    buffer = (float *) calloc(bufferLength, sizeof(float));
+    int bufferLength = initMessage->isFloat(1) ? (int) initMessage->getFloat(1) : DEFAULT_BUFFER_LENGTH;
+    tableBuffer = new TableBuffer((float *) calloc(bufferLength, sizeof(float)), bufferLength,
+        __sync_fetch_and_add(&numVersions, 1));
   } else {
     name = NULL;
-    buffer = NULL;
-    bufferLength = 0;
+    tableBuffer = new TableBuffer(NULL, 0, __sync_fetch_and_add(&numVersions, 1));
     graph->printErr("Object \"table\" must be initialised with a name.");
   }
 }
 
 MessageTable::~MessageTable() {
   free(name);
-  free(buffer);
+  // readers may still hold a snapshot of the current version
+  tableBuffer->release();
+  graph->getContext()->getDiskStreamService()->retireTableBuffer(tableBuffer);
 }
 
 float *MessageTable::getBuffer(int *bufferLength) {
-  *bufferLength = this->bufferLength;
-  return buffer;
+  TableBuffer *currentTableBuffer = tableBuffer;
+  *bufferLength = currentTableBuffer->getLength();
+  return currentTableBuffer->getBuffer();
 }
 
 float *MessageTable::resizeBuffer(int newBufferLength) {
-  if (newBufferLength > 0) {
+  TableBuffer *currentTableBuffer = tableBuffer;
+  if (newBufferLength > 0 && newBufferLength != currentTableBuffer->getLength()) {
     // the new buffer length must be positive
-    buffer = (float *) realloc(buffer, newBufferLength * sizeof(float));
-    if (newBufferLength > bufferLength) {
-      // clear the new portion of the buffer
-      memset(buffer+bufferLength, 0, (newBufferLength-bufferLength) * sizeof(float));
-    }
-    bufferLength = newBufferLength;
-    // NOTE(mhroth): this code does not check to see if the returned buffer from realloc
-    // is non-NULL. It assumes that realloc is always successful. This is slightly dangerous and
-    // could lead to problems.
+    float *buffer = (float *) calloc(newBufferLength, sizeof(float));
+    int bufferLength = currentTableBuffer->getLength();
+    memcpy(buffer, currentTableBuffer->getBuffer(),
+        ((newBufferLength < bufferLength) ? newBufferLength : bufferLength) * sizeof(float));
+    currentTableBuffer = new TableBuffer(buffer, newBufferLength, __sync_fetch_and_add(&numVersions, 1));
+    publish(currentTableBuffer);
   }
-  return buffer;
+  return currentTableBuffer->getBuffer();
+}
+
+void MessageTable::setBuffer(float *newBuffer, int newBufferLength) {
+  publish(new TableBuffer(newBuffer, newBufferLength, __sync_fetch_and_add(&numVersions, 1)));
+}
+
+void MessageTable::setMappedBuffer(float *newBuffer, int newBufferLength, void *mapping, size_t mappingLength) {
+  publish(new TableBuffer(newBuffer, newBufferLength, __sync_fetch_and_add(&numVersions, 1),
+      mapping, mappingLength));
+}
+
+void MessageTable::publish(TableBuffer *newTableBuffer) {
+  TableBuffer *oldTableBuffer = __sync_lock_test_and_set(&tableBuffer, newTableBuffer);
+  oldTableBuffer->release(); // the table no longer refers to the old version
+  graph->getContext()->getDiskStreamService()->retireTableBuffer(oldTableBuffer);
 }
 
 void MessageTable::processMessage(int inletIndex, PdMessage *message) {
@@ -80,6 +100,8 @@ void MessageTable::processMessage(int inletIndex, PdMessage *message) {
     // write the contents of the table to file
   } else if (message->isSymbol(0, "normalize")) {
     // normalise the contents of the table to the given value. Default to 1.
+    int bufferLength = 0;
+    float *buffer = getBuffer(&bufferLength);
     #if __APPLE__
     float sum = 0.0f;
     vDSP_sve(buffer, 1, &sum, bufferLength);
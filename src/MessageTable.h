@@ -24,6 +24,7 @@
 #define _MESSAGE_TABLE_H_
 
 #include "RemoteMessageReceiver.h"
+#include "TableBuffer.h"
 
 /** [table name] */
 class MessageTable : public RemoteMessageReceiver {
@@ -37,24 +38,53 @@ class MessageTable : public RemoteMessageReceiver {
     std::string toString();
     ObjectType getObjectType();
   
+    /**
+     * Returns a snapshot of the table's current storage. The buffer and length of a snapshot are
+     * always consistent, and remain valid until the end of the current block. Readers should take
+     * one snapshot per block (or message) rather than calling <code>getBuffer()</code> repeatedly.
+     */
+    TableBuffer *getTableBuffer();
+  
     /** Get a pointer to the table's buffer. */
     float *getBuffer(int *bufferLength);
   
     /**
      * Resize the table's buffer to the given buffer length. A pointer to the new buffer is returned.
      * If the size of the requested buffer is the same as the current size, then the current
-     * buffer is returned.
+     * buffer is returned. Otherwise a new version is published and the contents are copied.
      */
     float *resizeBuffer(int bufferLength);
   
+    /**
+     * Replaces the table's contents with the given buffer, which must have been allocated with
+     * <code>malloc()</code> and now belongs to the table. This does not lock, and may be called
+     * from any thread. Readers pick up the new buffer at their next snapshot.
+     */
+    void setBuffer(float *newBuffer, int newBufferLength);
+  
+    /**
+     * As <code>setBuffer()</code>, but the buffer points into the given memory mapping, which now
+     * belongs to the table and is unmapped once the buffer is no longer in use.
+     */
+    void setMappedBuffer(float *newBuffer, int newBufferLength, void *mapping, size_t mappingLength);
+  
   private:
     // tables can receive sent messages
     void processMessage(int inletIndex, PdMessage *message);
   
-    float *buffer;
-    int bufferLength;
+    /** Makes the given version current and retires the previous one. */
+    void publish(TableBuffer *newTableBuffer);
+  
+    TableBuffer * volatile tableBuffer;
+  
+    /** The number of versions published by all tables, from which each new version is numbered. */
+    static volatile unsigned int numVersions;
 };
 
+inline TableBuffer *MessageTable::getTableBuffer() {
+  return tableBuffer;
+}
+
 inline const char *MessageTable::getObjectLabel() {
   return "table";
 }
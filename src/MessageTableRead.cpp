@@ -48,8 +48,9 @@ void MessageTableRead::processMessage(int inletIndex, PdMessage *message) {
   switch (message->getType(0)) {
     case FLOAT: {
       if (table != NULL) {
-        int bufferLength = 0;
-        float *buffer = table->getBuffer(&bufferLength);
+        TableBuffer *tableBuffer = table->getTableBuffer();
+        int bufferLength = tableBuffer->getLength();
+        float *buffer = tableBuffer->getBuffer();
         int index = (int) message->getFloat(0);
         if (index >= 0 && index < bufferLength) {
           PdMessage *outgoingMessage = PD_MESSAGE_ON_STACK(1);
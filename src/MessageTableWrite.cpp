@@ -55,8 +55,9 @@ void MessageTableWrite::processMessage(int inletIndex, PdMessage *message) {
       switch (message->getType(0)) {
         case FLOAT: {
           if (table != NULL) {
-            int bufferLength = 0;
-            float *buffer = table->getBuffer(&bufferLength);
+            TableBuffer *tableBuffer = table->getTableBuffer();
+            int bufferLength = tableBuffer->getLength();
+            float *buffer = tableBuffer->getBuffer();
             if (index >= 0 && index < bufferLength) {
               buffer[index] = message->getFloat(0);
             }
@@ -74,6 +74,7 @@
 #include "MessageOutlet.h"
 #include "MessagePack.h"
 #include "MessagePipe.h"
+#include "MessagePoly.h"
 #include "MessagePow.h"
 #include "MessagePowToDb.h"
 #include "MessagePrint.h"
@@ -112,14 +113,19 @@
 #include "DspAdd.h"
 #include "DspBandpassFilter.h"
 #include "DspBang.h"
+#include "DspBiquad.h"
 #include "DspCatch.h"
 #include "DspClip.h"
 #include "DspCosine.h"
 #include "DspDac.h"
 #include "DspDelayRead.h"
+#include "DspDelayTaps.h"
 #include "DspDelayWrite.h"
 #include "DspDivide.h"
 #include "DspEnvelope.h"
+#include "DspExpression.h"
+#include "DspFdn.h"
+#include "DspFilterExpression.h"
 #include "DspHighpassFilter.h"
 #include "DspInlet.h"
 #include "DspLine.h"
@@ -132,6 +138,7 @@
 #include "DspOutlet.h"
 #include "DspPhasor.h"
 #include "DspPrint.h"
+#include "DspReadSoundfile.h"
 #include "DspReceive.h"
 #include "DspReciprocalSqrt.h"
 #include "DspRfft.h"
@@ -141,6 +148,7 @@
 #include "DspSqrt.h"
 #include "DspSnapshot.h"
 #include "DspSubtract.h"
+#include "DspTableOsc4.h"
 #include "DspTablePlay.h"
 #include "DspTableRead.h"
 #include "DspTableRead4.h"
@@ -149,8 +157,11 @@
 #include "DspVariableLine.h"
 #include "DspVCF.h"
 #include "DspWrap.h"
+#include "DspWriteSoundfile.h"
 
 ObjectFactoryMap::ObjectFactoryMap() {
+  version = 0;
+
   // these objects represent the core set of supported objects
   
   // message objects
@@ -208,6 +219,7 @@ ObjectFactoryMap::ObjectFactoryMap() {
   objectFactoryMap[string(MessageOutlet::getObjectLabel())] = &MessageOutlet::newObject;
   objectFactoryMap[string(MessagePack::getObjectLabel())] = &MessagePack::newObject;
   objectFactoryMap[string(MessagePipe::getObjectLabel())] = &MessagePipe::newObject;
+  objectFactoryMap[string(MessagePoly::getObjectLabel())] = &MessagePoly::newObject;
   objectFactoryMap[string(MessagePow::getObjectLabel())] = &MessagePow::newObject;
   objectFactoryMap[string(MessagePowToDb::getObjectLabel())] = &MessagePowToDb::newObject;
   objectFactoryMap[string(MessagePrint::getObjectLabel())] = &MessagePrint::newObject;
@@ -252,14 +264,19 @@ ObjectFactoryMap::ObjectFactoryMap() {
   objectFactoryMap[string(DspAdd::getObjectLabel())] = &DspAdd::newObject;
   objectFactoryMap[string(DspBandpassFilter::getObjectLabel())] = &DspBandpassFilter::newObject;
   objectFactoryMap[string(DspBang::getObjectLabel())] = &DspBang::newObject;
+  objectFactoryMap[string(DspBiquad::getObjectLabel())] = &DspBiquad::newObject;
   objectFactoryMap[string(DspCatch::getObjectLabel())] = &DspCatch::newObject;
   objectFactoryMap[string(DspClip::getObjectLabel())] = &DspClip::newObject;
   objectFactoryMap[string(DspCosine::getObjectLabel())] = &DspCosine::newObject;
   objectFactoryMap[string(DspDac::getObjectLabel())] = &DspDac::newObject;
   objectFactoryMap[string(DspDelayRead::getObjectLabel())] = &DspDelayRead::newObject;
+  objectFactoryMap[string(DspDelayTaps::getObjectLabel())] = &DspDelayTaps::newObject;
   objectFactoryMap[string(DspDelayWrite::getObjectLabel())] = &DspDelayWrite::newObject;
   objectFactoryMap[string(DspDivide::getObjectLabel())] = &DspDivide::newObject;
   objectFactoryMap[string(DspEnvelope::getObjectLabel())] = &DspEnvelope::newObject;
+  objectFactoryMap[string(DspExpression::getObjectLabel())] = &DspExpression::newObject;
+  objectFactoryMap[string(DspFdn::getObjectLabel())] = &DspFdn::newObject;
+  objectFactoryMap[string(DspFilterExpression::getObjectLabel())] = &DspFilterExpression::newObject;
   objectFactoryMap[string(DspHighpassFilter::getObjectLabel())] = &DspHighpassFilter::newObject;
   objectFactoryMap[string(DspInlet::getObjectLabel())] = &DspInlet::newObject;
   objectFactoryMap[string(DspLine::getObjectLabel())] = &DspLine::newObject;
@@ -272,6 +289,7 @@ ObjectFactoryMap::ObjectFactoryMap() {
   objectFactoryMap[string(DspOutlet::getObjectLabel())] = &DspOutlet::newObject;
   objectFactoryMap[string(DspPhasor::getObjectLabel())] = &DspPhasor::newObject;
   objectFactoryMap[string(DspPrint::getObjectLabel())] = &DspPrint::newObject;
+  objectFactoryMap[string(DspReadSoundfile::getObjectLabel())] = &DspReadSoundfile::newObject;
   objectFactoryMap[string(DspReceive::getObjectLabel())] = &DspReceive::newObject;
   objectFactoryMap[string("r~")] = &DspReceive::newObject;
   objectFactoryMap[string(DspReciprocalSqrt::getObjectLabel())] = &DspReciprocalSqrt::newObject;
@@ -285,13 +303,16 @@ ObjectFactoryMap::ObjectFactoryMap() {
   objectFactoryMap[string(DspSqrt::getObjectLabel())] = &DspSqrt::newObject;
   objectFactoryMap[string("q8_sqrt~")] = &DspSqrt::newObject;
   objectFactoryMap[string(DspSubtract::getObjectLabel())] = &DspSubtract::newObject;
+  objectFactoryMap[string(DspTableOsc4::getObjectLabel())] = &DspTableOsc4::newObject;
   objectFactoryMap[string(DspTablePlay::getObjectLabel())] = &DspTablePlay::newObject;
   objectFactoryMap[string(DspTableRead::getObjectLabel())] = &DspTableRead::newObject;
   objectFactoryMap[string(DspTableRead4::getObjectLabel())] = &DspTableRead4::newObject;
   objectFactoryMap[string(DspThrow::getObjectLabel())] = &DspThrow::newObject;
   objectFactoryMap[string(DspVariableDelay::getObjectLabel())] = &DspVariableDelay::newObject;
   objectFactoryMap[string(DspVariableLine::getObjectLabel())] = &DspVariableLine::newObject;
+  objectFactoryMap[string(DspVCF::getObjectLabel())] = &DspVCF::newObject;
   objectFactoryMap[string(DspWrap::getObjectLabel())] = &DspWrap::newObject;
+  objectFactoryMap[string(DspWriteSoundfile::getObjectLabel())] = &DspWriteSoundfile::newObject;
 }
 
 ObjectFactoryMap::~ObjectFactoryMap() {
@@ -300,13 +321,20 @@ ObjectFactoryMap::~ObjectFactoryMap() {
 
 void ObjectFactoryMap::registerExternalObject(const char *objectLabel, MessageObject *(*newObject)(PdMessage *, PdGraph *)) {
   objectFactoryMap[string(objectLabel)] = newObject;
+  version++;
 }
 
 void ObjectFactoryMap::unregisterExternalObject(const char *objectLabel) {
   objectFactoryMap.erase(string(objectLabel));
+  version++;
 }
 
 MessageObject *ObjectFactoryMap::newObject(const char *objectLabel, PdMessage *initMessage, PdGraph *graph) {
   MessageObject *(*newObject)(PdMessage *, PdGraph *) = objectFactoryMap[string(objectLabel)];
   return (newObject != NULL) ? newObject(initMessage, graph) : NULL;
 }
+
+ObjectFactory ObjectFactoryMap::getFactory(const char *objectLabel) {
+  map<string, ObjectFactory>::iterator it = objectFactoryMap.find(string(objectLabel));
+  return (it != objectFactoryMap.end()) ? it->second : NULL;
+}
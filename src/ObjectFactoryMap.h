@@ -31,6 +31,8 @@ class MessageObject;
 class PdGraph;
 class PdMessage;
 
+typedef MessageObject *(*ObjectFactory)(PdMessage *, PdGraph *);
+
 class ObjectFactoryMap {
   public:
     ObjectFactoryMap();
@@ -41,8 +43,18 @@ class ObjectFactoryMap {
   
     MessageObject *newObject(const char *objectLable, PdMessage *initMessage, PdGraph *graph);
   
+    /** Returns the factory of the given object label, or NULL if there is none. */
+    ObjectFactory getFactory(const char *objectLabel);
+  
+    /**
+     * Returns a number which changes whenever an object is registered or unregistered, such that
+     * factories which have been looked up before may be kept until then.
+     */
+    unsigned int getVersion() { return version; }
+  
   private:
     map<string, MessageObject *(*)(PdMessage *, PdGraph *)> objectFactoryMap;
+    unsigned int version;
 };
 
 #endif // _OBJECT_FACTORY_MAP_H_
@@ -34,20 +34,26 @@ enum ObjectType {
   DSP_DAC,
   DSP_TABLE_PLAY,
   DSP_DELAY_READ,
+  DSP_DELAY_TAPS,
   DSP_DELAY_WRITE,
+  DSP_FUSED_CHAIN,
+  DSP_READ_SOUNDFILE,
   DSP_INLET,
   DSP_OUTLET,
   DSP_RECEIVE,
   DSP_SEND,
+  DSP_TABLE_OSC4,
   DSP_TABLE_READ,
   DSP_TABLE_READ4,
   DSP_THROW,
   DSP_VARIABLE_DELAY,
+  DSP_WRITE_SOUNDFILE,
   MESSAGE_INLET,
   MESSAGE_NOTEIN,
   MESSAGE_OUTLET,
   MESSAGE_RECEIVE,
   MESSAGE_SEND,
+  MESSAGE_SOUNDFILER,
   MESSAGE_TABLE,
   MESSAGE_TABLE_READ,
   MESSAGE_TABLE_WRITE,
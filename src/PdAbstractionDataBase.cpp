@@ -21,25 +21,31 @@
  */
 
 #include "PdAbstractionDataBase.h"
+#include "PdPatch.h"
 
-PdAbstractionDataBase::PdAbstractionDataBase() {}
+PdAbstractionDataBase::PdAbstractionDataBase() : resolvedPatches(NULL) {}
 
 PdAbstractionDataBase::PdAbstractionDataBase(const PdAbstractionDataBase &db)
-  : database(db.database) {}
+  : database(db.database), resolvedPatches(NULL) {}
 
-PdAbstractionDataBase::~PdAbstractionDataBase() {}
+PdAbstractionDataBase::~PdAbstractionDataBase() {
+  removeAllPatches();
+}
 
 PdAbstractionDataBase &PdAbstractionDataBase::operator=(const PdAbstractionDataBase &db) {
   database = db.database;
+  removeAllPatches();
   return *this;
 }
 
 void PdAbstractionDataBase::addAbstraction(const std::string &key, const std::string &abstraction) {
   database[key] = abstraction;
+  removePatch(key);
 }
 
 void PdAbstractionDataBase::removeAbstraction(const std::string &key) {
   database.erase(key);
+  removePatch(key);
 }
 
 std::string PdAbstractionDataBase::getAbstraction(const std::string &key) const {
@@ -49,3 +55,36 @@ std::string PdAbstractionDataBase::getAbstraction(const std::string &key) const
 bool PdAbstractionDataBase::existsAbstraction(const std::string &key) const {
   return (database.find(key) != database.end());
 }
+
+void PdAbstractionDataBase::addPatch(const std::string &key, PdPatch *patch) {
+  removePatch(key);
+  patches[key] = patch;
+}
+
+PdPatch *PdAbstractionDataBase::getPatch(const std::string &key) const {
+  std::map<std::string, PdPatch *>::const_iterator it = patches.find(key);
+  return (it != patches.end()) ? it->second : NULL;
+}
+
+void PdAbstractionDataBase::setResolvedPatches(std::vector<std::pair<std::string, PdPatch *> > *resolvedPatches) {
+  this->resolvedPatches = resolvedPatches;
+}
+
+void PdAbstractionDataBase::addResolvedPatch(const std::string &label, PdPatch *patch) {
+  if (resolvedPatches != NULL) resolvedPatches->push_back(std::make_pair(label, patch));
+}
+
+void PdAbstractionDataBase::removePatch(const std::string &key) {
+  std::map<std::string, PdPatch *>::iterator it = patches.find(key);
+  if (it != patches.end()) {
+    delete it->second;
+    patches.erase(it);
+  }
+}
+
+void PdAbstractionDataBase::removeAllPatches() {
+  for (std::map<std::string, PdPatch *>::iterator it = patches.begin(); it != patches.end(); ++it) {
+    delete it->second;
+  }
+  patches.clear();
+}
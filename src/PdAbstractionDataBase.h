@@ -25,6 +25,9 @@
 
 #include <string>
 #include <map>
+#include <vector>
+
+class PdPatch;
 
 /**
  * This class is used to register memory mapped abstractions so that the PdFileParser can
@@ -34,6 +37,9 @@
  * memorymapped abstractions using the ZenGarden functions declared in ZenGarden.h:
  * - zg_context_register_memorymapped_abstraction
  * - zg_context_unregister_memorymapped_abstraction
+ *
+ * The database also keeps the parsed patches of abstractions, such that each is parsed only once.
+ * See <code>PdFileParser::parseAbstraction()</code>.
  */
 
 class PdAbstractionDataBase {
@@ -49,8 +55,29 @@ public :
   std::string getAbstraction(const std::string &key) const;
   bool existsAbstraction(const std::string &key) const;
   
+  /**
+   * The parsed patches, by the label of a registered abstraction or by the path of a file. The
+   * database takes ownership of the patch, and deletes any which it replaces. Registering or
+   * unregistering an abstraction forgets its patch. Patches are not copied with the database.
+   */
+  void addPatch(const std::string &key, PdPatch *patch);
+  PdPatch *getPatch(const std::string &key) const;
+  
+  /**
+   * While a list is given, each patch returned by <code>PdFileParser::parseAbstraction()</code> is
+   * appended to it with the label by which it was found, such that the abstractions which a graph
+   * uses are known exactly. Pass <code>NULL</code> to stop.
+   */
+  void setResolvedPatches(std::vector<std::pair<std::string, PdPatch *> > *resolvedPatches);
+  void addResolvedPatch(const std::string &label, PdPatch *patch);
+  
 private :
+  void removePatch(const std::string &key);
+  void removeAllPatches();
+  
   std::map<std::string, std::string> database;
+  std::map<std::string, PdPatch *> patches;
+  std::vector<std::pair<std::string, PdPatch *> > *resolvedPatches;
   
 };
 
@@ -0,0 +1,357 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "BufferPool.h"
+#include "DspInlet.h"
+#include "DspOutlet.h"
+#include "MessageInlet.h"
+#include "MessageListPrepend.h"
+#include "MessageOutlet.h"
+#include "PdCloneGraph.h"
+#include "PdContext.h"
+#include "PdFileParser.h"
+#include "PdPatch.h"
+
+// the number of instances which are stepped through together
+#define NUM_INSTANCES_PER_BATCH 16
+
+MessageObject *PdCloneGraph::newObject(PdMessage *initMessage, PdGraph *graph, PdContext *context) {
+  int firstIndex = 0;
+  int nameIndex = 0;
+  if (initMessage->isSymbol(0, "-s") && initMessage->isFloat(1)) {
+    firstIndex = (int) initMessage->getFloat(1);
+    nameIndex = 2;
+  }
+  PdCloneGraph *cloneGraph = new PdCloneGraph(initMessage, graph, context,
+      initMessage->isSymbol(nameIndex) ? initMessage->getSymbol(nameIndex) : "", firstIndex);
+  if (!initMessage->isSymbol(nameIndex) || !initMessage->isFloat(nameIndex+1) ||
+      initMessage->getFloat(nameIndex+1) < 1.0f) {
+    graph->printErr("%s requires an abstraction and a positive number of instances.", getObjectLabel());
+    return cloneGraph;
+  }
+  int numInstances = (int) initMessage->getFloat(nameIndex+1);
+  
+  // each instance is given its index, followed by the remaining arguments
+  int numArguments = initMessage->getNumElements() - (nameIndex+2);
+  PdMessage *instanceMessage = PD_MESSAGE_ON_STACK(numArguments+1);
+  instanceMessage->initWithTimestampAndNumElements(0.0, numArguments+1);
+  memcpy(instanceMessage->getElement(1), initMessage->getElement(nameIndex+2),
+      numArguments * sizeof(MessageAtom));
+  
+  // the abstraction is parsed once, and every instance is made from the same patch
+  PdPatch *patch = PdFileParser::parseAbstraction(initMessage->getSymbol(nameIndex), graph, context);
+  cloneGraph->instances.reserve(numInstances);
+  for (int i = 0; i < numInstances; i++) {
+    instanceMessage->setFloat(0, (float) (firstIndex + i));
+    PdGraph *instance = (patch != NULL) ? patch->instantiate(instanceMessage, cloneGraph, context) : NULL;
+    if (instance == NULL) {
+      graph->printErr("%s: abstraction '%s' could not be instantiated.", getObjectLabel(),
+          initMessage->getSymbol(nameIndex));
+      break;
+    }
+    cloneGraph->instances.push_back(instance);
+  }
+  
+  cloneGraph->connectInstances();
+  return cloneGraph;
+}
+
+PdCloneGraph::PdCloneGraph(PdMessage *initMessage, PdGraph *graph, PdContext *context,
+    const char *abstractionName, int firstIndex) :
+    PdGraph(initMessage, graph, context, context->getNextGraphId(), abstractionName) {
+  this->abstractionName = string(abstractionName);
+  this->firstIndex = firstIndex;
+  currentInstance = 0;
+}
+
+PdCloneGraph::~PdCloneGraph() {
+  // the instances are deleted along with all other objects of the graph
+}
+
+string PdCloneGraph::toString() {
+  char str[snprintf(NULL, 0, "%s %s %i", getObjectLabel(), abstractionName.c_str(), getNumInstances())+1];
+  snprintf(str, sizeof(str), "%s %s %i", getObjectLabel(), abstractionName.c_str(), getNumInstances());
+  return string(str);
+}
+
+void PdCloneGraph::connectInstances() {
+  if (instances.empty()) return;
+  PdGraph *prototype = instances.front();
+  
+  // the inlets and outlets are ordered by their horizontal position in the graph
+  for (int i = 0; i < prototype->getNumInlets(); i++) {
+    if (prototype->getInletConnectionType(i) == DSP) {
+      DspInlet *dspInlet = new DspInlet(this);
+      addObject((float) i, 0.0f, dspInlet);
+      for (int j = 0; j < instances.size(); j++) {
+        addConnection(dspInlet, 0, instances[j], i);
+      }
+    } else {
+      // messages are passed on to the instances by receiveMessage()
+      addObject((float) i, 0.0f, new MessageInlet(this));
+    }
+  }
+  
+  PdMessage *prependMessage = PD_MESSAGE_ON_STACK(1);
+  for (int i = 0; i < prototype->getNumOutlets(); i++) {
+    if (prototype->getConnectionType(i) == DSP) {
+      // the outlets of all instances are summed, as with any signal connections to the same inlet
+      DspOutlet *dspOutlet = new DspOutlet(this);
+      addObject((float) i, 0.0f, dspOutlet);
+      for (int j = 0; j < instances.size(); j++) {
+        addConnection(instances[j], i, dspOutlet, 0);
+      }
+    } else {
+      prependMessage->initWithTimestampAndNumElements(0.0, 0);
+      MessageOutlet *messageOutlet = new MessageOutlet(prependMessage, this);
+      addObject((float) i, 0.0f, messageOutlet);
+      for (int j = 0; j < instances.size(); j++) {
+        prependMessage->initWithTimestampAndFloat(0.0, (float) (firstIndex + j));
+        MessageListPrepend *listPrepend = new MessageListPrepend(prependMessage, this);
+        addObject(0.0f, 0.0f, listPrepend);
+        addConnection(instances[j], i, listPrepend, 0);
+        addConnection(listPrepend, 0, messageOutlet, 0);
+      }
+    }
+  }
+}
+
+void PdCloneGraph::receiveMessage(int inletIndex, PdMessage *message) {
+  if (getInletConnectionType(inletIndex) != MESSAGE) {
+    printErr("%s: inlet %i only accepts signals.", getObjectLabel(), inletIndex);
+  } else if (message->isFloat(0)) {
+    sendMessageToInstance((int) message->getFloat(0) - firstIndex, inletIndex, message);
+  } else if (message->isSymbol(0, "next")) {
+    currentInstance = (currentInstance + 1 < getNumInstances()) ? currentInstance + 1 : 0;
+    sendMessageToInstance(currentInstance, inletIndex, message);
+  } else if (message->isSymbol(0, "this")) {
+    sendMessageToInstance(currentInstance, inletIndex, message);
+  } else if (message->isSymbol(0, "set")) {
+    if (message->isFloat(1)) {
+      int instanceIndex = (int) message->getFloat(1) - firstIndex;
+      if (instanceIndex >= 0 && instanceIndex < getNumInstances()) {
+        currentInstance = instanceIndex;
+      } else {
+        printErr("%s: instance %i is out of range.", getObjectLabel(), instanceIndex + firstIndex);
+      }
+    }
+  } else if (message->isSymbol(0, "all")) {
+    for (int i = 0; i < getNumInstances(); i++) {
+      sendMessageToInstance(i, inletIndex, message);
+    }
+  } else if (message->isSymbol(0, "vis")) {
+    // instances have no window to open
+  } else {
+    char *messageString = message->toString();
+    printErr("%s: no instance selected by message: %s", getObjectLabel(), messageString);
+    free(messageString);
+  }
+}
+
+void PdCloneGraph::sendMessageToInstance(int instanceIndex, int inletIndex, PdMessage *message) {
+  if (instanceIndex < 0 || instanceIndex >= getNumInstances()) {
+    printErr("%s: instance %i is out of range.", getObjectLabel(), instanceIndex + firstIndex);
+    return;
+  }
+  
+  // the selector is removed from the message. Nothing else makes a bang.
+  int numElements = message->getNumElements() - 1;
+  PdMessage *outgoingMessage = PD_MESSAGE_ON_STACK((numElements > 0) ? numElements : 1);
+  if (numElements > 0) {
+    outgoingMessage->initWithTimestampAndNumElements(message->getTimestamp(), numElements);
+    memcpy(outgoingMessage->getElement(0), message->getElement(1), numElements * sizeof(MessageAtom));
+  } else {
+    outgoingMessage->initWithTimestampAndBang(message->getTimestamp());
+  }
+  instances[instanceIndex]->receiveMessage(inletIndex, outgoingMessage);
+}
+
+
+#pragma mark - Lockstep
+
+list<DspObject *> PdCloneGraph::getProcessOrder() {
+  if (isOrdered) return list<DspObject *>();
+  
+  // restore the instances, should they no longer be processed in lockstep
+  for (int i = 0; i < lockstepInstances.size(); i++) {
+    lockstepInstances[i]->processFunction = &processGraph;
+  }
+  lockstepInstances.clear();
+  
+  bool isLockstep = getContext()->isDspVoiceGroupingEnabled() && getNumInstances() > 1;
+  for (int i = 0; i < getNumInstances() && isLockstep; i++) {
+    isLockstep = isSelfOrdered(instances[i]);
+  }
+  // stepping through the instances is only worthwhile if some of their objects can be grouped
+  isLockstep = isLockstep && hasGroupableObjects(instances[0]);
+  
+  // no buffer which is released while the clone is ordered is reused within it
+  BufferPool *bufferPool = getBufferPool();
+  if (isLockstep) bufferPool->holdReleasedBuffers();
+  list<DspObject *> processOrder = PdGraph::getProcessOrder();
+  if (isLockstep) bufferPool->releaseHeldBuffers();
+  
+  if (isLockstep) {
+    // instances which have been folded out of the process order are not processed
+    for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
+      DspObject *dspObject = *it;
+      if (dspObject->getObjectType() == OBJECT_PD) {
+        dspObject->processFunction = lockstepInstances.empty() ? &processInstances : &processNothing;
+        lockstepInstances.push_back(reinterpret_cast<PdGraph *>(dspObject));
+      }
+    }
+    int numInstances = lockstepInstances.size();
+    steppingInstances.resize(numInstances);
+    steppingNodes.resize(numInstances);
+    isWatching.resize(numInstances);
+    stepObjects.resize(numInstances);
+    stepFunctions.resize(numInstances);
+    groupObjects.resize(numInstances);
+  }
+  return processOrder;
+}
+
+bool PdCloneGraph::isSelfOrdered(PdGraph *graph) {
+  list<MessageObject *> nodeList = graph->getNodeList();
+  for (list<MessageObject *>::iterator it = nodeList.begin(); it != nodeList.end(); ++it) {
+    MessageObject *messageObject = *it;
+    switch (messageObject->getObjectType()) {
+      case DSP_CATCH:
+      case DSP_DAC:
+      case DSP_DELAY_READ:
+      case DSP_DELAY_TAPS:
+      case DSP_DELAY_WRITE:
+      case DSP_RECEIVE:
+      case DSP_SEND:
+      case DSP_TABLE_OSC4:
+      case DSP_TABLE_PLAY:
+      case DSP_TABLE_READ:
+      case DSP_TABLE_READ4:
+      case DSP_THROW:
+      case DSP_VARIABLE_DELAY:
+      case MESSAGE_TABLE: return false;
+      case OBJECT_PD: {
+        if (!isSelfOrdered(reinterpret_cast<PdGraph *>(messageObject))) return false;
+        break;
+      }
+      default: break;
+    }
+  }
+  return true;
+}
+
+bool PdCloneGraph::hasGroupableObjects(PdGraph *graph) {
+  list<MessageObject *> nodeList = graph->getNodeList();
+  for (list<MessageObject *>::iterator it = nodeList.begin(); it != nodeList.end(); ++it) {
+    MessageObject *messageObject = *it;
+    if (messageObject->doesProcessAudio() &&
+        reinterpret_cast<DspObject *>(messageObject)->getGroupProcessFunction() != NULL) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PdCloneGraph::processInstances(DspObject *dspObject, int fromIndex, int toIndex) {
+  PdCloneGraph *d = reinterpret_cast<PdCloneGraph *>(reinterpret_cast<PdGraph *>(dspObject)->parentGraph);
+  d->processInstancesInLockstep();
+}
+
+void PdCloneGraph::processNothing(DspObject *dspObject, int fromIndex, int toIndex) {
+  // the instance has already been processed along with the first one
+}
+
+void PdCloneGraph::processInstancesInLockstep() {
+  // each instance decides whether it sleeps, as in processGraph()
+  int numStepping = 0;
+  for (int i = 0; i < lockstepInstances.size(); i++) {
+    PdGraph *instance = lockstepInstances[i];
+    if (!instance->switched) continue;
+    bool isInstanceWatching = instance->canSleep();
+    if (instance->isAsleep) {
+      if (isInstanceWatching) {
+        instance->processAsleep();
+        continue;
+      }
+      instance->isAsleep = false;
+    }
+    if (isInstanceWatching) instance->beginWatching();
+    if (instance->dspNodeList.empty()) {
+      if (isInstanceWatching) instance->endWatching();
+      continue;
+    }
+    steppingInstances[numStepping] = instance;
+    steppingNodes[numStepping] = instance->dspNodeList.begin();
+    isWatching[numStepping] = isInstanceWatching;
+    numStepping++;
+  }
+  
+  // the instances are stepped through in batches, such that the buffers of a batch stay in the
+  // cache while it is processed
+  for (int first = 0; first < numStepping; first += NUM_INSTANCES_PER_BATCH) {
+    int numBatched = numStepping - first;
+    stepInstances(first, (numBatched < NUM_INSTANCES_PER_BATCH) ? numBatched : NUM_INSTANCES_PER_BATCH);
+  }
+}
+
+void PdCloneGraph::stepInstances(int first, int numInstances) {
+  int end = first + numInstances;
+  while (end > first) {
+    // process the next object of every instance, together with its counterparts where possible.
+    // The instances are independent of each other, such that their order does not matter.
+    for (int i = first; i < end; i++) {
+      stepObjects[i] = *steppingNodes[i];
+      stepFunctions[i] = stepObjects[i]->getGroupProcessFunction();
+      if (stepFunctions[i] == NULL) {
+        stepObjects[i]->processFunction(stepObjects[i], 0, blockSizeInt);
+      }
+    }
+    for (int i = first; i < end; i++) {
+      DspGroupProcessFunction groupProcessFunction = stepFunctions[i];
+      if (groupProcessFunction != NULL) {
+        int numGroupObjects = 0;
+        for (int j = i; j < end; j++) {
+          if (stepFunctions[j] == groupProcessFunction) {
+            groupObjects[numGroupObjects++] = stepObjects[j];
+            stepFunctions[j] = NULL;
+          }
+        }
+        groupProcessFunction(&groupObjects[0], numGroupObjects, blockSizeInt);
+      }
+    }
+    
+    // watch each instance and move on to its next object. Finished instances are removed.
+    for (int i = end-1; i >= first; i--) {
+      PdGraph *instance = steppingInstances[i];
+      if (isWatching[i]) isWatching[i] = instance->watch(stepObjects[i]);
+      if (++steppingNodes[i] == instance->dspNodeList.end()) {
+        if (isWatching[i]) instance->endWatching();
+        end--;
+        steppingInstances[i] = steppingInstances[end];
+        steppingNodes[i] = steppingNodes[end];
+        isWatching[i] = isWatching[end];
+        stepObjects[i] = stepObjects[end];
+      }
+    }
+  }
+}
@@ -0,0 +1,137 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _PD_CLONE_GRAPH_H_
+#define _PD_CLONE_GRAPH_H_
+
+#include "PdGraph.h"
+
+/**
+ * [clone]
+ * A graph which holds a fixed number of instances of the same abstraction. The abstraction is
+ * read only once, and all instances are made from it when the object is created, such that voices
+ * are never instantiated while the patch is running. Each instance receives its index as
+ * <code>$1</code>, followed by any further arguments to <code>[clone]</code>. The init message is
+ * <code>[-s &lt;first index&gt;] &lt;abstraction&gt; &lt;n&gt; [arguments...]</code>, and instances are
+ * numbered from zero by default.
+ *
+ * The inlets and outlets of the clone are those of the abstraction. Signal inlets feed all
+ * instances, and the signal outlets of all instances are summed. A message to an inlet is passed
+ * to one instance, as selected by its first element: an instance index, <code>next</code>,
+ * <code>this</code>, or <code>all</code>. The selector is removed from the message. Messages from
+ * instances are output with the instance index prepended.
+ *
+ * Instances which are not playing do not cost anything, as they go to sleep once their outputs
+ * have decayed to silence. See <code>PdGraph::isAtRest()</code>.
+ *
+ * If voice grouping is turned on in the context, instances which do not communicate by name, e.g.
+ * through [send~] or [delwrite~], and which contain objects that may be grouped, are processed in
+ * lockstep: the first object of every instance, then the second, and so on. Counterparts which
+ * allow it are processed together, see <code>DspObject::getGroupProcessFunction()</code>. Every
+ * instance is then given its own buffers, such that none of them overwrites those of another
+ * before they have been read.
+ */
+class PdCloneGraph : public PdGraph {
+  
+  public:
+    /**
+     * Creates a clone with all of its instances. An empty clone is returned if the abstraction
+     * cannot be found.
+     */
+    static MessageObject *newObject(PdMessage *initMessage, PdGraph *graph, PdContext *context);
+    ~PdCloneGraph();
+  
+    /** Passes the message on to the instance selected by its first element. */
+    void receiveMessage(int inletIndex, PdMessage *message);
+  
+    list<DspObject *> getProcessOrder();
+  
+    static const char *getObjectLabel() { return "clone"; }
+    string toString();
+  
+    /** Returns the number of instances. */
+    int getNumInstances() { return instances.size(); }
+  
+    /** Returns the instance with the given index, counted from zero regardless of the first index. */
+    PdGraph *getInstance(int instanceIndex) { return instances[instanceIndex]; }
+  
+  private:
+    PdCloneGraph(PdMessage *initMessage, PdGraph *graph, PdContext *context, const char *abstractionName,
+        int firstIndex);
+  
+    /**
+     * Creates the inlets and outlets of the clone as those of the first instance, and connects them
+     * to all instances.
+     */
+    void connectInstances();
+  
+    /** Sends the message without its first element to the instance at the given position. */
+    void sendMessageToInstance(int instanceIndex, int inletIndex, PdMessage *message);
+  
+    /**
+     * Returns true if no object in the graph or in its subgraphs exchanges signals with objects
+     * elsewhere by name, reads a table or declares one, or adds to the output of the context. The
+     * graph may then be processed at any point in the block after its inputs.
+     */
+    static bool isSelfOrdered(PdGraph *graph);
+  
+    /** Returns true if any object of the given graph may be processed together with its counterparts. */
+    static bool hasGroupableObjects(PdGraph *graph);
+  
+    /**
+     * The process function of the first instance in the process order of the clone while
+     * processing in lockstep, which processes all of them. The others do nothing.
+     */
+    static void processInstances(DspObject *dspObject, int fromIndex, int toIndex);
+    static void processNothing(DspObject *dspObject, int fromIndex, int toIndex);
+  
+    /** Processes the instances one object at a time, as <code>PdGraph::processGraph()</code>. */
+    void processInstancesInLockstep();
+  
+    /** Steps through the given range of <code>steppingInstances</code> until all are finished. */
+    void stepInstances(int first, int numInstances);
+  
+    /** All instances of the abstraction, in order of their index. The graph owns them as objects. */
+    vector<PdGraph *> instances;
+  
+    /** The index of the first instance. */
+    int firstIndex;
+  
+    /** The position of the instance to which <code>this</code> messages are sent. */
+    int currentInstance;
+  
+    string abstractionName;
+  
+    /** The instances which are processed in lockstep, or none. */
+    vector<PdGraph *> lockstepInstances;
+  
+    // the state of each instance while stepping through them, allocated ahead of processing
+    vector<PdGraph *> steppingInstances;
+    vector<list<DspObject *>::iterator> steppingNodes;
+    vector<bool> isWatching;
+    vector<DspObject *> stepObjects;
+    vector<DspGroupProcessFunction> stepFunctions;
+    vector<DspObject *> groupObjects;
+};
+
+#endif // _PD_CLONE_GRAPH_H_
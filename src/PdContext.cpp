@@ -20,12 +20,18 @@
  *
  */
 
+#include <algorithm>
+#include <time.h>
+#include "BlockDeadlineMonitor.h"
 #include "BufferPool.h"
+#include "DiskStreamService.h"
 #include "MessageSendController.h"
 #include "ObjectFactoryMap.h"
 #include "PdAbstractionDataBase.h"
 #include "PdContext.h"
 #include "PdFileParser.h"
+#include "SoundfileCache.h"
+#include "WavetableCache.h"
 
 #include "DelayReceiver.h"
 #include "DspCatch.h"
@@ -50,6 +56,7 @@ PdContext::PdContext(int numInputChannels, int numOutputChannels, int blockSize,
   callbackFunction = function;
   callbackUserData = userData;
   blockStartTimestamp = 0.0;
+  blockStartSample = 0;
   blockDurationMs = ((double) blockSize / (double) sampleRate) * 1000.0;
   messageCallbackQueue = new OrderedMessageQueue();
   objectFactoryMap = new ObjectFactoryMap();
@@ -67,6 +74,20 @@ PdContext::PdContext(int numInputChannels, int numOutputChannels, int blockSize,
 
   abstractionDatabase = new PdAbstractionDataBase();
   
+  profiling = false;
+  deadlineMonitor = new BlockDeadlineMonitor(blockDurationMs);
+  diskStreamService = new DiskStreamService();
+  wavetableCache = new WavetableCache(diskStreamService);
+  tableCacheDirectory = NULL;
+  cosineAccuracy = COSINE_ACCURACY_TABLE;
+  dspFusion = true;
+  dspFolding = true;
+  dspSleep = true;
+  dspVoiceGrouping = false;
+  numSkippedDspNodes = 0;
+  // unless a seed is given, every context is different
+  randomSeedSequence = (((uint64_t) time(NULL)) << 32) ^ ((uint64_t) (uintptr_t) this);
+  
   // configure the context lock, which is recursive
   pthread_mutexattr_t mta;
   pthread_mutexattr_init(&mta);
@@ -82,13 +103,19 @@ PdContext::~PdContext() {
   delete sendController;
   delete objectFactoryMap;
   delete bufferPool;
+  delete deadlineMonitor;
   
   // delete all of the PdGraphs in the graph list
   for (int i = 0; i < graphList.size(); i++) {
     delete graphList[i];
   }
+  
+  // the disk thread is stopped only once all objects which it services have been deleted
+  delete wavetableCache;
+  delete diskStreamService;
 
   delete abstractionDatabase;
+  free(tableCacheDirectory);
 
   pthread_mutex_destroy(&contextLock);
 }
@@ -136,6 +163,10 @@ double PdContext::getBlockStartTimestamp() {
   return blockStartTimestamp;
 }
 
+uint64_t PdContext::getBlockStartSample() {
+  return blockStartSample;
+}
+
 double PdContext::getBlockDuration() {
   return blockDurationMs;
 }
@@ -149,12 +180,16 @@ int PdContext::getNextGraphId() {
 
 void PdContext::process(float *inputBuffers, float *outputBuffers) {
   lock(); // lock the context
+  uint64_t blockStart = ProfileTimer::now();
   
   // set up adc~ buffers
   memcpy(globalDspInputBuffers, inputBuffers, numBytesInInputBuffers);
   
   // clear the global output audio buffers so that dac~ nodes can write to it
   memset(globalDspOutputBuffers, 0, numBytesInOutputBuffers);
+  
+  // let objects act on work which the disk thread has finished, e.g. by scheduling messages
+  diskStreamService->beginBlock();
 
   // Send all messages for this block
   ObjectMessageLetPair omlPair;
@@ -179,23 +214,52 @@ void PdContext::process(float *inputBuffers, float *outputBuffers) {
     message->freeMessage(); // free the message now that it has been sent and processed
   }
   
+  // recompute the process order where connections have changed, and unfold the folded objects which
+  // have received messages in place
+  for (int i = 0; i < graphList.size(); i++) {
+    if (!graphList[i]->isDspProcessOrderValid()) graphList[i]->computeDeepLocalDspProcessOrder();
+    graphList[i]->unfoldDspObjects();
+  }
+  uint64_t dspStart = ProfileTimer::now();
+  numSkippedDspNodes = 0;
+  
+  // keep track of the slowest graph. With only one graph it is simply the dsp time.
+  int slowestGraphId = -1;
+  uint64_t slowestGraphNs = 0;
   switch (graphList.size()) {
     case 0: break;
-    case 1: graphList.front()->processFunction(graphList.front(), 0, 0); break;
+    case 1: {
+      graphList.front()->processFunction(graphList.front(), 0, 0);
+      slowestGraphId = graphList.front()->getGraphId();
+      break;
+    }
     default: {
       int numGraphs = graphList.size();
       PdGraph **graph = &graphList.front();
+      uint64_t graphStart = dspStart;
       for (int i = 0; i < numGraphs; ++i) {
         graph[i]->processFunction(graph[i], 0, 0);
+        uint64_t graphEnd = ProfileTimer::now();
+        if (graphEnd - graphStart > slowestGraphNs) {
+          slowestGraphNs = graphEnd - graphStart;
+          slowestGraphId = graph[i]->getGraphId();
+        }
+        graphStart = graphEnd;
       }
     }
   }
   
   blockStartTimestamp = nextBlockStartTimestamp;
+  blockStartSample += blockSize;
   
   // copy the output audio to the given buffer
   memcpy(outputBuffers, globalDspOutputBuffers, numBytesInOutputBuffers);
   
+  uint64_t blockEnd = ProfileTimer::now();
+  if (graphList.size() == 1) slowestGraphNs = blockEnd - dspStart;
+  deadlineMonitor->recordBlock(dspStart - blockStart, blockEnd - dspStart, slowestGraphId, slowestGraphNs,
+      numSkippedDspNodes);
+  
   unlock(); // unlock the context
 }
 
@@ -207,6 +271,7 @@ void PdContext::attachGraph(PdGraph *graph) {
   graphList.push_back(graph);
   graph->attachToContext(true);
   graph->computeDeepLocalDspProcessOrder();
+  graph->setProfiling(profiling);
   unlock();
 }
 
@@ -215,9 +280,173 @@ void PdContext::unattachGraph(PdGraph *graph) {
   graphList.erase(std::remove(graphList.begin(), graphList.end(), graph),
     graphList.end());
   graph->attachToContext(false);
+  graph->setProfiling(false);
+  unlock();
+}
+
+
+#pragma mark - Profiling
+
+void PdContext::setProfiling(bool enabled) {
+  lock();
+  profiling = enabled;
+  for (int i = 0; i < graphList.size(); i++) {
+    graphList[i]->setProfiling(enabled);
+  }
+  unlock();
+}
+
+void PdContext::setDspFusion(bool enabled) {
+  lock();
+  dspFusion = enabled;
+  for (int i = 0; i < graphList.size(); i++) {
+    graphList[i]->setDspFusion(enabled);
+  }
   unlock();
 }
 
+void PdContext::setDspFolding(bool enabled) {
+  lock();
+  dspFolding = enabled;
+  for (int i = 0; i < graphList.size(); i++) {
+    graphList[i]->computeDeepLocalDspProcessOrder();
+  }
+  unlock();
+}
+
+void PdContext::setDspVoiceGrouping(bool enabled) {
+  lock();
+  dspVoiceGrouping = enabled;
+  for (int i = 0; i < graphList.size(); i++) {
+    graphList[i]->computeDeepLocalDspProcessOrder();
+  }
+  unlock();
+}
+
+void PdContext::resetProfile() {
+  lock();
+  for (int i = 0; i < graphList.size(); i++) {
+    graphList[i]->resetProfile();
+  }
+  unlock();
+}
+
+void PdContext::collectProfile(PdGraph *graph, string path, list<pair<string, DspObject *> > *entries) {
+  list<DspObject *> dspNodeList = graph->getDspNodeList();
+  for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
+    DspObject *dspObject = *it;
+    if (dspObject->getObjectType() == OBJECT_PD) {
+      PdGraph *subgraph = reinterpret_cast<PdGraph *>(dspObject);
+      char str[snprintf(NULL, 0, "%s/%s(%i)", path.c_str(), subgraph->toString().c_str(),
+          subgraph->getGraphId())+1];
+      snprintf(str, sizeof(str), "%s/%s(%i)", path.c_str(), subgraph->toString().c_str(),
+          subgraph->getGraphId());
+      collectProfile(subgraph, string(str), entries);
+    } else if (dspObject->profile.numCalls > 0) {
+      entries->push_back(make_pair(path, dspObject));
+    }
+  }
+}
+
+char *PdContext::getProfile() {
+  lock();
+  
+  // collect all profiled objects, and the total number of profiled blocks
+  list<pair<string, DspObject *> > entries;
+  unsigned int numBlocks = 0;
+  for (int i = 0; i < graphList.size(); i++) {
+    PdGraph *graph = graphList[i];
+    numBlocks = max(numBlocks, graph->profile.numCalls);
+    char str[snprintf(NULL, 0, "%s(%i)", graph->toString().c_str(), graph->getGraphId())+1];
+    snprintf(str, sizeof(str), "%s(%i)", graph->toString().c_str(), graph->getGraphId());
+    collectProfile(graph, string(str), &entries);
+  }
+  
+  uint64_t totalNs = 0;
+  for (list<pair<string, DspObject *> >::iterator it = entries.begin(); it != entries.end(); ++it) {
+    totalNs += it->second->profile.numNanoseconds;
+  }
+  
+  /*
+   * The dump is tab-separated with one object per line. Lines beginning with '#' are comments.
+   * The first section lists every object by subpatch, in process order. The second section
+   * aggregates all objects with the same label.
+   */
+  string dump;
+  char line[1024];
+  snprintf(line, sizeof(line), "# blocks %u\tblock_us %.3f\tdsp_us %.3f\n", numBlocks,
+      blockDurationMs * 1000.0, ((double) totalNs) / 1000.0);
+  dump += line;
+  dump += "# subpatch\tobject\tcalls\tmessages\ttotal_us\tavg_ns\tpercent\n";
+  map<string, pair<unsigned int, DspProfile> > labelMap;
+  for (list<pair<string, DspObject *> >::iterator it = entries.begin(); it != entries.end(); ++it) {
+    DspObject *dspObject = it->second;
+    DspProfile *profile = &(dspObject->profile);
+    string description = dspObject->toString();
+    snprintf(line, sizeof(line), "%s\t%s\t%u\t%u\t%.3f\t%.1f\t%.2f\n",
+        it->first.c_str(), description.c_str(), profile->numCalls, profile->numMessages,
+        ((double) profile->numNanoseconds) / 1000.0,
+        ((double) profile->numNanoseconds) / ((double) profile->numCalls),
+        (totalNs > 0) ? (100.0 * profile->numNanoseconds) / totalNs : 0.0);
+    dump += line;
+    
+    // the label is the first token of the object description, e.g. "osc~" of "osc~ 440"
+    string label = description.substr(0, description.find(' '));
+    pair<unsigned int, DspProfile> *labelEntry = &labelMap[label];
+    if (labelEntry->first == 0) memset(&(labelEntry->second), 0, sizeof(DspProfile));
+    labelEntry->first++;
+    labelEntry->second.numCalls += profile->numCalls;
+    labelEntry->second.numMessages += profile->numMessages;
+    labelEntry->second.numNanoseconds += profile->numNanoseconds;
+  }
+  
+  dump += "# label\tinstances\tcalls\tmessages\ttotal_us\tavg_ns\tpercent\n";
+  for (map<string, pair<unsigned int, DspProfile> >::iterator it = labelMap.begin();
+      it != labelMap.end(); ++it) {
+    DspProfile *profile = &(it->second.second);
+    snprintf(line, sizeof(line), "%s\t%u\t%u\t%u\t%.3f\t%.1f\t%.2f\n",
+        it->first.c_str(), it->second.first, profile->numCalls, profile->numMessages,
+        ((double) profile->numNanoseconds) / 1000.0,
+        ((double) profile->numNanoseconds) / ((double) profile->numCalls),
+        (totalNs > 0) ? (100.0 * profile->numNanoseconds) / totalNs : 0.0);
+    dump += line;
+  }
+  
+  unlock();
+  
+  return StaticUtils::copyString(dump.c_str());
+}
+
+
+#pragma mark - Block Statistics
+
+void PdContext::getBlockStatistics(ZGBlockStatistics *stats) {
+  deadlineMonitor->getStatistics(stats);
+}
+
+void PdContext::resetBlockStatistics() {
+  deadlineMonitor->reset();
+}
+
+void PdContext::printBlockStatistics() {
+  ZGBlockStatistics stats;
+  deadlineMonitor->getStatistics(&stats);
+  // times are printed in microseconds, as blocks are typically only a few milliseconds long
+  printStd("blockstats: %u blocks, %u overruns, deadline %.1fus", stats.numBlocks,
+      stats.numOverruns, stats.deadlineMs * 1000.0);
+  printStd("blockstats: min %.1fus avg %.1fus p99 %.1fus max %.1fus (%.1f%% of deadline)",
+      stats.minMs * 1000.0, stats.avgMs * 1000.0, stats.p99Ms * 1000.0, stats.maxMs * 1000.0,
+      (stats.deadlineMs > 0.0) ? (100.0 * stats.maxMs) / stats.deadlineMs : 0.0);
+  printStd("blockstats: messages avg %.1fus max %.1fus, dsp avg %.1fus max %.1fus",
+      stats.avgMessageMs * 1000.0, stats.maxMessageMs * 1000.0,
+      stats.avgDspMs * 1000.0, stats.maxDspMs * 1000.0);
+  if (stats.slowestGraphId >= 0) {
+    printStd("blockstats: slowest graph %i (%.1fus)", stats.slowestGraphId,
+        stats.slowestGraphMs * 1000.0);
+  }
+  printStd("blockstats: %.1f dsp objects asleep per block", stats.avgSkippedDspNodes);
+}
+
 
 #pragma mark - New Object
 
@@ -281,7 +510,7 @@ void PdContext::registerDspReceive(DspReceive *dspReceive) {
   // connect receive~ to associated send~
   DspSend *dspSend = getDspSend(dspReceive->getName());
   if (dspSend != NULL) {
-    dspReceive->setDspBufferAtInlet(dspSend->getDspBufferAtInlet(0), 0);
+    dspReceive->setDspBufferAtInlet(dspSend->getDspBufferAtOutlet(0), 0);
   }
 }
 
@@ -402,6 +631,12 @@ void PdContext::registerTable(MessageTable *table) {
   }
   tableList.push_back(table);
   
+  // replaced table buffers are deleted by the disk thread
+  diskStreamService->start();
+  
+  // the mipmaps of [tabosc4~] are kept per table name, and looked up without allocating
+  wavetableCache->addEntry(table->getName());
+  
   for (list<TableReceiverInterface *>::iterator it = tableReceiverList.begin();
       it != tableReceiverList.end(); it++) {
     // in case the table receiver doesn't have the table name yet
@@ -418,6 +653,17 @@ MessageTable *PdContext::getTable(const char *name) {
   return NULL;
 }
 
+void PdContext::setTableCacheDirectory(const char *directory) {
+  lock();
+  free(tableCacheDirectory);
+  tableCacheDirectory = (directory != NULL) ? StaticUtils::copyString(directory) : NULL;
+  unlock();
+}
+
+const char *PdContext::getTableCacheDirectory() {
+  return (tableCacheDirectory != NULL) ? tableCacheDirectory : SoundfileCache::getDefaultCacheDirectory();
+}
+
 void PdContext::registerTableReceiver(TableReceiverInterface *tableReceiver) {
   tableReceiverList.push_back(tableReceiver); // add the new receiver
   
@@ -433,6 +679,14 @@ void PdContext::unregisterTableReceiver(TableReceiverInterface *tableReceiver) {
   tableReceiver->setTable(NULL);
 }
 
+void PdContext::registerDiskStream(DiskStream *diskStream) {
+  diskStreamService->registerStream(diskStream);
+}
+
+void PdContext::unregisterDiskStream(DiskStream *diskStream) {
+  diskStreamService->unregisterStream(diskStream);
+}
+
 void PdContext::setValueForName(const char *name, float constant) {
   valueMap[string(name)] = constant;
 }
@@ -523,6 +777,8 @@ void PdContext::receiveSystemMessage(PdMessage *message) {
   // TODO(mhroth): What are all of the possible system messages?
   if (message->isSymbol(0, "obj")) {
     // TODO(mhroth): dynamic patching
+  } else if (message->isSymbol(0, "blockstats")) {
+    printBlockStatistics();
   } else if (callbackFunction != NULL) {
     if (message->isSymbol(0, "dsp") && message->isFloat(1)) {
       int result = (message->getFloat(1) != 0.0f) ? 1 : 0;
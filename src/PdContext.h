@@ -25,11 +25,18 @@
 
 #include <map>
 #include <pthread.h>
+#include "CosineEngine.h"
+#include "RandomGenerator.h"
 #include "OrderedMessageQueue.h"
 #include "PdGraph.h"
 #include "ZGCallbackFunction.h"
+#include "ZenGarden.h"
 
+class BlockDeadlineMonitor;
 class BufferPool;
+class DiskStream;
+class DiskStreamService;
+class WavetableCache;
 class DspCatch;
 class DelayReceiver;
 class DspDelayWrite;
@@ -115,8 +122,31 @@ class PdContext {
     void registerTableReceiver(TableReceiverInterface *tableReceiver);
     void unregisterTableReceiver(TableReceiverInterface *tableReceiver);
     
+    /** Globally register a [readsf~], [writesf~], or [soundfiler] object, such that its file is serviced by the disk thread. */
+    void registerDiskStream(DiskStream *diskStream);
+    void unregisterDiskStream(DiskStream *diskStream);
+    
     MessageTable *getTable(const char *name);
     
+    /** Sets the directory in which <code>SoundfileCache</code> files are kept. NULL selects the default. */
+    void setTableCacheDirectory(const char *directory);
+    
+    /** Returns the directory in which <code>SoundfileCache</code> files are kept. */
+    const char *getTableCacheDirectory();
+    
+    /**
+     * Restarts the sequence of seeds from which [noise~] and [random] objects are seeded when they
+     * are created. Graphs which are created in the same order after the same seed are repeatable.
+     */
+    void setRandomSeed(uint32_t seed) { randomSeedSequence = seed; }
+    
+    /** Returns the next seed for a new [noise~] or [random] object. */
+    uint32_t nextRandomSeed() { return RandomGenerator::nextSeed(&randomSeedSequence); }
+    
+    /** Selects how [osc~] and [cos~] compute cosines. The table is the default. */
+    void setCosineAccuracy(CosineAccuracy accuracy) { cosineAccuracy = accuracy; }
+    CosineAccuracy getCosineAccuracy() { return cosineAccuracy; }
+    
     /** Returns the named global <code>DspCatch</code> object. */
     DspCatch *getDspCatch(const char *name);
     
@@ -172,6 +202,12 @@ class PdContext {
     /** Returns the timestamp of the beginning of the current block. */
     double getBlockStartTimestamp();
     
+    /**
+     * Returns the index of the first sample of the current block, counted from the first block
+     * which the context has processed.
+     */
+    uint64_t getBlockStartSample();
+    
     /** Returns the duration in milliseconds of one block. */
     double getBlockDuration();
   
@@ -210,14 +246,87 @@ class PdContext {
     void unregisterExternalObject(const char *objectLabel);
   
     BufferPool *getBufferPool() { return bufferPool; }
+  
+    /** Returns the service which performs all disk access on behalf of the audio thread. */
+    DiskStreamService *getDiskStreamService() { return diskStreamService; }
+  
+    /** Returns the cache of band-limited wavetables shared by all [tabosc4~] objects. */
+    WavetableCache *getWavetableCache() { return wavetableCache; }
+  
+    /**
+     * Turns per-object profiling on or off for all attached graphs. Counters are not reset, such
+     * that profiling may be paused and resumed.
+     */
+    void setProfiling(bool enabled);
+    bool isProfiling() { return profiling; }
+  
+    /** Clears all profiling counters. */
+    void resetProfile();
+  
+    /**
+     * Turns the fusion of runs of elementwise dsp objects on or off for all graphs, including those
+     * which are already attached. It is on by default, and may be turned off for comparison.
+     */
+    void setDspFusion(bool enabled);
+    bool isDspFusionEnabled() { return dspFusion; }
+  
+    /**
+     * Turns constant folding and the removal of dead dsp objects on or off for all graphs,
+     * including those which are already attached. It is on by default, and may be turned off for
+     * comparison. See <code>DspGraphOptimiser</code>.
+     */
+    void setDspFolding(bool enabled);
+    bool isDspFoldingEnabled() { return dspFolding; }
+  
+    /**
+     * Turns the sleeping of silent subgraphs on or off for all graphs. It is on by default, and may
+     * be turned off for comparison. Sleeping graphs wake up with the next block. See
+     * <code>PdGraph::isAtRest()</code>.
+     */
+    void setDspSleep(bool enabled) { dspSleep = enabled; }
+    bool isDspSleepEnabled() { return dspSleep; }
+  
+    /**
+     * Turns the processing of the instances of each [clone] in lockstep on or off for all graphs,
+     * including those which are already attached. Their objects are then processed one step at a
+     * time across all instances, and counterparts which allow it, such as filters, are processed
+     * together. It is off by default, as it is no faster in the builds measured so far. See
+     * <code>PdCloneGraph</code>.
+     */
+    void setDspVoiceGrouping(bool enabled);
+    bool isDspVoiceGroupingEnabled() { return dspVoiceGrouping; }
+  
+    /** Counts the dsp objects which a sleeping graph has not processed in the current block. */
+    void recordSkippedDspNodes(unsigned int numDspNodes) { numSkippedDspNodes += numDspNodes; }
+  
+    /**
+     * Returns a human (and machine) readable dump of the profiling counters, grouped by subpatch
+     * and by object label. The returned string must be freed by the caller.
+     */
+    char *getProfile();
+  
+    /** Fills in a snapshot of the block timing statistics. Does not lock the context. */
+    void getBlockStatistics(ZGBlockStatistics *stats);
+  
+    /** Clears the block timing statistics, starting with the next block. */
+    void resetBlockStatistics();
+  
+    /** Prints a summary of the block timing statistics to standard output. */
+    void printBlockStatistics();
 
     PdAbstractionDataBase *getAbstractionDataBase();
   
+    /** Returns the factories of all objects which the context can create. */
+    ObjectFactoryMap *getObjectFactoryMap() { return objectFactoryMap; }
+  
   private:
     /** Returns <code>true</code> if the graph was successfully configured. <code>false</code> otherwise. */
     bool configureEmptyGraphWithParser(PdGraph *graph, PdFileParser *fileParser);
   
     void initObjectInitMap();
+  
+    /** Recursively collects the profile entries of the given graph. */
+    void collectProfile(PdGraph *graph, string path, list<pair<string, DspObject *> > *entries);
 
     int numInputChannels;
     int numOutputChannels;
@@ -245,6 +354,9 @@ class PdContext {
     /** The start of the current block in milliseconds. */
     double blockStartTimestamp;
     
+    /** The index of the first sample of the current block. */
+    uint64_t blockStartSample;
+    
     /** The duration of one block in milliseconds. */
     double blockDurationMs;
   
@@ -283,6 +395,34 @@ class PdContext {
     map<string,float> valueMap;
 
     PdAbstractionDataBase *abstractionDatabase;
+  
+    /** True if the attached graphs are currently being profiled. */
+    bool profiling;
+  
+    /** Records how long each block takes to process, relative to <code>blockDurationMs</code>. */
+    BlockDeadlineMonitor *deadlineMonitor;
+  
+    /** Owns the disk thread which services all [readsf~], [writesf~], and [soundfiler] objects. */
+    DiskStreamService *diskStreamService;
+  
+    /** Builds the band-limited wavetables of [tabosc4~] objects on the disk thread. */
+    WavetableCache *wavetableCache;
+  
+    /** The directory in which memory mapped tables are cached, or NULL for the default. */
+    char *tableCacheDirectory;
+  
+    CosineAccuracy cosineAccuracy;
+  
+    bool dspFusion;
+    bool dspFolding;
+    bool dspSleep;
+    bool dspVoiceGrouping;
+  
+    /** The number of dsp objects which sleeping graphs have skipped in the current block. */
+    unsigned int numSkippedDspNodes;
+  
+    /** The sequence from which new [noise~] and [random] objects are seeded. */
+    uint64_t randomSeedSequence;
 };
 
 #endif // _PD_CONTEXT_H_
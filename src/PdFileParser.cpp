@@ -20,15 +20,12 @@
  *
  */
 
-#include "MessageFloat.h"
-#include "MessageMessageBox.h"
-#include "MessageSymbol.h"
-#include "MessageTable.h"
-#include "MessageText.h"
+#include <sys/stat.h>
 #include "PdAbstractionDataBase.h"
 #include "PdContext.h"
 #include "PdFileParser.h"
 #include "PdGraph.h"
+#include "PdPatch.h"
 
 PdFileParser::PdFileParser(string directory, string filename) {
   rootPath = string(directory);
@@ -112,21 +109,73 @@ string PdFileParser::nextLine() {
 }
 
 
-#pragma mark - execute
+#pragma mark - parse
 
 PdGraph *PdFileParser::execute(PdContext *context) {
-  return execute(NULL, NULL, context, true);
+  PdPatch *patch = parse(context);
+  PdGraph *graph = patch->instantiate(context);
+  delete patch;
+  return graph;
+}
+
+PdPatch *PdFileParser::parseAbstraction(const char *objectLabel, PdGraph *graph, PdContext *context) {
+  PdPatch *patch = findAbstraction(objectLabel, graph, context);
+  if (patch != NULL) context->getAbstractionDataBase()->addResolvedPatch(objectLabel, patch);
+  return patch;
 }
 
-PdGraph *PdFileParser::execute(PdMessage *initMsg, PdGraph *graph, PdContext *context, bool isSubPatch) {
-#define OBJECT_LABEL_RESOLUTION_BUFFER_LENGTH 32
-#define RESOLUTION_BUFFER_LENGTH 512
-#define INIT_MESSAGE_MAX_ELEMENTS 32
-  PdMessage *initMessage = PD_MESSAGE_ON_STACK(INIT_MESSAGE_MAX_ELEMENTS);
+PdPatch *PdFileParser::findAbstraction(const char *objectLabel, PdGraph *graph, PdContext *context) {
+  PdAbstractionDataBase *abstractionDataBase = context->getAbstractionDataBase();
+  PdPatch *patch = NULL;
+  if (abstractionDataBase->existsAbstraction(objectLabel)) {
+    // registered abstractions are parsed when first used, and again once they are replaced
+    patch = abstractionDataBase->getPatch(objectLabel);
+    if (patch == NULL) {
+      PdFileParser parser(abstractionDataBase->getAbstraction(objectLabel));
+      patch = parser.parse(context);
+      abstractionDataBase->addPatch(objectLabel, patch);
+    }
+    return patch;
+  } else if ((patch = graph->getEmbeddedAbstraction(objectLabel)) != NULL) {
+    // abstractions embedded in a binary patch belong to the graph which was loaded from it
+    return patch;
+  } else {
+    string filename = string(objectLabel) + ".pd";
+    string directory = graph->findFilePath(filename.c_str());
+    if (directory.empty()) {
+      // if the system cannot find the file itself, make a final effort to find the file via
+      // the user supplied callback
+      if (context->callbackFunction != NULL) {
+        char *dir = (char *) context->callbackFunction(ZG_CANNOT_FIND_OBJECT,
+          context->callbackUserData, (void *) objectLabel);
+        if (dir != NULL) {
+        // TODO(mhroth): create new object based on returned path
+          free(dir); // free the returned objectpath
+        } else {
+          context->printErr("Unknown object or abstraction '%s'.", objectLabel);
+        }
+      }
+    }
+    
+    // files are parsed when first used, and again whenever they have been modified since
+    string path = directory + filename;
+    struct stat fileStat;
+    if (stat(path.c_str(), &fileStat) != 0) return NULL;
+    patch = abstractionDataBase->getPatch(path);
+    if (patch == NULL || patch->getModificationTime() != fileStat.st_mtime) {
+      PdFileParser parser(directory, filename);
+      patch = parser.parse(context);
+      patch->setModificationTime(fileStat.st_mtime);
+      abstractionDataBase->addPatch(path, patch);
+    }
+    return patch;
+  }
+}
+
+PdPatch *PdFileParser::parse(PdContext *context) {
+  PdPatch *patch = new PdPatch(rootPath, fileName);
   
   string message;
-  MessageTable *lastArrayCreated = NULL;  // used to know on which table the #A line values have to be set
-  int lastArrayCreatedIndex = 0;
   while (!(message = nextMessage()).empty()) {
     // create a non-const copy of message such that strtok can modify it
     char line[message.size()+1];
@@ -137,189 +186,111 @@ PdGraph *PdFileParser::execute(PdMessage *initMsg, PdGraph *graph, PdContext *co
     if (!strcmp(hashType, "#N")) {
       char *objectType = strtok(NULL, " ");
       if (!strcmp(objectType, "canvas")) {
-        int canvasX = atoi(strtok(NULL, " "));
-        int canvasY = atoi(strtok(NULL, " "));
-        int canvasW = atoi(strtok(NULL, " "));
-        int canvasH = atoi(strtok(NULL, " "));
+        PatchLine *patchLine = patch->addLine(PATCH_CANVAS);
+        patchLine->values[0] = atoi(strtok(NULL, " ")); // x
+        patchLine->values[1] = atoi(strtok(NULL, " ")); // y
+        patchLine->values[2] = atoi(strtok(NULL, " ")); // width
+        patchLine->values[3] = atoi(strtok(NULL, " ")); // height
         const char *canvasName = strtok(NULL, " ");
-
-        // A new graph is defined inline. No arguments are passed (from this line)
-        // the graphId is not incremented as this is a subpatch, not an abstraction
-        // NOTE(mhroth): pixel location is not recorded
-        PdGraph *newGraph = NULL;
-        if (graph == NULL) { // if no parent graph exists
-          initMessage->initWithTimestampAndNumElements(0.0, 0); // make a dummy initMessage
-          newGraph = new PdGraph(initMessage, NULL, context, context->getNextGraphId(), "zg_root");
-          if (!rootPath.empty()) {
-            // inform the root graph of where it is in the file system, if this information exists.
-            // This will allow abstractions to be correctly loaded.
-            newGraph->addDeclarePath(rootPath.c_str());
-          }
-        } else {
-          if (isSubPatch) {
-            // a graph made a subpatch
-            newGraph = new PdGraph(graph->getArguments(), graph, context, graph->getGraphId(), canvasName);
-          } else {
-            // a graph made as an abstraction
-            newGraph = new PdGraph(initMsg, graph, context, context->getNextGraphId(), (rootPath+fileName).c_str());
-            isSubPatch = true;
-          }
-          graph->addObject(0, 0, newGraph); // add the new graph to the current one as an object
-        }
-        
-        // the new graph is pushed onto the stack
-        graph = newGraph;
-    } else {
+        if (canvasName != NULL) patchLine->text = patch->addString(canvasName);
+      } else {
         context->printErr("Unrecognised #N object type: \"%s\".", line);
       }
     } else if (!strcmp(hashType, "#X")) {
       char *objectType = strtok(NULL, " ");
       if (!strcmp(objectType, "obj")) {
         // read the canvas coordinates (Pd defines them to be integers, ZG represents them as floats internally)
-        float canvasX = (float) atoi(strtok(NULL, " "));
-        float canvasY = (float) atoi(strtok(NULL, " "));
+        PatchLine *patchLine = patch->addLine(PATCH_OBJECT);
+        patchLine->values[0] = atoi(strtok(NULL, " "));
+        patchLine->values[1] = atoi(strtok(NULL, " "));
         
-        // resolve $ variables in the object label (such as objects that are simply labeled "$1")
-        char *objectLabel = strtok(NULL, " ;\r"); // delimit with " " or ";"
-        
-        char resBufferLabel[OBJECT_LABEL_RESOLUTION_BUFFER_LENGTH];
-        PdMessage::resolveString(objectLabel, graph->getArguments(), 0,
-          resBufferLabel, OBJECT_LABEL_RESOLUTION_BUFFER_LENGTH); // object labels are always strings
-                                                                  // even if they are numbers, e.g. "1"
+        // $ variables in the object label (such as objects that are simply labeled "$1") are
+        // resolved when the object is created
+        const char *objectLabel = strtok(NULL, " ;\r"); // delimit with " " or ";"
+        if (objectLabel == NULL) objectLabel = "";
+        if (strstr(objectLabel, "\\$") == NULL) {
+          patch->setLabel(patchLine, objectLabel);
+        } else {
+          patchLine->text = patch->addString(objectLabel);
+          patchLine->isTextResolved = 0;
+        }
         
-        // resolve $ variables in the object arguments
         char *objectInitString = strtok(NULL, ";\r"); // get the object initialisation string
-        char resBuffer[RESOLUTION_BUFFER_LENGTH];
-        initMessage->initWithSARb(INIT_MESSAGE_MAX_ELEMENTS, objectInitString, graph->getArguments(),
-            resBuffer, RESOLUTION_BUFFER_LENGTH);
-        
-        // create the object
-        MessageObject *messageObject = context->newObject(resBufferLabel, initMessage, graph);
-        if (messageObject == NULL) { // object could not be created based on any known object factory functions
-          if (context->getAbstractionDataBase()->existsAbstraction(objectLabel)) {
-            PdFileParser *parser = new PdFileParser(context->getAbstractionDataBase()->getAbstraction(objectLabel));
-            messageObject = parser->execute(initMessage, graph, context, false);
-            delete parser;
-          } else {
-            string filename = string(objectLabel) + ".pd";
-            string directory = graph->findFilePath(filename.c_str());
-            if (directory.empty()) {
-              // if the system cannot find the file itself, make a final effort to find the file via
-              // the user supplied callback
-              if (context->callbackFunction != NULL) {
-                char *dir = (char *) context->callbackFunction(ZG_CANNOT_FIND_OBJECT,
-                  context->callbackUserData, objectLabel);
-                if (dir != NULL) {
-                // TODO(mhroth): create new object based on returned path
-                  free(dir); // free the returned objectpath
-                } else {
-                  context->printErr("Unknown object or abstraction '%s'.", objectLabel);
-                }
-              }
-            }
-            PdFileParser *parser = new PdFileParser(directory, filename);
-            messageObject = parser->execute(initMessage, graph, context, false);
-            delete parser;
+        if (objectInitString != NULL) {
+          // an escaped semicolon, such as between the expressions of expr~, does not end the object
+          char *end = objectInitString + strlen(objectInitString);
+          while (end > objectInitString && end[-1] == '\\' && end < line + sizeof(line) - 1) {
+            *end = ';';
+            end = strpbrk(end + 1, ";\r");
+            if (end == NULL) break;
+            *end = '\0';
+          }
+          
+          // the arguments are split as by PdMessage::initWithString(), though before $ variables
+          // are resolved, which never introduces a delimiter
+          for (char *token = strtok(objectInitString, " ;"); token != NULL; token = strtok(NULL, " ;")) {
+            patch->addAtom(token);
           }
-        } else {
-          // add the object to the local graph and make any necessary registrations
-          graph->addObject(canvasX, canvasY, messageObject);
         }
       } else if (!strcmp(objectType, "msg")) {
-        float canvasX = (float) atoi(strtok(NULL, " ")); // read the first canvas coordinate
-        float canvasY = (float) atoi(strtok(NULL, " ")); // read the second canvas coordinate
+        PatchLine *patchLine = patch->addLine(PATCH_MESSAGE);
+        patchLine->values[0] = atoi(strtok(NULL, " ")); // read the first canvas coordinate
+        patchLine->values[1] = atoi(strtok(NULL, " ")); // read the second canvas coordinate
         char *objectInitString = strtok(NULL, "\n\r"); // get the message initialisation string (including trailing ';')
-        initMessage->initWithTimestampAndSymbol(0.0, objectInitString);
-        MessageObject *messageObject = context->newObject(
-          MessageMessageBox::getObjectLabel(), initMessage, graph);
-        graph->addObject(canvasX, canvasY, messageObject);
+        if (objectInitString != NULL) patchLine->text = patch->addString(objectInitString);
       } else if (!strcmp(objectType, "connect")) {
-        int fromObjectIndex = atoi(strtok(NULL, " "));
-        int outletIndex = atoi(strtok(NULL, " "));
-        int toObjectIndex = atoi(strtok(NULL, " "));
-        int inletIndex = atoi(strtok(NULL, ";"));
-        graph->addConnection(fromObjectIndex, outletIndex, toObjectIndex, inletIndex);
+        PatchLine *patchLine = patch->addLine(PATCH_CONNECT);
+        patchLine->values[0] = atoi(strtok(NULL, " ")); // from object
+        patchLine->values[1] = atoi(strtok(NULL, " ")); // outlet
+        patchLine->values[2] = atoi(strtok(NULL, " ")); // to object
+        patchLine->values[3] = atoi(strtok(NULL, ";")); // inlet
       } else if (!strcmp(objectType, "floatatom")) {
-        float canvasX = (float) atoi(strtok(NULL, " "));
-        float canvasY = (float) atoi(strtok(NULL, " "));
-        initMessage->initWithTimestampAndFloat(0.0, 0.0f);
-        MessageObject *messageObject = context->newObject(
-            MessageFloat::getObjectLabel(), initMessage, graph); // defines a number box
-        graph->addObject(canvasX, canvasY, messageObject);
+        PatchLine *patchLine = patch->addLine(PATCH_FLOAT_ATOM);
+        patchLine->values[0] = atoi(strtok(NULL, " "));
+        patchLine->values[1] = atoi(strtok(NULL, " "));
       } else if (!strcmp(objectType, "symbolatom")) {
-        float canvasX = (float) atoi(strtok(NULL, " "));
-        float canvasY = (float) atoi(strtok(NULL, " "));
-        initMessage->initWithTimestampAndSymbol(0.0, NULL);
-        MessageObject *messageObject = context->newObject(
-            MessageSymbol::getObjectLabel(), initMessage, graph);
-        graph->addObject(canvasX, canvasY, messageObject);
+        PatchLine *patchLine = patch->addLine(PATCH_SYMBOL_ATOM);
+        patchLine->values[0] = atoi(strtok(NULL, " "));
+        patchLine->values[1] = atoi(strtok(NULL, " "));
       } else if (!strcmp(objectType, "restore")) {
-        // the graph is finished being defined
-        // pop the graph stack to the parent graph
-        // the process order will be computed by the parent graph
-        graph = graph->getParentGraph();
+        patch->addLine(PATCH_RESTORE);
       } else if (!strcmp(objectType, "text")) {
-        float canvasX = (float) atoi(strtok(NULL, " "));
-        float canvasY = (float) atoi(strtok(NULL, " "));
+        PatchLine *patchLine = patch->addLine(PATCH_TEXT);
+        patchLine->values[0] = atoi(strtok(NULL, " "));
+        patchLine->values[1] = atoi(strtok(NULL, " "));
         char *comment = strtok(NULL, ";"); // get the comment
-        initMessage->initWithTimestampAndSymbol(0.0, comment);
-        MessageObject *messageText = context->newObject(
-            MessageText::getObjectLabel(), initMessage, graph);
-        graph->addObject(canvasX, canvasY, messageText);
+        if (comment != NULL) patchLine->text = patch->addString(comment);
       } else if (!strcmp(objectType, "declare")) {
-        // set environment for loading patch
         char *objectInitString = strtok(NULL, ";"); // get the arguments to declare
-        initMessage->initWithString(0.0, 2, objectInitString); // parse them
-        if (initMessage->isSymbol(0, "-path")) {
-          if (initMessage->isSymbol(1)) {
-            // add symbol to declare directories
-            graph->addDeclarePath(initMessage->getSymbol(1));
-          }
-        } else {
-          context->printErr("declare \"%s\" flag is not supported.", initMessage->getSymbol(0));
+        if (objectInitString != NULL) {
+          PatchLine *patchLine = patch->addLine(PATCH_DECLARE);
+          patchLine->text = patch->addString(objectInitString);
         }
       } else if (!strcmp(objectType, "array")) {
-        // creates a new table
         // objectInitString should contain both name and buffer length
+        patch->addLine(PATCH_ARRAY);
         char *objectInitString = strtok(NULL, ";"); // get the object initialisation string
-        char resBuffer[RESOLUTION_BUFFER_LENGTH];
-        initMessage->initWithSARb(4, objectInitString, graph->getArguments(), resBuffer, RESOLUTION_BUFFER_LENGTH);
-        lastArrayCreated = reinterpret_cast<MessageTable *>(context->newObject("table", initMessage, graph));
-        lastArrayCreatedIndex = 0;
-        graph->addObject(0, 0, lastArrayCreated);
-        context->printStd("PdFileParser: Replacer array with table, name: '%s'", initMessage->getSymbol(0));
+        if (objectInitString != NULL) {
+          for (char *token = strtok(objectInitString, " ;"); token != NULL; token = strtok(NULL, " ;")) {
+            patch->addAtom(token);
+          }
+        }
       } else if (!strcmp(objectType, "coords")) {
         continue;
       } else {
         context->printErr("Unrecognised #X object type: \"%s\"", message.c_str());
       }
     } else if (!strcmp(hashType, "#A")) {
-      if (lastArrayCreated == NULL) {
-        context->printErr("#A line but no array were created");
-      } else {
-        int bufferLength = 0;
-        float *buffer = lastArrayCreated->getBuffer(&bufferLength);
-        char *token = NULL;
-        
-        int index = atoi(strtok(NULL, " ;"));
-        while ((token = strtok(NULL, " ;")) != NULL) {
-          if (index >= bufferLength) {
-            context->printErr("#A trying to add value at index %d while buffer length is %d", index, bufferLength);
-            break;
-          }
-          buffer[index] = atof(token);
-          ++index;
-          ++lastArrayCreatedIndex;
-        }
-        if (lastArrayCreatedIndex == bufferLength) {
-          lastArrayCreated = NULL;
-          lastArrayCreatedIndex = 0;
-        }
+      PatchLine *patchLine = patch->addLine(PATCH_ARRAY_VALUES);
+      patchLine->values[0] = atoi(strtok(NULL, " ;")); // the index of the first value
+      char *token = NULL;
+      while ((token = strtok(NULL, " ;")) != NULL) {
+        patch->addAtom((float) atof(token));
       }
     } else {
       context->printErr("Unrecognised hash type: \"%s\"", message.c_str());
     }
   }
   
-  return graph;
+  return patch;
 }
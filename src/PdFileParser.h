@@ -31,6 +31,7 @@
 
 class PdContext;
 class PdGraph;
+class PdPatch;
 
 using namespace std;
 
@@ -47,10 +48,27 @@ class PdFileParser {
     PdFileParser(string aString);
     ~PdFileParser();
   
+    /** Parses the file and instantiates it as a new root graph, which is returned. */
     PdGraph *execute(PdContext *context);
+  
+    /**
+     * Parses the file into a patch, which may then be instantiated any number of times. The
+     * parser is used up. The caller must delete the patch.
+     */
+    PdPatch *parse(PdContext *context);
+  
+    /**
+     * Returns the parsed patch of the abstraction with the given label. It is looked up among the
+     * abstractions registered with the context, then among those embedded in the binary patch from
+     * which the root graph was loaded, and then in the declared paths of the graph. Each abstraction
+     * is parsed only once, and files again only if they have changed since. The database, or the
+     * root graph, keeps the patch. Returns <code>NULL</code> if the abstraction cannot be found.
+     */
+    static PdPatch *parseAbstraction(const char *objectLabel, PdGraph *graph, PdContext *context);
 
   private:
-    PdGraph *execute(PdMessage *initMsg, PdGraph *graph, PdContext *context, bool isSubPatch);
+    /** See <code>parseAbstraction()</code>, which also records the patch which is found. */
+    static PdPatch *findAbstraction(const char *objectLabel, PdGraph *graph, PdContext *context);
 
     /**
      * Returns the next logical message in the file, or <code>NULL</code> if the end of the file
@@ -20,19 +20,28 @@
  *
  */
 
+#include <algorithm>
+#include "BufferPool.h"
 #include "DeclareList.h"
+#include "DspFusedChain.h"
+#include "DspGraphOptimiser.h"
 #include "DspImplicitAdd.h"
 #include "DspInlet.h"
 #include "DspOutlet.h"
+#include "DspReadSoundfile.h"
+#include "DspTableOsc4.h"
 #include "DspTablePlay.h"
 #include "DspTableRead.h"
 #include "DspTableRead4.h"
+#include "DspWriteSoundfile.h"
 #include "MessageInlet.h"
 #include "MessageOutlet.h"
+#include "MessageSoundfiler.h"
 #include "MessageTableRead.h"
 #include "MessageTableWrite.h"
 #include "PdContext.h"
 #include "PdGraph.h"
+#include "PdPatch.h"
 #include "StaticUtils.h"
 
 
@@ -52,6 +61,11 @@ PdGraph::PdGraph(PdMessage *initMessage, PdGraph *parentGraph, PdContext *contex
   // all graphs start out unattached to any context, though they exist in a context
   isAttachedToContext = false;
   switched = true; // graphs are switched on by default
+  isDspOrderValid = true;
+  hasFoldedMessages = false;
+  isAsleep = false;
+  isSelfContained = false;
+  numSleepingDspNodes = 0;
   processFunction = &processGraph;
       
   // initialise the graph arguments
@@ -69,7 +83,9 @@ PdGraph::~PdGraph() {
   graphArguments->freeMessage();
   delete declareList;
 
-  // remove all implicit +~~ objects
+  // remove all fused chains, and then all implicit +~~ objects, including dormant ones
+  DspGraphOptimiser::restore(&dspNodeList, &dormantDspNodeList, &dspSubstitutions);
+  DspFusedChain::unfuse(&dspNodeList);
   for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
     DspObject *dspObject = *it;
     
@@ -83,6 +99,12 @@ PdGraph::~PdGraph() {
   for (list<MessageObject *>::iterator it = nodeList.begin(); it != nodeList.end(); ++it) {
     delete *it;
   }
+  
+  // the instances of a [clone] refer to their patch until they are deleted
+  for (map<string, PdPatch *>::iterator it = embeddedAbstractions.begin();
+      it != embeddedAbstractions.end(); ++it) {
+    delete it->second;
+  }
 }
 
 
@@ -167,9 +189,13 @@ void PdGraph::removeObject(MessageObject *object) {
       // remove the object from the nodeList
       nodeList.erase(it);
       
-      // remove the object from the dspNodeList if the object processes audio
+      // remove the object from the dspNodeList if the object processes audio. It may be part of a
+      // fused chain or dormant, and so the process order is left unoptimised until it is recomputed.
       if (object->doesProcessAudio()) {
+        DspGraphOptimiser::restore(&dspNodeList, &dormantDspNodeList, &dspSubstitutions);
+        DspFusedChain::unfuse(&dspNodeList);
         dspNodeList.remove((DspObject *) object);
+        invalidateDspProcessOrder();
       }
       
       // remove the object from any special lists if it is in any of them (e.g., receive, throw~, etc.)
@@ -225,6 +251,10 @@ void PdGraph::registerObject(MessageObject *messageObject) {
       context->registerRemoteMessageReceiver(reinterpret_cast<RemoteMessageReceiver *>(messageObject));
       break;
     }
+    case MESSAGE_SOUNDFILER: {
+      context->registerDiskStream((MessageSoundfiler *) messageObject);
+      break;
+    }
     case MESSAGE_TABLE: {
       // tables must be registered globally as a table, but can also receive remote messages
       context->registerRemoteMessageReceiver(reinterpret_cast<RemoteMessageReceiver *>(messageObject));
@@ -244,6 +274,7 @@ void PdGraph::registerObject(MessageObject *messageObject) {
       break;
     }
     case DSP_DELAY_READ:
+    case DSP_DELAY_TAPS:
     case DSP_VARIABLE_DELAY: {
       context->registerDelayReceiver((DelayReceiver *) messageObject);
       break;
@@ -252,6 +283,10 @@ void PdGraph::registerObject(MessageObject *messageObject) {
       context->registerDelayline((DspDelayWrite *) messageObject);
       break;
     }
+    case DSP_READ_SOUNDFILE: {
+      context->registerDiskStream((DspReadSoundfile *) messageObject);
+      break;
+    }
     case DSP_SEND: {
       context->registerDspSend((DspSend *) messageObject);
       break;
@@ -264,6 +299,10 @@ void PdGraph::registerObject(MessageObject *messageObject) {
       context->registerTableReceiver((DspTablePlay *) messageObject);
       break;
     }
+    case DSP_TABLE_OSC4: {
+      context->registerTableReceiver((DspTableOsc4 *) messageObject);
+      break;
+    }
     case DSP_TABLE_READ4: {
       context->registerTableReceiver((DspTableRead4 *) messageObject);
       break;
@@ -276,6 +315,10 @@ void PdGraph::registerObject(MessageObject *messageObject) {
       context->registerDspThrow((DspThrow *) messageObject);
       break;
     }
+    case DSP_WRITE_SOUNDFILE: {
+      context->registerDiskStream((DspWriteSoundfile *) messageObject);
+      break;
+    }
     default: {
       break; // nothing to do
     }
@@ -290,6 +333,10 @@ void PdGraph::unregisterObject(MessageObject *messageObject) {
       context->unregisterRemoteMessageReceiver((RemoteMessageReceiver *) messageObject);
       break;
     }
+    case MESSAGE_SOUNDFILER: {
+      context->unregisterDiskStream((MessageSoundfiler *) messageObject);
+      break;
+    }
     case MESSAGE_TABLE_READ: {
       context->unregisterTableReceiver((MessageTableRead *) messageObject);
       break;
@@ -298,6 +345,10 @@ void PdGraph::unregisterObject(MessageObject *messageObject) {
       context->unregisterTableReceiver((MessageTableWrite *) messageObject);
       break;
     }
+    case DSP_READ_SOUNDFILE: {
+      context->unregisterDiskStream((DspReadSoundfile *) messageObject);
+      break;
+    }
     case DSP_SEND: {
       context->unregisterDspSend((DspSend *) messageObject);
       break;
@@ -310,6 +361,10 @@ void PdGraph::unregisterObject(MessageObject *messageObject) {
       context->unregisterTableReceiver((DspTablePlay *) messageObject);
       break;
     }
+    case DSP_TABLE_OSC4: {
+      context->unregisterTableReceiver((DspTableOsc4 *) messageObject);
+      break;
+    }
     case DSP_TABLE_READ4: {
       context->unregisterTableReceiver((DspTableRead4 *) messageObject);
       break;
@@ -318,6 +373,10 @@ void PdGraph::unregisterObject(MessageObject *messageObject) {
       context->unregisterTableReceiver((DspTableRead *) messageObject);
       break;
     }
+    case DSP_WRITE_SOUNDFILE: {
+      context->unregisterDiskStream((DspWriteSoundfile *) messageObject);
+      break;
+    }
     default: {
       break;
     }
@@ -359,6 +418,17 @@ char *PdGraph::resolveFullPath(const char *filename) {
   }
 }
 
+char *PdGraph::resolveNewFilePath(const char *filename) {
+  if (DeclareList::isFullPath(filename)) {
+    return StaticUtils::copyString(filename);
+  } else if (declareList->getIterator() != declareList->getEnd()) {
+    return StaticUtils::concatStrings(declareList->getRootPath(), filename);
+  } else {
+    // graphs which were not loaded from a file have no directory of their own
+    return isRootGraph() ? StaticUtils::copyString(filename) : parentGraph->resolveNewFilePath(filename);
+  }
+}
+
 string PdGraph::findFilePath(const char *filename) {
   for (list<string>::iterator it = declareList->getIterator(); it != declareList->getEnd(); ++it) {
     string directory = *it;
@@ -370,6 +440,16 @@ string PdGraph::findFilePath(const char *filename) {
   return isRootGraph() ? "" : parentGraph->findFilePath(filename);
 }
 
+void PdGraph::setEmbeddedAbstractions(map<string, PdPatch *> *abstractions) {
+  embeddedAbstractions.swap(*abstractions);
+}
+
+PdPatch *PdGraph::getEmbeddedAbstraction(const char *label) {
+  if (!isRootGraph()) return parentGraph->getEmbeddedAbstraction(label);
+  map<string, PdPatch *>::iterator it = embeddedAbstractions.find(string(label));
+  return (it != embeddedAbstractions.end()) ? it->second : NULL;
+}
+
 void PdGraph::addDeclarePath(const char *path) {
   if (isRootGraph()) {
     declareList->addPath(path);
@@ -408,21 +488,242 @@ void PdGraph::receiveMessage(int inletIndex, PdMessage *message) {
 }
 
 void PdGraph::processGraph(DspObject *dspObject, int fromIndex, int toIndex) {
+  reinterpret_cast<PdGraph *>(dspObject)->processDspNodes(false);
+}
+
+void PdGraph::processGraphProfiled(DspObject *dspObject, int fromIndex, int toIndex) {
   PdGraph *d = reinterpret_cast<PdGraph *>(dspObject);
+  uint64_t graphStart = ProfileTimer::now();
+  d->processDspNodes(true);
   
-  if (d->switched) {
+  // the graph's own counters include the time spent in all of its objects
+  d->profile.numNanoseconds += ProfileTimer::now() - graphStart;
+  d->profile.numCalls++;
+}
+
+void PdGraph::processDspNodes(bool isProfiling) {
+  if (switched) {
     // when inlets are processed, they will resolve their buffers and everything will proceed as normal
     
+    // a sleeping graph stays asleep for as long as nothing arrives at its inlets
+    bool isWatching = canSleep();
+    if (isAsleep) {
+      if (isWatching) {
+        processAsleep();
+        return;
+      }
+      isAsleep = false;
+    }
+    if (isWatching) beginWatching();
+    
     // process all dsp objects
     // DSP processing elements are only executed if the graph is switched on
     
     // TODO(mhroth): iterate depending on local blocksize relative to parent
     // execute all nodes which process audio
-    for (list<DspObject *>::iterator it = d->dspNodeList.begin(); it != d->dspNodeList.end(); ++it) {
+    for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
       DspObject *dspObject = *it;
-      dspObject->processFunction(dspObject, 0, d->blockSizeInt);
+      if (isProfiling) {
+        processDspObjectProfiled(dspObject);
+      } else {
+        dspObject->processFunction(dspObject, 0, blockSizeInt);
+      }
+      if (isWatching) isWatching = watch(dspObject);
+    }
+    if (isWatching) endWatching();
+  }
+}
+
+void PdGraph::processDspObjectProfiled(DspObject *dspObject) {
+  if (dspObject->processFunction == &processGraph) {
+    // subgraphs are descended into such that their objects are profiled individually
+    processGraphProfiled(dspObject, 0, blockSizeInt);
+  } else {
+    dspObject->profile.numMessages += dspObject->getNumPendingMessages();
+    uint64_t start = ProfileTimer::now();
+    dspObject->processFunction(dspObject, 0, blockSizeInt);
+    dspObject->profile.numNanoseconds += ProfileTimer::now() - start;
+    dspObject->profile.numCalls++;
+  }
+}
+
+void PdGraph::setProfiling(bool enabled) {
+  processFunction = enabled ? &processGraphProfiled : &processGraph;
+}
+
+void PdGraph::setDspFusion(bool enabled) {
+  DspFusedChain::unfuse(&dspNodeList);
+  if (enabled) DspFusedChain::fuse(&dspNodeList, this);
+  for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
+    DspObject *dspObject = *it;
+    if (dspObject->getObjectType() == OBJECT_PD) {
+      reinterpret_cast<PdGraph *>(dspObject)->setDspFusion(enabled);
+    }
+  }
+}
+
+void PdGraph::resetProfile() {
+  memset(&profile, 0, sizeof(DspProfile));
+  for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
+    DspObject *dspObject = *it;
+    if (dspObject->getObjectType() == OBJECT_PD) {
+      reinterpret_cast<PdGraph *>(dspObject)->resetProfile();
+    } else {
+      memset(&dspObject->profile, 0, sizeof(DspProfile));
+    }
+  }
+}
+
+
+#pragma mark - Sleep
+
+bool PdGraph::isAtRest() {
+  // the parent must know that nothing arrives at the inlets
+  if (!isAsleep) return false;
+  for (vector<MessageObject *>::iterator it = inletList.begin(); it != inletList.end(); ++it) {
+    MessageObject *messageObject = *it;
+    if (messageObject->getObjectType() == DSP_INLET) {
+      float *buffer = reinterpret_cast<DspInlet *>(messageObject)->getDspBufferAtOutlet(0);
+      if (!graph->isDspBufferKnownSilent(buffer)) return false;
+    }
+  }
+  return true;
+}
+
+bool PdGraph::hasSilentOutput() {
+  return isAsleep;
+}
+
+void PdGraph::wake() {
+  for (PdGraph *graph = this; graph != NULL; graph = graph->parentGraph) {
+    graph->isAsleep = false;
+  }
+}
+
+bool PdGraph::canSleep() {
+  if (parentGraph == NULL || !isSelfContained || !context->isDspSleepEnabled()) return false;
+  for (vector<MessageObject *>::iterator it = inletList.begin(); it != inletList.end(); ++it) {
+    MessageObject *messageObject = *it;
+    if (messageObject->getObjectType() == DSP_INLET) {
+      float *buffer = reinterpret_cast<DspInlet *>(messageObject)->getDspBufferAtOutlet(0);
+      if (!ArrayArithmetic::isSilent(buffer, 0, blockSizeInt)) return false;
     }
   }
+  return true;
+}
+
+void PdGraph::processAsleep() {
+  // the outlet buffers are shared with objects elsewhere in the process order
+  for (vector<MessageObject *>::iterator it = outletList.begin(); it != outletList.end(); ++it) {
+    MessageObject *messageObject = *it;
+    if (messageObject->getObjectType() == DSP_OUTLET) {
+      float *buffer = reinterpret_cast<DspOutlet *>(messageObject)->getDspBufferAtOutlet(0);
+      memset(buffer, 0, blockSizeInt * sizeof(float));
+    }
+  }
+  context->recordSkippedDspNodes(numSleepingDspNodes);
+}
+
+void PdGraph::beginWatching() {
+  std::fill(silentDspBufferFlags.begin(), silentDspBufferFlags.end(), false);
+  for (vector<MessageObject *>::iterator it = inletList.begin(); it != inletList.end(); ++it) {
+    MessageObject *messageObject = *it;
+    if (messageObject->getObjectType() == DSP_INLET) {
+      setDspBufferKnownSilent(reinterpret_cast<DspInlet *>(messageObject)->getDspBufferAtOutlet(0), true);
+    }
+  }
+}
+
+bool PdGraph::watch(DspObject *dspObject) {
+  if (!dspObject->isAtRest()) return false;
+  // buffers are reused within the block, such that every outlet is updated
+  bool isSilent = dspObject->hasSilentOutput();
+  if (dspObject->getObjectType() == OBJECT_PD) {
+    PdGraph *subgraph = reinterpret_cast<PdGraph *>(dspObject);
+    for (int i = 0; i < subgraph->outletList.size(); i++) {
+      if (subgraph->outletList[i]->getObjectType() == DSP_OUTLET) {
+        setDspBufferKnownSilent(subgraph->getDspBufferAtOutlet(i), isSilent);
+      }
+    }
+  } else {
+    for (int i = 0; i < dspObject->getNumDspOutlets(); i++) {
+      float *buffer = dspObject->getDspBufferAtOutlet(i);
+      if (buffer != NULL) setDspBufferKnownSilent(buffer, isSilent);
+    }
+  }
+  return true;
+}
+
+void PdGraph::endWatching() {
+  for (vector<MessageObject *>::iterator it = outletList.begin(); it != outletList.end(); ++it) {
+    MessageObject *messageObject = *it;
+    if (messageObject->getObjectType() == DSP_OUTLET) {
+      float *buffer = reinterpret_cast<DspOutlet *>(messageObject)->getDspBufferAtOutlet(0);
+      if (!isDspBufferKnownSilent(buffer)) return;
+    }
+  }
+  isAsleep = true;
+  numSleepingDspNodes = getNumDeepDspNodes();
+}
+
+bool PdGraph::isDspBufferKnownSilent(float *buffer) {
+  if (buffer == getBufferPool()->getZeroBuffer()) return true;
+  int index = getWatchedDspBufferIndex(buffer);
+  return index >= 0 && silentDspBufferFlags[index];
+}
+
+void PdGraph::setDspBufferKnownSilent(float *buffer, bool isKnownSilent) {
+  // any other buffer, such as one published by a [delread~], is never known to be silent
+  int index = getWatchedDspBufferIndex(buffer);
+  if (index >= 0) silentDspBufferFlags[index] = isKnownSilent;
+}
+
+int PdGraph::getWatchedDspBufferIndex(float *buffer) {
+  vector<float *>::iterator it =
+      std::lower_bound(watchedDspBuffers.begin(), watchedDspBuffers.end(), buffer);
+  return (it != watchedDspBuffers.end() && *it == buffer) ? (int) (it - watchedDspBuffers.begin()) : -1;
+}
+
+void PdGraph::collectWatchedDspBuffers() {
+  watchedDspBuffers.clear();
+  for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
+    DspObject *dspObject = *it;
+    bool isGraph = (dspObject->getObjectType() == OBJECT_PD);
+    int numInlets = isGraph ? dspObject->getNumInlets() : dspObject->getNumDspInlets();
+    int numOutlets = isGraph ? dspObject->getNumOutlets() : dspObject->getNumDspOutlets();
+    for (int i = 0; i < numInlets; i++) {
+      float *buffer = dspObject->getDspBufferAtInlet(i);
+      if (buffer != NULL) watchedDspBuffers.push_back(buffer);
+    }
+    for (int i = 0; i < numOutlets; i++) {
+      float *buffer = dspObject->getDspBufferAtOutlet(i);
+      if (buffer != NULL) watchedDspBuffers.push_back(buffer);
+    }
+  }
+  for (vector<MessageObject *>::iterator it = inletList.begin(); it != inletList.end(); ++it) {
+    if ((*it)->getObjectType() == DSP_INLET) {
+      watchedDspBuffers.push_back(reinterpret_cast<DspInlet *>(*it)->getDspBufferAtOutlet(0));
+    }
+  }
+  for (vector<MessageObject *>::iterator it = outletList.begin(); it != outletList.end(); ++it) {
+    if ((*it)->getObjectType() == DSP_OUTLET) {
+      watchedDspBuffers.push_back(reinterpret_cast<DspOutlet *>(*it)->getDspBufferAtOutlet(0));
+    }
+  }
+  std::sort(watchedDspBuffers.begin(), watchedDspBuffers.end());
+  watchedDspBuffers.erase(std::unique(watchedDspBuffers.begin(), watchedDspBuffers.end()),
+      watchedDspBuffers.end());
+  silentDspBufferFlags.assign(watchedDspBuffers.size(), false);
+}
+
+unsigned int PdGraph::getNumDeepDspNodes() {
+  unsigned int numDspNodes = 0;
+  for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
+    DspObject *dspObject = *it;
+    numDspNodes += (dspObject->getObjectType() == OBJECT_PD)
+        ? reinterpret_cast<PdGraph *>(dspObject)->getNumDeepDspNodes() : 1;
+  }
+  return numDspNodes;
 }
 
 
@@ -430,7 +731,8 @@ void PdGraph::processGraph(DspObject *dspObject, int fromIndex, int toIndex) {
 
 void PdGraph::addConnection(MessageObject *fromObject, int outletIndex, MessageObject *toObject, int inletIndex) {
   // check to make sure that this connection can even work. Otherwise don't bother.
-  if (outletIndex >= fromObject->getNumOutlets() || inletIndex >= toObject->getNumInlets()) {
+  if (outletIndex < 0 || inletIndex < 0 ||
+      outletIndex >= fromObject->getNumOutlets() || inletIndex >= toObject->getNumInlets()) {
     printErr("mismatched connnection. Attempt to make a connection from "
         "%s(%p):%i/%i to %s(%p):%i/%i. Connection ignored.",
         fromObject->toString().c_str(), fromObject, outletIndex, fromObject->getNumOutlets(),
@@ -441,6 +743,7 @@ void PdGraph::addConnection(MessageObject *fromObject, int outletIndex, MessageO
   lockContextIfAttached();
   toObject->addConnectionFromObjectToInlet(fromObject, outletIndex, inletIndex);
   fromObject->addConnectionToObjectFromOutlet(toObject, inletIndex, outletIndex);
+  if (isAttachedToContext) invalidateDspProcessOrder();
   
   // NOTE(mhroth): very heavy handed approach. Always recompute the process order when adding connections.
   // In theory this function should check to see if a reordering is even necessary and then only make
@@ -453,9 +756,15 @@ void PdGraph::addConnection(MessageObject *fromObject, int outletIndex, MessageO
 
 void PdGraph::addConnection(int fromObjectIndex, int outletIndex, int toObjectIndex, int inletIndex) {
   list<MessageObject *>::iterator fromIt = nodeList.begin();
-  for (int i = 0; i < fromObjectIndex; i++) fromIt++;
+  for (int i = 0; i < fromObjectIndex && fromIt != nodeList.end(); i++) fromIt++;
   list<MessageObject *>::iterator toIt = nodeList.begin();
-  for (int i = 0; i < toObjectIndex; i++) toIt++;
+  for (int i = 0; i < toObjectIndex && toIt != nodeList.end(); i++) toIt++;
+  if (fromObjectIndex < 0 || toObjectIndex < 0 || fromIt == nodeList.end() || toIt == nodeList.end()) {
+    // such as when an object could not be created
+    printErr("connection from object %i to object %i refers to an object which does not exist. "
+        "Connection ignored.", fromObjectIndex, toObjectIndex);
+    return;
+  }
   
   MessageObject *fromObject = *fromIt;
   MessageObject *toObject = *toIt;
@@ -471,6 +780,7 @@ void PdGraph::removeConnection(MessageObject *fromObject, int outletIndex, Messa
   lockContextIfAttached();
   toObject->removeConnectionFromObjectToInlet(fromObject, outletIndex, inletIndex);
   fromObject->removeConnectionToObjectFromOutlet(toObject, inletIndex, outletIndex);
+  if (isAttachedToContext) invalidateDspProcessOrder();
   unlockContextIfAttached();
 }
 
@@ -673,7 +983,10 @@ void PdGraph::computeDeepLocalDspProcessOrder() {
     }
   }
   
-  // remove all +~~ objects
+  // return all dormant objects, remove all fused chains, including dissolved ones, and then remove
+  // all +~~ objects
+  DspGraphOptimiser::restore(&dspNodeList, &dormantDspNodeList, &dspSubstitutions);
+  DspFusedChain::unfuse(&dspNodeList);
   for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
     DspObject *dspObject = *it;
     if (!strcmp(dspObject->toString().c_str(), DspImplicitAdd::getObjectLabel())) {
@@ -690,6 +1003,30 @@ void PdGraph::computeDeepLocalDspProcessOrder() {
     dspNodeList.splice(dspNodeList.end(), processSubList);
   }
   
+  // another graph may have ordered some of the objects, e.g. a [catch~] those before its [throw~]s.
+  // Only the implicit +~~ objects of this graph are not in its node list.
+  isSelfContained = true;
+  for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
+    if ((*it)->getGraph() != this) isSelfContained = false;
+  }
+  for (list<MessageObject *>::iterator it = nodeList.begin(); it != nodeList.end(); ++it) {
+    MessageObject *object = *it;
+    if (object->doesProcessAudio() &&
+        std::find(dspNodeList.begin(), dspNodeList.end(), object) == dspNodeList.end()) {
+      isSelfContained = false;
+    }
+  }
+  
+  // before folding, which only ever gives readers these buffers or constant ones
+  collectWatchedDspBuffers();
+  
+  if (context->isDspFoldingEnabled()) {
+    DspGraphOptimiser::optimise(&dspNodeList, &dormantDspNodeList, &dspSubstitutions, this);
+  }
+  if (context->isDspFusionEnabled()) DspFusedChain::fuse(&dspNodeList, this);
+  isDspOrderValid = true;
+  isAsleep = false; // the graph must be processed before it can tell whether it may sleep again
+  
   /* print out process order of local dsp objects (for debugging) */
   /*
   if (!dspNodeList.empty()) {
@@ -738,6 +1075,12 @@ double PdGraph::getBlockIndex(PdMessage *message) {
   return (message->getTimestamp() - context->getBlockStartTimestamp()) * 0.001 * context->getSampleRate();
 }
 
+uint64_t PdGraph::getSampleIndex(PdMessage *message) {
+  // rounded up as in DspObject::processFunctionMessage(), and no earlier than the block
+  double blockIndex = ceil(getBlockIndex(message));
+  return context->getBlockStartSample() + ((blockIndex > 0.0) ? (uint64_t) blockIndex : 0);
+}
+
 float PdGraph::getSampleRate() {
   // there is no such thing as a local sample rate. Return the sample rate of the context.
   return context->getSampleRate();
@@ -785,6 +1128,10 @@ ConnectionType PdGraph::getConnectionType(int outletIndex) {
   return messageObject->getConnectionType(0);
 }
 
+ConnectionType PdGraph::getInletConnectionType(int inletIndex) {
+  return (inletList.at(inletIndex)->getObjectType() == DSP_INLET) ? DSP : MESSAGE;
+}
+
 bool PdGraph::doesProcessAudio() {
   // This graph processes audio if it contains any nodes which process audio.
   // This works because graph objects are only created after they have been filled with objects.
@@ -805,6 +1152,33 @@ PdGraph *PdGraph::getParentGraph() {
   return parentGraph;
 }
 
+void PdGraph::invalidateDspProcessOrder() {
+  // subgraphs are ordered along with their parent
+  PdGraph *graph = this;
+  while (graph->parentGraph != NULL) graph = graph->parentGraph;
+  graph->isDspOrderValid = false;
+}
+
+void PdGraph::scheduleDspUnfolding() {
+  for (PdGraph *graph = this; graph != NULL && !graph->hasFoldedMessages; graph = graph->parentGraph) {
+    graph->hasFoldedMessages = true;
+  }
+}
+
+void PdGraph::unfoldDspObjects() {
+  if (!hasFoldedMessages) return;
+  hasFoldedMessages = false;
+  DspGraphOptimiser::unfold(&dspNodeList, &dormantDspNodeList, &dspSubstitutions);
+  
+  // subgraphs, including the instances of a clone, are always in the process order
+  for (list<DspObject *>::iterator it = dspNodeList.begin(); it != dspNodeList.end(); ++it) {
+    DspObject *dspObject = *it;
+    if (dspObject->getObjectType() == OBJECT_PD) {
+      reinterpret_cast<PdGraph *>(dspObject)->unfoldDspObjects();
+    }
+  }
+}
+
 void PdGraph::setSwitch(bool switched) {
   this->switched = switched;
 }
@@ -23,6 +23,8 @@
 #ifndef _PD_GRAPH_H_
 #define _PD_GRAPH_H_
 
+#include <map>
+#include "DspGraphOptimiser.h"
 #include "DspObject.h"
 #include "OrderedMessageQueue.h"
 
@@ -40,6 +42,7 @@ class MessageReceive;
 class MessageSend;
 class MessageTable;
 class PdContext;
+class PdPatch;
 
 class PdGraph : public DspObject {
   
@@ -96,6 +99,9 @@ class PdGraph : public DspObject {
   
     ConnectionType getConnectionType(int outletIndex);
   
+    /** Returns the connection type of the given inlet. */
+    ConnectionType getInletConnectionType(int inletIndex);
+  
     bool doesProcessAudio();
     
     /** Turn the audio processing of this graph on or off. */
@@ -140,12 +146,39 @@ class PdGraph : public DspObject {
     /** A convenience function to determine when in a block a message occurs. */
     double getBlockIndex(PdMessage *message);
   
+    /**
+     * Returns the index of the sample at which a message in the current block takes effect,
+     * counted as with <code>PdContext::getBlockStartSample()</code>.
+     */
+    uint64_t getSampleIndex(PdMessage *message);
+  
     /** Returns the graphId of this graph. */
     int getGraphId();
   
     /** Computes the local tree and node processing ordering for dsp nodes, including subgraphs. */
     void computeDeepLocalDspProcessOrder();
   
+    /**
+     * Marks the process order of the top-level graph as out of date, such that the context
+     * recomputes it before the next block. This is the case when connections change.
+     */
+    void invalidateDspProcessOrder();
+  
+    /** Returns false if the process order must be recomputed before the next block. */
+    bool isDspProcessOrderValid() { return isDspOrderValid; }
+  
+    /**
+     * Notes that an object which has been folded out of the process order of this graph has
+     * received a message, such that it is unfolded before the next block.
+     */
+    void scheduleDspUnfolding();
+  
+    /**
+     * Unfolds the folded objects of this graph and of its subgraphs which have received messages.
+     * See <code>DspGraphOptimiser::unfold()</code>.
+     */
+    void unfoldDspObjects();
+  
     /**
      * Get the process order as if this object (i.e. graph) were an atomic object. The internal
      * process order is not changed.
@@ -191,6 +224,13 @@ class PdGraph : public DspObject {
      */
     char *resolveFullPath(const char *filename);
   
+    /**
+     * Returns the full path at which a new file with the given name should be created. Relative
+     * paths are resolved against the directory of the graph, if it has one. The file need not
+     * exist. The returned path SHOULD be freed by the caller.
+     */
+    char *resolveNewFilePath(const char *filename);
+  
     /**
      * Adds a full or partial path to the declare list. If it is a relative path, then it will be
      * resolved relative to the path of the abstraction. If this graph is a subgraph (not an
@@ -198,6 +238,19 @@ class PdGraph : public DspObject {
      */
     void addDeclarePath(const char *path);
   
+    /**
+     * Gives this root graph the parsed patches of the abstractions embedded in the binary patch from
+     * which it is loaded, by label. They are found only by this graph and its subgraphs, and are
+     * deleted with it. The given map is left empty.
+     */
+    void setEmbeddedAbstractions(map<string, PdPatch *> *abstractions);
+  
+    /**
+     * Returns the patch of the abstraction with the given label which is embedded in the binary
+     * patch from which the root graph was loaded, or <code>NULL</code>.
+     */
+    PdPatch *getEmbeddedAbstraction(const char *label);
+  
     /** Used with MessageValue for keeping track of global variables. */
     // TODO(mhroth): these are not yet fully implemented
     void setValueForName(const char *name, float constant);
@@ -226,9 +279,97 @@ class PdGraph : public DspObject {
     /** Set the graph name. */
     void setName(string newName) { name = newName; }
   
+    /** Returns the dsp objects of this graph in the order in which they are processed. */
+    list<DspObject *> getDspNodeList() { return dspNodeList; }
+  
+    /**
+     * Turns profiling of this graph on or off. When on, the time spent in each dsp object of this
+     * graph and of all subgraphs is accumulated in the objects' <code>profile</code> counters.
+     * Only root graphs need to be set, as subgraphs are profiled by their parent.
+     */
+    void setProfiling(bool enabled);
+  
+    /** Clears the profiling counters of this graph, its dsp objects and all subgraphs. */
+    void resetProfile();
+  
+    /**
+     * Fuses the runs of elementwise objects in the process order of this graph and all subgraphs
+     * into <code>DspFusedChain</code>s, or undoes it.
+     */
+    void setDspFusion(bool enabled);
+  
+    /**
+     * A subgraph whose objects are all at rest, and whose dsp outlets are silent, goes to sleep.
+     * It is then not processed, and only fills its dsp outlets with silence, until any of its
+     * dsp inlets is no longer silent, one of its dsp objects receives a message, or the process
+     * order changes. See <code>DspObject::isAtRest()</code>.
+     */
+    bool isAtRest();
+    bool hasSilentOutput();
+  
+    /** Wakes this graph and all of its parents, such that they are processed in this block. */
+    void wake();
+  
+    /**
+     * Returns true if the given buffer is known to stay silent while this graph sleeps. Only
+     * meaningful while the graph is deciding whether to go to sleep, i.e., when asked from
+     * <code>DspObject::isAtRest()</code> or <code>DspObject::hasSilentOutput()</code>.
+     */
+    bool isDspBufferKnownSilent(float *buffer);
+  
   private:
+    // a clone steps through the process order of each of its instances, see PdCloneGraph
+    friend class PdCloneGraph;
+  
     static void processGraph(DspObject *dspObject, int fromIndex, int toIndex);
   
+    /**
+     * Identical to <code>processGraph()</code>, but records the time spent in each object. It is
+     * swapped in as the <code>processFunction</code> only while profiling, such that normal
+     * processing does not pay for any of the bookkeeping.
+     */
+    static void processGraphProfiled(DspObject *dspObject, int fromIndex, int toIndex);
+  
+    /**
+     * Processes the dsp objects of this graph in order, or lets the graph sleep. Shared by
+     * <code>processGraph()</code> and <code>processGraphProfiled()</code>, which differ only in
+     * how each object is processed.
+     */
+    void processDspNodes(bool isProfiling);
+  
+    /** Processes a single dsp object and adds the time spent to its profile. */
+    void processDspObjectProfiled(DspObject *dspObject);
+  
+    /**
+     * Returns true if this graph may sleep in the current block: it is a self-contained subgraph,
+     * sleeping is enabled in the context, and all of its dsp inlets are silent.
+     */
+    bool canSleep();
+  
+    /** Fills the dsp outlets with silence in place of processing the graph. */
+    void processAsleep();
+  
+    /**
+     * Keeps track of which buffers are known to be silent while the objects of the graph are
+     * processed in order. Returns false as soon as an object is not at rest, after which the
+     * graph stays awake for the rest of the block.
+     */
+    void beginWatching();
+    bool watch(DspObject *dspObject);
+    void endWatching();
+  
+    /** Records whether the given buffer is known to be silent. */
+    void setDspBufferKnownSilent(float *buffer, bool isKnownSilent);
+  
+    /** Collects the buffers which the objects of the graph read and write, once they are known. */
+    void collectWatchedDspBuffers();
+  
+    /** Returns the index of the given buffer among the watched buffers, or -1 if it is not one. */
+    int getWatchedDspBufferIndex(float *buffer);
+  
+    /** Returns the number of dsp objects in the process order of this graph and all subgraphs. */
+    unsigned int getNumDeepDspNodes();
+  
     /** Create a new object based on its initialisation string. */
     MessageObject *newObject(char *objectType, char *objectLabel, PdMessage *initMessage, PdGraph *graph);
   
@@ -270,6 +411,40 @@ class PdGraph : public DspObject {
      * called in the <code>processFunction()</code> loop.
      */
     list<DspObject *> dspNodeList;
+  
+    /**
+     * The <code>DspObject</code>s which have been taken out of the process order because they need
+     * not be processed. See <code>DspGraphOptimiser</code>.
+     */
+    list<DspObject *> dormantDspNodeList;
+  
+    /** The buffers which the readers of folded objects would otherwise read. */
+    vector<DspSubstitution> dspSubstitutions;
+  
+    /** True if a folded object of this graph, or of one of its subgraphs, has received a message. */
+    bool hasFoldedMessages;
+  
+    /** False if the process order must be recomputed. Only meaningful for top-level graphs. */
+    bool isDspOrderValid;
+  
+    /** True if the graph is not processed because it would only output silence. */
+    bool isAsleep;
+  
+    /**
+     * True if this graph processes all of its dsp objects, and no others. A graph whose objects are
+     * ordered along with those of another graph, e.g. a [throw~] before its [catch~], never sleeps.
+     */
+    bool isSelfContained;
+  
+    /** The number of dsp objects which are skipped in each block while the graph is asleep. */
+    unsigned int numSleepingDspNodes;
+  
+    /**
+     * The buffers which the dsp objects of this graph read and write, in ascending order, and
+     * whether each is known to be silent in the current block. See <code>watch()</code>.
+     */
+    vector<float *> watchedDspBuffers;
+    vector<bool> silentDspBufferFlags;
     
     /** A list of all inlet (message or audio) nodes in this subgraph. */
     vector<MessageObject *> inletList; // in fact contains only MessageInlet and DspInlet objects
@@ -280,6 +455,9 @@ class PdGraph : public DspObject {
     /** A global list of all declared directories (-path and -stdpath) */
     DeclareList *declareList;
   
+    /** The abstractions embedded in the binary patch from which this root graph was loaded. */
+    map<string, PdPatch *> embeddedAbstractions;
+  
     /** PdGraphs may have an associated name, such as their abstraction name. */
     string name;
 };
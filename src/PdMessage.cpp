@@ -86,7 +86,12 @@ void PdMessage::resolveString(char *initString, PdMessage *arguments, unsigned i
         case '7': { argumentIndex = 7; break; }
         case '8': { argumentIndex = 8; break; }
         case '9': { argumentIndex = 9; break; }
-        default: continue;
+        default: {
+          // not an argument, such as $v1 of expr~. The dollar sign is kept.
+          buffer[bufferPos++] = '$';
+          initPos--;
+          continue;
+        }
       }
       argumentIndex -= offset;
       if (argumentIndex >= 0 && argumentIndex < numArguments) { // bounds check
@@ -0,0 +1,466 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "MessageFloat.h"
+#include "MessageMessageBox.h"
+#include "MessageSymbol.h"
+#include "MessageTable.h"
+#include "MessageText.h"
+#include "PdCloneGraph.h"
+#include "PdContext.h"
+#include "PdFileParser.h"
+#include "PdGraph.h"
+#include "PdPatch.h"
+
+#define OBJECT_LABEL_RESOLUTION_BUFFER_LENGTH 32
+#define RESOLUTION_BUFFER_LENGTH 512
+#define INIT_MESSAGE_MAX_ELEMENTS 128
+#define ARRAY_MESSAGE_MAX_ELEMENTS 4
+
+// the tables of a section are padded to a multiple of this many bytes
+#define SECTION_ALIGNMENT 4
+
+/** The counts of the tables which follow, in this order, in a section of a binary patch. */
+typedef struct PatchSection {
+  unsigned int numLines;
+  unsigned int numAtoms;
+  unsigned int numLabels;
+  unsigned int numChars; // the length of the string table, including padding
+} PatchSection;
+
+PdPatch::PdPatch(string rootPath, string fileName) {
+  this->rootPath = rootPath;
+  this->fileName = fileName;
+  modificationTime = 0;
+  factoryMap = NULL;
+  factoryMapVersion = 0;
+}
+
+PdPatch::~PdPatch() {
+  // nothing to do
+}
+
+
+#pragma mark - Build
+
+PatchLine *PdPatch::addLine(PatchLineType type) {
+  PatchLine line;
+  line.type = type;
+  memset(line.values, 0, sizeof(line.values));
+  line.text = PATCH_NO_TEXT;
+  line.isTextResolved = 1;
+  line.label = PATCH_NO_LABEL;
+  line.firstAtom = atoms.size();
+  line.numAtoms = 0;
+  line.numChars = 0;
+  lines.push_back(line);
+  return &lines.back();
+}
+
+void PdPatch::addAtom(const char *token) {
+  PatchAtom atom;
+  atom.constant = 0.0f;
+  atom.symbol = 0;
+  atom.isResolved = 1;
+  if (strstr(token, "\\$") != NULL) {
+    // the token can only be converted once the arguments are known
+    atom.type = SYMBOL;
+    atom.isResolved = 0;
+  } else {
+    PdMessage *message = PD_MESSAGE_ON_STACK(1);
+    message->initWithTimestampAndNumElements(0.0, 1);
+    message->parseAndSetMessageElement(0, (char *) token);
+    atom.type = message->getType(0);
+    if (atom.type == FLOAT) atom.constant = message->getFloat(0);
+  }
+  if (atom.type == SYMBOL) {
+    atom.symbol = addString(token);
+    lines.back().numChars += strlen(token) + 1;
+  }
+  atoms.push_back(atom);
+  lines.back().numAtoms++;
+}
+
+void PdPatch::addAtom(float constant) {
+  PatchAtom atom;
+  atom.type = FLOAT;
+  atom.constant = constant;
+  atom.symbol = 0;
+  atom.isResolved = 1;
+  atoms.push_back(atom);
+  lines.back().numAtoms++;
+}
+
+unsigned int PdPatch::addString(const char *str) {
+  unsigned int offset = strings.size();
+  strings.insert(strings.end(), str, str + strlen(str) + 1);
+  return offset;
+}
+
+void PdPatch::setLabel(PatchLine *line, const char *label) {
+  // patches use few distinct labels
+  unsigned int index = 0;
+  while (index < labels.size() && strcmp(getString(labels[index]), label)) index++;
+  if (index == labels.size()) labels.push_back(addString(label));
+  line->text = labels[index];
+  line->label = index;
+}
+
+
+#pragma mark - Binary
+
+void PdPatch::appendToData(vector<char> *data) {
+  PatchSection section;
+  section.numLines = lines.size();
+  section.numAtoms = atoms.size();
+  section.numLabels = labels.size();
+  section.numChars = ((strings.size() + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT) * SECTION_ALIGNMENT;
+  const char *bytes = (const char *) &section;
+  data->insert(data->end(), bytes, bytes + sizeof(PatchSection));
+  if (!lines.empty()) {
+    bytes = (const char *) &lines[0];
+    data->insert(data->end(), bytes, bytes + lines.size() * sizeof(PatchLine));
+  }
+  if (!atoms.empty()) {
+    bytes = (const char *) &atoms[0];
+    data->insert(data->end(), bytes, bytes + atoms.size() * sizeof(PatchAtom));
+  }
+  if (!labels.empty()) {
+    bytes = (const char *) &labels[0];
+    data->insert(data->end(), bytes, bytes + labels.size() * sizeof(unsigned int));
+  }
+  data->insert(data->end(), strings.begin(), strings.end());
+  data->insert(data->end(), section.numChars - strings.size(), '\0');
+}
+
+size_t PdPatch::readFromData(const char *data, size_t length) {
+  lines.clear();
+  atoms.clear();
+  labels.clear();
+  strings.clear();
+  factories.clear();
+  factoryMap = NULL;
+
+  PatchSection section;
+  if (length < sizeof(PatchSection)) return 0;
+  memcpy(&section, data, sizeof(PatchSection));
+  size_t offset = sizeof(PatchSection);
+
+  // each table is checked against the remaining length before it is read
+  if (section.numLines > (length - offset) / sizeof(PatchLine)) return 0;
+  lines.resize(section.numLines);
+  if (!lines.empty()) memcpy(&lines[0], data + offset, lines.size() * sizeof(PatchLine));
+  offset += lines.size() * sizeof(PatchLine);
+
+  if (section.numAtoms > (length - offset) / sizeof(PatchAtom)) return 0;
+  atoms.resize(section.numAtoms);
+  if (!atoms.empty()) memcpy(&atoms[0], data + offset, atoms.size() * sizeof(PatchAtom));
+  offset += atoms.size() * sizeof(PatchAtom);
+
+  if (section.numLabels > (length - offset) / sizeof(unsigned int)) return 0;
+  labels.resize(section.numLabels);
+  if (!labels.empty()) memcpy(&labels[0], data + offset, labels.size() * sizeof(unsigned int));
+  offset += labels.size() * sizeof(unsigned int);
+
+  if (section.numChars > length - offset || section.numChars % SECTION_ALIGNMENT != 0) return 0;
+  strings.assign(data + offset, data + offset + section.numChars);
+  offset += section.numChars;
+
+  if (!isValid()) {
+    lines.clear();
+    atoms.clear();
+    labels.clear();
+    strings.clear();
+    return 0;
+  }
+  return offset;
+}
+
+bool PdPatch::isValid() {
+  // every string ends within the table, as long as the last does
+  if (!strings.empty() && strings.back() != '\0') return false;
+  for (unsigned int i = 0; i < labels.size(); i++) {
+    if (labels[i] >= strings.size()) return false;
+  }
+  for (unsigned int i = 0; i < atoms.size(); i++) {
+    if (atoms[i].type != BANG && atoms[i].type != FLOAT && atoms[i].type != SYMBOL) return false;
+    if (atoms[i].type == SYMBOL && atoms[i].symbol >= strings.size()) return false;
+  }
+  for (unsigned int i = 0; i < lines.size(); i++) {
+    PatchLine *line = &lines[i];
+    if (line->type < PATCH_CANVAS || line->type > PATCH_ARRAY_VALUES) return false;
+    if (line->text != PATCH_NO_TEXT && line->text >= strings.size()) return false;
+    if (line->text == PATCH_NO_TEXT && (line->type == PATCH_OBJECT || line->type == PATCH_DECLARE)) {
+      return false;
+    }
+    if (line->label != PATCH_NO_LABEL && line->label >= labels.size()) return false;
+    if (line->firstAtom > atoms.size() || line->numAtoms > atoms.size() - line->firstAtom) return false;
+
+    // the buffers into which the atoms are resolved are sized by the length of their symbols
+    unsigned int numChars = 0;
+    for (unsigned int j = 0; j < line->numAtoms; j++) {
+      PatchAtom *atom = &atoms[line->firstAtom + j];
+      if (atom->type == SYMBOL) numChars += strlen(getString(atom->symbol)) + 1;
+    }
+    if (line->numChars != numChars) return false;
+  }
+  return true;
+}
+
+
+#pragma mark - Instantiate
+
+PdGraph *PdPatch::instantiate(PdContext *context) {
+  return instantiate(NULL, NULL, context, true, NULL);
+}
+
+PdGraph *PdPatch::instantiate(PdContext *context, map<string, PdPatch *> *embeddedAbstractions) {
+  return instantiate(NULL, NULL, context, true, embeddedAbstractions);
+}
+
+PdGraph *PdPatch::instantiate(PdMessage *initMessage, PdGraph *graph, PdContext *context) {
+  PdGraph *newGraph = instantiate(initMessage, graph, context, false, NULL);
+  return (newGraph == graph) ? NULL : newGraph;
+}
+
+void PdPatch::initMessageWithAtoms(PdMessage *message, unsigned int maxElements, PatchLine *line,
+    PdMessage *arguments, char *buffer, unsigned int bufferLength) {
+  if (line->numAtoms == 0) {
+    message->initWithTimestampAndBang(0.0); // there is always at least one element in a message
+    return;
+  }
+  unsigned int numElements = (line->numAtoms < maxElements) ? line->numAtoms : maxElements;
+  message->initWithTimestampAndNumElements(0.0, numElements);
+  unsigned int bufferPos = 0;
+  for (unsigned int i = 0; i < numElements; i++) {
+    PatchAtom *atom = &atoms[line->firstAtom + i];
+    switch (atom->type) {
+      case FLOAT: message->setFloat(i, atom->constant); break;
+      case SYMBOL: {
+        // symbols are copied, such that objects may do with them as they please
+        char *symbol = buffer + bufferPos;
+        if (atom->isResolved) {
+          strcpy(symbol, getString(atom->symbol));
+          message->setSymbol(i, symbol);
+        } else {
+          PdMessage::resolveString((char *) getString(atom->symbol), arguments, 0, symbol,
+              bufferLength - bufferPos);
+          message->parseAndSetMessageElement(i, symbol);
+        }
+        bufferPos += strlen(symbol) + 1;
+        break;
+      }
+      default: message->setBang(i); break;
+    }
+  }
+}
+
+void PdPatch::updateFactories(PdContext *context) {
+  ObjectFactoryMap *objectFactoryMap = context->getObjectFactoryMap();
+  if (factoryMap != objectFactoryMap || factoryMapVersion != objectFactoryMap->getVersion() ||
+      factories.size() != labels.size()) {
+    factories.resize(labels.size());
+    for (unsigned int i = 0; i < labels.size(); i++) {
+      factories[i] = objectFactoryMap->getFactory(getString(labels[i]));
+    }
+    factoryMap = objectFactoryMap;
+    factoryMapVersion = objectFactoryMap->getVersion();
+  }
+}
+
+PdGraph *PdPatch::instantiate(PdMessage *initMsg, PdGraph *graph, PdContext *context, bool isSubPatch,
+    map<string, PdPatch *> *embeddedAbstractions) {
+  PdMessage *initMessage = PD_MESSAGE_ON_STACK(INIT_MESSAGE_MAX_ELEMENTS);
+  updateFactories(context);
+
+  MessageTable *lastArrayCreated = NULL;  // used to know on which table the #A line values have to be set
+  int lastArrayCreatedIndex = 0;
+  for (unsigned int i = 0; i < lines.size(); i++) {
+    PatchLine *line = &lines[i];
+    switch (line->type) {
+      case PATCH_CANVAS: {
+        // A new graph is defined inline. No arguments are passed (from this line)
+        // the graphId is not incremented as this is a subpatch, not an abstraction
+        // NOTE(mhroth): pixel location is not recorded
+        const char *canvasName = (line->text == PATCH_NO_TEXT) ? NULL : getString(line->text);
+        PdGraph *newGraph = NULL;
+        if (graph == NULL) { // if no parent graph exists
+          initMessage->initWithTimestampAndNumElements(0.0, 0); // make a dummy initMessage
+          newGraph = new PdGraph(initMessage, NULL, context, context->getNextGraphId(), "zg_root");
+          if (!rootPath.empty()) {
+            // inform the root graph of where it is in the file system, if this information exists.
+            // This will allow abstractions to be correctly loaded.
+            newGraph->addDeclarePath(rootPath.c_str());
+          }
+          if (embeddedAbstractions != NULL) newGraph->setEmbeddedAbstractions(embeddedAbstractions);
+        } else {
+          if (isSubPatch) {
+            // a graph made a subpatch
+            newGraph = new PdGraph(graph->getArguments(), graph, context, graph->getGraphId(), canvasName);
+          } else {
+            // a graph made as an abstraction
+            newGraph = new PdGraph(initMsg, graph, context, context->getNextGraphId(), (rootPath+fileName).c_str());
+            isSubPatch = true;
+          }
+          graph->addObject(0, 0, newGraph); // add the new graph to the current one as an object
+        }
+
+        // the new graph is pushed onto the stack
+        graph = newGraph;
+        break;
+      }
+      case PATCH_OBJECT: {
+        // resolve $ variables in the object label (such as objects that are simply labeled "$1")
+        const char *objectLabel = getString(line->text);
+        char resBufferLabel[strlen(objectLabel) + OBJECT_LABEL_RESOLUTION_BUFFER_LENGTH];
+        if (!line->isTextResolved) {
+          PdMessage::resolveString((char *) objectLabel, graph->getArguments(), 0,
+              resBufferLabel, sizeof(resBufferLabel)); // object labels are always strings
+                                                       // even if they are numbers, e.g. "1"
+          objectLabel = resBufferLabel;
+        }
+
+        // resolve $ variables in the object arguments
+        char resBuffer[line->numChars + RESOLUTION_BUFFER_LENGTH];
+        initMessageWithAtoms(initMessage, INIT_MESSAGE_MAX_ELEMENTS, line, graph->getArguments(),
+            resBuffer, sizeof(resBuffer));
+
+        // create the object
+        MessageObject *messageObject = NULL;
+        ObjectFactory factory = (line->label != PATCH_NO_LABEL) ? factories[line->label] : NULL;
+        if (factory != NULL) {
+          messageObject = factory(initMessage, graph);
+        } else if (!strcmp(objectLabel, PdCloneGraph::getObjectLabel())) {
+          // all instances of a [clone] are made from the same patch
+          messageObject = PdCloneGraph::newObject(initMessage, graph, context);
+        } else {
+          messageObject = context->newObject(objectLabel, initMessage, graph);
+        }
+        if (messageObject == NULL) { // object could not be created based on any known object factory functions
+          PdPatch *abstraction = PdFileParser::parseAbstraction(objectLabel, graph, context);
+          if (abstraction != NULL) abstraction->instantiate(initMessage, graph, context, false, NULL);
+        } else {
+          // add the object to the local graph and make any necessary registrations
+          graph->addObject((float) line->values[0], (float) line->values[1], messageObject);
+        }
+        break;
+      }
+      case PATCH_MESSAGE: {
+        // the message box resolves its own arguments whenever it is sent a message
+        char text[(line->text == PATCH_NO_TEXT) ? 1 : strlen(getString(line->text))+1];
+        if (line->text != PATCH_NO_TEXT) strcpy(text, getString(line->text));
+        initMessage->initWithTimestampAndSymbol(0.0, (line->text == PATCH_NO_TEXT) ? NULL : text);
+        MessageObject *messageObject = context->newObject(
+            MessageMessageBox::getObjectLabel(), initMessage, graph);
+        graph->addObject((float) line->values[0], (float) line->values[1], messageObject);
+        break;
+      }
+      case PATCH_CONNECT: {
+        graph->addConnection(line->values[0], line->values[1], line->values[2], line->values[3]);
+        break;
+      }
+      case PATCH_FLOAT_ATOM: {
+        initMessage->initWithTimestampAndFloat(0.0, 0.0f);
+        MessageObject *messageObject = context->newObject(
+            MessageFloat::getObjectLabel(), initMessage, graph); // defines a number box
+        graph->addObject((float) line->values[0], (float) line->values[1], messageObject);
+        break;
+      }
+      case PATCH_SYMBOL_ATOM: {
+        initMessage->initWithTimestampAndSymbol(0.0, NULL);
+        MessageObject *messageObject = context->newObject(
+            MessageSymbol::getObjectLabel(), initMessage, graph);
+        graph->addObject((float) line->values[0], (float) line->values[1], messageObject);
+        break;
+      }
+      case PATCH_RESTORE: {
+        // the graph is finished being defined
+        // pop the graph stack to the parent graph
+        // the process order will be computed by the parent graph
+        graph = graph->getParentGraph();
+        break;
+      }
+      case PATCH_TEXT: {
+        char comment[(line->text == PATCH_NO_TEXT) ? 1 : strlen(getString(line->text))+1];
+        if (line->text != PATCH_NO_TEXT) strcpy(comment, getString(line->text));
+        initMessage->initWithTimestampAndSymbol(0.0, (line->text == PATCH_NO_TEXT) ? NULL : comment);
+        MessageObject *messageText = context->newObject(
+            MessageText::getObjectLabel(), initMessage, graph);
+        graph->addObject((float) line->values[0], (float) line->values[1], messageText);
+        break;
+      }
+      case PATCH_DECLARE: {
+        // set environment for loading patch
+        char objectInitString[strlen(getString(line->text))+1];
+        strcpy(objectInitString, getString(line->text));
+        initMessage->initWithString(0.0, 2, objectInitString); // parse the arguments to declare
+        if (initMessage->isSymbol(0, "-path")) {
+          if (initMessage->isSymbol(1)) {
+            // add symbol to declare directories
+            graph->addDeclarePath(initMessage->getSymbol(1));
+          }
+        } else {
+          context->printErr("declare \"%s\" flag is not supported.", initMessage->getSymbol(0));
+        }
+        break;
+      }
+      case PATCH_ARRAY: {
+        // creates a new table
+        // the atoms should contain both name and buffer length
+        char resBuffer[line->numChars + RESOLUTION_BUFFER_LENGTH];
+        initMessageWithAtoms(initMessage, ARRAY_MESSAGE_MAX_ELEMENTS, line, graph->getArguments(),
+            resBuffer, sizeof(resBuffer));
+        lastArrayCreated = reinterpret_cast<MessageTable *>(context->newObject("table", initMessage, graph));
+        lastArrayCreatedIndex = 0;
+        graph->addObject(0, 0, lastArrayCreated);
+        context->printStd("PdFileParser: Replacer array with table, name: '%s'", initMessage->getSymbol(0));
+        break;
+      }
+      case PATCH_ARRAY_VALUES: {
+        if (lastArrayCreated == NULL) {
+          context->printErr("#A line but no array were created");
+        } else {
+          int bufferLength = 0;
+          float *buffer = lastArrayCreated->getBuffer(&bufferLength);
+          int index = line->values[0];
+          for (unsigned int j = 0; j < line->numAtoms; j++) {
+            if (index >= bufferLength) {
+              context->printErr("#A trying to add value at index %d while buffer length is %d", index, bufferLength);
+              break;
+            }
+            buffer[index] = atoms[line->firstAtom + j].constant;
+            ++index;
+            ++lastArrayCreatedIndex;
+          }
+          if (lastArrayCreatedIndex == bufferLength) {
+            lastArrayCreated = NULL;
+            lastArrayCreatedIndex = 0;
+          }
+        }
+        break;
+      }
+      default: break;
+    }
+  }
+
+  return graph;
+}
@@ -0,0 +1,216 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PD_PATCH_H_
+#define _PD_PATCH_H_
+
+#include <map>
+#include <string>
+#include <time.h>
+#include <vector>
+#include "MessageElementType.h"
+#include "ObjectFactoryMap.h"
+
+class PdContext;
+class PdGraph;
+class PdMessage;
+
+using namespace std;
+
+/** The kinds of logical line of which a patch consists. */
+typedef enum PatchLineType {
+  PATCH_CANVAS,      // #N canvas, which begins a graph or a subpatch
+  PATCH_OBJECT,      // #X obj
+  PATCH_MESSAGE,     // #X msg
+  PATCH_FLOAT_ATOM,  // #X floatatom
+  PATCH_SYMBOL_ATOM, // #X symbolatom
+  PATCH_TEXT,        // #X text
+  PATCH_CONNECT,     // #X connect
+  PATCH_RESTORE,     // #X restore, which ends a subpatch
+  PATCH_DECLARE,     // #X declare
+  PATCH_ARRAY,       // #X array
+  PATCH_ARRAY_VALUES // #A
+} PatchLineType;
+
+/** The text of a line which has none, such as a comment without words. */
+#define PATCH_NO_TEXT 0xFFFFFFFF
+
+/** The label of an object which can only be known once the arguments of the graph are. */
+#define PATCH_NO_LABEL 0xFFFFFFFF
+
+/**
+ * One element of the init message of an object or array. Elements which refer to the arguments of
+ * the graph, such as <code>\$0-freq</code>, are kept as unresolved symbols and are resolved anew
+ * for every instance.
+ */
+typedef struct PatchAtom {
+  MessageElementType type; // BANG, FLOAT or SYMBOL
+  float constant;
+  unsigned int symbol; // the offset of the symbol in the string table
+  unsigned int isResolved; // zero if the symbol refers to the arguments of the graph
+} PatchAtom;
+
+/** One logical line of a patch. */
+typedef struct PatchLine {
+  PatchLineType type;
+
+  /**
+   * The position of an object on the canvas, followed by the size of a canvas. The index of the
+   * first of the values of an array. The object, outlet, object and inlet of a connection.
+   */
+  int values[4];
+
+  /**
+   * The offset in the string table of the label of an object, the name of a canvas, or the text
+   * of a message box, comment or declaration. <code>PATCH_NO_TEXT</code> if there is none.
+   */
+  unsigned int text;
+  unsigned int isTextResolved; // zero if the label of an object refers to the arguments of the graph
+
+  /**
+   * The index of the label of an object in the label table, such that objects with the same label
+   * share one factory. <code>PATCH_NO_LABEL</code> if the label is not yet resolved.
+   */
+  unsigned int label;
+
+  /** The elements of the init message of an object or array, or the values of an array. */
+  unsigned int firstAtom;
+  unsigned int numAtoms;
+
+  /** The total length of the symbols of the atoms, including their terminators. */
+  unsigned int numChars;
+} PatchLine;
+
+/**
+ * A patch which has been parsed once, and which may be instantiated any number of times. Each
+ * logical line of the file is kept as a <code>PatchLine</code>, whose arguments have already been
+ * split into atoms, and numbers converted. Instantiation only resolves the atoms which refer to
+ * <code>$</code> arguments, and creates the objects.
+ *
+ * Patches are made by <code>PdFileParser::parse()</code>. Those of abstractions are kept in the
+ * context's <code>PdAbstractionDataBase</code>, such that each abstraction is parsed only once
+ * however many times it is instantiated. Those embedded in a binary patch are kept by the root graph
+ * which is loaded from it.
+ */
+class PdPatch {
+
+  public:
+    /** The root path and file name are those of the file from which the patch is parsed. */
+    PdPatch(string rootPath, string fileName);
+    ~PdPatch();
+
+    /** Instantiates the patch as a new root graph, which is returned. */
+    PdGraph *instantiate(PdContext *context);
+
+    /**
+     * Instantiates the patch as a new root graph, which takes the given patches of embedded
+     * abstractions before any object is created. See <code>PdGraph::setEmbeddedAbstractions()</code>.
+     */
+    PdGraph *instantiate(PdContext *context, map<string, PdPatch *> *embeddedAbstractions);
+
+    /**
+     * Instantiates the patch as an abstraction with the given arguments, and adds it to the given
+     * graph. Returns the new graph, or <code>NULL</code> if the patch does not define one.
+     */
+    PdGraph *instantiate(PdMessage *initMessage, PdGraph *graph, PdContext *context);
+
+    /**
+     * Appends a line of the given type, with no text and no atoms. The returned line may be filled
+     * in until the next line is appended.
+     */
+    PatchLine *addLine(PatchLineType type);
+
+    /**
+     * Appends an atom to the last line. Tokens which refer to <code>$</code> arguments are kept as
+     * they are, and others are converted as by <code>PdMessage::parseAndSetMessageElement()</code>.
+     */
+    void addAtom(const char *token);
+
+    /** Appends an atom with the given value to the last line. */
+    void addAtom(float constant);
+
+    /** Adds a string to the string table, and returns its offset. */
+    unsigned int addString(const char *str);
+  
+    /**
+     * Sets the label of the given object line, which must not refer to the arguments of the graph.
+     * Each distinct label is added to the label table once.
+     */
+    void setLabel(PatchLine *line, const char *label);
+  
+    /**
+     * Appends the tables of the patch to the given data, as a section of a binary patch. See
+     * <code>PdPatchFile</code>.
+     */
+    void appendToData(vector<char> *data);
+  
+    /**
+     * Replaces the tables of the patch with those of the section at the given data. Returns the
+     * length of the section, or zero if it is malformed, in which case the patch is left empty.
+     */
+    size_t readFromData(const char *data, size_t length);
+
+    unsigned int getNumLines() { return lines.size(); }
+
+    /** The modification time of the file from which the patch was parsed, or zero. */
+    time_t getModificationTime() { return modificationTime; }
+    void setModificationTime(time_t modificationTime) { this->modificationTime = modificationTime; }
+
+  private:
+    PdGraph *instantiate(PdMessage *initMsg, PdGraph *graph, PdContext *context, bool isSubPatch,
+        map<string, PdPatch *> *embeddedAbstractions);
+
+    /**
+     * Initialises the message with the atoms of the given line, resolving those which refer to
+     * the given arguments. Symbols are written into the buffer, which must be at least
+     * <code>line->numChars</code> long plus room for the resolved arguments.
+     */
+    void initMessageWithAtoms(PdMessage *message, unsigned int maxElements, PatchLine *line,
+        PdMessage *arguments, char *buffer, unsigned int bufferLength);
+
+    const char *getString(unsigned int offset) { return &strings[offset]; }
+  
+    /** Returns true if all offsets and indices in the tables of the patch are in bounds. */
+    bool isValid();
+  
+    /**
+     * Looks up the factory of every label in the label table, unless it has been done since the
+     * objects of the context last changed.
+     */
+    void updateFactories(PdContext *context);
+
+    vector<PatchLine> lines;
+    vector<PatchAtom> atoms;
+    vector<unsigned int> labels; // the offsets of the distinct object labels in the string table
+    vector<char> strings;
+  
+    /** The factory of each label, as last looked up, and the map in which it was. */
+    vector<ObjectFactory> factories;
+    ObjectFactoryMap *factoryMap;
+    unsigned int factoryMapVersion;
+
+    string rootPath;
+    string fileName;
+    time_t modificationTime;
+};
+
+#endif // _PD_PATCH_H_
@@ -0,0 +1,195 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "PdAbstractionDataBase.h"
+#include "PdContext.h"
+#include "PdFileParser.h"
+#include "PdGraph.h"
+#include "PdPatch.h"
+#include "PdPatchFile.h"
+
+// labels are padded to a multiple of this many bytes, as are the tables of each patch
+#define LABEL_ALIGNMENT 4
+
+
+#pragma mark - Write
+
+bool PdPatchFile::write(PdContext *context, const char *directory, const char *fileName, const char *path) {
+  PdFileParser *parser = new PdFileParser(string(directory), string(fileName));
+  PdPatch *patch = parser->parse(context);
+  delete parser;
+
+  // the abstractions are found by instantiating the patch, exactly as they are when it is loaded
+  PdAbstractionDataBase *abstractionDataBase = context->getAbstractionDataBase();
+  vector<pair<string, PdPatch *> > resolvedPatches;
+  abstractionDataBase->setResolvedPatches(&resolvedPatches);
+  PdGraph *graph = patch->instantiate(context);
+  abstractionDataBase->setResolvedPatches(NULL);
+  if (graph == NULL) {
+    context->printErr("Patch \"%s%s\" could not be loaded.", directory, fileName);
+    delete patch;
+    return false;
+  }
+  delete graph;
+
+  // each abstraction is embedded once, under the label by which it was found
+  vector<PdPatch *> patches(1, patch);
+  vector<string> labels(1, string());
+  for (unsigned int i = 0; i < resolvedPatches.size(); i++) {
+    string label = resolvedPatches[i].first;
+    unsigned int j = 1;
+    while (j < labels.size() && labels[j] != label) j++;
+    if (j == labels.size()) {
+      patches.push_back(resolvedPatches[i].second);
+      labels.push_back(label);
+    } else if (patches[j] != resolvedPatches[i].second) {
+      context->printErr("Abstraction \"%s\" is found in more than one directory. Only the first is embedded.",
+          label.c_str());
+    }
+  }
+
+  vector<char> data;
+  PatchFileHeader header;
+  memcpy(header.magic, PATCH_FILE_MAGIC, sizeof(header.magic));
+  header.version = PATCH_FILE_VERSION;
+  header.byteOrder = PATCH_FILE_BYTE_ORDER;
+  header.numPatches = patches.size();
+  data.insert(data.end(), (const char *) &header, (const char *) &header + sizeof(PatchFileHeader));
+  for (unsigned int i = 0; i < patches.size(); i++) {
+    // the label is terminated by at least one zero
+    unsigned int labelLength = ((labels[i].size() + LABEL_ALIGNMENT) / LABEL_ALIGNMENT) * LABEL_ALIGNMENT;
+    data.insert(data.end(), (const char *) &labelLength, (const char *) &labelLength + sizeof(unsigned int));
+    data.insert(data.end(), labels[i].begin(), labels[i].end());
+    data.insert(data.end(), labelLength - labels[i].size(), '\0');
+    patches[i]->appendToData(&data);
+  }
+  delete patch; // the abstractions remain in the database
+
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    context->printErr("Binary patch \"%s\" could not be written.", path);
+    return false;
+  }
+  size_t numBytesWritten = fwrite(&data[0], 1, data.size(), fp);
+  fclose(fp);
+  if (numBytesWritten != data.size()) {
+    context->printErr("Binary patch \"%s\" could not be written.", path);
+    return false;
+  }
+  return true;
+}
+
+
+#pragma mark - Read
+
+PdGraph *PdPatchFile::newGraph(PdContext *context, const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    context->printErr("Binary patch \"%s\" could not be opened.", path);
+    return NULL;
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t) sizeof(PatchFileHeader)) {
+    close(fd);
+    context->printErr("\"%s\" is not a binary patch.", path);
+    return NULL;
+  }
+  size_t length = fileStat.st_size;
+  void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps the file open
+  if (mapping == MAP_FAILED) {
+    context->printErr("Binary patch \"%s\" could not be mapped.", path);
+    return NULL;
+  }
+  const char *data = (const char *) mapping;
+
+  PatchFileHeader header;
+  memcpy(&header, data, sizeof(PatchFileHeader));
+  if (memcmp(header.magic, PATCH_FILE_MAGIC, sizeof(header.magic)) ||
+      header.version != PATCH_FILE_VERSION || header.byteOrder != PATCH_FILE_BYTE_ORDER) {
+    munmap(mapping, length);
+    context->printErr("\"%s\" is not a binary patch of this version or byte order.", path);
+    return NULL;
+  }
+
+  // abstractions are found relative to the binary patch, as they would be relative to the Pd file
+  string fullPath = string(path);
+  size_t separator = fullPath.find_last_of('/');
+  string directory = (separator == string::npos) ? string() : fullPath.substr(0, separator + 1);
+  string fileName = (separator == string::npos) ? fullPath : fullPath.substr(separator + 1);
+
+  // all patches are read before any is used, such that a malformed file changes nothing
+  vector<PdPatch *> patches;
+  vector<string> labels;
+  size_t offset = sizeof(PatchFileHeader);
+  bool isValid = (header.numPatches > 0);
+  for (unsigned int i = 0; i < header.numPatches && isValid; i++) {
+    unsigned int labelLength = 0;
+    if (length - offset >= sizeof(unsigned int)) {
+      memcpy(&labelLength, data + offset, sizeof(unsigned int));
+      offset += sizeof(unsigned int);
+    }
+    if (labelLength == 0 || labelLength > length - offset || labelLength % LABEL_ALIGNMENT != 0 ||
+        data[offset + labelLength - 1] != '\0') {
+      isValid = false;
+    } else {
+      string label = string(data + offset);
+      offset += labelLength;
+      PdPatch *patch = new PdPatch(directory, (i == 0) ? fileName : label + ".pd");
+      size_t sectionLength = patch->readFromData(data + offset, length - offset);
+      offset += sectionLength;
+      patches.push_back(patch);
+      labels.push_back(label);
+      isValid = (sectionLength > 0);
+    }
+  }
+  munmap(mapping, length);
+
+  if (!isValid) {
+    for (unsigned int i = 0; i < patches.size(); i++) delete patches[i];
+    context->printErr("Binary patch \"%s\" is malformed.", path);
+    return NULL;
+  }
+  // the embedded abstractions belong to the new graph, such that they shadow no other patch
+  map<string, PdPatch *> embeddedAbstractions;
+  for (unsigned int i = 1; i < patches.size(); i++) {
+    if (embeddedAbstractions.count(labels[i]) > 0) delete embeddedAbstractions[labels[i]];
+    embeddedAbstractions[labels[i]] = patches[i];
+  }
+  PdGraph *graph = patches[0]->instantiate(context, &embeddedAbstractions);
+  delete patches[0];
+  if (graph == NULL) {
+    // the patch defines no graph which could have taken them
+    for (map<string, PdPatch *>::iterator it = embeddedAbstractions.begin();
+        it != embeddedAbstractions.end(); ++it) {
+      delete it->second;
+    }
+  }
+  return graph;
+}
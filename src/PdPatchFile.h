@@ -0,0 +1,85 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _PD_PATCH_FILE_H_
+#define _PD_PATCH_FILE_H_
+
+#include <string>
+#include <vector>
+
+class PdContext;
+class PdGraph;
+class PdPatch;
+
+using namespace std;
+
+/** The first four bytes of every binary patch. */
+#define PATCH_FILE_MAGIC "ZGPB"
+
+/** The version of the layout of binary patches. Files of any other version are refused. */
+#define PATCH_FILE_VERSION 1
+
+/** Written as is, such that files written with another byte order are recognised. */
+#define PATCH_FILE_BYTE_ORDER 0x01020304
+
+/** The header of a binary patch. */
+typedef struct PatchFileHeader {
+  char magic[4];
+  unsigned int version;
+  unsigned int byteOrder;
+  unsigned int numPatches; // the root patch, followed by the embedded abstractions
+} PatchFileHeader;
+
+/**
+ * A binary patch holds a Pd file which has already been parsed, together with all of the
+ * abstractions which it uses, such that it can be loaded without tokenising any text or searching
+ * for any files. It is made of a <code>PatchFileHeader</code> followed by one entry per patch.
+ * Each entry is the length of a label, the label itself, and the tables of a <code>PdPatch</code>
+ * (see <code>PdPatch::appendToData()</code>). The label of the root patch is empty. Object labels
+ * are kept in a label table per patch, such that each distinct label is looked up in the factory
+ * map only once. All values are in the byte order of the machine which wrote the file, and all
+ * entries are padded to a multiple of four bytes.
+ */
+class PdPatchFile {
+
+  public:
+    /**
+     * Parses the given Pd file and writes it, with all of the abstractions which it uses, to a
+     * binary patch at the given path. The file is instantiated once in the context, and every
+     * abstraction which is found while doing so is embedded under the label by which it was found,
+     * exactly as it would be found when the file is loaded. The graph is then deleted. Abstractions
+     * whose labels refer to the arguments of a graph are embedded as they are resolved with the
+     * arguments of this instance. Returns true on success.
+     */
+    static bool write(PdContext *context, const char *directory, const char *fileName, const char *path);
+  
+    /**
+     * Maps the binary patch at the given path into memory, and instantiates it as a new root graph,
+     * which is returned. The embedded abstractions belong to the new graph, where they take
+     * precedence over files, and are not seen by any other graph. Returns <code>NULL</code> if the
+     * file cannot be read, or is not a binary patch of this version.
+     */
+    static PdGraph *newGraph(PdContext *context, const char *path);
+};
+
+#endif // _PD_PATCH_FILE_H_
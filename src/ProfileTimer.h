@@ -0,0 +1,65 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _PROFILE_TIMER_H_
+#define _PROFILE_TIMER_H_
+
+#include <stdint.h>
+#if __APPLE__
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+/** Counters accumulated for a single <code>DspObject</code> while its context is profiling. */
+typedef struct DspProfile {
+  uint64_t numNanoseconds; // total time spent in the object's process function
+  unsigned int numCalls; // number of times the process function was called
+  unsigned int numMessages; // number of messages which were pending when the function was called
+} DspProfile;
+
+/**
+ * A monotonic high resolution clock used for profiling the audio thread. No allocation or locking
+ * takes place, such that it is safe to call from within <code>PdContext::process()</code>.
+ */
+class ProfileTimer {
+
+  public:
+    /** Returns a monotonic timestamp in nanoseconds. The reference point is arbitrary. */
+    static inline uint64_t now() {
+      #if __APPLE__
+      static mach_timebase_info_data_t timebase = {0, 0};
+      if (timebase.denom == 0) mach_timebase_info(&timebase);
+      return (mach_absolute_time() * timebase.numer) / timebase.denom;
+      #else
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+      #endif
+    }
+
+  private:
+    ProfileTimer(); // a private constructor. No instances of this object should be made.
+    ~ProfileTimer();
+};
+
+#endif // _PROFILE_TIMER_H_
@@ -0,0 +1,237 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#if __AVX2__
+#include <immintrin.h>
+#endif
+#if __SSE2__
+#include <emmintrin.h>
+#elif __ARM_NEON__
+#include <arm_neon.h>
+#endif
+#include "RandomGenerator.h"
+
+// random bits are converted to floats in [-1, 1) from their top 24 bits
+#define UNIFORM_SCALE (1.0f / 8388608.0f) // 2^-23
+
+RandomGenerator::RandomGenerator(uint32_t seed) {
+  this->seed(seed);
+}
+
+void RandomGenerator::seed(uint32_t seed) {
+  // each lane is seeded from its own part of one sequence, as recommended for xoshiro
+  uint64_t sequence = seed;
+  for (int i = 0; i < RANDOM_GENERATOR_NUM_LANES; i++) {
+    for (int j = 0; j < 4; j++) {
+      state[j][i] = nextSeed(&sequence);
+    }
+    if ((state[0][i] | state[1][i] | state[2][i] | state[3][i]) == 0) state[0][i] = 1; // never all zero
+  }
+  numBitsUsed = RANDOM_GENERATOR_NUM_LANES;
+}
+
+uint32_t RandomGenerator::nextSeed(uint64_t *sequence) {
+  // splitmix64
+  uint64_t z = (*sequence += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return (uint32_t) ((z ^ (z >> 31)) >> 32);
+}
+
+uint32_t RandomGenerator::nextInt() {
+  if (numBitsUsed == RANDOM_GENERATOR_NUM_LANES) {
+    step();
+    numBitsUsed = 0;
+  }
+  return bits[numBitsUsed++];
+}
+
+uint32_t RandomGenerator::nextInt(uint32_t range) {
+  // the top bits are the best ones of xoshiro128+
+  return (uint32_t) ((((uint64_t) nextInt()) * range) >> 32);
+}
+
+void RandomGenerator::step() {
+  #if __AVX2__
+  __m256i s0 = _mm256_loadu_si256((__m256i *) state[0]);
+  __m256i s1 = _mm256_loadu_si256((__m256i *) state[1]);
+  __m256i s2 = _mm256_loadu_si256((__m256i *) state[2]);
+  __m256i s3 = _mm256_loadu_si256((__m256i *) state[3]);
+  _mm256_storeu_si256((__m256i *) bits, _mm256_add_epi32(s0, s3));
+  __m256i t = _mm256_slli_epi32(s1, 9);
+  s2 = _mm256_xor_si256(s2, s0);
+  s3 = _mm256_xor_si256(s3, s1);
+  s1 = _mm256_xor_si256(s1, s2);
+  s0 = _mm256_xor_si256(s0, s3);
+  s2 = _mm256_xor_si256(s2, t);
+  s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+  _mm256_storeu_si256((__m256i *) state[0], s0);
+  _mm256_storeu_si256((__m256i *) state[1], s1);
+  _mm256_storeu_si256((__m256i *) state[2], s2);
+  _mm256_storeu_si256((__m256i *) state[3], s3);
+  #elif __SSE2__
+  for (int i = 0; i < RANDOM_GENERATOR_NUM_LANES; i += 4) {
+    __m128i s0 = _mm_loadu_si128((__m128i *) (state[0] + i));
+    __m128i s1 = _mm_loadu_si128((__m128i *) (state[1] + i));
+    __m128i s2 = _mm_loadu_si128((__m128i *) (state[2] + i));
+    __m128i s3 = _mm_loadu_si128((__m128i *) (state[3] + i));
+    _mm_storeu_si128((__m128i *) (bits + i), _mm_add_epi32(s0, s3));
+    __m128i t = _mm_slli_epi32(s1, 9);
+    s2 = _mm_xor_si128(s2, s0);
+    s3 = _mm_xor_si128(s3, s1);
+    s1 = _mm_xor_si128(s1, s2);
+    s0 = _mm_xor_si128(s0, s3);
+    s2 = _mm_xor_si128(s2, t);
+    s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+    _mm_storeu_si128((__m128i *) (state[0] + i), s0);
+    _mm_storeu_si128((__m128i *) (state[1] + i), s1);
+    _mm_storeu_si128((__m128i *) (state[2] + i), s2);
+    _mm_storeu_si128((__m128i *) (state[3] + i), s3);
+  }
+  #elif __ARM_NEON__
+  for (int i = 0; i < RANDOM_GENERATOR_NUM_LANES; i += 4) {
+    uint32x4_t s0 = vld1q_u32(state[0] + i);
+    uint32x4_t s1 = vld1q_u32(state[1] + i);
+    uint32x4_t s2 = vld1q_u32(state[2] + i);
+    uint32x4_t s3 = vld1q_u32(state[3] + i);
+    vst1q_u32(bits + i, vaddq_u32(s0, s3));
+    uint32x4_t t = vshlq_n_u32(s1, 9);
+    s2 = veorq_u32(s2, s0);
+    s3 = veorq_u32(s3, s1);
+    s1 = veorq_u32(s1, s2);
+    s0 = veorq_u32(s0, s3);
+    s2 = veorq_u32(s2, t);
+    s3 = vsriq_n_u32(vshlq_n_u32(s3, 11), s3, 21);
+    vst1q_u32(state[0] + i, s0);
+    vst1q_u32(state[1] + i, s1);
+    vst1q_u32(state[2] + i, s2);
+    vst1q_u32(state[3] + i, s3);
+  }
+  #else
+  for (int i = 0; i < RANDOM_GENERATOR_NUM_LANES; i++) {
+    bits[i] = state[0][i] + state[3][i];
+    uint32_t t = state[1][i] << 9;
+    state[2][i] ^= state[0][i];
+    state[3][i] ^= state[1][i];
+    state[1][i] ^= state[2][i];
+    state[0][i] ^= state[3][i];
+    state[2][i] ^= t;
+    state[3][i] = (state[3][i] << 11) | (state[3][i] >> 21);
+  }
+  #endif
+}
+
+void RandomGenerator::fillUniform(float *buffer, int length) {
+  int i = 0;
+  // first use up the bits which are left over from the last call
+  for (; i < length && numBitsUsed < RANDOM_GENERATOR_NUM_LANES; i++) {
+    buffer[i] = ((float) (((int32_t) bits[numBitsUsed++]) >> 8)) * UNIFORM_SCALE;
+  }
+  int numSteps = (length - i) / RANDOM_GENERATOR_NUM_LANES;
+  fillUniformSteps(buffer + i, numSteps);
+  i += numSteps * RANDOM_GENERATOR_NUM_LANES;
+  if (i < length) {
+    // keep the rest of the bits for the next call
+    step();
+    for (numBitsUsed = 0; i < length; i++) {
+      buffer[i] = ((float) (((int32_t) bits[numBitsUsed++]) >> 8)) * UNIFORM_SCALE;
+    }
+  }
+}
+
+void RandomGenerator::fillUniformSteps(float *buffer, int numSteps) {
+  #if __AVX2__
+  __m256i s0 = _mm256_loadu_si256((__m256i *) state[0]);
+  __m256i s1 = _mm256_loadu_si256((__m256i *) state[1]);
+  __m256i s2 = _mm256_loadu_si256((__m256i *) state[2]);
+  __m256i s3 = _mm256_loadu_si256((__m256i *) state[3]);
+  for (int i = 0; i < numSteps; i++, buffer += 8) {
+    _mm256_storeu_ps(buffer, _mm256_mul_ps(_mm256_cvtepi32_ps(
+        _mm256_srai_epi32(_mm256_add_epi32(s0, s3), 8)), _mm256_set1_ps(UNIFORM_SCALE)));
+    __m256i t = _mm256_slli_epi32(s1, 9);
+    s2 = _mm256_xor_si256(s2, s0);
+    s3 = _mm256_xor_si256(s3, s1);
+    s1 = _mm256_xor_si256(s1, s2);
+    s0 = _mm256_xor_si256(s0, s3);
+    s2 = _mm256_xor_si256(s2, t);
+    s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+  }
+  _mm256_storeu_si256((__m256i *) state[0], s0);
+  _mm256_storeu_si256((__m256i *) state[1], s1);
+  _mm256_storeu_si256((__m256i *) state[2], s2);
+  _mm256_storeu_si256((__m256i *) state[3], s3);
+  #elif __SSE2__
+  // the two halves of the lanes are independent
+  for (int j = 0; j < RANDOM_GENERATOR_NUM_LANES; j += 4) {
+    __m128i s0 = _mm_loadu_si128((__m128i *) (state[0] + j));
+    __m128i s1 = _mm_loadu_si128((__m128i *) (state[1] + j));
+    __m128i s2 = _mm_loadu_si128((__m128i *) (state[2] + j));
+    __m128i s3 = _mm_loadu_si128((__m128i *) (state[3] + j));
+    for (int i = 0; i < numSteps; i++) {
+      _mm_storeu_ps(buffer + i*RANDOM_GENERATOR_NUM_LANES + j, _mm_mul_ps(_mm_cvtepi32_ps(
+          _mm_srai_epi32(_mm_add_epi32(s0, s3), 8)), _mm_set1_ps(UNIFORM_SCALE)));
+      __m128i t = _mm_slli_epi32(s1, 9);
+      s2 = _mm_xor_si128(s2, s0);
+      s3 = _mm_xor_si128(s3, s1);
+      s1 = _mm_xor_si128(s1, s2);
+      s0 = _mm_xor_si128(s0, s3);
+      s2 = _mm_xor_si128(s2, t);
+      s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+    }
+    _mm_storeu_si128((__m128i *) (state[0] + j), s0);
+    _mm_storeu_si128((__m128i *) (state[1] + j), s1);
+    _mm_storeu_si128((__m128i *) (state[2] + j), s2);
+    _mm_storeu_si128((__m128i *) (state[3] + j), s3);
+  }
+  #elif __ARM_NEON__
+  // the two halves of the lanes are independent
+  for (int j = 0; j < RANDOM_GENERATOR_NUM_LANES; j += 4) {
+    uint32x4_t s0 = vld1q_u32(state[0] + j);
+    uint32x4_t s1 = vld1q_u32(state[1] + j);
+    uint32x4_t s2 = vld1q_u32(state[2] + j);
+    uint32x4_t s3 = vld1q_u32(state[3] + j);
+    for (int i = 0; i < numSteps; i++) {
+      vst1q_f32(buffer + i*RANDOM_GENERATOR_NUM_LANES + j, vmulq_n_f32(vcvtq_f32_s32(
+          vshrq_n_s32(vreinterpretq_s32_u32(vaddq_u32(s0, s3)), 8)), UNIFORM_SCALE));
+      uint32x4_t t = vshlq_n_u32(s1, 9);
+      s2 = veorq_u32(s2, s0);
+      s3 = veorq_u32(s3, s1);
+      s1 = veorq_u32(s1, s2);
+      s0 = veorq_u32(s0, s3);
+      s2 = veorq_u32(s2, t);
+      s3 = vsriq_n_u32(vshlq_n_u32(s3, 11), s3, 21);
+    }
+    vst1q_u32(state[0] + j, s0);
+    vst1q_u32(state[1] + j, s1);
+    vst1q_u32(state[2] + j, s2);
+    vst1q_u32(state[3] + j, s3);
+  }
+  #else
+  for (int i = 0; i < numSteps; i++, buffer += RANDOM_GENERATOR_NUM_LANES) {
+    step();
+    for (int j = 0; j < RANDOM_GENERATOR_NUM_LANES; j++) {
+      buffer[j] = ((float) (((int32_t) bits[j]) >> 8)) * UNIFORM_SCALE;
+    }
+  }
+  #endif
+}
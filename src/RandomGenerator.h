@@ -0,0 +1,79 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _RANDOM_GENERATOR_H_
+#define _RANDOM_GENERATOR_H_
+
+#include <stdint.h>
+
+#define RANDOM_GENERATOR_NUM_LANES 8
+
+/**
+ * A pseudo-random number generator for [noise~] and [random]. It consists of eight independent
+ * xoshiro128+ generators (lanes) which are advanced together, such that they are computed with
+ * one or two vector instructions per step. Sample <code>k</code> of the output is taken from lane
+ * <code>k % 8</code>, which makes the sequence the same on every target, however it is vectorised
+ * and however it is split into calls.
+ *
+ * The same seed always yields the same sequence.
+ */
+class RandomGenerator {
+
+  public:
+    RandomGenerator(uint32_t seed);
+
+    /** Restarts the sequence from the given seed. */
+    void seed(uint32_t seed);
+
+    /** Returns the next 32 random bits. */
+    uint32_t nextInt();
+
+    /** Returns the next random integer in [0, range). */
+    uint32_t nextInt(uint32_t range);
+
+    /** Fills the buffer with uniformly distributed random numbers in [-1, 1). */
+    void fillUniform(float *buffer, int length);
+
+    /**
+     * Returns a new seed from the given sequence of seeds, which is advanced. Seeds which are
+     * drawn from a sequence in the same order are the same, and are well distributed even if the
+     * sequence starts from similar values.
+     */
+    static uint32_t nextSeed(uint64_t *sequence);
+
+  private:
+    /** Advances all lanes by one step, and writes the output of each lane to <code>bits</code>. */
+    void step();
+
+    /** Fills the buffer with the uniform output of the given number of steps, one float per lane. */
+    void fillUniformSteps(float *buffer, int numSteps);
+
+    // the state of each lane, by component
+    uint32_t state[4][RANDOM_GENERATOR_NUM_LANES];
+
+    // the output of the last step, which is handed out by nextInt()
+    uint32_t bits[RANDOM_GENERATOR_NUM_LANES];
+    int numBitsUsed;
+};
+
+#endif // _RANDOM_GENERATOR_H_
@@ -0,0 +1,105 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _RING_BUFFER_H_
+#define _RING_BUFFER_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * A lock-free ring buffer of floats with exactly one producer thread and exactly one consumer
+ * thread. Neither side ever blocks or allocates. The read and write counters increase
+ * monotonically and are only masked when indexing, such that a full buffer can be distinguished
+ * from an empty one. The capacity is always a power of two.
+ */
+class RingBuffer {
+
+  public:
+    /** The capacity is rounded up to the next power of two. */
+    RingBuffer(unsigned int minCapacity) {
+      capacity = 1;
+      while (capacity < minCapacity) capacity <<= 1;
+      mask = capacity - 1;
+      buffer = (float *) calloc(capacity, sizeof(float));
+      readIndex = 0;
+      writeIndex = 0;
+    }
+
+    ~RingBuffer() {
+      free(buffer);
+    }
+
+    unsigned int getCapacity() { return capacity; }
+
+    /** The number of floats which may be read. Safe to call from either thread. */
+    unsigned int getNumAvailable() { return writeIndex - readIndex; }
+
+    /** The number of floats which may be written. Safe to call from either thread. */
+    unsigned int getNumFree() { return capacity - (writeIndex - readIndex); }
+
+    /** Producer only. Writes at most n floats and returns the number which were written. */
+    unsigned int write(const float *input, unsigned int n) {
+      unsigned int numFree = getNumFree();
+      if (n > numFree) n = numFree;
+      unsigned int index = writeIndex & mask;
+      unsigned int n0 = (n < capacity - index) ? n : capacity - index;
+      memcpy(buffer + index, input, n0 * sizeof(float));
+      memcpy(buffer, input + n0, (n - n0) * sizeof(float));
+      __sync_synchronize(); // the data must be visible before the index is updated
+      writeIndex += n;
+      return n;
+    }
+
+    /** Consumer only. Reads at most n floats and returns the number which were read. */
+    unsigned int read(float *output, unsigned int n) {
+      unsigned int numAvailable = getNumAvailable();
+      if (n > numAvailable) n = numAvailable;
+      __sync_synchronize(); // do not read the data before the index has been checked
+      unsigned int index = readIndex & mask;
+      unsigned int n0 = (n < capacity - index) ? n : capacity - index;
+      memcpy(output, buffer + index, n0 * sizeof(float));
+      memcpy(output + n0, buffer, (n - n0) * sizeof(float));
+      __sync_synchronize();
+      readIndex += n;
+      return n;
+    }
+
+    /**
+     * Empties the buffer. This may only be called when it is certain that neither the producer nor
+     * the consumer is accessing the buffer.
+     */
+    void reset() {
+      readIndex = 0;
+      writeIndex = 0;
+      __sync_synchronize();
+    }
+
+  private:
+    float *buffer;
+    unsigned int capacity;
+    unsigned int mask;
+    volatile unsigned int readIndex;
+    volatile unsigned int writeIndex;
+};
+
+#endif // _RING_BUFFER_H_
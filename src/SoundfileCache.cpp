@@ -0,0 +1,170 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <sndfile.h>
+#include "SoundfileCache.h"
+
+// the number of frames which are decoded at once
+#define NUM_FRAMES_PER_CHUNK 4096
+
+using namespace std;
+
+const char *SoundfileCache::getDefaultCacheDirectory() {
+  const char *directory = getenv("TMPDIR");
+  return (directory != NULL && directory[0] != '\0') ? directory : "/tmp";
+}
+
+char *SoundfileCache::getCachePath(const char *cacheDirectory, const char *fullPath, int channel) {
+  struct stat fileStat;
+  if (stat(fullPath, &fileStat) != 0) return NULL;
+
+  // 64-bit FNV-1a over the path, size, and modification time of the source
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char *c = fullPath; *c != '\0'; c++) {
+    hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+  }
+  uint64_t values[2] = {(uint64_t) fileStat.st_size, (uint64_t) fileStat.st_mtime};
+  const unsigned char *bytes = (const unsigned char *) values;
+  for (int i = 0; i < sizeof(values); i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+
+  const char *format = "%s/zg-%016llx-%i.f32";
+  char *cachePath = (char *) malloc(snprintf(NULL, 0, format, cacheDirectory, (unsigned long long) hash, channel)+1);
+  sprintf(cachePath, format, cacheDirectory, (unsigned long long) hash, channel);
+  return cachePath;
+}
+
+bool SoundfileCache::createCacheFiles(const char *cacheDirectory, const char *fullPath) {
+  SF_INFO sfInfo;
+  memset(&sfInfo, 0, sizeof(SF_INFO));
+  SNDFILE *sndFile = sf_open(fullPath, SFM_READ, &sfInfo);
+  if (sndFile == NULL) return false;
+  if (sfInfo.channels <= 0) {
+    sf_close(sndFile);
+    return false;
+  }
+
+  // Each channel is written to a temporary file which is renamed into place once complete, such
+  // that concurrent readers (in this or other processes) never map a partially written cache file.
+  int numChannels = sfInfo.channels;
+  vector<char *> cachePaths(numChannels, (char *) NULL);
+  vector<char *> tempPaths(numChannels, (char *) NULL);
+  vector<FILE *> files(numChannels, (FILE *) NULL);
+  bool isValid = true;
+  for (int i = 0; i < numChannels && isValid; i++) {
+    cachePaths[i] = getCachePath(cacheDirectory, fullPath, i);
+    if (cachePaths[i] == NULL) {
+      isValid = false;
+      break;
+    }
+    tempPaths[i] = (char *) malloc(strlen(cachePaths[i]) + 8);
+    sprintf(tempPaths[i], "%s.XXXXXX", cachePaths[i]);
+    int fd = mkstemp(tempPaths[i]);
+    if (fd < 0 || (files[i] = fdopen(fd, "wb")) == NULL) {
+      if (fd >= 0) close(fd);
+      isValid = false;
+    }
+  }
+
+  float *chunk = (float *) malloc(NUM_FRAMES_PER_CHUNK * numChannels * sizeof(float));
+  float *channelChunk = (float *) malloc(NUM_FRAMES_PER_CHUNK * sizeof(float));
+  sf_count_t n = 0;
+  while (isValid && (n = sf_readf_float(sndFile, chunk, NUM_FRAMES_PER_CHUNK)) > 0) {
+    for (int i = 0; i < numChannels; i++) {
+      for (int j = 0, k = i; j < n; j++, k += numChannels) {
+        channelChunk[j] = chunk[k];
+      }
+      if (fwrite(channelChunk, sizeof(float), n, files[i]) != n) isValid = false;
+    }
+  }
+  free(chunk);
+  free(channelChunk);
+  sf_close(sndFile);
+
+  for (int i = 0; i < numChannels; i++) {
+    if (files[i] != NULL && fclose(files[i]) != 0) isValid = false;
+  }
+  // channel 0 is renamed last, as it marks the cache as complete
+  for (int i = numChannels-1; i >= 0; i--) {
+    if (tempPaths[i] != NULL) {
+      if (!isValid || rename(tempPaths[i], cachePaths[i]) != 0) {
+        unlink(tempPaths[i]);
+        isValid = false;
+      }
+    }
+    free(tempPaths[i]);
+    free(cachePaths[i]);
+  }
+  return isValid;
+}
+
+float *SoundfileCache::map(const char *cacheDirectory, const char *fullPath, int channel,
+    bool shouldPrefetch, int *numFrames, size_t *mappingLength) {
+  char *cachePath = getCachePath(cacheDirectory, fullPath, channel);
+  if (cachePath == NULL) return NULL;
+  int fd = open(cachePath, O_RDONLY);
+  if (fd < 0) {
+    // the cache is generated as a whole, and is complete once channel 0 exists
+    char *firstCachePath = getCachePath(cacheDirectory, fullPath, 0);
+    if (firstCachePath != NULL && access(firstCachePath, F_OK) != 0 &&
+        createCacheFiles(cacheDirectory, fullPath)) {
+      fd = open(cachePath, O_RDONLY);
+    }
+    free(firstCachePath);
+  }
+  free(cachePath);
+  if (fd < 0) return NULL; // there is no such channel, or the cache could not be written
+
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0) {
+    close(fd);
+    return NULL;
+  }
+  *numFrames = (int) (fileStat.st_size / sizeof(float));
+  *mappingLength = *numFrames * sizeof(float);
+  if (*mappingLength == 0) {
+    close(fd);
+    return NULL;
+  }
+  // the mapping is writable, such that tables backed by it may be changed like any other. Written
+  // pages are copied and remain private to the mapping, and the cache file itself never changes.
+  void *mapping = mmap(NULL, *mappingLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd); // the mapping keeps the file open
+  if (mapping == MAP_FAILED) return NULL;
+  if (shouldPrefetch) madvise(mapping, *mappingLength, MADV_WILLNEED);
+  return (float *) mapping;
+}
+
+void SoundfileCache::unmap(void *mapping, size_t mappingLength) {
+  if (mapping != NULL) munmap(mapping, mappingLength);
+}
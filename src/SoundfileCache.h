@@ -0,0 +1,67 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _SOUNDFILE_CACHE_H_
+#define _SOUNDFILE_CACHE_H_
+
+#include <stddef.h>
+
+/**
+ * Maintains raw float32 copies of decoded soundfiles, one file per channel, such that tables can
+ * be backed directly by a memory mapping of the samples instead of by a decoded buffer. A cache
+ * file is generated once with libsndfile and is named after the path, size, and modification time
+ * of its source, such that any change to the source invalidates it. Cache files are mapped
+ * privately and copy-on-write: unmodified pages are shared through the page cache by all tables,
+ * contexts, and processes which map the same file, and are read from disk only when first touched.
+ */
+class SoundfileCache {
+
+  public:
+    /**
+     * Maps the cache file of the given channel of a soundfile, generating the cache files first if
+     * necessary. <code>fullPath</code> must already be resolved. Returns the mapping, or NULL if
+     * the soundfile cannot be read or has no such channel. The number of frames in the mapping is
+     * returned in <code>numFrames</code>, and the mapping must be released with
+     * <code>unmap()</code>. If <code>shouldPrefetch</code> is true, the kernel is asked to page in
+     * the whole file in advance. May block, and so should be called from the disk thread.
+     */
+    static float *map(const char *cacheDirectory, const char *fullPath, int channel, bool shouldPrefetch,
+        int *numFrames, size_t *mappingLength);
+
+    static void unmap(void *mapping, size_t mappingLength);
+
+    /** Returns the directory in which cache files are kept when none has been set. */
+    static const char *getDefaultCacheDirectory();
+
+  private:
+    /** Returns the path of the cache file of one channel of a soundfile, or NULL if the soundfile does not exist. */
+    static char *getCachePath(const char *cacheDirectory, const char *fullPath, int channel);
+
+    /**
+     * Decodes a soundfile into one cache file per channel. Channel 0 is always the last to appear,
+     * such that its presence means that the cache of the whole soundfile is complete.
+     */
+    static bool createCacheFiles(const char *cacheDirectory, const char *fullPath);
+};
+
+#endif // _SOUNDFILE_CACHE_H_
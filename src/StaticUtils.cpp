@@ -24,7 +24,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "regex.h"
 #include "StaticUtils.h"
 
 StaticUtils::StaticUtils() {
@@ -46,12 +45,28 @@ char *StaticUtils::copyString(const char *str) {
 }
 
 bool StaticUtils::isNumeric(const char *str) {
+  // matches ^[-+]?[0-9]*\.?[0-9]+([eE][-+]?[0-9]+)?$, as in
   // http://www.regular-expressions.info/floatingpoint.html
-  regex_t preg;
-  regcomp(&preg, "^[-+]?[0-9]*\\.?[0-9]+([eE][-+]?[0-9]+)?$", REG_NOSUB | REG_EXTENDED);
-  bool isFloat = (regexec(&preg, str, 0, NULL, 0) == 0);
-  regfree(&preg);
-  return isFloat;
+  // It is scanned directly, as compiling the expression for every token dominates parsing.
+  const char *c = str;
+  if (*c == '-' || *c == '+') c++;
+  const char *integerPart = c;
+  while (*c >= '0' && *c <= '9') c++;
+  if (*c == '.') {
+    const char *fractionalPart = ++c;
+    while (*c >= '0' && *c <= '9') c++;
+    if (c == fractionalPart) return false;
+  } else if (c == integerPart) {
+    return false;
+  }
+  if (*c == 'e' || *c == 'E') {
+    c++;
+    if (*c == '-' || *c == '+') c++;
+    const char *exponent = c;
+    while (*c >= '0' && *c <= '9') c++;
+    if (c == exponent) return false;
+  }
+  return (*c == '\0');
 }
 
 char *StaticUtils::concatStrings(const char *path0, const char *path1) {
@@ -80,7 +95,7 @@ vector<string> StaticUtils::tokenizeString(const char *str, const char *delim) {
   string s0 = string(str);
   
   const char *head = str;
-  char *tail = NULL;
+  const char *tail = NULL;
   while ((tail = strstr(head, delim)) != NULL) {
     int numBytes = tail-head;
     string nextToken = string(s0, head-str, numBytes);
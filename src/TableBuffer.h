@@ -0,0 +1,105 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _TABLE_BUFFER_H_
+#define _TABLE_BUFFER_H_
+
+#include <stdlib.h>
+#include "SoundfileCache.h"
+
+/**
+ * One immutable version of the storage of a <code>MessageTable</code>. The buffer and its length
+ * never change, such that a reader which has taken a snapshot of the table always sees a
+ * consistent pair. A table changes size or content wholesale by publishing a new version, and the
+ * old one is retired to the context's <code>DiskStreamService</code>. It is deleted there once no
+ * block which could have seen it is still running, and once it is no longer retained.
+ *
+ * Readers on the audio thread need not retain a snapshot which they only use during one block.
+ * Anything which holds on to a snapshot for longer, such as a file being written on the disk
+ * thread, must <code>retain()</code> it on the audio thread and <code>release()</code> it when
+ * done.
+ *
+ * The storage is either a buffer allocated with malloc(), or a memory mapping of a
+ * <code>SoundfileCache</code> file which the buffer points into.
+ */
+class TableBuffer {
+
+  public:
+    /** The table buffer takes ownership of the given buffer, which must have been allocated with malloc(). */
+    TableBuffer(float *buffer, int length, unsigned int version) {
+      this->buffer = buffer;
+      this->length = length;
+      this->version = version;
+      mapping = NULL;
+      mappingLength = 0;
+      refCount = 1; // the reference held by the table
+      nextRetired = NULL;
+      retiredAtBlock = 0;
+    }
+
+    /** The table buffer takes ownership of the given mapping, into which the buffer points. */
+    TableBuffer(float *buffer, int length, unsigned int version, void *mapping, size_t mappingLength) {
+      this->buffer = buffer;
+      this->length = length;
+      this->version = version;
+      this->mapping = mapping;
+      this->mappingLength = mappingLength;
+      refCount = 1;
+      nextRetired = NULL;
+      retiredAtBlock = 0;
+    }
+
+    ~TableBuffer() {
+      if (mapping != NULL) {
+        SoundfileCache::unmap(mapping, mappingLength);
+      } else {
+        free(buffer);
+      }
+    }
+
+    float *getBuffer() { return buffer; }
+    int getLength() { return length; }
+
+    /**
+     * Versions are numbered in increasing order, and no two versions in the process share a
+     * number, such that derived data (e.g., wavetable mipmaps) may be keyed on the version alone.
+     */
+    unsigned int getVersion() { return version; }
+
+    void retain() { __sync_add_and_fetch(&refCount, 1); }
+    void release() { __sync_sub_and_fetch(&refCount, 1); }
+    bool isRetained() { return refCount > 0; }
+
+    // bookkeeping for the DiskStreamService, which collects retired versions
+    TableBuffer *nextRetired;
+    unsigned int retiredAtBlock;
+
+  private:
+    float *buffer;
+    int length;
+    unsigned int version;
+    void *mapping; // NULL unless the buffer is memory mapped
+    size_t mappingLength;
+    volatile int refCount;
+};
+
+#endif // _TABLE_BUFFER_H_
@@ -0,0 +1,274 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "StaticUtils.h"
+#include "WavetableCache.h"
+
+// the higher levels are stored with at least this many points per period of their highest harmonic
+#define LEVEL_OVERSAMPLING 8
+// but no level is shorter than this
+#define MIN_LEVEL_LENGTH 64
+
+/**
+ * An in-place iterative radix-2 complex FFT of length n, a power of two. The inverse transform is
+ * not normalised.
+ */
+static void fft(double *re, double *im, int n, bool isInverse) {
+  // bit-reversal permutation
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      double t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+  for (int size = 2; size <= n; size <<= 1) {
+    double angle = (isInverse ? 2.0 : -2.0) * M_PI / size;
+    double wRe = cos(angle);
+    double wIm = sin(angle);
+    for (int i = 0; i < n; i += size) {
+      double uRe = 1.0;
+      double uIm = 0.0;
+      for (int j = 0; j < size/2; j++) {
+        int k = i + j;
+        int l = k + size/2;
+        double tRe = re[l] * uRe - im[l] * uIm;
+        double tIm = re[l] * uIm + im[l] * uRe;
+        re[l] = re[k] - tRe;
+        im[l] = im[k] - tIm;
+        re[k] += tRe;
+        im[k] += tIm;
+        double nextRe = uRe * wRe - uIm * wIm;
+        uIm = uRe * wIm + uIm * wRe;
+        uRe = nextRe;
+      }
+    }
+  }
+}
+
+WavetableCache::WavetableCache(DiskStreamService *diskStreamService) {
+  this->diskStreamService = diskStreamService;
+  isStarted = false;
+  hasUndeliveredCompletion = false;
+  isDeleting = false;
+}
+
+WavetableCache::~WavetableCache() {
+  if (isStarted) diskStreamService->unregisterStream(this);
+  // pending commands are executed on this thread, but no more mipmaps are built
+  isDeleting = true;
+  service();
+  while (!replacedMipmaps.empty()) {
+    freeMipmap(replacedMipmaps.front());
+    replacedMipmaps.pop();
+  }
+  for (list<WavetableCacheEntry *>::iterator it = entryList.begin(); it != entryList.end(); ++it) {
+    freeMipmap((*it)->mipmap);
+    freeMipmap((*it)->pendingMipmap);
+    free((*it)->name);
+    delete *it;
+  }
+}
+
+void WavetableCache::start() {
+  if (!isStarted) {
+    isStarted = true;
+    diskStreamService->registerStream(this);
+  }
+}
+
+void WavetableCache::freeMipmap(WavetableMipmap *mipmap) {
+  if (mipmap == NULL) return;
+  for (int i = 0; i < mipmap->numLevels; i++) {
+    free(mipmap->levels[i]);
+  }
+  free(mipmap->levels);
+  free(mipmap->levelLengths);
+  free(mipmap);
+}
+
+void WavetableCache::addEntry(const char *tableName) {
+  if (getEntry(tableName) != NULL) return;
+  WavetableCacheEntry *entry = new WavetableCacheEntry();
+  entry->name = StaticUtils::copyString(tableName);
+  entry->mipmap = NULL;
+  entry->pendingTableBuffer = NULL;
+  entry->pendingMipmap = NULL;
+  entry->isPendingDone = false;
+  entryList.push_back(entry);
+}
+
+
+#pragma mark - Audio Thread
+
+WavetableCacheEntry *WavetableCache::getEntry(const char *tableName) {
+  for (list<WavetableCacheEntry *>::iterator it = entryList.begin(); it != entryList.end(); ++it) {
+    if (!strcmp((*it)->name, tableName)) return *it;
+  }
+  return NULL;
+}
+
+WavetableMipmap *WavetableCache::getMipmap(WavetableCacheEntry *entry, TableBuffer *tableBuffer) {
+  if (!replacedMipmaps.empty()) releaseMipmaps();
+  if (entry->mipmap != NULL && entry->mipmap->version == tableBuffer->getVersion()) {
+    return entry->mipmap;
+  }
+  // only one mipmap is built at a time per table. If the table changes again in the meantime,
+  // the latest version is built once the current build has finished.
+  if (entry->pendingTableBuffer == NULL) {
+    DiskStreamCommand *command = getNextCommand();
+    if (command != NULL) {
+      tableBuffer->retain(); // released by the disk thread once the mipmap has been built
+      entry->pendingTableBuffer = tableBuffer;
+      entry->isPendingDone = false;
+      command->type = DISK_STREAM_COMPUTE;
+      command->data = entry;
+      postCommand();
+      diskStreamService->signal();
+    }
+  }
+  return NULL;
+}
+
+void WavetableCache::complete() {
+  for (list<WavetableCacheEntry *>::iterator it = entryList.begin(); it != entryList.end(); ++it) {
+    WavetableCacheEntry *entry = *it;
+    if (entry->pendingTableBuffer != NULL && entry->isPendingDone) {
+      if (entry->pendingMipmap != NULL) {
+        if (entry->mipmap != NULL) replacedMipmaps.push(entry->mipmap);
+        entry->mipmap = entry->pendingMipmap;
+        entry->pendingMipmap = NULL;
+      }
+      entry->pendingTableBuffer = NULL;
+    }
+  }
+  releaseMipmaps();
+}
+
+void WavetableCache::releaseMipmaps() {
+  while (!replacedMipmaps.empty()) {
+    DiskStreamCommand *command = getNextCommand();
+    if (command == NULL) break; // try again later
+    command->type = DISK_STREAM_RELEASE;
+    command->data = replacedMipmaps.front();
+    postCommand();
+    replacedMipmaps.pop();
+  }
+}
+
+
+#pragma mark - Disk Thread
+
+void WavetableCache::executeCommand(DiskStreamCommand *command) {
+  switch (command->type) {
+    case DISK_STREAM_COMPUTE: {
+      WavetableCacheEntry *entry = (WavetableCacheEntry *) command->data;
+      if (!isDeleting) entry->pendingMipmap = buildMipmap(entry->pendingTableBuffer);
+      entry->pendingTableBuffer->release();
+      __sync_synchronize(); // the mipmap must be visible before the build is marked as done
+      entry->isPendingDone = true;
+      if (!isDeleting && !diskStreamService->postCompletion(this)) {
+        hasUndeliveredCompletion = true;
+      }
+      break;
+    }
+    case DISK_STREAM_RELEASE: {
+      freeMipmap((WavetableMipmap *) command->data);
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
+void WavetableCache::transfer() {
+  if (hasUndeliveredCompletion && diskStreamService->postCompletion(this)) {
+    hasUndeliveredCompletion = false;
+  }
+}
+
+WavetableMipmap *WavetableCache::buildMipmap(TableBuffer *tableBuffer) {
+  int length = tableBuffer->getLength() - 3;
+  if (length < 1 || (length & (length-1)) != 0) return NULL;
+  float *period = tableBuffer->getBuffer() + 1; // the first point is a guard point
+
+  WavetableMipmap *mipmap = (WavetableMipmap *) malloc(sizeof(WavetableMipmap));
+  mipmap->version = tableBuffer->getVersion();
+  mipmap->length = length;
+  mipmap->numLevels = 1;
+  while (mipmap->getNumHarmonics(mipmap->numLevels) >= 1) mipmap->numLevels++;
+  mipmap->levels = (float **) malloc(mipmap->numLevels * sizeof(float *));
+  mipmap->levelLengths = (int *) malloc(mipmap->numLevels * sizeof(int));
+
+  // the first level is the waveform itself
+  mipmap->levels[0] = (float *) malloc(length * sizeof(float));
+  memcpy(mipmap->levels[0], period, length * sizeof(float));
+  mipmap->levelLengths[0] = length;
+  if (mipmap->numLevels == 1) return mipmap;
+
+  // the higher levels are resynthesised from the lower harmonics of the spectrum
+  double *spectrumRe = (double *) malloc(length * sizeof(double));
+  double *spectrumIm = (double *) calloc(length, sizeof(double));
+  for (int i = 0; i < length; i++) {
+    spectrumRe[i] = period[i];
+  }
+  fft(spectrumRe, spectrumIm, length, false);
+
+  double *re = (double *) malloc(length * sizeof(double));
+  double *im = (double *) malloc(length * sizeof(double));
+  for (int level = 1; level < mipmap->numLevels; level++) {
+    int numHarmonics = mipmap->getNumHarmonics(level);
+    int levelLength = LEVEL_OVERSAMPLING * numHarmonics;
+    if (levelLength < MIN_LEVEL_LENGTH) levelLength = MIN_LEVEL_LENGTH;
+    if (levelLength > length) levelLength = length;
+
+    memset(re, 0, levelLength * sizeof(double));
+    memset(im, 0, levelLength * sizeof(double));
+    re[0] = spectrumRe[0];
+    for (int k = 1; k <= numHarmonics; k++) {
+      re[k] = spectrumRe[k];
+      im[k] = spectrumIm[k];
+      re[levelLength-k] = spectrumRe[length-k];
+      im[levelLength-k] = spectrumIm[length-k];
+    }
+    fft(re, im, levelLength, true);
+
+    float *buffer = (float *) malloc(levelLength * sizeof(float));
+    for (int i = 0; i < levelLength; i++) {
+      buffer[i] = (float) (re[i] / length);
+    }
+    mipmap->levels[level] = buffer;
+    mipmap->levelLengths[level] = levelLength;
+  }
+  free(re);
+  free(im);
+  free(spectrumRe);
+  free(spectrumIm);
+  return mipmap;
+}
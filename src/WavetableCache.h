@@ -0,0 +1,123 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef _WAVETABLE_CACHE_H_
+#define _WAVETABLE_CACHE_H_
+
+#include <list>
+#include <queue>
+#include "DiskStreamService.h"
+#include "TableBuffer.h"
+
+/**
+ * The band-limited versions of one version of a table's waveform. The waveform is one period of
+ * <code>length</code> points, read from a table with three guard points as by Pd's tabosc4~.
+ * Level <code>l</code> contains only the harmonics up to <code>getNumHarmonics(l)</code>, such
+ * that it can be played without aliasing up to a frequency of
+ * <code>sampleRate / (2 * getNumHarmonics(l))</code>.
+ */
+typedef struct WavetableMipmap {
+  unsigned int version; // the version of the table from which the mipmap is built
+  int length; // the number of points in one period of the waveform, a power of two
+  int numLevels;
+  float **levels; // one period per level
+  int *levelLengths; // the higher levels have fewer harmonics, and so need fewer points
+  
+  int getNumHarmonics(int level) { return (length >> 1) >> level; }
+} WavetableMipmap;
+
+/** The mipmaps of one named table, shared by all [tabosc4~] objects which read it. */
+typedef struct WavetableCacheEntry {
+  char *name; // the name of the table
+  WavetableMipmap *mipmap; // the latest mipmap which has been built, or NULL
+  TableBuffer *pendingTableBuffer; // the retained version from which a mipmap is being built, or NULL
+  WavetableMipmap *pendingMipmap; // written by the disk thread
+  volatile bool isPendingDone;
+} WavetableCacheEntry;
+
+/**
+ * A per-context cache of band-limited wavetable mipmaps, keyed by table name and table version.
+ * The mipmap of a table is built lazily by the context's disk thread once the table has changed,
+ * and is swapped in at the beginning of a block. In the meantime readers should play the table
+ * itself. Only changes which publish a new version of a table (resizing, reading a file, or
+ * setting its buffer) are noticed.
+ */
+class WavetableCache : public DiskStream {
+
+  public:
+    WavetableCache(DiskStreamService *diskStreamService);
+    ~WavetableCache();
+  
+    /** Registers the cache with the disk thread. Must not be called from the audio thread. */
+    void start();
+  
+    /**
+     * Creates the entry of the named table, unless it already exists. Called when a table is
+     * registered with the context, and never from the audio thread.
+     */
+    void addEntry(const char *tableName);
+  
+    /**
+     * Returns the entry of the named table, or NULL if no table of that name has been registered.
+     * The entry remains valid for the life of the cache. It does not allocate, and so may be called
+     * from the audio thread.
+     */
+    WavetableCacheEntry *getEntry(const char *tableName);
+  
+    /**
+     * Returns the mipmap of the given version of a table, or NULL if it is not yet available. In
+     * that case it is built in the background. Called only by the audio thread.
+     */
+    WavetableMipmap *getMipmap(WavetableCacheEntry *entry, TableBuffer *tableBuffer);
+  
+    void complete();
+  
+  protected:
+    void executeCommand(DiskStreamCommand *command);
+    void transfer();
+  
+  private:
+    /**
+     * Computes the mipmap of the given version of a table, or returns NULL if the table does not
+     * have a power of two plus three points. Called only by the disk thread.
+     */
+    static WavetableMipmap *buildMipmap(TableBuffer *tableBuffer);
+  
+    static void freeMipmap(WavetableMipmap *mipmap);
+  
+    /** Hands replaced mipmaps to the disk thread to be freed. Called only by the audio thread. */
+    void releaseMipmaps();
+  
+    DiskStreamService *diskStreamService;
+    bool isStarted;
+  
+    // audio thread state
+    std::list<WavetableCacheEntry *> entryList;
+    std::queue<WavetableMipmap *> replacedMipmaps; // waiting to be handed to the disk thread
+  
+    // disk thread state
+    bool hasUndeliveredCompletion;
+    bool isDeleting;
+};
+
+#endif // _WAVETABLE_CACHE_H_
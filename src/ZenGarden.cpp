@@ -29,6 +29,7 @@
 #include "PdContext.h"
 #include "PdFileParser.h"
 #include "PdGraph.h"
+#include "PdPatchFile.h"
 #include "ZenGarden.h"
 
 /*
@@ -172,6 +173,15 @@ ZGGraph *zg_context_new_graph_from_string(PdContext *context, const char *netlis
   return graph;
 }
 
+ZGGraph *zg_context_new_graph_from_binary(ZGContext *context, const char *path) {
+  return PdPatchFile::newGraph(context, path);
+}
+
+int zg_context_write_binary_patch(ZGContext *context, const char *directory, const char *filename,
+    const char *path) {
+  return PdPatchFile::write(context, directory, filename, path) ? 1 : 0;
+}
+
 void zg_context_process(PdContext *context, float *inputBuffers, float *outputBuffers) {
   context->process(inputBuffers, outputBuffers);
 }
@@ -283,6 +293,30 @@ void zg_context_process_s(ZGContext *context, short *inputBuffers, short *output
   #endif
 }
 
+void zg_context_set_profiling(ZGContext *context, int enabled) {
+  context->setProfiling(enabled != 0);
+}
+
+void zg_context_reset_profile(ZGContext *context) {
+  context->resetProfile();
+}
+
+char *zg_context_get_profile(ZGContext *context) {
+  return context->getProfile();
+}
+
+void zg_context_get_block_statistics(ZGContext *context, ZGBlockStatistics *stats) {
+  context->getBlockStatistics(stats);
+}
+
+void zg_context_reset_block_statistics(ZGContext *context) {
+  context->resetBlockStatistics();
+}
+
+void zg_context_print_block_statistics(ZGContext *context) {
+  context->printBlockStatistics();
+}
+
 void *zg_context_get_userinfo(PdContext *context) {
   return context->callbackUserData;
 }
@@ -309,6 +343,38 @@ ZGObject *zg_context_get_table_for_name(ZGObject *table, const char *name) {
   return NULL; // TODO(mhroth): implement this
 }
 
+void zg_context_set_table_cache_directory(ZGContext *context, const char *directory) {
+  context->setTableCacheDirectory(directory);
+}
+
+void zg_context_set_seed(ZGContext *context, unsigned int seed) {
+  context->setRandomSeed(seed);
+}
+
+void zg_context_set_dsp_fusion(ZGContext *context, int enabled) {
+  context->setDspFusion(enabled != 0);
+}
+
+void zg_context_set_dsp_folding(ZGContext *context, int enabled) {
+  context->setDspFolding(enabled != 0);
+}
+
+void zg_context_set_dsp_sleep(ZGContext *context, int enabled) {
+  context->setDspSleep(enabled != 0);
+}
+
+void zg_context_set_dsp_voice_grouping(ZGContext *context, int enabled) {
+  context->setDspVoiceGrouping(enabled != 0);
+}
+
+void zg_context_set_cosine_accuracy(ZGContext *context, ZGCosineAccuracy accuracy) {
+  switch (accuracy) {
+    case ZG_COSINE_ACCURACY_POLYNOMIAL: context->setCosineAccuracy(COSINE_ACCURACY_POLYNOMIAL); break;
+    case ZG_COSINE_ACCURACY_TABLE:
+    default: context->setCosineAccuracy(COSINE_ACCURACY_TABLE); break;
+  }
+}
+
 
 #pragma mark - Context Un/Register External Receivers
 
@@ -418,10 +484,10 @@ float *zg_table_get_buffer(MessageObject *table, unsigned int *n) {
 void zg_table_set_buffer(MessageObject *table, float *buffer, unsigned int n) {
   if (table != NULL && table->getObjectType() == MESSAGE_TABLE)  {
     MessageTable *messageTable = reinterpret_cast<MessageTable *>(table);
-    messageTable->getGraph()->lockContextIfAttached();
-    float *tableBuffer = messageTable->resizeBuffer(n); // resize the buffer to the new size (if necessary)
-    memcpy(tableBuffer, buffer, n*sizeof(float)); // copy the contents of the buffer to the table
-    messageTable->getGraph()->unlockContextIfAttached();
+    // the contents are copied into a new version of the table, which is published without locking
+    float *tableBuffer = (float *) malloc(n * sizeof(float));
+    memcpy(tableBuffer, buffer, n*sizeof(float));
+    messageTable->setBuffer(tableBuffer, n);
   }
 }
 
@@ -67,6 +67,33 @@ typedef struct ZGReceiverMessagePair {
   ZGMessage *message;
 } ZGReceiverMessagePair;
   
+/**
+ * Timing statistics of <code>zg_context_process()</code>, relative to the duration of one block
+ * (the deadline). All times are in milliseconds.
+ */
+typedef struct ZGBlockStatistics {
+  double deadlineMs; // the duration of one block
+  unsigned int numBlocks; // the number of blocks recorded
+  unsigned int numOverruns; // the number of blocks which took longer than the deadline
+  double minMs;
+  double avgMs;
+  double p99Ms; // 99th percentile, resolved to 1% of the deadline
+  double maxMs;
+  double avgMessageMs; // time spent delivering scheduled messages
+  double maxMessageMs;
+  double avgDspMs; // time spent processing the graphs
+  double maxDspMs;
+  int slowestGraphId; // the id ($0) of the graph which took longest in any one block, or -1 if unknown
+  double slowestGraphMs;
+  double avgSkippedDspNodes; // dsp objects per block which were not processed because their subgraph was asleep
+} ZGBlockStatistics;
+  
+/** Enumerates the methods with which [osc~] and [cos~] compute cosines. */
+typedef enum ZGCosineAccuracy {
+  ZG_COSINE_ACCURACY_TABLE, // a small table with linear interpolation, to within 5e-6. The default.
+  ZG_COSINE_ACCURACY_POLYNOMIAL // a polynomial, to within the precision of a float
+} ZGCosineAccuracy;
+  
 /** Enumerates the kinds of connections in ZenGarden; Message and DSP */
 typedef enum ZGConnectionType {
   ZG_CONNECTION_MESSAGE,
@@ -89,6 +116,24 @@ typedef enum ZGConnectionType {
   /** Create a new graph based on a string representation of the netlist. */
   ZGGraph *zg_context_new_graph_from_string(ZGContext *context, const char *netlist);
   
+  /**
+   * Create a new graph from a binary patch, as written by <code>zg_context_write_binary_patch</code>.
+   * The file is memory-mapped, and neither it nor its abstractions need be parsed. The abstractions
+   * embedded in it are used only by the new graph. Returns NULL if the file is not a binary patch
+   * of this version of ZenGarden.
+   */
+  ZGGraph *zg_context_new_graph_from_binary(ZGContext *context, const char *path);
+  
+  /**
+   * Writes a Pd file, together with all of the abstractions which it uses, to a binary patch at the
+   * given path. The file is loaded once in the context in order to find its abstractions, which
+   * should be registered beforehand as for <code>zg_context_new_graph_from_file</code>. Binary
+   * patches are specific to the version and byte order of the library which writes them. Returns
+   * non-zero on success.
+   */
+  int zg_context_write_binary_patch(ZGContext *context, const char *directory, const char *filename,
+      const char *path);
+  
   /** Remove the graph from the context. */
   //void zg_remove_graph(ZGContext *context, ZGGraph *graph);
   
@@ -131,6 +176,57 @@ typedef enum ZGConnectionType {
   
   /** Returns the global table object with the given name. NULL if the table does not exist. */
   ZGObject *zg_context_get_table_for_name(ZGObject *table, const char *name);
+  
+  /**
+   * Sets the directory in which decoded soundfiles are cached for <code>soundfiler read -map</code>.
+   * Contexts and processes which share a directory share the cached samples. If NULL, or by default,
+   * the directory named by the TMPDIR environment variable (or /tmp) is used.
+   */
+  void zg_context_set_table_cache_directory(ZGContext *context, const char *directory);
+  
+  /**
+   * Selects how [osc~] and [cos~] compute cosines. The polynomial is more accurate, and is faster
+   * on some targets. [cos] and [sin] always use the polynomial.
+   */
+  void zg_context_set_cosine_accuracy(ZGContext *context, ZGCosineAccuracy accuracy);
+  
+  /**
+   * Seeds the random number generators of all [noise~] and [random] objects which are created
+   * afterwards. Graphs which are created in the same order after the same seed produce the same
+   * output on every run and on every platform. By default, every context is seeded differently.
+   */
+  void zg_context_set_seed(ZGContext *context, unsigned int seed);
+  
+  /**
+   * Turns the fusion of chains of elementwise dsp objects, such as [*~] into [+~] into [clip~], on
+   * (non-zero) or off (zero). A fused chain is computed in a single pass, with the same result.
+   * Fusion is on by default, and may be turned off in order to compare.
+   */
+  void zg_context_set_dsp_fusion(ZGContext *context, int enabled);
+  
+  /**
+   * Turns constant folding and the removal of dead dsp objects on (non-zero) or off (zero). Objects
+   * whose output is known in advance, such as [*~ 0], and objects whose output is not used, are
+   * then not processed. Folding is on by default, and may be turned off in order to compare.
+   */
+  void zg_context_set_dsp_folding(ZGContext *context, int enabled);
+  
+  /**
+   * Turns the sleeping of silent subgraphs on (non-zero) or off (zero). A subgraph whose output
+   * has decayed to silence, and which receives only silence and no messages, is then not processed
+   * until either changes. Oscillators in it keep their phase, such that the output is the same as
+   * without sleeping. Sleeping is on by default, and may be turned off in order to compare.
+   */
+  void zg_context_set_dsp_sleep(ZGContext *context, int enabled);
+  
+  /**
+   * Turns the grouping of voices on (non-zero) or off (zero). The instances of a [clone] are then
+   * processed in lockstep, and the same filter in every instance is computed as one bank, with a
+   * filter in each vector lane, where the build supports AVX2. The result differs from that of
+   * filters computed one at a time only by rounding. Grouping is off by default, as filter banks
+   * were measured to be no faster than filters computed one at a time.
+   */
+  void zg_context_set_dsp_voice_grouping(ZGContext *context, int enabled);
 
 
 #pragma mark - Graph
@@ -183,6 +279,40 @@ typedef enum ZGConnectionType {
   void zg_context_process_s(ZGContext *context, short *inputBuffers, short *outputBuffers);
   
   
+#pragma mark - Context Profiling
+  
+  /**
+   * Turns per-object dsp profiling on (non-zero) or off (zero). Profiling is off by default, and
+   * costs nothing while it is off. Counters are retained when profiling is turned off.
+   */
+  void zg_context_set_profiling(ZGContext *context, int enabled);
+  
+  /** Clears all profiling counters of the context. */
+  void zg_context_reset_profile(ZGContext *context);
+  
+  /**
+   * Returns a tab-separated dump of the profiling counters. Each dsp object is listed with the
+   * subpatch in which it lives, followed by a summary grouped by object label. Lines beginning
+   * with '#' describe the columns. The string must be freed by the caller.
+   */
+  char *zg_context_get_profile(ZGContext *context);
+  
+  /**
+   * Fills in the block timing statistics of the context. Statistics are always recorded and this
+   * function may be called from any thread without blocking the audio thread.
+   */
+  void zg_context_get_block_statistics(ZGContext *context, ZGBlockStatistics *stats);
+  
+  /** Clears the block timing statistics. The reset takes effect with the next processed block. */
+  void zg_context_reset_block_statistics(ZGContext *context);
+  
+  /**
+   * Prints a summary of the block timing statistics to the ZG_PRINT_STD callback. The same summary
+   * is printed when the message "blockstats" is sent to "pd".
+   */
+  void zg_context_print_block_statistics(ZGContext *context);
+  
+  
 #pragma mark - Context Send Message
   
   /** Send a message to the named receiver. */
@@ -294,15 +424,22 @@ typedef enum ZGConnectionType {
 #pragma mark - Table
   
   /**
-   * Returns a direct pointer to the table's buffer with a given length. Note that if elements
-   * of the buffer are modified while the context is being processed, a race condition may occur
-   * between the timing of the write and the read by zg_context_process().
+   * Returns a direct pointer to the table's buffer with a given length. The buffer belongs to the
+   * current version of the table. Resizing the table, <code>zg_table_set_buffer()</code> and
+   * reading a file into the table publish a new version, and the buffer of the old one is freed
+   * once two further blocks have begun. The pointer may therefore be used only until the end of
+   * the block after the one during which it was returned. If it is requested between calls to
+   * <code>zg_context_process()</code>, it may be used until the next call has returned, and should
+   * then be requested again. Note that if elements of the buffer are modified while the context is
+   * being processed, a race condition may occur between the timing of the write and the read by
+   * zg_context_process(). Writes to a version which has been replaced are lost.
    */
   float *zg_table_get_buffer(ZGObject *table, unsigned int *n);
   
   /**
    * The table's buffer is resized and copied from the given buffer. This set operation is thread-safe
-   * especially with regards to zg_context_process().
+   * especially with regards to zg_context_process(). It does not lock the context. The new contents
+   * are published as a new version of the table, which readers pick up at their next block.
    */
   void zg_table_set_buffer(ZGObject *table, float *buffer, unsigned int n);
   
@@ -0,0 +1,926 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Times a standard set of stress patches. The patches are generated programmatically such that
+ * they are identical on every run and need not be kept in the repository.
+ *
+ * One JSON object is written per benchmark to the results file (or stdout), e.g.
+ * {"bench":"osc1000","load_ms":3.2,"blocks":6891,"us_per_block":210.4,"realtime_factor":6.9,...}
+ * The realtime factor is the duration of the rendered audio divided by the time taken to render it.
+ *
+ * With -a, the accuracy of each cosine method is measured instead, e.g.
+ * {"accuracy":"polynomial","samples":441000,"max_error":0.00000012,"rms_error":0.00000004}
+ *
+ * With -l, the time taken to load each patch from a Pd file and from a binary patch is compared,
+ * e.g. {"load":"abstractions-500","file_ms":21.3,"binary_ms":12.8,"binary_bytes":19840}
+ * The files are written to TMPDIR (or /tmp), and removed afterwards.
+ *
+ * usage: zg-benchmark [-a | -l] [-s seconds] [-o results.jsonl] [benchmark name ...]
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "ProfileTimer.h"
+#include "ZenGarden.h"
+
+#define BLOCK_SIZE 64
+#define SAMPLE_RATE 44100.0f
+#define NUM_WARMUP_BLOCKS 100
+#define NETLIST_BUFFER_LENGTH 256
+#define NUM_LOAD_REPETITIONS 10
+
+using namespace std;
+
+extern "C" {
+  void *callbackFunction(ZGCallbackFunction function, void *userData, void *ptr) {
+    switch (function) {
+      case ZG_PRINT_ERR: fprintf(stderr, "ERROR: %s\n", (char *) ptr); break;
+      default: break;
+    }
+    return NULL;
+  }
+};
+
+/** A small helper to assemble Pd netlists. Objects are numbered in the order in which they are added. */
+class Netlist {
+  public:
+    Netlist() : numObjects(0) {
+      netlist = "#N canvas 0 0 400 300 10;\n";
+    }
+
+    int obj(const char *format, ...) {
+      char str[NETLIST_BUFFER_LENGTH];
+      va_list ap;
+      va_start(ap, format);
+      vsnprintf(str, sizeof(str), format, ap);
+      va_end(ap);
+      netlist += "#X obj 0 0 ";
+      netlist += str;
+      netlist += ";\n";
+      return numObjects++;
+    }
+
+    /** Adds a message box. Commas must be escaped, as in a Pd file. */
+    int msg(const char *message) {
+      netlist += "#X msg 0 0 ";
+      netlist += message;
+      netlist += ";\n";
+      return numObjects++;
+    }
+
+    void connect(int fromObject, int outlet, int toObject, int inlet) {
+      char str[NETLIST_BUFFER_LENGTH];
+      snprintf(str, sizeof(str), "#X connect %i %i %i %i;\n", fromObject, outlet, toObject, inlet);
+      netlist += str;
+    }
+
+    const char *c_str() { return netlist.c_str(); }
+
+  private:
+    string netlist;
+    int numObjects;
+};
+
+/** 1000 oscillators at different frequencies, summed and sent to the output. */
+static void configureOsc1000(ZGContext *context, Netlist *netlist) {
+  int mul = netlist->obj("*~ 0.001");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 1000; i++) {
+    int osc = netlist->obj("osc~ %g", 100.0f + 3.7f*i);
+    netlist->connect(osc, 0, mul, 0);
+  }
+}
+
+/** As osc1000, with cosines computed by the polynomial. */
+static void configureOsc1000Polynomial(ZGContext *context, Netlist *netlist) {
+  zg_context_set_cosine_accuracy(context, ZG_COSINE_ACCURACY_POLYNOMIAL);
+  configureOsc1000(context, netlist);
+}
+
+/** 256 phasor~ driven cos~ objects, summed and sent to the output. */
+static void configureCos256(ZGContext *context, Netlist *netlist) {
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    int phasor = netlist->obj("phasor~ %g", 100.0f + 3.7f*i);
+    int cos = netlist->obj("cos~");
+    netlist->connect(phasor, 0, cos, 0);
+    netlist->connect(cos, 0, mul, 0);
+  }
+}
+
+/** As cos-256, with cosines computed by the polynomial. */
+static void configureCos256Polynomial(ZGContext *context, Netlist *netlist) {
+  zg_context_set_cosine_accuracy(context, ZG_COSINE_ACCURACY_POLYNOMIAL);
+  configureCos256(context, netlist);
+}
+
+/**
+ * A binary tree of abstractions, ten levels deep (1023 graphs). Each leaf filters its input.
+ * The abstractions are registered in memory, such that no files are needed.
+ */
+static void configureAbstractionTree(ZGContext *context, Netlist *netlist) {
+  const int numLevels = 10;
+  for (int level = 0; level < numLevels; level++) {
+    Netlist abstraction;
+    int inlet = abstraction.obj("inlet~");
+    int outlet = abstraction.obj("outlet~");
+    if (level == 0) {
+      int lop = abstraction.obj("lop~ 1000");
+      abstraction.connect(inlet, 0, lop, 0);
+      abstraction.connect(lop, 0, outlet, 0);
+    } else {
+      int left = abstraction.obj("zgbench-level%i", level-1);
+      int right = abstraction.obj("zgbench-level%i", level-1);
+      abstraction.connect(inlet, 0, left, 0);
+      abstraction.connect(inlet, 0, right, 0);
+      abstraction.connect(left, 0, outlet, 0);
+      abstraction.connect(right, 0, outlet, 0);
+    }
+    char label[32];
+    snprintf(label, sizeof(label), "zgbench-level%i", level);
+    zg_context_register_memorymapped_abstraction(context, label, abstraction.c_str());
+  }
+
+  int noise = netlist->obj("noise~");
+  char label[32];
+  snprintf(label, sizeof(label), "zgbench-level%i", numLevels-1);
+  int tree = netlist->obj(label);
+  int mul = netlist->obj("*~ 0.001");
+  int dac = netlist->obj("dac~");
+  netlist->connect(noise, 0, tree, 0);
+  netlist->connect(tree, 0, mul, 0);
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+}
+
+/**
+ * 500 instances of an abstraction of mostly message objects, with arguments. Its load time is
+ * dominated by the instantiation of the abstraction, which is parsed only once.
+ */
+static void configureAbstractions500(ZGContext *context, Netlist *netlist) {
+  Netlist strip;
+  int inlet = strip.obj("inlet");
+  int route = strip.obj("route set get");
+  int f = strip.obj("f \\$1");
+  int add = strip.obj("+ \\$2");
+  int mul = strip.obj("* 2");
+  int send = strip.obj("s \\$0-value");
+  int receive = strip.obj("r \\$0-value");
+  int pack = strip.obj("pack f f");
+  int unpack = strip.obj("unpack f f");
+  int msg = strip.msg("\\$1 \\$2");
+  int moses = strip.obj("moses 10");
+  int select = strip.obj("select 1 2 3");
+  int outlet = strip.obj("outlet");
+  int inletSignal = strip.obj("inlet~");
+  int mulSignal = strip.obj("*~ \\$1");
+  int lop = strip.obj("lop~ 1000");
+  int outletSignal = strip.obj("outlet~");
+  strip.connect(inlet, 0, route, 0);
+  strip.connect(route, 0, f, 0);
+  strip.connect(route, 1, f, 1);
+  strip.connect(f, 0, add, 0);
+  strip.connect(add, 0, mul, 0);
+  strip.connect(mul, 0, send, 0);
+  strip.connect(receive, 0, pack, 0);
+  strip.connect(pack, 0, unpack, 0);
+  strip.connect(unpack, 0, msg, 0);
+  strip.connect(msg, 0, moses, 0);
+  strip.connect(moses, 0, select, 0);
+  strip.connect(select, 0, outlet, 0);
+  strip.connect(inletSignal, 0, mulSignal, 0);
+  strip.connect(mulSignal, 0, lop, 0);
+  strip.connect(lop, 0, outletSignal, 0);
+  zg_context_register_memorymapped_abstraction(context, "zgbench-strip", strip.c_str());
+
+  const int numStrips = 500;
+  int noise = netlist->obj("noise~");
+  int mulOutput = netlist->obj("*~ 0.002");
+  int dac = netlist->obj("dac~");
+  for (int i = 0; i < numStrips; i++) {
+    int instance = netlist->obj("zgbench-strip %i %i", i, 2*i);
+    netlist->connect(noise, 0, instance, 1);
+    netlist->connect(instance, 1, mulOutput, 0);
+  }
+  netlist->connect(mulOutput, 0, dac, 0);
+  netlist->connect(mulOutput, 0, dac, 1);
+}
+
+/**
+ * 256 counters driven by fast metros, each changing the frequency of an oscillator several times
+ * per block. This stresses message scheduling and the delivery of messages to dsp objects.
+ */
+static void configureMessaging(ZGContext *context, Netlist *netlist) {
+  int loadbang = netlist->obj("loadbang");
+  int mul = netlist->obj("*~ 0.001");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    int metro = netlist->obj("metro %g", 0.25f + 0.01f*i);
+    int f = netlist->obj("f %i", i);
+    int add = netlist->obj("+ 1");
+    int mod = netlist->obj("mod 128");
+    int mtof = netlist->obj("mtof");
+    int osc = netlist->obj("osc~");
+    netlist->connect(loadbang, 0, metro, 0);
+    netlist->connect(metro, 0, f, 0);
+    netlist->connect(f, 0, add, 0);
+    netlist->connect(add, 0, f, 1);
+    netlist->connect(f, 0, mod, 0);
+    netlist->connect(mod, 0, mtof, 0);
+    netlist->connect(mtof, 0, osc, 0);
+    netlist->connect(osc, 0, mul, 0);
+  }
+}
+
+/** 256 sample playback voices, each scanning a one second table with tabread4~ at its own rate. */
+static void configureTableRead256(ZGContext *context, Netlist *netlist) {
+  netlist->obj("table zgbench-table 44100");
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    int phasor = netlist->obj("phasor~ %g", 0.5f + 0.01f*i);
+    int scale = netlist->obj("*~ 44100");
+    int tabread4 = netlist->obj("tabread4~ zgbench-table");
+    netlist->connect(phasor, 0, scale, 0);
+    netlist->connect(scale, 0, tabread4, 0);
+    netlist->connect(tabread4, 0, mul, 0);
+  }
+}
+
+/** 256 band-limited wavetable voices reading one shared table with tabosc4~. */
+static void configureTableOsc256(ZGContext *context, Netlist *netlist) {
+  netlist->obj("table zgbench-wavetable 2051");
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    int sig = netlist->obj("sig~ %g", 55.0f * powf(2.0f, i / 32.0f));
+    int tabosc4 = netlist->obj("tabosc4~ zgbench-wavetable");
+    netlist->connect(sig, 0, tabosc4, 0);
+    netlist->connect(tabosc4, 0, mul, 0);
+  }
+}
+
+/** 256 two-operator FM voices, each an osc~ modulating the frequency of another osc~. */
+static void configureFm256(ZGContext *context, Netlist *netlist) {
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    float frequency = 55.0f * powf(2.0f, i / 32.0f);
+    int modulator = netlist->obj("osc~ %g", 1.5f * frequency);
+    int depth = netlist->obj("*~ %g", 2.0f * frequency);
+    int centre = netlist->obj("+~ %g", frequency);
+    int carrier = netlist->obj("osc~");
+    netlist->connect(modulator, 0, depth, 0);
+    netlist->connect(depth, 0, centre, 0);
+    netlist->connect(centre, 0, carrier, 0);
+    netlist->connect(carrier, 0, mul, 0);
+  }
+}
+
+/** 256 chorus voices, each reading a shared delay line with vd~ at a modulated delay. */
+static void configureVariableDelay256(ZGContext *context, Netlist *netlist) {
+  int noise = netlist->obj("noise~");
+  int delwrite = netlist->obj("delwrite~ zgbench-delay 100");
+  netlist->connect(noise, 0, delwrite, 0);
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    int osc = netlist->obj("osc~ %g", 0.2f + 0.013f*i);
+    int depth = netlist->obj("*~ 5");
+    int centre = netlist->obj("+~ %g", 10.0f + 0.2f*i);
+    int vd = netlist->obj("vd~ zgbench-delay");
+    netlist->connect(osc, 0, depth, 0);
+    netlist->connect(depth, 0, centre, 0);
+    netlist->connect(centre, 0, vd, 0);
+    netlist->connect(vd, 0, mul, 0);
+  }
+}
+
+/**
+ * A multi-tap delay of 256 delread~s on one delay line, each attenuated and summed. The taps are
+ * whole blocks apart.
+ */
+static void configureDelayRead256(ZGContext *context, Netlist *netlist) {
+  int noise = netlist->obj("noise~");
+  int delwrite = netlist->obj("delwrite~ zgbench-taps 400");
+  netlist->connect(noise, 0, delwrite, 0);
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    // a quarter of a sample is added, such that the delay is not truncated to one sample less
+    int delread = netlist->obj("delread~ zgbench-taps %g",
+        (BLOCK_SIZE*(i+1) + 0.25f) * 1000.0f / SAMPLE_RATE);
+    int gain = netlist->obj("*~ %g", 1.0f - i/256.0f);
+    netlist->connect(delread, 0, gain, 0);
+    netlist->connect(gain, 0, mul, 0);
+  }
+}
+
+/**
+ * The multi-tap delay of delread-256 as 16 taps~ of 16 taps each, with each delay half a sample
+ * longer such that every tap is interpolated.
+ */
+static void configureDelayTaps256(ZGContext *context, Netlist *netlist) {
+  int noise = netlist->obj("noise~");
+  int delwrite = netlist->obj("delwrite~ zgbench-taps 400");
+  netlist->connect(noise, 0, delwrite, 0);
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int j = 0; j < 16; j++) {
+    string delays;
+    for (int i = 16*j; i < 16*(j+1); i++) {
+      char str[32];
+      snprintf(str, sizeof(str), " %g", (BLOCK_SIZE*(i+1) + 0.5f) * 1000.0f / SAMPLE_RATE);
+      delays += str;
+    }
+    int taps = netlist->obj("taps~ zgbench-taps%s", delays.c_str());
+    for (int i = 0; i < 16; i++) {
+      int gain = netlist->obj("*~ %g", 1.0f - (16*j+i)/256.0f);
+      netlist->connect(taps, i, gain, 0);
+      netlist->connect(gain, 0, mul, 0);
+    }
+  }
+}
+
+/** 16 fdn~ reverberators of 16 delay lines each over one noise~, with a feedback gain of 0.9. */
+static void configureFdn16x16(ZGContext *context, Netlist *netlist) {
+  int noise = netlist->obj("noise~");
+  int loadbang = netlist->obj("loadbang");
+  int feedback = netlist->obj("f 0.9");
+  netlist->connect(loadbang, 0, feedback, 0);
+  int left = netlist->obj("*~ 0.01");
+  int right = netlist->obj("*~ 0.01");
+  int dac = netlist->obj("dac~");
+  netlist->connect(left, 0, dac, 0);
+  netlist->connect(right, 0, dac, 1);
+  for (int j = 0; j < 16; j++) {
+    string delays;
+    for (int i = 0; i < 16; i++) {
+      char str[32];
+      snprintf(str, sizeof(str), " %g", 20.0f + 3.1f*i + 0.7f*j);
+      delays += str;
+    }
+    int fdn = netlist->obj("fdn~%s", delays.c_str());
+    netlist->connect(noise, 0, fdn, 0);
+    netlist->connect(feedback, 0, fdn, 1);
+    netlist->connect(fdn, 0, left, 0);
+    netlist->connect(fdn, 1, right, 0);
+  }
+}
+
+/** A bank of 256 resonant bp~ filters over one noise~, summed and sent to the output. */
+static void configureBandpass256(ZGContext *context, Netlist *netlist) {
+  int noise = netlist->obj("noise~");
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    int bp = netlist->obj("bp~ %g 20", 55.0f * powf(2.0f, i / 32.0f));
+    netlist->connect(noise, 0, bp, 0);
+    netlist->connect(bp, 0, mul, 0);
+  }
+}
+
+/** 256 resonant vcf~ filters over one noise~, each swept by its own osc~. */
+static void configureVcf256(ZGContext *context, Netlist *netlist) {
+  int noise = netlist->obj("noise~");
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    float frequency = 55.0f * powf(2.0f, i / 32.0f);
+    int lfo = netlist->obj("osc~ %g", 0.1f + 0.01f*i);
+    int depth = netlist->obj("*~ %g", 0.5f * frequency);
+    int centre = netlist->obj("+~ %g", frequency);
+    int vcf = netlist->obj("vcf~ 20");
+    netlist->connect(lfo, 0, depth, 0);
+    netlist->connect(depth, 0, centre, 0);
+    netlist->connect(noise, 0, vcf, 0);
+    netlist->connect(centre, 0, vcf, 1);
+    netlist->connect(vcf, 0, mul, 0);
+  }
+}
+
+/** 256 noise~ generators, summed and sent to the output. */
+static void configureNoise256(ZGContext *context, Netlist *netlist) {
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    int noise = netlist->obj("noise~");
+    netlist->connect(noise, 0, mul, 0);
+  }
+}
+
+/** 256 osc~ shaped by the cubic soft clipper x*(1.5 - 0.5*x*x), each written as one expr~. */
+static void configureExpr256(ZGContext *context, Netlist *netlist) {
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    int osc = netlist->obj("osc~ %g", 55.0f + 1.7f*i);
+    int expr = netlist->obj("expr~ \\$v1*(1.5 - 0.5*\\$v1*\\$v1)");
+    netlist->connect(osc, 0, expr, 0);
+    netlist->connect(expr, 0, mul, 0);
+  }
+}
+
+/** The same soft clippers as expr-256, built from *~ and +~ objects for comparison. */
+static void configureExpr256Objects(ZGContext *context, Netlist *netlist) {
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    int osc = netlist->obj("osc~ %g", 55.0f + 1.7f*i);
+    int square = netlist->obj("*~");
+    int scale = netlist->obj("*~ -0.5");
+    int offset = netlist->obj("+~ 1.5");
+    int clip = netlist->obj("*~");
+    netlist->connect(osc, 0, square, 0);
+    netlist->connect(osc, 0, square, 1);
+    netlist->connect(square, 0, scale, 0);
+    netlist->connect(scale, 0, offset, 0);
+    netlist->connect(osc, 0, clip, 0);
+    netlist->connect(offset, 0, clip, 1);
+    netlist->connect(clip, 0, mul, 0);
+  }
+}
+
+/** 256 osc~, each shaped by a chain of elementwise objects, summed and sent to the output. */
+static void configureChain256(ZGContext *context, Netlist *netlist) {
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  const char *chain[] = {"*~ 0.7", "+~ 0.2", "clip~ -0.5 0.5", "*~ 2", "wrap~", "sqrt~"};
+  for (int i = 0; i < 256; i++) {
+    int previous = netlist->obj("osc~ %g", 55.0f + 1.7f*i);
+    for (int j = 0; j < (int) (sizeof(chain)/sizeof(chain[0])); j++) {
+      int object = netlist->obj(chain[j]);
+      netlist->connect(previous, 0, object, 0);
+      previous = object;
+    }
+    netlist->connect(previous, 0, mul, 0);
+  }
+}
+
+/** As chain-256, with each object processed on its own. */
+static void configureChain256Unfused(ZGContext *context, Netlist *netlist) {
+  zg_context_set_dsp_fusion(context, 0);
+  configureChain256(context, netlist);
+}
+
+/**
+ * 256 voices of osc~ through a muted gain stage and lop~, summed and sent to the output. The lop~
+ * has only ever filtered silence, such that it is folded along with the gain stage.
+ */
+static void configureFold256(ZGContext *context, Netlist *netlist) {
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    int osc = netlist->obj("osc~ %g", 55.0f + 1.7f*i);
+    int gain = netlist->obj("*~ 0");
+    int lop = netlist->obj("lop~ 2000");
+    netlist->connect(osc, 0, gain, 0);
+    netlist->connect(gain, 0, lop, 0);
+    netlist->connect(lop, 0, mul, 0);
+  }
+}
+
+/** As fold-256, with every object processed. */
+static void configureFold256Unfolded(ZGContext *context, Netlist *netlist) {
+  zg_context_set_dsp_folding(context, 0);
+  configureFold256(context, netlist);
+}
+
+/**
+ * 256 voices of osc~ behind a percussive envelope and lop~, in abstractions. Each voice is struck
+ * every three seconds, at staggered times, such that most of them are silent at any one time.
+ */
+static void configureSleep256(ZGContext *context, Netlist *netlist) {
+  Netlist voice;
+  int loadbang = voice.obj("loadbang");
+  int delay = voice.obj("delay \\$2");
+  int metro = voice.obj("metro 3000");
+  int envelope = voice.msg("1 \\, 0 300");
+  int line = voice.obj("line~");
+  int osc = voice.obj("osc~ \\$1");
+  int gain = voice.obj("*~");
+  int lop = voice.obj("lop~ 2000");
+  int outlet = voice.obj("outlet~");
+  voice.connect(loadbang, 0, delay, 0);
+  voice.connect(delay, 0, metro, 0);
+  voice.connect(metro, 0, envelope, 0);
+  voice.connect(envelope, 0, line, 0);
+  voice.connect(osc, 0, gain, 0);
+  voice.connect(line, 0, gain, 1);
+  voice.connect(gain, 0, lop, 0);
+  voice.connect(lop, 0, outlet, 0);
+  zg_context_register_memorymapped_abstraction(context, "zgbench-voice", voice.c_str());
+
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+  for (int i = 0; i < 256; i++) {
+    int object = netlist->obj("zgbench-voice %g %g", 55.0f + 1.7f*i, (3000.0f*i) / 256.0f);
+    netlist->connect(object, 0, mul, 0);
+  }
+}
+
+/** As sleep-256, with silent voices processed as any other. */
+static void configureSleep256Awake(ZGContext *context, Netlist *netlist) {
+  zg_context_set_dsp_sleep(context, 0);
+  configureSleep256(context, netlist);
+}
+
+/**
+ * A [clone] of 256 voices as in sleep-256, allocated by [poly]. A note is played every 3000/256
+ * milliseconds, such that each voice is stolen and struck again every three seconds.
+ */
+static void configureClone256(ZGContext *context, Netlist *netlist) {
+  Netlist voice;
+  int inlet = voice.obj("inlet");
+  int unpack = voice.obj("unpack f f");
+  int mtof = voice.obj("mtof");
+  int osc = voice.obj("osc~");
+  int velocity = voice.obj("/ 127");
+  int envelope = voice.msg("\\$1 \\, 0 300");
+  int line = voice.obj("line~");
+  int gain = voice.obj("*~");
+  int lop = voice.obj("lop~ 2000");
+  int outlet = voice.obj("outlet~");
+  voice.connect(inlet, 0, unpack, 0);
+  voice.connect(unpack, 0, mtof, 0);
+  voice.connect(mtof, 0, osc, 0);
+  voice.connect(unpack, 1, velocity, 0);
+  voice.connect(velocity, 0, envelope, 0);
+  voice.connect(envelope, 0, line, 0);
+  voice.connect(osc, 0, gain, 0);
+  voice.connect(line, 0, gain, 1);
+  voice.connect(gain, 0, lop, 0);
+  voice.connect(lop, 0, outlet, 0);
+  zg_context_register_memorymapped_abstraction(context, "zgbench-polyvoice", voice.c_str());
+
+  int loadbang = netlist->obj("loadbang");
+  int metro = netlist->obj("metro %g", 3000.0f / 256.0f);
+  int counter = netlist->obj("f");
+  int increment = netlist->obj("+ 1");
+  int modulo = netlist->obj("mod 48");
+  int offset = netlist->obj("+ 36");
+  int note = netlist->obj("pack f 100");
+  int poly = netlist->obj("poly 256 1");
+  int pack = netlist->obj("pack f f f");
+  int clone = netlist->obj("clone -s 1 zgbench-polyvoice 256");
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(loadbang, 0, metro, 0);
+  netlist->connect(metro, 0, counter, 0);
+  netlist->connect(counter, 0, increment, 0);
+  netlist->connect(increment, 0, counter, 1);
+  netlist->connect(counter, 0, modulo, 0);
+  netlist->connect(modulo, 0, offset, 0);
+  netlist->connect(offset, 0, note, 0);
+  netlist->connect(note, 0, poly, 0);
+  netlist->connect(poly, 0, pack, 0);
+  netlist->connect(poly, 1, pack, 1);
+  netlist->connect(poly, 2, pack, 2);
+  netlist->connect(pack, 0, clone, 0);
+  netlist->connect(clone, 0, mul, 0);
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+}
+
+/**
+ * A [clone] of 256 filter banks, each of which filters the same noise with bp~, lop~ and hip~. All
+ * instances are busy.
+ */
+static void configureCloneFilters256(ZGContext *context, Netlist *netlist) {
+  Netlist voice;
+  int inlet = voice.obj("inlet~");
+  int bp = voice.obj("bp~ \\$2 5");
+  int lop = voice.obj("lop~ 4000");
+  int hip = voice.obj("hip~ 20");
+  int outlet = voice.obj("outlet~");
+  voice.connect(inlet, 0, bp, 0);
+  voice.connect(bp, 0, lop, 0);
+  voice.connect(lop, 0, hip, 0);
+  voice.connect(hip, 0, outlet, 0);
+  zg_context_register_memorymapped_abstraction(context, "zgbench-filters", voice.c_str());
+
+  int noise = netlist->obj("noise~");
+  int clone = netlist->obj("clone zgbench-filters 256 %g", 100.0f);
+  int mul = netlist->obj("*~ 0.004");
+  int dac = netlist->obj("dac~");
+  netlist->connect(noise, 0, clone, 0);
+  netlist->connect(clone, 0, mul, 0);
+  netlist->connect(mul, 0, dac, 0);
+  netlist->connect(mul, 0, dac, 1);
+}
+
+/**
+ * As clone-filters-256, with voice grouping on, such that the filters are computed as banks of
+ * voices where the build supports AVX2.
+ */
+static void configureCloneFilters256Grouped(ZGContext *context, Netlist *netlist) {
+  zg_context_set_dsp_voice_grouping(context, 1);
+  configureCloneFilters256(context, netlist);
+}
+
+static const struct {
+  const char *name;
+  void (*configure)(ZGContext *context, Netlist *netlist);
+} BENCHMARKS[] = {
+  {"osc1000", &configureOsc1000},
+  {"osc1000-polynomial", &configureOsc1000Polynomial},
+  {"cos-256", &configureCos256},
+  {"cos-256-polynomial", &configureCos256Polynomial},
+  {"abstraction-tree", &configureAbstractionTree},
+  {"abstractions-500", &configureAbstractions500},
+  {"messaging", &configureMessaging},
+  {"tabread4-256", &configureTableRead256},
+  {"vd-256", &configureVariableDelay256},
+  {"delread-256", &configureDelayRead256},
+  {"taps-256", &configureDelayTaps256},
+  {"fdn-16x16", &configureFdn16x16},
+  {"tabosc4-256", &configureTableOsc256},
+  {"fm-256", &configureFm256},
+  {"noise-256", &configureNoise256},
+  {"bp-256", &configureBandpass256},
+  {"vcf-256", &configureVcf256},
+  {"expr-256", &configureExpr256},
+  {"expr-256-objects", &configureExpr256Objects},
+  {"chain-256", &configureChain256},
+  {"chain-256-unfused", &configureChain256Unfused},
+  {"fold-256", &configureFold256},
+  {"fold-256-unfolded", &configureFold256Unfolded},
+  {"sleep-256", &configureSleep256},
+  {"sleep-256-awake", &configureSleep256Awake},
+  {"clone-256", &configureClone256},
+  {"clone-filters-256", &configureCloneFilters256},
+  {"clone-filters-256-grouped", &configureCloneFilters256Grouped},
+  {NULL, NULL}
+};
+
+static bool runBenchmark(const char *name, void (*configure)(ZGContext *, Netlist *),
+    float seconds, FILE *results) {
+  ZGContext *context = zg_context_new(2, 2, BLOCK_SIZE, SAMPLE_RATE, callbackFunction, NULL);
+
+  // the load time includes parsing, object creation and computing the process order
+  uint64_t loadStart = ProfileTimer::now();
+  Netlist netlist;
+  configure(context, &netlist);
+  ZGGraph *graph = zg_context_new_graph_from_string(context, netlist.c_str());
+  if (graph == NULL) {
+    zg_context_delete(context);
+    return false;
+  }
+  zg_graph_attach(graph);
+  double loadMs = ((double) (ProfileTimer::now() - loadStart)) / 1000000.0;
+
+  float inputBuffers[2*BLOCK_SIZE];
+  float outputBuffers[2*BLOCK_SIZE];
+  memset(inputBuffers, 0, sizeof(inputBuffers));
+  for (int i = 0; i < NUM_WARMUP_BLOCKS; i++) {
+    zg_context_process(context, inputBuffers, outputBuffers);
+  }
+  zg_context_reset_block_statistics(context);
+
+  int numBlocks = (int) ((seconds * SAMPLE_RATE) / BLOCK_SIZE);
+  uint64_t start = ProfileTimer::now();
+  for (int i = 0; i < numBlocks; i++) {
+    zg_context_process(context, inputBuffers, outputBuffers);
+  }
+  double elapsedMs = ((double) (ProfileTimer::now() - start)) / 1000000.0;
+
+  ZGBlockStatistics stats;
+  zg_context_get_block_statistics(context, &stats);
+  double simulatedMs = (numBlocks * BLOCK_SIZE * 1000.0) / SAMPLE_RATE;
+  fprintf(results, "{\"bench\":\"%s\",\"load_ms\":%.3f,\"blocks\":%i,\"total_ms\":%.3f,"
+      "\"us_per_block\":%.3f,\"realtime_factor\":%.3f,\"p99_us\":%.3f,\"max_us\":%.3f,"
+      "\"message_us\":%.3f,\"dsp_us\":%.3f,\"overruns\":%u,\"asleep\":%.1f}\n",
+      name, loadMs, numBlocks, elapsedMs, (elapsedMs * 1000.0) / numBlocks,
+      simulatedMs / elapsedMs, stats.p99Ms * 1000.0, stats.maxMs * 1000.0,
+      stats.avgMessageMs * 1000.0, stats.avgDspMs * 1000.0, stats.numOverruns,
+      stats.avgSkippedDspNodes);
+  fflush(results);
+
+  zg_context_delete(context);
+  return true;
+}
+
+/**
+ * Loads the patch in a fresh context, either from the Pd file in the given directory or from the
+ * binary patch at the given path, and returns the time taken in milliseconds, or a negative number
+ * if it could not be loaded. The context is configured as for the benchmark beforehand.
+ */
+static double loadPatch(void (*configure)(ZGContext *, Netlist *), const char *directory,
+    const char *fileName, const char *binaryPath) {
+  ZGContext *context = zg_context_new(2, 2, BLOCK_SIZE, SAMPLE_RATE, callbackFunction, NULL);
+  Netlist netlist;
+  configure(context, &netlist);
+  uint64_t loadStart = ProfileTimer::now();
+  ZGGraph *graph = (binaryPath != NULL) ? zg_context_new_graph_from_binary(context, binaryPath)
+      : zg_context_new_graph_from_file(context, directory, fileName);
+  if (graph != NULL) zg_graph_attach(graph);
+  double loadMs = ((double) (ProfileTimer::now() - loadStart)) / 1000000.0;
+  zg_context_delete(context);
+  return (graph != NULL) ? loadMs : -1.0;
+}
+
+/**
+ * Writes the patch of the benchmark to a Pd file and to a binary patch, and compares the shortest
+ * time taken to load each over a number of repetitions.
+ */
+static bool measureLoadTime(const char *name, void (*configure)(ZGContext *, Netlist *),
+    FILE *results) {
+  const char *directory = getenv("TMPDIR");
+  string path = string((directory != NULL && directory[0] != '\0') ? directory : "/tmp") + "/";
+  string fileName = string("zg-benchmark-") + name + ".pd";
+  string binaryPath = path + "zg-benchmark-" + name + ".zgp";
+
+  ZGContext *context = zg_context_new(2, 2, BLOCK_SIZE, SAMPLE_RATE, callbackFunction, NULL);
+  Netlist netlist;
+  configure(context, &netlist);
+  FILE *fp = fopen((path + fileName).c_str(), "w");
+  if (fp != NULL) {
+    fputs(netlist.c_str(), fp);
+    fclose(fp);
+  }
+  bool isWritten = (fp != NULL) &&
+      zg_context_write_binary_patch(context, path.c_str(), fileName.c_str(), binaryPath.c_str());
+  zg_context_delete(context);
+
+  double fileMs = -1.0;
+  double binaryMs = -1.0;
+  for (int i = 0; i < NUM_LOAD_REPETITIONS && isWritten; i++) {
+    double ms = loadPatch(configure, path.c_str(), fileName.c_str(), NULL);
+    if (fileMs < 0.0 || ms < fileMs) fileMs = ms;
+    ms = loadPatch(configure, NULL, NULL, binaryPath.c_str());
+    if (binaryMs < 0.0 || ms < binaryMs) binaryMs = ms;
+    isWritten = (fileMs >= 0.0 && binaryMs >= 0.0);
+  }
+
+  long binaryLength = 0;
+  fp = fopen(binaryPath.c_str(), "rb");
+  if (fp != NULL) {
+    fseek(fp, 0, SEEK_END);
+    binaryLength = ftell(fp);
+    fclose(fp);
+  }
+  remove((path + fileName).c_str());
+  remove(binaryPath.c_str());
+  if (!isWritten) return false;
+
+  fprintf(results, "{\"load\":\"%s\",\"file_ms\":%.3f,\"binary_ms\":%.3f,\"binary_bytes\":%li}\n",
+      name, fileMs, binaryMs, binaryLength);
+  fflush(results);
+  return true;
+}
+
+/**
+ * Renders a 440Hz osc~ with the given cosine accuracy, and compares it to the cosine computed in
+ * double precision. osc~ advances its 32-bit fixed point phase by the truncated increment, which the
+ * reference does as well, such that only the error of the cosine itself is measured.
+ */
+static bool measureCosineAccuracy(const char *name, ZGCosineAccuracy accuracy, float seconds,
+    FILE *results) {
+  ZGContext *context = zg_context_new(0, 1, BLOCK_SIZE, SAMPLE_RATE, callbackFunction, NULL);
+  zg_context_set_cosine_accuracy(context, accuracy);
+  Netlist netlist;
+  int osc = netlist.obj("osc~ 440");
+  int dac = netlist.obj("dac~");
+  netlist.connect(osc, 0, dac, 0);
+  ZGGraph *graph = zg_context_new_graph_from_string(context, netlist.c_str());
+  if (graph == NULL) {
+    zg_context_delete(context);
+    return false;
+  }
+  zg_graph_attach(graph);
+
+  uint32_t phaseIncrement = (uint32_t) ((440.0 / SAMPLE_RATE) * 4294967296.0);
+  uint32_t phase = 0;
+  double maxError = 0.0;
+  double sumSquaredError = 0.0;
+  int numBlocks = (int) ((seconds * SAMPLE_RATE) / BLOCK_SIZE);
+  float inputBuffer[BLOCK_SIZE]; // the context has no inputs
+  float outputBuffer[BLOCK_SIZE];
+  for (int i = 0; i < numBlocks; i++) {
+    zg_context_process(context, inputBuffer, outputBuffer);
+    for (int j = 0; j < BLOCK_SIZE; j++, phase += phaseIncrement) {
+      double error = fabs(outputBuffer[j] - cos(2.0 * M_PI * (phase / 4294967296.0)));
+      if (error > maxError) maxError = error;
+      sumSquaredError += error * error;
+    }
+  }
+  fprintf(results, "{\"accuracy\":\"%s\",\"samples\":%i,\"max_error\":%.10f,\"rms_error\":%.10f}\n",
+      name, numBlocks * BLOCK_SIZE, maxError, sqrt(sumSquaredError / (numBlocks * BLOCK_SIZE)));
+  fflush(results);
+
+  zg_context_delete(context);
+  return true;
+}
+
+int main(int argc, char * const argv[]) {
+  float seconds = 10.0f;
+  bool measureAccuracy = false;
+  bool measureLoad = false;
+  const char *resultsPath = NULL;
+  vector<string> selected;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-a") == 0) {
+      measureAccuracy = true;
+    } else if (strcmp(argv[i], "-l") == 0) {
+      measureLoad = true;
+    } else if (strcmp(argv[i], "-s") == 0 && i+1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+      resultsPath = argv[++i];
+    } else {
+      selected.push_back(string(argv[i]));
+    }
+  }
+
+  FILE *results = (resultsPath != NULL) ? fopen(resultsPath, "w") : stdout;
+  if (results == NULL) {
+    fprintf(stderr, "Could not open results file %s.\n", resultsPath);
+    return -1;
+  }
+
+  int numFailed = 0;
+  if (measureAccuracy) {
+    if (!measureCosineAccuracy("table", ZG_COSINE_ACCURACY_TABLE, seconds, results)) numFailed++;
+    if (!measureCosineAccuracy("polynomial", ZG_COSINE_ACCURACY_POLYNOMIAL, seconds, results)) numFailed++;
+    if (results != stdout) fclose(results);
+    return numFailed;
+  }
+  for (int i = 0; BENCHMARKS[i].name != NULL; i++) {
+    bool isSelected = selected.empty();
+    for (vector<string>::iterator it = selected.begin(); it != selected.end(); ++it) {
+      if (it->compare(BENCHMARKS[i].name) == 0) isSelected = true;
+    }
+    if (!isSelected) continue;
+    bool isLoaded = measureLoad ? measureLoadTime(BENCHMARKS[i].name, BENCHMARKS[i].configure, results)
+        : runBenchmark(BENCHMARKS[i].name, BENCHMARKS[i].configure, seconds, results);
+    if (!isLoaded) {
+      fprintf(stderr, "Benchmark %s could not be loaded.\n", BENCHMARKS[i].name);
+      numFailed++;
+    }
+  }
+
+  if (results != stdout) fclose(results);
+  return numFailed;
+}
@@ -0,0 +1,511 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * A native golden-output regression runner. It renders every patch in test/ and compares the
+ * printed output with the corresponding .golden.txt file, and every patch in test/dsp/ and
+ * compares the audio output with the corresponding .golden.wav file. It mirrors the JUnit tests
+ * in test/me/rjdj/zengarden but does not require a JVM.
+ *
+ * One JSON object is written per test to the results file (or stdout), e.g.
+ * {"suite":"dsp","test":"DspOsc.pd","result":"pass","blocks":689,"max_error":0,"first_error_block":-1}
+ * A human readable summary is printed to stderr. The exit code is the number of failed tests.
+ *
+ * With -e, every patch in test/dsp/ is also rendered with each of the dsp optimisations switched
+ * on alone, with all of them on, and loaded from a binary patch, and the output is compared with
+ * that of the patch with all of them off. None of these should change the output, e.g.
+ * {"suite":"equivalence","test":"DspSleep.pd","result":"pass","blocks":689,"max_difference":0,"variant":"sleep"}
+ *
+ * usage: zg-golden-test [-e] [-t tolerance] [-o results.jsonl] [test directory]
+ */
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sndfile.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "ZenGarden.h"
+
+#define BLOCK_SIZE 64
+#define SAMPLE_RATE 44100.0f
+#define DSP_TEST_RUNTIME_MS 1000.0f
+#define BLOCK_DURATION_US ((useconds_t) (1000000.0f*BLOCK_SIZE/SAMPLE_RATE))
+
+using namespace std;
+
+/** Some message tests must run longer than a single block. These are the same as in PdObjectTest. */
+static const struct {
+  const char *filename;
+  float runtimeMs;
+} MESSAGE_TEST_RUNTIMES[] = {
+  {"MessageDelay.pd", 2000.0f},
+  {"MessageLine.pd", 3000.0f},
+  {"MessageMetro.pd", 11000.0f},
+  {"MessagePipe.pd", 2000.0f},
+  {"MessageSoundfiler.pd", 1000.0f},
+  {"MessageSoundfilerMap.pd", 1000.0f},
+  {"MessageTimer.pd", 1247.0f},
+  {NULL, 0.0f}
+};
+
+/**
+ * Patches which use the disk thread, to read or write files or to build [tabosc4~] mipmaps, are run
+ * in real time, as by an audio host, such that the disk thread keeps up with them as it would then.
+ */
+static const char *REAL_TIME_TESTS[] = {
+  "DspReadSoundfile.pd",
+  "DspTableOsc4.pd",
+  "DspWriteSoundfile.pd",
+  "MessageSoundfiler.pd",
+  "MessageSoundfilerMap.pd",
+  NULL
+};
+
+/**
+ * Some dsp goldens are rendered from a double-precision reference rather than by ZenGarden itself,
+ * and some objects round differently with the vector instructions of the build. These tests may
+ * differ from their golden by the given number of 16-bit steps, or by the tolerance given with -t
+ * if that is larger.
+ */
+static const struct {
+  const char *filename;
+  int tolerance;
+} DSP_TEST_TOLERANCES[] = {
+  {"DspBiquad.pd", 1},
+  {"DspClone.pd", 1},
+  {"DspCloneFilters.pd", 1},
+  {"DspDelayRead.pd", 1},
+  {"DspDelayTaps.pd", 1},
+  {"DspExpression.pd", 1},
+  {"DspFdn.pd", 1},
+  {"DspFilterExpression.pd", 1},
+  {"DspFolding.pd", 1},
+  {"DspFusedChain.pd", 1},
+  {"DspOscFm.pd", 2},
+  {"DspSleep.pd", 1},
+  {"DspTableOsc4.pd", 1},
+  {"DspVcf.pd", 3},
+  {NULL, 0}
+};
+
+/**
+ * The dsp optimisations of a context, which are checked with -e. Each is set by a function of the
+ * API, and may change the output by no more than the given difference. Grouped filters are computed
+ * in a different order where the build supports AVX2, and so may differ by rounding.
+ */
+static const struct {
+  const char *name;
+  void (*setEnabled)(ZGContext *, int);
+  float maxDifference;
+} DSP_OPTIMISATIONS[] = {
+  {"sleep", zg_context_set_dsp_sleep, 0.0f},
+  {"fusion", zg_context_set_dsp_fusion, 0.0f},
+  {"folding", zg_context_set_dsp_folding, 0.0f},
+  {"grouping", zg_context_set_dsp_voice_grouping, 1.0e-5f},
+  {NULL, NULL, 0.0f}
+};
+
+typedef enum {
+  RESULT_PASS,
+  RESULT_FAIL,
+  RESULT_SKIP
+} TestResult;
+
+static const char *resultToString(TestResult result) {
+  switch (result) {
+    case RESULT_PASS: return "pass";
+    case RESULT_FAIL: return "fail";
+    default: return "skip";
+  }
+}
+
+extern "C" {
+  void *callbackFunction(ZGCallbackFunction function, void *userData, void *ptr) {
+    switch (function) {
+      case ZG_PRINT_STD: {
+        // standard output is collected for comparison with the golden file
+        string *printBuffer = (string *) userData;
+        printBuffer->append((char *) ptr);
+        printBuffer->append("\n");
+        break;
+      }
+      default: break; // errors are ignored, as with the JUnit tests
+    }
+    return NULL;
+  }
+};
+
+/** Returns the number of blocks needed to cover the given runtime. */
+static int numBlocksForRuntime(float runtimeMs) {
+  return (int) (floorf(((runtimeMs/1000.0f)*SAMPLE_RATE)/BLOCK_SIZE)+1);
+}
+
+static bool isRealTimeTest(const string &filename) {
+  for (int i = 0; REAL_TIME_TESTS[i] != NULL; i++) {
+    if (filename.compare(REAL_TIME_TESTS[i]) == 0) return true;
+  }
+  return false;
+}
+
+/** Returns the tolerance of the given dsp test, being at least the given tolerance. */
+static int toleranceForDspTest(const string &filename, int tolerance) {
+  for (int i = 0; DSP_TEST_TOLERANCES[i].filename != NULL; i++) {
+    if (filename.compare(DSP_TEST_TOLERANCES[i].filename) == 0) {
+      return (DSP_TEST_TOLERANCES[i].tolerance > tolerance) ? DSP_TEST_TOLERANCES[i].tolerance : tolerance;
+    }
+  }
+  return tolerance;
+}
+
+/** Returns the sorted list of all .pd files in the given directory. */
+static vector<string> listPatches(const string &directory) {
+  vector<string> patches;
+  DIR *dir = opendir(directory.c_str());
+  if (dir != NULL) {
+    struct dirent *entry = NULL;
+    while ((entry = readdir(dir)) != NULL) {
+      size_t len = strlen(entry->d_name);
+      if (len > 3 && strcmp(entry->d_name + len - 3, ".pd") == 0) {
+        patches.push_back(string(entry->d_name));
+      }
+    }
+    closedir(dir);
+  }
+  sort(patches.begin(), patches.end());
+  return patches;
+}
+
+/** Reads a text file line by line, such that every line (including the last) ends with '\n'. */
+static bool readTextFile(const string &path, string *contents) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == NULL) return false;
+  char buffer[4096];
+  while (fgets(buffer, sizeof(buffer), fp) != NULL) {
+    size_t len = strcspn(buffer, "\r\n");
+    contents->append(buffer, len);
+    if (len < strlen(buffer) || feof(fp)) contents->append("\n");
+  }
+  fclose(fp);
+  return true;
+}
+
+static string goldenPathForPatch(const string &directory, const string &filename, const char *extension) {
+  return directory + filename.substr(0, filename.find('.')) + extension;
+}
+
+static TestResult runMessageTest(const string &directory, const string &filename, int *numBlocks) {
+  string goldenOutput;
+  if (!readTextFile(goldenPathForPatch(directory, filename, ".golden.txt"), &goldenOutput)) {
+    // patches without golden output are still rendered such that crashes are caught
+    goldenOutput.clear();
+  }
+
+  float runtimeMs = 0.0f;
+  for (int i = 0; MESSAGE_TEST_RUNTIMES[i].filename != NULL; i++) {
+    if (filename.compare(MESSAGE_TEST_RUNTIMES[i].filename) == 0) {
+      runtimeMs = MESSAGE_TEST_RUNTIMES[i].runtimeMs;
+    }
+  }
+
+  string printBuffer;
+  ZGContext *context = zg_context_new(2, 2, BLOCK_SIZE, SAMPLE_RATE, callbackFunction, &printBuffer);
+  zg_context_set_seed(context, 0); // such that [noise~] and [random] are repeatable
+  ZGGraph *graph = zg_context_new_graph_from_file(context, directory.c_str(), filename.c_str());
+  if (graph == NULL) {
+    zg_context_delete(context);
+    return RESULT_FAIL;
+  }
+  zg_graph_attach(graph);
+
+  short inputBuffers[2*BLOCK_SIZE];
+  short outputBuffers[2*BLOCK_SIZE];
+  memset(inputBuffers, 0, sizeof(inputBuffers));
+  *numBlocks = numBlocksForRuntime(runtimeMs);
+  bool isRealTime = isRealTimeTest(filename);
+  for (int i = 0; i < *numBlocks; i++) {
+    zg_context_process_s(context, inputBuffers, outputBuffers);
+    if (isRealTime) usleep(BLOCK_DURATION_US);
+  }
+  zg_context_delete(context);
+
+  if (goldenOutput.empty()) return RESULT_SKIP;
+  return (goldenOutput.compare(printBuffer) == 0) ? RESULT_PASS : RESULT_FAIL;
+}
+
+static TestResult runDspTest(const string &directory, const string &filename, int tolerance,
+    int *numBlocks, int *maxError, int *firstErrorBlock) {
+  *numBlocks = 0;
+  *maxError = 0;
+  *firstErrorBlock = -1;
+
+  SF_INFO info;
+  memset(&info, 0, sizeof(SF_INFO));
+  SNDFILE *goldenFile = sf_open(goldenPathForPatch(directory, filename, ".golden.wav").c_str(),
+      SFM_READ, &info);
+
+  string printBuffer;
+  ZGContext *context = zg_context_new(1, 1, BLOCK_SIZE, SAMPLE_RATE, callbackFunction, &printBuffer);
+  zg_context_set_seed(context, 0); // such that [noise~] and [random] are repeatable
+  ZGGraph *graph = zg_context_new_graph_from_file(context, directory.c_str(), filename.c_str());
+  if (graph == NULL) {
+    if (goldenFile != NULL) sf_close(goldenFile);
+    zg_context_delete(context);
+    return RESULT_FAIL;
+  }
+  zg_graph_attach(graph);
+
+  *numBlocks = numBlocksForRuntime(DSP_TEST_RUNTIME_MS);
+  if (goldenFile != NULL) {
+    *numBlocks = min(*numBlocks, (int) (info.frames/BLOCK_SIZE));
+  }
+
+  short inputBuffers[BLOCK_SIZE];
+  short outputBuffers[BLOCK_SIZE];
+  short goldenBuffers[BLOCK_SIZE];
+  memset(inputBuffers, 0, sizeof(inputBuffers));
+  bool isRealTime = isRealTimeTest(filename);
+  for (int i = 0; i < *numBlocks; i++) {
+    zg_context_process_s(context, inputBuffers, outputBuffers);
+    if (isRealTime) usleep(BLOCK_DURATION_US);
+    if (goldenFile != NULL) {
+      sf_readf_short(goldenFile, goldenBuffers, BLOCK_SIZE);
+      for (int j = 0; j < BLOCK_SIZE; j++) {
+        int error = abs(((int) outputBuffers[j]) - ((int) goldenBuffers[j]));
+        if (error > *maxError) *maxError = error;
+        if (error > tolerance && *firstErrorBlock < 0) *firstErrorBlock = i;
+      }
+    }
+  }
+  zg_context_delete(context);
+
+  if (goldenFile == NULL) return RESULT_SKIP;
+  sf_close(goldenFile);
+  return (*maxError <= tolerance) ? RESULT_PASS : RESULT_FAIL;
+}
+
+/**
+ * Renders the given dsp patch for the given number of blocks into the output buffer. Only the
+ * optimisations in the given mask (indexed as <code>DSP_OPTIMISATIONS</code>) are switched on. If a
+ * binary path is given, the patch is loaded from that binary patch instead of from its Pd file.
+ * Returns false if the patch could not be loaded.
+ */
+static bool renderDspPatch(const string &directory, const string &filename, const char *binaryPath,
+    unsigned int optimisations, int numBlocks, float *output) {
+  string printBuffer;
+  ZGContext *context = zg_context_new(1, 1, BLOCK_SIZE, SAMPLE_RATE, callbackFunction, &printBuffer);
+  zg_context_set_seed(context, 0);
+  for (int i = 0; DSP_OPTIMISATIONS[i].name != NULL; i++) {
+    DSP_OPTIMISATIONS[i].setEnabled(context, (optimisations >> i) & 0x1);
+  }
+  ZGGraph *graph = (binaryPath != NULL) ? zg_context_new_graph_from_binary(context, binaryPath)
+      : zg_context_new_graph_from_file(context, directory.c_str(), filename.c_str());
+  if (graph == NULL) {
+    zg_context_delete(context);
+    return false;
+  }
+  zg_graph_attach(graph);
+
+  float inputBuffers[BLOCK_SIZE];
+  memset(inputBuffers, 0, sizeof(inputBuffers));
+  bool isRealTime = isRealTimeTest(filename);
+  for (int i = 0; i < numBlocks; i++) {
+    zg_context_process(context, inputBuffers, output + i*BLOCK_SIZE);
+    if (isRealTime) usleep(BLOCK_DURATION_US);
+  }
+  zg_context_delete(context);
+  return true;
+}
+
+/** Writes the given patch, with its abstractions, to a binary patch at the given path. */
+static bool writeBinaryPatch(const string &directory, const string &filename, const string &path) {
+  string printBuffer;
+  ZGContext *context = zg_context_new(1, 1, BLOCK_SIZE, SAMPLE_RATE, callbackFunction, &printBuffer);
+  int success = zg_context_write_binary_patch(context, directory.c_str(), filename.c_str(), path.c_str());
+  zg_context_delete(context);
+  return (success != 0);
+}
+
+/**
+ * Renders the given dsp patch with all optimisations off, and then with each on alone, with all of
+ * them on, and loaded from a binary patch. Each output must match the first. The variant which
+ * differs most from its allowance is reported.
+ */
+static TestResult runEquivalenceTest(const string &directory, const string &filename, int *numBlocks,
+    float *maxDifference, int *firstDifferenceBlock, const char **variant) {
+  *numBlocks = numBlocksForRuntime(DSP_TEST_RUNTIME_MS);
+  *maxDifference = 0.0f;
+  *firstDifferenceBlock = -1;
+  *variant = "none";
+
+  int numOptimisations = 0;
+  while (DSP_OPTIMISATIONS[numOptimisations].name != NULL) numOptimisations++;
+
+  vector<float> reference(*numBlocks * BLOCK_SIZE);
+  vector<float> output(*numBlocks * BLOCK_SIZE);
+  if (!renderDspPatch(directory, filename, NULL, 0, *numBlocks, &reference[0])) return RESULT_FAIL;
+
+  // the binary patch is written next to the Pd file, such that the files which it opens are found
+  // relative to the same directory, and removed afterwards
+  string binaryPath = directory + filename + ".zgp";
+  if (!writeBinaryPatch(directory, filename, binaryPath)) {
+    *variant = "binary";
+    return RESULT_FAIL;
+  }
+
+  TestResult result = RESULT_PASS;
+  float worstExcess = 0.0f;
+  for (int i = 0; i <= numOptimisations+1; i++) {
+    // the second to last variant has all optimisations on, the last is loaded from the binary patch
+    bool isAll = (i == numOptimisations);
+    bool isBinary = (i == numOptimisations+1);
+    const char *name = isBinary ? "binary" : isAll ? "all" : DSP_OPTIMISATIONS[i].name;
+    unsigned int optimisations = isBinary ? 0 : isAll ? ((0x1 << numOptimisations) - 1) : (0x1 << i);
+    float allowedDifference = 0.0f;
+    for (int j = 0; j < numOptimisations; j++) {
+      if ((optimisations >> j) & 0x1) allowedDifference += DSP_OPTIMISATIONS[j].maxDifference;
+    }
+    if (!renderDspPatch(directory, filename, isBinary ? binaryPath.c_str() : NULL, optimisations,
+        *numBlocks, &output[0])) {
+      unlink(binaryPath.c_str());
+      *variant = name;
+      return RESULT_FAIL;
+    }
+    for (int j = 0; j < *numBlocks * BLOCK_SIZE; j++) {
+      float difference = fabsf(output[j] - reference[j]);
+      // NaN is never equivalent
+      if (difference != difference) difference = INFINITY;
+      if (difference > allowedDifference) {
+        result = RESULT_FAIL;
+        if (difference - allowedDifference > worstExcess) {
+          worstExcess = difference - allowedDifference;
+          *maxDifference = difference;
+          *firstDifferenceBlock = j / BLOCK_SIZE;
+          *variant = name;
+        }
+      } else if (result == RESULT_PASS && difference > *maxDifference) {
+        *maxDifference = difference;
+        *variant = name;
+      }
+    }
+  }
+  unlink(binaryPath.c_str());
+  return result;
+}
+
+int main(int argc, char * const argv[]) {
+  string testDirectory = "./test/";
+  const char *resultsPath = NULL;
+  int tolerance = 0;
+  bool isCheckingEquivalence = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-e") == 0) {
+      isCheckingEquivalence = true;
+    } else if (strcmp(argv[i], "-t") == 0 && i+1 < argc) {
+      tolerance = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+      resultsPath = argv[++i];
+    } else {
+      testDirectory = string(argv[i]);
+      if (testDirectory[testDirectory.length()-1] != '/') testDirectory.append("/");
+    }
+  }
+
+  // patches resolve declared paths and abstractions relative to an absolute root directory
+  char *absoluteDirectory = realpath(testDirectory.c_str(), NULL);
+  if (absoluteDirectory == NULL) {
+    fprintf(stderr, "Could not find test directory %s.\n", testDirectory.c_str());
+    return -1;
+  }
+  testDirectory = string(absoluteDirectory) + "/";
+  free(absoluteDirectory);
+
+  FILE *results = (resultsPath != NULL) ? fopen(resultsPath, "w") : stdout;
+  if (results == NULL) {
+    fprintf(stderr, "Could not open results file %s.\n", resultsPath);
+    return -1;
+  }
+
+  int numTests[3] = {0, 0, 0}; // indexed by TestResult
+
+  // message tests
+  vector<string> patches = listPatches(testDirectory);
+  for (vector<string>::iterator it = patches.begin(); it != patches.end(); ++it) {
+    int numBlocks = 0;
+    TestResult result = runMessageTest(testDirectory, *it, &numBlocks);
+    numTests[result]++;
+    fprintf(results, "{\"suite\":\"message\",\"test\":\"%s\",\"result\":\"%s\",\"blocks\":%i}\n",
+        it->c_str(), resultToString(result), numBlocks);
+    if (result == RESULT_FAIL) fprintf(stderr, "FAIL: %s\n", it->c_str());
+    fflush(results); // keep results of completed tests, should a later one crash
+  }
+
+  // dsp tests
+  string dspDirectory = testDirectory + "dsp/";
+  patches = listPatches(dspDirectory);
+  for (vector<string>::iterator it = patches.begin(); it != patches.end(); ++it) {
+    int numBlocks = 0;
+    int maxError = 0;
+    int firstErrorBlock = -1;
+    int testTolerance = toleranceForDspTest(*it, tolerance);
+    TestResult result = runDspTest(dspDirectory, *it, testTolerance, &numBlocks, &maxError, &firstErrorBlock);
+    numTests[result]++;
+    fprintf(results, "{\"suite\":\"dsp\",\"test\":\"%s\",\"result\":\"%s\",\"blocks\":%i,"
+        "\"max_error\":%i,\"first_error_block\":%i}\n",
+        it->c_str(), resultToString(result), numBlocks, maxError, firstErrorBlock);
+    fflush(results);
+    if (result == RESULT_FAIL) {
+      fprintf(stderr, "FAIL: dsp/%s (max error %i at tolerance %i, first at %.3fs)\n", it->c_str(),
+          maxError, testTolerance, (firstErrorBlock * BLOCK_SIZE) / SAMPLE_RATE);
+    }
+  }
+
+  // equivalence of the dsp optimisations
+  for (vector<string>::iterator it = patches.begin(); it != patches.end() && isCheckingEquivalence; ++it) {
+    int numBlocks = 0;
+    float maxDifference = 0.0f;
+    int firstDifferenceBlock = -1;
+    const char *variant = NULL;
+    TestResult result = runEquivalenceTest(dspDirectory, *it, &numBlocks, &maxDifference,
+        &firstDifferenceBlock, &variant);
+    numTests[result]++;
+    fprintf(results, "{\"suite\":\"equivalence\",\"test\":\"%s\",\"result\":\"%s\",\"blocks\":%i,"
+        "\"max_difference\":%g,\"variant\":\"%s\"}\n",
+        it->c_str(), resultToString(result), numBlocks, maxDifference, variant);
+    fflush(results);
+    if (result == RESULT_FAIL) {
+      fprintf(stderr, "FAIL: equivalence/%s (differs with %s by %g, first at %.3fs)\n", it->c_str(),
+          variant, maxDifference, (firstDifferenceBlock * BLOCK_SIZE) / SAMPLE_RATE);
+    }
+  }
+
+  if (results != stdout) fclose(results);
+  fprintf(stderr, "%i passed, %i failed, %i skipped (no golden file).\n",
+      numTests[RESULT_PASS], numTests[RESULT_FAIL], numTests[RESULT_SKIP]);
+
+  return numTests[RESULT_FAIL];
+}
@@ -0,0 +1,65 @@
+/*
+ *  Copyright 2012 Reality Jockey, Ltd.
+ *                 info@rjdj.me
+ *                 http://rjdj.me/
+ *
+ *  This file is part of ZenGarden.
+ *
+ *  ZenGarden is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  ZenGarden is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with ZenGarden.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+/*
+ * Writes a Pd file, with all of the abstractions which it uses, to a binary patch which can be
+ * loaded with zg_context_new_graph_from_binary(). Abstractions are found as they are when the Pd
+ * file is loaded with zg_context_new_graph_from_file(), relative to the file and its declared paths.
+ *
+ * usage: zg-patch-compiler input.pd output.zgp
+ */
+
+#include <stdio.h>
+#include <string>
+
+#include "ZenGarden.h"
+
+using namespace std;
+
+extern "C" {
+  void *callbackFunction(ZGCallbackFunction function, void *userData, void *ptr) {
+    switch (function) {
+      case ZG_PRINT_ERR: fprintf(stderr, "ERROR: %s\n", (char *) ptr); break;
+      default: break;
+    }
+    return NULL;
+  }
+};
+
+int main(int argc, char * const argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s input.pd output.zgp\n", argv[0]);
+    return -1;
+  }
+
+  // the directory of the input file includes the trailing separator
+  string inputPath = string(argv[1]);
+  size_t separator = inputPath.find_last_of('/');
+  string directory = (separator == string::npos) ? string("./") : inputPath.substr(0, separator + 1);
+  string fileName = (separator == string::npos) ? inputPath : inputPath.substr(separator + 1);
+
+  ZGContext *context = zg_context_new(2, 2, 64, 44100.0f, callbackFunction, NULL);
+  int success = zg_context_write_binary_patch(context, directory.c_str(), fileName.c_str(), argv[2]);
+  zg_context_delete(context);
+  return success ? 0 : -1;
+}